@@ -11,6 +11,7 @@
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 
+#include <cstring>
 #include <unordered_map>
 #include <optional>
 
@@ -242,6 +243,26 @@ namespace wallet_types
         crypto::SecretKey ownerPrivateSpendKey;
     };
 
+    /* Where a transaction is in the wallet's history, which is ordered by
+       block height, then hash. The next page of a paginated query starts
+       after the cursor of the last transaction in the previous one. */
+    struct TransactionCursor
+    {
+        uint64_t blockHeight;
+
+        crypto::Hash hash;
+
+        bool operator<(const TransactionCursor &other) const
+        {
+            if (blockHeight != other.blockHeight)
+            {
+                return blockHeight < other.blockHeight;
+            }
+
+            return std::memcmp(hash.data, other.hash.data, sizeof(hash.data)) < 0;
+        }
+    };
+
     class Transaction
     {
     public:
@@ -301,6 +322,11 @@ namespace wallet_types
             return fee == 0 && !isCoinbaseTransaction;
         }
 
+        TransactionCursor cursor() const
+        {
+            return {blockHeight, hash};
+        }
+
         /////////////////////////////
         /* Public member variables */
         /////////////////////////////
@@ -0,0 +1,343 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+#include <cxxopts.hpp>
+#include <config/cli_header.h>
+#include <config/cryptonote_config.h>
+
+#include <syst/context_group.h>
+#include <syst/dispatcher.h>
+#include <syst/ipv4_address.h>
+#include <syst/tcp_connection.h>
+#include <syst/tcp_connector.h>
+#include <syst/tcp_listener.h>
+
+#include "crypto/random.h"
+#include "cryptonote_core/block_template_candidates.h"
+
+#define BLOCK_TEMPLATE_TRANSACTIONS 10000
+#define BLOCK_TEMPLATE_ITERATIONS 1000
+
+#define CONTEXT_SWITCH_ITERATIONS 1000000
+#define ECHO_MESSAGES 20000
+#define ECHO_MESSAGE_SIZE 4096
+#define ECHO_PORT 32347
+
+using namespace cryptonote;
+
+namespace
+{
+    crypto::Hash randomHash()
+    {
+        crypto::Hash hash;
+
+        for (auto &byte : hash.data)
+        {
+            byte = rnd::randomValue<uint8_t>();
+        }
+
+        return hash;
+    }
+
+    void addRandomTransaction(BlockTemplateCandidates &candidates, std::vector<crypto::Hash> &pool, const uint64_t receiveTime)
+    {
+        const crypto::Hash hash = randomHash();
+
+        /* One in twenty is a fusion transaction */
+        const bool fusion = rnd::randomValue<int>(0, 19) == 0;
+
+        const uint64_t fee = fusion ? 0 : rnd::randomValue<uint64_t>(10, 10000);
+        const size_t size = rnd::randomValue<size_t>(400, 3000);
+
+        candidates.add(hash, fee, size, receiveTime);
+        pool.push_back(hash);
+    }
+}
+
+/* How long it takes to pick the transactions for a block template out of a
+   pool of this many transactions. The first template at a height validates
+   every transaction it looks at, later ones at the same height reuse that.
+   Between templates, one transaction leaves the pool and another one joins,
+   as happens on a busy node, and both are reported as the core does. */
+void benchmarkBlockTemplate(const int transactionCount, const int iterations)
+{
+    BlockTemplateCandidates candidates;
+
+    std::vector<crypto::Hash> pool;
+    pool.reserve(transactionCount);
+
+    for (int i = 0; i < transactionCount; i++)
+    {
+        addRandomTransaction(candidates, pool, i);
+    }
+
+    std::unordered_set<crypto::Hash> inPool(pool.begin(), pool.end());
+
+    uint64_t validations = 0;
+
+    const auto isInPool = [&inPool](const crypto::Hash &hash) {
+        return inPool.find(hash) != inPool.end();
+    };
+
+    const auto isValid = [&validations](const crypto::Hash &, const uint64_t) {
+        validations++;
+        return true;
+    };
+
+    const size_t medianSize = parameters::CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE;
+    const size_t maxTotalSize = (125 * medianSize) / 100 - parameters::CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+
+    const uint64_t height = 1000000;
+
+    const crypto::Hash topBlockHash = randomHash();
+
+    std::vector<crypto::Hash> hashes;
+    size_t transactionsSize;
+    uint64_t fee;
+
+    /* New top block, nothing validated yet */
+    auto startTimer = std::chrono::high_resolution_clock::now();
+
+    candidates.fill(height, topBlockHash, medianSize, maxTotalSize, parameters::FUSION_TX_MAX_SIZE, inPool.size(), isInPool, isValid, hashes, transactionsSize, fee);
+
+    const auto coldTime = std::chrono::high_resolution_clock::now() - startTimer;
+
+    std::cout << "Pool transactions: " << candidates.size() << std::endl
+              << "Transactions in template: " << hashes.size() << " (" << transactionsSize << " bytes)" << std::endl
+              << "First template at a height: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(coldTime).count() << " us, "
+              << validations << " validations" << std::endl;
+
+    validations = 0;
+
+    std::chrono::high_resolution_clock::duration warmTime{};
+
+    for (int i = 0; i < iterations; i++)
+    {
+        /* Pool churn - one out, one in */
+        const size_t evicted = rnd::randomValue<size_t>(0, pool.size() - 1);
+        inPool.erase(pool[evicted]);
+        candidates.remove(pool[evicted]);
+        pool[evicted] = pool.back();
+        pool.pop_back();
+
+        addRandomTransaction(candidates, pool, transactionCount + i);
+        inPool.insert(pool.back());
+
+        hashes.clear();
+
+        startTimer = std::chrono::high_resolution_clock::now();
+
+        candidates.fill(height, topBlockHash, medianSize, maxTotalSize, parameters::FUSION_TX_MAX_SIZE, inPool.size(), isInPool, isValid, hashes, transactionsSize, fee);
+
+        warmTime += std::chrono::high_resolution_clock::now() - startTimer;
+    }
+
+    std::cout << "Later templates at the same height: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(warmTime).count() / iterations << " us, "
+              << static_cast<double>(validations) / iterations << " validations" << std::endl;
+}
+
+/* How long the dispatcher takes to switch from one context to another and
+   back again */
+void benchmarkContextSwitch(const int iterations)
+{
+    syst::Dispatcher dispatcher;
+
+    syst::NativeContext *mainContext = dispatcher.getCurrentContext();
+    syst::NativeContext *otherContext = nullptr;
+
+    bool done = false;
+
+    syst::ContextGroup group(dispatcher);
+
+    group.spawn([&]() {
+        otherContext = dispatcher.getCurrentContext();
+
+        while (!done)
+        {
+            dispatcher.pushContext(mainContext);
+            dispatcher.dispatch();
+        }
+    });
+
+    /* Let it start up, so the stack is allocated before timing */
+    dispatcher.yield();
+
+    const auto startTimer = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        dispatcher.pushContext(otherContext);
+        dispatcher.dispatch();
+    }
+
+    const auto elapsed = std::chrono::high_resolution_clock::now() - startTimer;
+
+    done = true;
+    dispatcher.pushContext(otherContext);
+    group.wait();
+
+    std::cout << "Round trips: " << iterations << std::endl
+              << "Per round trip: "
+              << static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / iterations
+              << " ns" << std::endl;
+}
+
+/* Sends messages to a server on the loopback interface which sends each one
+   straight back, one at a time. Mostly measures how quickly the dispatcher
+   gets a context going again once its socket is ready. */
+void benchmarkEcho(const int messages, const int messageSize, const uint16_t port)
+{
+    syst::Dispatcher dispatcher;
+
+    const syst::Ipv4Address loopback("127.0.0.1");
+
+    syst::TcpListener listener(dispatcher, loopback, port);
+
+    syst::ContextGroup group(dispatcher);
+
+    group.spawn([&]() {
+        syst::TcpConnection connection = listener.accept();
+
+        std::vector<uint8_t> buffer(messageSize);
+
+        for (;;)
+        {
+            const size_t received = connection.read(buffer.data(), buffer.size());
+
+            if (received == 0)
+            {
+                break;
+            }
+
+            for (size_t sent = 0; sent < received;)
+            {
+                sent += connection.write(buffer.data() + sent, received - sent);
+            }
+        }
+    });
+
+    syst::TcpConnection connection = syst::TcpConnector(dispatcher).connect(loopback, port);
+
+    std::vector<uint8_t> message(messageSize);
+    std::vector<uint8_t> reply(messageSize);
+
+    for (auto &byte : message)
+    {
+        byte = rnd::randomValue<uint8_t>();
+    }
+
+    const auto startTimer = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < messages; i++)
+    {
+        for (size_t sent = 0; sent < message.size();)
+        {
+            sent += connection.write(message.data() + sent, message.size() - sent);
+        }
+
+        for (size_t received = 0; received < reply.size();)
+        {
+            const size_t transferred = connection.read(reply.data() + received, reply.size() - received);
+
+            if (transferred == 0)
+            {
+                throw std::runtime_error("Echo server closed the connection");
+            }
+
+            received += transferred;
+        }
+    }
+
+    const auto elapsed = std::chrono::high_resolution_clock::now() - startTimer;
+
+    /* Shut down our end, so the server sees the end of the stream */
+    connection.write(nullptr, 0);
+    group.wait();
+
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+
+    std::cout << "Messages: " << messages << " of " << messageSize << " bytes" << std::endl
+              << "Round trips per second: " << messages / seconds << std::endl
+              << "Throughput: " << (2.0 * messages * messageSize) / seconds / (1024 * 1024) << " MiB/s" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    bool o_help, o_version;
+    int o_transactions;
+    int o_iterations;
+    int o_switches;
+    int o_messages;
+    int o_messageSize;
+    uint16_t o_port;
+
+    cxxopts::Options options(argv[0], getProjectCLIHeader());
+
+    options.add_options("Core")("h,help", "Display this help message", cxxopts::value<bool>(o_help)->implicit_value("true"))("v,version", "Output software version information", cxxopts::value<bool>(o_version)->default_value("false")->implicit_value("true"));
+
+    options.add_options("Block Template")("t,transactions", "The number of transactions in the pool", cxxopts::value<int>(o_transactions)->default_value(std::to_string(BLOCK_TEMPLATE_TRANSACTIONS)), "#")("i,iterations", "The number of block templates to time", cxxopts::value<int>(o_iterations)->default_value(std::to_string(BLOCK_TEMPLATE_ITERATIONS)), "#");
+
+    options.add_options("Dispatcher")("switches", "The number of context switch round trips to time", cxxopts::value<int>(o_switches)->default_value(std::to_string(CONTEXT_SWITCH_ITERATIONS)), "#")("messages", "The number of messages to echo", cxxopts::value<int>(o_messages)->default_value(std::to_string(ECHO_MESSAGES)), "#")("message-size", "The size of each echoed message", cxxopts::value<int>(o_messageSize)->default_value(std::to_string(ECHO_MESSAGE_SIZE)), "#")("port", "The loopback port to run the echo server on", cxxopts::value<uint16_t>(o_port)->default_value(std::to_string(ECHO_PORT)), "#");
+
+    try
+    {
+        auto result = options.parse(argc, argv);
+    }
+    catch (const cxxopts::OptionException &e)
+    {
+        std::cout << "Error: Unable to parse command line argument options: " << e.what() << std::endl
+                  << std::endl;
+        std::cout << options.help({}) << std::endl;
+        exit(1);
+    }
+
+    if (o_help) // Do we want to display the help message?
+    {
+        std::cout << options.help({}) << std::endl;
+        exit(0);
+    }
+    else if (o_version) // Do we want to display the software version?
+    {
+        std::cout << getProjectCLIHeader() << std::endl;
+        exit(0);
+    }
+
+    if (o_transactions < 1 || o_iterations < 1)
+    {
+        std::cout << "Error: --transactions and --iterations must be at least 1" << std::endl;
+        exit(1);
+    }
+
+    if (o_switches < 1 || o_messages < 1 || o_messageSize < 1)
+    {
+        std::cout << "Error: --switches, --messages and --message-size must be at least 1" << std::endl;
+        exit(1);
+    }
+
+    std::cout << getProjectCLIHeader() << std::endl;
+
+    std::cout << "Block template" << std::endl;
+
+    benchmarkBlockTemplate(o_transactions, o_iterations);
+
+    std::cout << std::endl
+              << "Context switch" << std::endl;
+
+    benchmarkContextSwitch(o_switches);
+
+    std::cout << std::endl
+              << "Loopback echo" << std::endl;
+
+    benchmarkEcho(o_messages, o_messageSize, o_port);
+
+    return 0;
+}
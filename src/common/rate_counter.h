@@ -0,0 +1,98 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <algorithm>
+
+#include <chrono>
+
+#include <cstdint>
+
+#include <mutex>
+
+#include <vector>
+
+/* Counts events, and how many happened per second, averaged over the last
+   few whole seconds. Safe to use from several threads. */
+class RateCounter
+{
+public:
+    explicit RateCounter(const size_t windowSeconds = 10) :
+        m_buckets(std::max<size_t>(windowSeconds, 1) + 1, 0),
+        m_lastSecond(now()),
+        m_total(0)
+    {
+    }
+
+    void add(const uint64_t count = 1)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        advance(now());
+
+        m_buckets[m_lastSecond % m_buckets.size()] += count;
+        m_total += count;
+    }
+
+    /* The second in progress isn't complete, so isn't included */
+    double perSecond() const
+    {
+        std::scoped_lock lock(m_mutex);
+
+        advance(now());
+
+        uint64_t count = 0;
+
+        for (size_t i = 0; i < m_buckets.size(); i++)
+        {
+            if (i != m_lastSecond % m_buckets.size())
+            {
+                count += m_buckets[i];
+            }
+        }
+
+        return static_cast<double>(count) / (m_buckets.size() - 1);
+    }
+
+    uint64_t total() const
+    {
+        std::scoped_lock lock(m_mutex);
+
+        return m_total;
+    }
+
+private:
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /* Empties the buckets of the seconds nothing happened in since the last
+       event, so they don't count events from a previous trip round */
+    void advance(const uint64_t second) const
+    {
+        const uint64_t elapsed = std::min<uint64_t>(second - m_lastSecond, m_buckets.size());
+
+        for (uint64_t i = 1; i <= elapsed; i++)
+        {
+            m_buckets[(m_lastSecond + i) % m_buckets.size()] = 0;
+        }
+
+        m_lastSecond = second;
+    }
+
+    /* Events per second, indexed by the second modulo the size. One more
+       than the window, for the second in progress. */
+    mutable std::vector<uint64_t> m_buckets;
+
+    /* The second of the most recent add() or perSecond() */
+    mutable uint64_t m_lastSecond;
+
+    uint64_t m_total;
+
+    mutable std::mutex m_mutex;
+};
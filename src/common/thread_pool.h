@@ -0,0 +1,133 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <algorithm>
+
+#include <condition_variable>
+
+#include <functional>
+
+#include <future>
+
+#include <memory>
+
+#include <mutex>
+
+#include <queue>
+
+#include <thread>
+
+#include <vector>
+
+/* A fixed size pool of worker threads. Jobs are queued with addJob() and
+   executed in FIFO order on the first free worker. The returned future can
+   be used to wait for, and retrieve the result of, the job. */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(const size_t threadCount = std::thread::hardware_concurrency()) : m_shouldStop(false)
+    {
+        /* hardware_concurrency() is allowed to return 0 if it can't figure
+           it out, always have at least one worker */
+        const size_t workerCount = std::max<size_t>(threadCount, 1);
+
+        for (size_t i = 0; i < workerCount; i++)
+        {
+            m_threads.emplace_back(&ThreadPool::worker, this);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_shouldStop = true;
+        }
+
+        /* Wake up every worker so they can see we're stopping. Any jobs still
+           in the queue are completed first. */
+        m_haveJob.notify_all();
+
+        for (auto &thread : m_threads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    template <typename F>
+    auto addJob(F &&job) -> std::future<decltype(job())>
+    {
+        using ResultType = decltype(job());
+
+        /* std::function must be copyable, packaged_task is not */
+        auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(job));
+
+        std::future<ResultType> result = task->get_future();
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobs.emplace([task]()
+                           { (*task)(); });
+        }
+
+        m_haveJob.notify_one();
+
+        return result;
+    }
+
+    size_t size() const
+    {
+        return m_threads.size();
+    }
+
+private:
+    void worker()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                m_haveJob.wait(lock, [&]
+                               { return m_shouldStop || !m_jobs.empty(); });
+
+                /* Only exit once the queue has been drained, so no futures
+                   are left without a value */
+                if (m_shouldStop && m_jobs.empty())
+                {
+                    return;
+                }
+
+                job = std::move(m_jobs.front());
+                m_jobs.pop();
+            }
+
+            job();
+        }
+    }
+
+    /* The worker threads */
+    std::vector<std::thread> m_threads;
+
+    /* Jobs waiting for a free worker */
+    std::queue<std::function<void()>> m_jobs;
+
+    /* Protects m_jobs and m_shouldStop */
+    std::mutex m_mutex;
+
+    /* Triggered when a job is added, or we're stopping */
+    std::condition_variable m_haveJob;
+
+    bool m_shouldStop;
+};
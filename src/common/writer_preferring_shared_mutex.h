@@ -0,0 +1,92 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <condition_variable>
+
+#include <cstddef>
+
+#include <mutex>
+
+/* A shared mutex which lets a waiting writer in ahead of any new readers, so
+   a steady stream of readers can't keep it out forever, as they can with
+   glibc's std::shared_mutex. Also, unlike std::shared_mutex, it doesn't
+   belong to the thread which locked it, so it can be locked on one thread
+   and unlocked on another. Works with std::shared_lock and std::unique_lock. */
+class WriterPreferringSharedMutex
+{
+public:
+    void lock()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_waitingWriters++;
+
+        m_changed.wait(lock, [this] { return !m_writing && m_readers == 0; });
+
+        m_waitingWriters--;
+
+        m_writing = true;
+    }
+
+    bool try_lock()
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (m_writing || m_readers != 0)
+        {
+            return false;
+        }
+
+        m_writing = true;
+
+        return true;
+    }
+
+    void unlock()
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+            m_writing = false;
+        }
+
+        m_changed.notify_all();
+    }
+
+    void lock_shared()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_changed.wait(lock, [this] { return !m_writing && m_waitingWriters == 0; });
+
+        m_readers++;
+    }
+
+    void unlock_shared()
+    {
+        bool lastReader;
+
+        {
+            std::scoped_lock lock(m_mutex);
+            lastReader = --m_readers == 0;
+        }
+
+        if (lastReader)
+        {
+            m_changed.notify_all();
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+
+    std::condition_variable m_changed;
+
+    size_t m_readers = 0;
+
+    size_t m_waitingWriters = 0;
+
+    bool m_writing = false;
+};
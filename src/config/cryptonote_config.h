@@ -230,6 +230,9 @@ namespace cryptonote
 
     const size_t BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT = 10000; // by default, blocks ids count in synchronizing
     const uint64_t BLOCKS_SYNCHRONIZING_DEFAULT_COUNT = 100;     // by default, blocks count in blocks downloading
+    const size_t BLOCKS_SYNCHRONIZING_MAX_REQUESTS_PER_PEER = 4; // block download requests in flight to a single peer
+    const size_t BLOCKS_SYNCHRONIZING_MAX_QUEUED_COUNT = 2000;   // blocks requested or downloaded but not yet added
+    const uint32_t BLOCKS_SYNCHRONIZING_REQUEST_TIMEOUT = 120;   // seconds a peer has to send the blocks we requested
     const size_t COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT = 1000;
 
 #ifdef USE_TESTNET
@@ -274,6 +277,19 @@ namespace cryptonote
     const uint32_t DATABASE_DEFAULT_MAX_OPEN_FILES = 100;
     const uint16_t DATABASE_DEFAULT_BACKGROUND_THREADS_COUNT = 2;
 
+    /* Number of decompressed ring member keys kept around for checking ring
+       signatures. Each entry is roughly 400 bytes. */
+    const size_t RING_MEMBER_CACHE_DEFAULT_SIZE = 65536;
+
+    /* Size in bytes of the in memory filter over spent key images. At 16 MB
+       this holds ten million or so key images at under a 1% false positive
+       rate. */
+    const size_t SPENT_KEY_IMAGE_FILTER_SIZE = 16 * 1024 * 1024;
+
+    /* Number of recent main chain blocks whose wallet sync data is kept in
+       memory - about ten days of blocks. */
+    const size_t WALLET_SYNC_DATA_CACHE_SIZE = 10000;
+
     const char LATEST_VERSION_URL[] = "https://github.com/kryptokrona/kryptokrona";
     const std::string LICENSE_URL = "https://github.com/kryptokrona/kryptokrona/blob/master/LICENSE";
 
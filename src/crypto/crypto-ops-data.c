@@ -5,6 +5,7 @@
 //
 // Please see the included LICENSE file for more information.
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "crypto-ops.h"
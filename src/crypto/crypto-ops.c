@@ -6,6 +6,7 @@
 // Please see the included LICENSE file for more information.
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "crypto-ops.h"
@@ -1805,6 +1806,65 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h)
     s[31] ^= fe_isnegative(x) << 7;
 }
 
+/* Encodes count points like ge_tobytes, but shares a single field inversion
+   between all of them (Montgomery's trick). scratch must have room for count
+   field elements. */
+void ge_tobytes_batch(unsigned char *s, const ge_p2 *h, fe *scratch, size_t count)
+{
+    fe acc;
+    fe recip;
+    fe x;
+    fe y;
+    size_t i;
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    /* scratch[i] = Z_0 * Z_1 * ... * Z_i */
+    fe_copy(scratch[0], h[0].Z);
+
+    for (i = 1; i < count; i++)
+    {
+        fe_mul(scratch[i], scratch[i - 1], h[i].Z);
+    }
+
+    /* Can't happen for points produced by the complete addition formulas,
+       but if it did a single zero would poison every result */
+    if (!fe_isnonzero(scratch[count - 1]))
+    {
+        for (i = 0; i < count; i++)
+        {
+            ge_tobytes(s + 32 * i, &h[i]);
+        }
+
+        return;
+    }
+
+    /* acc = 1 / (Z_0 * ... * Z_(count - 1)) */
+    fe_invert(acc, scratch[count - 1]);
+
+    for (i = count - 1; i > 0; i--)
+    {
+        /* recip = 1 / Z_i */
+        fe_mul(recip, acc, scratch[i - 1]);
+
+        /* acc = 1 / (Z_0 * ... * Z_(i - 1)) */
+        fe_mul(acc, acc, h[i].Z);
+
+        fe_mul(x, h[i].X, recip);
+        fe_mul(y, h[i].Y, recip);
+        fe_tobytes(s + 32 * i, y);
+        s[32 * i + 31] ^= fe_isnegative(x) << 7;
+    }
+
+    fe_mul(x, h[0].X, acc);
+    fe_mul(y, h[0].Y, acc);
+    fe_tobytes(s, y);
+    s[31] ^= fe_isnegative(x) << 7;
+}
+
 /* From sc_reduce.c */
 
 /*
@@ -17,6 +17,7 @@
 #include "crypto.h"
 #include "hash.h"
 #include "random.h"
+#include "ring_member_cache.h"
 
 namespace crypto
 {
@@ -484,81 +485,159 @@ namespace crypto
     bool crypto_ops::checkRingSignature(
         const Hash &prefix_hash,
         const KeyImage &image,
-        const std::vector<PublicKey> pubs,
-        const std::vector<Signature> signatures)
+        const std::vector<PublicKey> &pubs,
+        const std::vector<Signature> &signatures)
     {
+        return checkRingSignatures({{&prefix_hash, &image, &pubs, &signatures}}) == 1;
+    }
 
-        ge_p3 image_unp;
-
-        ge_dsmp image_pre;
-
-        EllipticCurveScalar sum, h;
+    size_t crypto_ops::checkRingSignatures(const std::vector<RingSignatureBatchEntry> &batch, RingMemberCache *cache)
+    {
+        /* Number of signatures we need to finish checking. If one fails early
+           on, we only need to check the ones before it. */
+        size_t count = batch.size();
 
-        rs_comm *const buf = reinterpret_cast<rs_comm *>(alloca(rs_comm_size(pubs.size())));
+        size_t pointCount = 0;
 
-        if (ge_frombytes_vartime(&image_unp, reinterpret_cast<const unsigned char *>(&image)) != 0)
+        for (const auto &entry : batch)
         {
-            return false;
+            pointCount += 2 * entry.publicKeys->size();
         }
 
-        ge_dsm_precomp(image_pre, &image_unp);
+        /* The a and b points of every ring member, interleaved in the same
+           order as rs_comm expects them */
+        std::vector<ge_p2> points(pointCount);
 
-        if (ge_check_subgroup_precomp_vartime(image_pre) != 0)
-        {
-            return false;
-        }
+        /* Where the points of each signature start */
+        std::vector<size_t> offsets(batch.size());
 
-        sc_0(reinterpret_cast<unsigned char *>(&sum));
+        std::vector<EllipticCurveScalar> sums(batch.size());
 
-        buf->h = prefix_hash;
+        size_t offset = 0;
 
-        for (size_t i = 0; i < pubs.size(); i++)
+        for (size_t i = 0; i < count; i++)
         {
-            ge_p2 tmp2;
-            ge_p3 tmp3;
+            const auto &pubs = *batch[i].publicKeys;
+            const auto &signatures = *batch[i].signatures;
 
-            if (sc_check(reinterpret_cast<const unsigned char *>(&signatures[i])) != 0 || sc_check(reinterpret_cast<const unsigned char *>(&signatures[i]) + 32) != 0)
+            ge_p3 image_unp;
+
+            ge_dsmp image_pre;
+
+            offsets[i] = offset;
+
+            if (signatures.size() < pubs.size() || ge_frombytes_vartime(&image_unp, reinterpret_cast<const unsigned char *>(batch[i].keyImage)) != 0)
             {
-                return false;
+                count = i;
+                break;
             }
 
-            if (ge_frombytes_vartime(&tmp3, reinterpret_cast<const unsigned char *>(&pubs[i])) != 0)
+            ge_dsm_precomp(image_pre, &image_unp);
+
+            if (ge_check_subgroup_precomp_vartime(image_pre) != 0)
             {
-                return false;
+                count = i;
+                break;
             }
 
-            ge_double_scalarmult_base_vartime(
-                &tmp2,
-                reinterpret_cast<const unsigned char *>(&signatures[i]),
-                &tmp3,
-                reinterpret_cast<const unsigned char *>(&signatures[i]) + 32);
+            sc_0(reinterpret_cast<unsigned char *>(&sums[i]));
 
-            ge_tobytes(reinterpret_cast<unsigned char *>(&buf->ab[i].a), &tmp2);
+            bool valid = true;
 
-            hash_to_ec(pubs[i], tmp3);
+            for (size_t j = 0; j < pubs.size(); j++)
+            {
+                DecompressedRingMember member;
 
-            ge_double_scalarmult_precomp_vartime(
-                &tmp2,
-                reinterpret_cast<const unsigned char *>(&signatures[i]) + 32,
-                &tmp3,
-                reinterpret_cast<const unsigned char *>(&signatures[i]),
-                image_pre);
+                if (sc_check(reinterpret_cast<const unsigned char *>(&signatures[j])) != 0 || sc_check(reinterpret_cast<const unsigned char *>(&signatures[j]) + 32) != 0)
+                {
+                    valid = false;
+                    break;
+                }
 
-            ge_tobytes(reinterpret_cast<unsigned char *>(&buf->ab[i].b), &tmp2);
+                /* Popular outputs appear in many rings, so decompressing the
+                   key (a square root) and hashing it to the curve is often
+                   work we've already done */
+                if (cache == nullptr || !cache->get(pubs[j], member))
+                {
+                    if (ge_frombytes_vartime(&member.point, reinterpret_cast<const unsigned char *>(&pubs[j])) != 0)
+                    {
+                        valid = false;
+                        break;
+                    }
+
+                    hash_to_ec(pubs[j], member.hashedPoint);
+
+                    if (cache != nullptr)
+                    {
+                        cache->insert(pubs[j], member);
+                    }
+                }
+
+                ge_double_scalarmult_base_vartime(
+                    &points[offset + 2 * j],
+                    reinterpret_cast<const unsigned char *>(&signatures[j]),
+                    &member.point,
+                    reinterpret_cast<const unsigned char *>(&signatures[j]) + 32);
 
-            sc_add(
-                reinterpret_cast<unsigned char *>(&sum),
-                reinterpret_cast<unsigned char *>(&sum),
-                reinterpret_cast<const unsigned char *>(&signatures[i]));
+                ge_double_scalarmult_precomp_vartime(
+                    &points[offset + 2 * j + 1],
+                    reinterpret_cast<const unsigned char *>(&signatures[j]) + 32,
+                    &member.hashedPoint,
+                    reinterpret_cast<const unsigned char *>(&signatures[j]),
+                    image_pre);
+
+                sc_add(
+                    reinterpret_cast<unsigned char *>(&sums[i]),
+                    reinterpret_cast<unsigned char *>(&sums[i]),
+                    reinterpret_cast<const unsigned char *>(&signatures[j]));
+            }
+
+            if (!valid)
+            {
+                count = i;
+                break;
+            }
+
+            offset += 2 * pubs.size();
         }
 
-        hash_to_scalar(buf, rs_comm_size(pubs.size()), h);
+        /* Converting a point to bytes needs a field inversion, which is a
+           large part of the cost of each ring member. Do them all at once. */
+        std::vector<EllipticCurvePoint> encoded(offset);
 
-        sc_sub(
-            reinterpret_cast<unsigned char *>(&h),
-            reinterpret_cast<unsigned char *>(&h),
-            reinterpret_cast<unsigned char *>(&sum));
+        std::unique_ptr<fe[]> scratch(new fe[offset > 0 ? offset : 1]);
+
+        ge_tobytes_batch(reinterpret_cast<unsigned char *>(encoded.data()), points.data(), scratch.get(), offset);
+
+        std::vector<uint8_t> buffer;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const size_t ringSize = batch[i].publicKeys->size();
+
+            EllipticCurveScalar h;
+
+            buffer.resize(rs_comm_size(ringSize));
+
+            rs_comm *const buf = reinterpret_cast<rs_comm *>(buffer.data());
+
+            buf->h = *batch[i].prefixHash;
+
+            std::memcpy(buf->ab, encoded.data() + offsets[i], 2 * ringSize * sizeof(EllipticCurvePoint));
+
+            hash_to_scalar(buf, rs_comm_size(ringSize), h);
+
+            sc_sub(
+                reinterpret_cast<unsigned char *>(&h),
+                reinterpret_cast<unsigned char *>(&h),
+                reinterpret_cast<unsigned char *>(&sums[i]));
+
+            if (sc_isnonzero(reinterpret_cast<unsigned char *>(&h)) != 0)
+            {
+                return i;
+            }
+        }
 
-        return sc_isnonzero(reinterpret_cast<unsigned char *>(&h)) == 0;
+        return count;
     }
 }
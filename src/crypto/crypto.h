@@ -31,6 +31,18 @@ namespace crypto
         uint8_t data[32];
     };
 
+    class RingMemberCache;
+
+    /* A ring signature to be checked as part of a batch. The referenced data
+       must outlive the call to checkRingSignatures */
+    struct RingSignatureBatchEntry
+    {
+        const Hash *prefixHash;
+        const KeyImage *keyImage;
+        const std::vector<PublicKey> *publicKeys;
+        const std::vector<Signature> *signatures;
+    };
+
     class crypto_ops
     {
         crypto_ops();
@@ -88,8 +100,15 @@ namespace crypto
         static bool checkRingSignature(
             const Hash &prefix_hash,
             const KeyImage &image,
-            const std::vector<PublicKey> pubs,
-            const std::vector<Signature> signatures);
+            const std::vector<PublicKey> &pubs,
+            const std::vector<Signature> &signatures);
+
+        /* Checks every ring signature in the batch, sharing the cost of
+           encoding the intermediate points between all of them. Returns
+           the index of the first invalid signature, or batch.size() if they
+           are all valid. If a cache is given, the decompressed ring members
+           are looked up in, and added to, it. */
+        static size_t checkRingSignatures(const std::vector<RingSignatureBatchEntry> &batch, RingMemberCache *cache = nullptr);
     };
 
     /* Generate a new key pair
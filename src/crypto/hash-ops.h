@@ -64,6 +64,14 @@ enum
 void cn_fast_hash(const void *data, size_t length, char *hash);
 void cn_slow_hash(const void *data, size_t length, char *hash, int light, int variant, int prehashed, uint32_t page_size, uint32_t scratchpad, uint32_t iterations);
 
+/* Hashes ways blobs of length bytes each, laid out one after another, into
+   ways hashes, HASH_SIZE bytes apart. With AES-NI and 2 or 4 ways the hashes
+   are computed together, otherwise one at a time with cn_slow_hash(). */
+void cn_slow_hash_multi(const void *data, size_t length, char *hash, size_t ways, int light, int variant, uint32_t page_size, uint32_t scratchpad, uint32_t iterations);
+
+/* Frees the calling thread's cn_slow_hash_multi() scratchpads */
+void cn_slow_hash_free_multi_state(void);
+
 void hash_extra_blake(const void *data, size_t length, char *hash);
 void hash_extra_groestl(const void *data, size_t length, char *hash);
 void hash_extra_jh(const void *data, size_t length, char *hash);
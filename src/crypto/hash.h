@@ -165,6 +165,12 @@ namespace crypto
         cn_slow_hash(data, length, reinterpret_cast<char *>(&hash), 1, 2, 0, CN_TURTLE_PAGE_SIZE, CN_TURTLE_SCRATCHPAD, CN_TURTLE_ITERATIONS);
     }
 
+    // ways blobs of length bytes each, one after another, into ways hashes
+    inline void cn_turtle_lite_slow_hash_v2_multi(const void *data, size_t length, Hash *hashes, size_t ways)
+    {
+        cn_slow_hash_multi(data, length, reinterpret_cast<char *>(hashes), ways, 1, 2, CN_TURTLE_PAGE_SIZE, CN_TURTLE_SCRATCHPAD, CN_TURTLE_ITERATIONS);
+    }
+
     // CryptoNight Soft Shell
     inline void cn_soft_shell_slow_hash_v0(const void *data, size_t length, Hash &hash, uint32_t height)
     {
@@ -0,0 +1,86 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "ring_member_cache.h"
+
+#include <algorithm>
+
+namespace crypto
+{
+
+    RingMemberCache::RingMemberCache(const size_t capacity) : m_shardCapacity(std::max<size_t>(capacity / SHARD_COUNT, 1)),
+                                                               m_hits(0),
+                                                               m_misses(0)
+    {
+    }
+
+    RingMemberCache::Shard &RingMemberCache::getShard(const PublicKey &key)
+    {
+        /* Public keys are uniformly distributed, any byte will do. The hash
+           map uses the leading bytes, so pick one it doesn't. */
+        return m_shards[key.data[16] % SHARD_COUNT];
+    }
+
+    bool RingMemberCache::get(const PublicKey &key, DecompressedRingMember &member)
+    {
+        Shard &shard = getShard(key);
+
+        std::scoped_lock lock(shard.mutex);
+
+        const auto it = shard.index.find(key);
+
+        if (it == shard.index.end())
+        {
+            m_misses++;
+            return false;
+        }
+
+        /* Move to the front of the LRU list */
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+
+        member = it->second->second;
+
+        m_hits++;
+
+        return true;
+    }
+
+    void RingMemberCache::insert(const PublicKey &key, const DecompressedRingMember &member)
+    {
+        Shard &shard = getShard(key);
+
+        std::scoped_lock lock(shard.mutex);
+
+        /* Another thread may have beaten us to it */
+        if (shard.index.find(key) != shard.index.end())
+        {
+            return;
+        }
+
+        if (shard.entries.size() >= m_shardCapacity)
+        {
+            shard.index.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+        }
+
+        shard.entries.emplace_front(key, member);
+        shard.index[key] = shard.entries.begin();
+    }
+
+    uint64_t RingMemberCache::getHits() const
+    {
+        return m_hits;
+    }
+
+    uint64_t RingMemberCache::getMisses() const
+    {
+        return m_misses;
+    }
+
+    size_t RingMemberCache::getCapacity() const
+    {
+        return m_shardCapacity * SHARD_COUNT;
+    }
+
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <crypto_types.h>
+
+namespace crypto
+{
+
+    extern "C"
+    {
+#include "crypto-ops.h"
+    }
+
+    /* The decompressed forms of a ring member's public key, as used when
+       checking a ring signature */
+    struct DecompressedRingMember
+    {
+        /* The public key as a curve point (ge_frombytes_vartime) */
+        ge_p3 point;
+
+        /* The public key hashed to a curve point (hash_to_ec) */
+        ge_p3 hashedPoint;
+    };
+
+    /* A bounded, thread safe LRU cache of decompressed ring members. The
+       cache is split into shards, each with their own lock and LRU list, so
+       signature checking threads rarely contend with each other. */
+    class RingMemberCache
+    {
+    public:
+        explicit RingMemberCache(const size_t capacity);
+
+        RingMemberCache(const RingMemberCache &) = delete;
+        RingMemberCache &operator=(const RingMemberCache &) = delete;
+
+        /* Returns true and fills in member if the key is cached */
+        bool get(const PublicKey &key, DecompressedRingMember &member);
+
+        void insert(const PublicKey &key, const DecompressedRingMember &member);
+
+        uint64_t getHits() const;
+
+        uint64_t getMisses() const;
+
+        size_t getCapacity() const;
+
+    private:
+        static const size_t SHARD_COUNT = 16;
+
+        typedef std::list<std::pair<PublicKey, DecompressedRingMember>> LruList;
+
+        struct Shard
+        {
+            std::mutex mutex;
+
+            /* Most recently used at the front */
+            LruList entries;
+
+            std::unordered_map<PublicKey, LruList::iterator> index;
+        };
+
+        Shard &getShard(const PublicKey &key);
+
+        const size_t m_shardCapacity;
+
+        std::array<Shard, SHARD_COUNT> m_shards;
+
+        std::atomic<uint64_t> m_hits;
+
+        std::atomic<uint64_t> m_misses;
+    };
+
+}
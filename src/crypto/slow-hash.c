@@ -849,6 +849,236 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int light, int va
     slow_hash_free_state(page_size);
 }
 
+/* Scratchpads for cn_slow_hash_multi(), one per way, side by side. Unlike
+ * the single hash's, these are kept for the life of the thread rather than
+ * mapped and unmapped on every call - a miner calls it in a loop. */
+THREADV uint8_t *hp_multi_state = NULL;
+THREADV size_t hp_multi_size = 0;
+THREADV int hp_multi_allocated = 0;
+
+static uint8_t *slow_hash_allocate_multi_state(size_t size)
+{
+    if (hp_multi_state != NULL && hp_multi_size >= size)
+        return hp_multi_state;
+
+    cn_slow_hash_free_multi_state();
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    SetLockPagesPrivilege(GetCurrentProcess(), TRUE);
+    hp_multi_state = (uint8_t *)VirtualAlloc(NULL, size, MEM_LARGE_PAGES | MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+    defined(__DragonFly__) || defined(__NetBSD__)
+    hp_multi_state = mmap(0, size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANON, 0, 0);
+#else
+    hp_multi_state = mmap(0, size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, 0, 0);
+#endif
+    if (hp_multi_state == MAP_FAILED)
+        hp_multi_state = NULL;
+#endif
+    hp_multi_allocated = 1;
+    if (hp_multi_state == NULL)
+    {
+        hp_multi_allocated = 0;
+        hp_multi_state = (uint8_t *)malloc(size);
+    }
+
+    hp_multi_size = hp_multi_state == NULL ? 0 : size;
+
+    return hp_multi_state;
+}
+
+void cn_slow_hash_free_multi_state(void)
+{
+    if (hp_multi_state == NULL)
+        return;
+
+    if (!hp_multi_allocated)
+        free(hp_multi_state);
+    else
+    {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        VirtualFree(hp_multi_state, 0, MEM_RELEASE);
+#else
+        munmap(hp_multi_state, hp_multi_size);
+#endif
+    }
+
+    hp_multi_state = NULL;
+    hp_multi_size = 0;
+    hp_multi_allocated = 0;
+}
+
+/* Everything one of the hashes cn_slow_hash_multi() computes at once keeps
+ * between rounds of the main loop */
+struct cn_slow_hash_lane
+{
+    union cn_slow_hash_state state;
+    RDATA_ALIGN16 uint64_t a[2];
+    RDATA_ALIGN16 uint64_t b[4];
+    RDATA_ALIGN16 uint64_t c[2];
+    __m128i _b, _b1;
+    uint64_t division_result;
+    uint64_t sqrt_result;
+    uint64_t tweak1_2;
+    uint8_t *hp_state;
+};
+
+/* One iteration of step 3 of cn_slow_hash() for one lane, with AES-NI. The
+ * locals have the names the pre_aes() and post_aes() macros expect. */
+STATIC INLINE void cn_slow_hash_lane_round(struct cn_slow_hash_lane *lane, int variant, size_t lightFlag, uint32_t TOTALBLOCKS)
+{
+    uint8_t *hp_state = lane->hp_state;
+    uint64_t *a = lane->a;
+    uint64_t *b = lane->b;
+    uint64_t *c = lane->c;
+    uint64_t division_result = lane->division_result;
+    uint64_t sqrt_result = lane->sqrt_result;
+    const uint64_t tweak1_2 = lane->tweak1_2;
+    __m128i _a, _c;
+    __m128i _b = lane->_b;
+    __m128i _b1 = lane->_b1;
+    uint64_t hi, lo;
+    uint64_t *p = NULL;
+    size_t j;
+
+    pre_aes();
+    _c = _mm_aesenc_si128(_c, _a);
+    post_aes();
+
+    lane->division_result = division_result;
+    lane->sqrt_result = sqrt_result;
+    lane->_b = _b;
+    lane->_b1 = _b1;
+}
+
+/* cn_slow_hash() for ways blobs at once. Step 3 is bound by the latency of
+ * the random scratchpad reads - running the lanes' rounds one after another
+ * gives the CPU independent reads to have in flight at the same time. ways
+ * is a constant in each caller, so the lane loops unroll. */
+STATIC INLINE void cn_slow_hash_lanes(const uint8_t *data, size_t length, char *hash, const size_t ways, int light, int variant, uint32_t page_size, uint32_t scratchpad, uint32_t iterations, uint8_t *scratchpads)
+{
+    uint32_t TOTALBLOCKS = (page_size / AES_BLOCK_SIZE);
+    uint32_t init_rounds = (scratchpad / INIT_SIZE_BYTE);
+    uint32_t aes_rounds = (iterations / 2);
+    size_t lightFlag = (light ? 2 : 1);
+
+    RDATA_ALIGN16 uint8_t expandedKey[240];
+    uint8_t text[INIT_SIZE_BYTE];
+    struct cn_slow_hash_lane lanes[4];
+    size_t i, k;
+
+    static void (*const extra_hashes[4])(const void *, size_t, char *) =
+        {
+            hash_extra_blake, hash_extra_groestl, hash_extra_jh, hash_extra_skein};
+
+    if (variant == 1 && length < 43)
+    {
+        fprintf(stderr, "Cryptonight variant 1 need at least 43 bytes of data");
+        abort();
+    }
+
+    /* Steps 1 and 2, as in cn_slow_hash() */
+    for (k = 0; k < ways; k++)
+    {
+        struct cn_slow_hash_lane *lane = &lanes[k];
+        const uint8_t *laneData = data + k * length;
+
+        lane->hp_state = scratchpads + k * page_size;
+
+        hash_process(&lane->state.hs, laneData, length);
+        memcpy(text, lane->state.init, INIT_SIZE_BYTE);
+
+        lane->tweak1_2 = 0;
+        if (variant == 1)
+        {
+            uint64_t nonce;
+            memcpy(&nonce, laneData + 35, sizeof(nonce));
+            lane->tweak1_2 = lane->state.hs.w[24] ^ nonce;
+        }
+
+        lane->division_result = 0;
+        lane->sqrt_result = 0;
+        if (variant == 2)
+        {
+            lane->b[2] = lane->state.hs.w[8] ^ lane->state.hs.w[10];
+            lane->b[3] = lane->state.hs.w[9] ^ lane->state.hs.w[11];
+            lane->division_result = lane->state.hs.w[12];
+            lane->sqrt_result = lane->state.hs.w[13];
+        }
+
+        aes_expand_key(lane->state.hs.b, expandedKey);
+        for (i = 0; i < init_rounds; i++)
+        {
+            aes_pseudo_round(text, text, expandedKey, INIT_SIZE_BLK);
+            memcpy(&lane->hp_state[i * INIT_SIZE_BYTE], text, INIT_SIZE_BYTE);
+        }
+
+        lane->a[0] = U64(&lane->state.k[0])[0] ^ U64(&lane->state.k[32])[0];
+        lane->a[1] = U64(&lane->state.k[0])[1] ^ U64(&lane->state.k[32])[1];
+        lane->b[0] = U64(&lane->state.k[16])[0] ^ U64(&lane->state.k[48])[0];
+        lane->b[1] = U64(&lane->state.k[16])[1] ^ U64(&lane->state.k[48])[1];
+
+        lane->_b = _mm_load_si128(R128(lane->b));
+        lane->_b1 = _mm_load_si128(R128(lane->b) + 1);
+    }
+
+    /* Step 3, the lanes interleaved */
+    for (i = 0; i < aes_rounds; i++)
+    {
+        for (k = 0; k < ways; k++)
+        {
+            cn_slow_hash_lane_round(&lanes[k], variant, lightFlag, TOTALBLOCKS);
+        }
+    }
+
+    /* Steps 4 and 5 */
+    for (k = 0; k < ways; k++)
+    {
+        struct cn_slow_hash_lane *lane = &lanes[k];
+
+        memcpy(text, lane->state.init, INIT_SIZE_BYTE);
+        aes_expand_key(&lane->state.hs.b[32], expandedKey);
+        for (i = 0; i < init_rounds; i++)
+        {
+            aes_pseudo_round_xor(text, text, expandedKey, &lane->hp_state[i * INIT_SIZE_BYTE], INIT_SIZE_BLK);
+        }
+
+        memcpy(lane->state.init, text, INIT_SIZE_BYTE);
+        hash_permutation(&lane->state.hs);
+        extra_hashes[lane->state.hs.b[0] & 3](&lane->state, 200, hash + k * HASH_SIZE);
+    }
+}
+
+void cn_slow_hash_multi(const void *data, size_t length, char *hash, size_t ways, int light, int variant, uint32_t page_size, uint32_t scratchpad, uint32_t iterations)
+{
+    uint8_t *scratchpads = NULL;
+    size_t k;
+
+    if ((ways == 2 || ways == 4) && !force_software_aes() && check_aes_hw())
+    {
+        scratchpads = slow_hash_allocate_multi_state((size_t)page_size * ways);
+    }
+
+    if (scratchpads == NULL)
+    {
+        for (k = 0; k < ways; k++)
+        {
+            cn_slow_hash((const uint8_t *)data + k * length, length, hash + k * HASH_SIZE, light, variant, 0, page_size, scratchpad, iterations);
+        }
+    }
+    else if (ways == 2)
+    {
+        cn_slow_hash_lanes((const uint8_t *)data, length, hash, 2, light, variant, page_size, scratchpad, iterations, scratchpads);
+    }
+    else
+    {
+        cn_slow_hash_lanes((const uint8_t *)data, length, hash, 4, light, variant, page_size, scratchpad, iterations, scratchpads);
+    }
+}
+
 #elif !defined NO_AES && (defined(__arm__) || defined(__aarch64__))
 void slow_hash_allocate_state(void)
 {
@@ -1459,6 +1689,20 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int light, int va
 }
 #endif /* !aarch64 || !crypto */
 
+void cn_slow_hash_multi(const void *data, size_t length, char *hash, size_t ways, int light, int variant, uint32_t page_size, uint32_t scratchpad, uint32_t iterations)
+{
+    size_t k;
+
+    for (k = 0; k < ways; k++)
+    {
+        cn_slow_hash((const uint8_t *)data + k * length, length, hash + k * HASH_SIZE, light, variant, 0, page_size, scratchpad, iterations);
+    }
+}
+
+void cn_slow_hash_free_multi_state(void)
+{
+}
+
 #else
 // Portable implementation as a fallback
 
@@ -1674,4 +1918,18 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int light, int va
 #endif
 }
 
+void cn_slow_hash_multi(const void *data, size_t length, char *hash, size_t ways, int light, int variant, uint32_t page_size, uint32_t scratchpad, uint32_t iterations)
+{
+    size_t k;
+
+    for (k = 0; k < ways; k++)
+    {
+        cn_slow_hash((const uint8_t *)data + k * length, length, hash + k * HASH_SIZE, light, variant, 0, page_size, scratchpad, iterations);
+    }
+}
+
+void cn_slow_hash_free_multi_state(void)
+{
+}
+
 #endif
@@ -16,6 +16,7 @@
 #include "crypto_types.h"
 #include "common/string_tools.h"
 #include "crypto/crypto.h"
+#include "crypto/ring_member_cache.h"
 
 #define PERFORMANCE_ITERATIONS 1000
 #define PERFORMANCE_ITERATIONS_LONG_MULTIPLIER 10
@@ -167,6 +168,225 @@ void testHashFunction(
     assert(CompareHashes(hash, expectedOutput));
 }
 
+#define TEST_MULTI_HASH_FUNCTION(light, variant, pageSize, scratchpad, iterations, expectedOutput) \
+    testMultiHashFunction(light, variant, pageSize, scratchpad, iterations, expectedOutput, #expectedOutput)
+
+/* Hashes 1, 2 and 4 blobs at once with cn_slow_hash_multi(), and checks each
+   hash matches hashing the blob on its own. The first blob is the test input,
+   the others differ from it in the last byte. */
+void testMultiHashFunction(
+    const int light,
+    const int variant,
+    const uint32_t pageSize,
+    const uint32_t scratchpad,
+    const uint32_t iterations,
+    const std::string expectedOutput,
+    const std::string name)
+{
+    const BinaryArray rawData = common::fromHex(INPUT_DATA);
+
+    const size_t maxWays = 4;
+
+    BinaryArray blobs;
+
+    std::vector<Hash> expected(maxWays);
+
+    for (size_t way = 0; way < maxWays; way++)
+    {
+        BinaryArray blob = rawData;
+        blob.back() ^= static_cast<uint8_t>(way);
+
+        cn_slow_hash(blob.data(), blob.size(), reinterpret_cast<char *>(&expected[way]), light, variant, 0, pageSize, scratchpad, iterations);
+
+        blobs.insert(blobs.end(), blob.begin(), blob.end());
+    }
+
+    assert(CompareHashes(expected[0], expectedOutput));
+
+    for (const size_t ways : {1, 2, 4})
+    {
+        std::vector<Hash> hashes(ways);
+
+        cn_slow_hash_multi(blobs.data(), rawData.size(), reinterpret_cast<char *>(hashes.data()), ways, light, variant, pageSize, scratchpad, iterations);
+
+        for (size_t way = 0; way < ways; way++)
+        {
+            assert(hashes[way] == expected[way]);
+        }
+    }
+
+    std::cout << name << " (1, 2, 4 ways): OK" << std::endl;
+}
+
+/* A public key which isn't a point on the curve */
+PublicKey invalidPublicKey()
+{
+    PublicKey key = PublicKey();
+    ge_p3 point;
+
+    while (ge_frombytes_vartime(&point, key.data) == 0)
+    {
+        key.data[0]++;
+    }
+
+    return key;
+}
+
+/* Checks batches of ring signatures with crypto_ops::checkRingSignatures()
+   give the same answer as checking them one at a time, with and without a
+   ring member cache */
+void testBatchRingSignatures()
+{
+    struct Input
+    {
+        Hash prefixHash;
+        KeyImage keyImage;
+        std::vector<PublicKey> publicKeys;
+        std::vector<Signature> signatures;
+    };
+
+    const std::vector<size_t> ringSizes = {1, 2, 3, 4, 7};
+
+    std::vector<Input> inputs;
+
+    for (size_t i = 0; i < ringSizes.size(); i++)
+    {
+        Input input;
+
+        const std::string prefix = "prefix " + std::to_string(i);
+        cn_fast_hash(prefix.data(), prefix.size(), input.prefixHash);
+
+        SecretKey secretKey;
+
+        for (size_t member = 0; member < ringSizes[i]; member++)
+        {
+            PublicKey publicKey;
+            generate_keys(publicKey, secretKey);
+            input.publicKeys.push_back(publicKey);
+        }
+
+        /* The last key generated is the real one */
+        const uint64_t realOutput = ringSizes[i] - 1;
+
+        generate_key_image(input.publicKeys[realOutput], secretKey, input.keyImage);
+
+        bool success;
+
+        std::tie(success, input.signatures) = crypto_ops::generateRingSignatures(
+            input.prefixHash, input.keyImage, input.publicKeys, secretKey, realOutput);
+
+        assert(success);
+
+        inputs.push_back(input);
+    }
+
+    /* Returns the index of the first invalid signature */
+    const auto check = [](const std::vector<Input> &inputs, RingMemberCache *cache) {
+        std::vector<RingSignatureBatchEntry> batch;
+
+        for (const auto &input : inputs)
+        {
+            batch.push_back({&input.prefixHash, &input.keyImage, &input.publicKeys, &input.signatures});
+        }
+
+        const size_t firstInvalid = crypto_ops::checkRingSignatures(batch, cache);
+
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            const bool valid = crypto_ops::checkRingSignature(
+                inputs[i].prefixHash, inputs[i].keyImage, inputs[i].publicKeys, inputs[i].signatures);
+
+            if (!valid)
+            {
+                assert(firstInvalid == i);
+                return firstInvalid;
+            }
+        }
+
+        assert(firstInvalid == inputs.size());
+
+        return firstInvalid;
+    };
+
+    RingMemberCache cache(100);
+
+    for (RingMemberCache *ringMemberCache : {static_cast<RingMemberCache *>(nullptr), &cache, &cache})
+    {
+        /* All valid */
+        assert(check(inputs, ringMemberCache) == inputs.size());
+
+        /* A single signature in the batch */
+        assert(check({inputs[3]}, ringMemberCache) == 1);
+
+        /* One bad signature */
+        std::vector<Input> badSignature = inputs;
+        badSignature[2].signatures[1].data[0] ^= 1;
+        assert(check(badSignature, ringMemberCache) == 2);
+
+        /* A ring member which isn't a point */
+        std::vector<Input> badPoint = inputs;
+        badPoint[3].publicKeys[0] = invalidPublicKey();
+        assert(check(badPoint, ringMemberCache) == 3);
+
+        /* Signed for a different transaction */
+        std::vector<Input> badPrefix = inputs;
+        badPrefix[4].prefixHash = badPrefix[0].prefixHash;
+        assert(check(badPrefix, ringMemberCache) == 4);
+    }
+
+    assert(cache.getHits() > 0);
+
+    std::cout << "checkRingSignatures: OK" << std::endl;
+}
+
+/* Checks ge_tobytes_batch() encodes the same as ge_tobytes(), including
+   when one of the points is invalid, with Z = 0 */
+void testBatchToBytes()
+{
+    const size_t count = 9;
+
+    std::vector<ge_p2> points(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned char scalar[64] = {};
+        scalar[0] = static_cast<unsigned char>(i + 1);
+        scalar[31] = static_cast<unsigned char>(i * 37);
+        sc_reduce(scalar);
+
+        ge_p3 base;
+        ge_scalarmult_base(&base, scalar);
+
+        /* ge_scalarmult gives a Z other than 1 */
+        ge_scalarmult(&points[i], scalar, &base);
+    }
+
+    const auto check = [](const std::vector<ge_p2> &points) {
+        std::vector<unsigned char> expected(32 * points.size());
+        std::vector<unsigned char> encoded(32 * points.size());
+        std::vector<fe> scratch(points.size());
+
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            ge_tobytes(&expected[32 * i], &points[i]);
+        }
+
+        ge_tobytes_batch(encoded.data(), points.data(), scratch.data(), points.size());
+
+        assert(encoded == expected);
+    };
+
+    check(points);
+
+    check({points[0]});
+
+    std::vector<ge_p2> invalidPoint = points;
+    memset(invalidPoint[4].Z, 0, sizeof(fe));
+    check(invalidPoint);
+
+    std::cout << "ge_tobytes_batch: OK" << std::endl;
+}
+
 /* Bit of hackery so we can get the variable name of the passed in function.
    This way we can print the test we are currently performing. */
 #define BENCHMARK(hashFunction, iterations) \
@@ -365,6 +585,37 @@ int main(int argc, char **argv)
             TEST_HASH_FUNCTION_WITH_HEIGHT(cn_soft_shell_slow_hash_v2, CN_SOFT_SHELL_V2[height / 512], height);
         }
 
+        std::cout << std::endl;
+
+        TEST_MULTI_HASH_FUNCTION(0, 0, CN_PAGE_SIZE, CN_SCRATCHPAD, CN_ITERATIONS, CN_SLOW_HASH_V0);
+        TEST_MULTI_HASH_FUNCTION(0, 1, CN_PAGE_SIZE, CN_SCRATCHPAD, CN_ITERATIONS, CN_SLOW_HASH_V1);
+        TEST_MULTI_HASH_FUNCTION(0, 2, CN_PAGE_SIZE, CN_SCRATCHPAD, CN_ITERATIONS, CN_SLOW_HASH_V2);
+
+        TEST_MULTI_HASH_FUNCTION(1, 0, CN_LITE_PAGE_SIZE, CN_LITE_SCRATCHPAD, CN_LITE_ITERATIONS, CN_LITE_SLOW_HASH_V0);
+        TEST_MULTI_HASH_FUNCTION(1, 1, CN_LITE_PAGE_SIZE, CN_LITE_SCRATCHPAD, CN_LITE_ITERATIONS, CN_LITE_SLOW_HASH_V1);
+        TEST_MULTI_HASH_FUNCTION(1, 2, CN_LITE_PAGE_SIZE, CN_LITE_SCRATCHPAD, CN_LITE_ITERATIONS, CN_LITE_SLOW_HASH_V2);
+
+        TEST_MULTI_HASH_FUNCTION(0, 0, CN_DARK_PAGE_SIZE, CN_DARK_SCRATCHPAD, CN_DARK_ITERATIONS, CN_DARK_SLOW_HASH_V0);
+        TEST_MULTI_HASH_FUNCTION(0, 1, CN_DARK_PAGE_SIZE, CN_DARK_SCRATCHPAD, CN_DARK_ITERATIONS, CN_DARK_SLOW_HASH_V1);
+        TEST_MULTI_HASH_FUNCTION(0, 2, CN_DARK_PAGE_SIZE, CN_DARK_SCRATCHPAD, CN_DARK_ITERATIONS, CN_DARK_SLOW_HASH_V2);
+
+        TEST_MULTI_HASH_FUNCTION(1, 0, CN_DARK_PAGE_SIZE, CN_DARK_SCRATCHPAD, CN_DARK_ITERATIONS, CN_DARK_LITE_SLOW_HASH_V0);
+        TEST_MULTI_HASH_FUNCTION(1, 1, CN_DARK_PAGE_SIZE, CN_DARK_SCRATCHPAD, CN_DARK_ITERATIONS, CN_DARK_LITE_SLOW_HASH_V1);
+        TEST_MULTI_HASH_FUNCTION(1, 2, CN_DARK_PAGE_SIZE, CN_DARK_SCRATCHPAD, CN_DARK_ITERATIONS, CN_DARK_LITE_SLOW_HASH_V2);
+
+        TEST_MULTI_HASH_FUNCTION(0, 0, CN_TURTLE_PAGE_SIZE, CN_TURTLE_SCRATCHPAD, CN_TURTLE_ITERATIONS, CN_TURTLE_SLOW_HASH_V0);
+        TEST_MULTI_HASH_FUNCTION(0, 1, CN_TURTLE_PAGE_SIZE, CN_TURTLE_SCRATCHPAD, CN_TURTLE_ITERATIONS, CN_TURTLE_SLOW_HASH_V1);
+        TEST_MULTI_HASH_FUNCTION(0, 2, CN_TURTLE_PAGE_SIZE, CN_TURTLE_SCRATCHPAD, CN_TURTLE_ITERATIONS, CN_TURTLE_SLOW_HASH_V2);
+
+        TEST_MULTI_HASH_FUNCTION(1, 0, CN_TURTLE_PAGE_SIZE, CN_TURTLE_SCRATCHPAD, CN_TURTLE_ITERATIONS, CN_TURTLE_LITE_SLOW_HASH_V0);
+        TEST_MULTI_HASH_FUNCTION(1, 1, CN_TURTLE_PAGE_SIZE, CN_TURTLE_SCRATCHPAD, CN_TURTLE_ITERATIONS, CN_TURTLE_LITE_SLOW_HASH_V1);
+        TEST_MULTI_HASH_FUNCTION(1, 2, CN_TURTLE_PAGE_SIZE, CN_TURTLE_SCRATCHPAD, CN_TURTLE_ITERATIONS, CN_TURTLE_LITE_SLOW_HASH_V2);
+
+        std::cout << std::endl;
+
+        testBatchRingSignatures();
+        testBatchToBytes();
+
         if (o_benchmark)
         {
             std::cout << "\nPerformance Tests: Please wait, this may take a while depending on your system...\n\n";
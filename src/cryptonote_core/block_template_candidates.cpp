@@ -0,0 +1,198 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "block_template_candidates.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+#include <common/int_util.h>
+
+namespace cryptonote
+{
+
+    bool BlockTemplateCandidates::CandidateComparator::operator()(const Candidate &lhs, const Candidate &rhs) const
+    {
+        /* lhs.fee / lhs.size > rhs.fee / rhs.size, without the division */
+        uint64_t lhsHi;
+        uint64_t rhsHi;
+
+        const uint64_t lhsLo = mul128(lhs.fee, rhs.size, &lhsHi);
+        const uint64_t rhsLo = mul128(rhs.fee, lhs.size, &rhsHi);
+
+        if (lhsHi != rhsHi)
+        {
+            return lhsHi > rhsHi;
+        }
+
+        if (lhsLo != rhsLo)
+        {
+            return lhsLo > rhsLo;
+        }
+
+        if (lhs.size != rhs.size)
+        {
+            return lhs.size < rhs.size;
+        }
+
+        if (lhs.receiveTime != rhs.receiveTime)
+        {
+            return lhs.receiveTime < rhs.receiveTime;
+        }
+
+        return std::memcmp(lhs.transactionHash.data, rhs.transactionHash.data, sizeof(lhs.transactionHash.data)) < 0;
+    }
+
+    void BlockTemplateCandidates::add(
+        const crypto::Hash &transactionHash,
+        const uint64_t fee,
+        const size_t size,
+        const uint64_t receiveTime)
+    {
+        if (m_byHash.find(transactionHash) != m_byHash.end())
+        {
+            return;
+        }
+
+        Candidate candidate;
+
+        candidate.transactionHash = transactionHash;
+        candidate.fee = fee;
+        candidate.size = size;
+        candidate.receiveTime = receiveTime;
+
+        m_byHash[transactionHash] = m_candidates.insert(candidate).first;
+
+        m_minSize = std::min(m_minSize, size);
+    }
+
+    void BlockTemplateCandidates::remove(const crypto::Hash &transactionHash)
+    {
+        const auto it = m_byHash.find(transactionHash);
+
+        if (it == m_byHash.end())
+        {
+            return;
+        }
+
+        m_candidates.erase(it->second);
+        m_byHash.erase(it);
+    }
+
+    void BlockTemplateCandidates::clear()
+    {
+        m_candidates.clear();
+        m_byHash.clear();
+
+        m_minSize = std::numeric_limits<size_t>::max();
+    }
+
+    size_t BlockTemplateCandidates::size() const
+    {
+        return m_candidates.size();
+    }
+
+    bool BlockTemplateCandidates::isCandidateValid(
+        const Candidate &candidate,
+        const uint64_t height,
+        const crypto::Hash &previousBlockHash,
+        const Validator &isValid) const
+    {
+        if (!candidate.validated || candidate.validatedPreviousBlockHash != previousBlockHash)
+        {
+            candidate.valid = isValid(candidate.transactionHash, height);
+            candidate.validated = true;
+            candidate.validatedPreviousBlockHash = previousBlockHash;
+        }
+
+        return candidate.valid;
+    }
+
+    void BlockTemplateCandidates::fill(
+        const uint64_t height,
+        const crypto::Hash &previousBlockHash,
+        const size_t medianSize,
+        const size_t maxTotalSize,
+        const size_t fusionMaxSize,
+        const size_t poolSize,
+        const PresenceChecker &isInPool,
+        const Validator &isValid,
+        std::vector<crypto::Hash> &transactionHashes,
+        size_t &transactionsSize,
+        uint64_t &fee)
+    {
+        transactionsSize = 0;
+        fee = 0;
+
+        /* Every pool transaction is a candidate, so if the counts match, no
+           candidate has left the pool. Otherwise, find the ones which have -
+           normally once per block, when the block's transactions leave. */
+        for (auto it = m_candidates.begin(); m_candidates.size() > poolSize && it != m_candidates.end();)
+        {
+            if (!isInPool(it->transactionHash))
+            {
+                m_byHash.erase(it->transactionHash);
+                it = m_candidates.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        /* Fusion transactions pay no fee, so are at the back */
+        std::unordered_set<crypto::Hash> includedFusion;
+
+        for (auto it = m_candidates.rbegin(); it != m_candidates.rend() && it->fee == 0; ++it)
+        {
+            if (fusionMaxSize < transactionsSize + it->size)
+            {
+                continue;
+            }
+
+            if (!isCandidateValid(*it, height, previousBlockHash, isValid))
+            {
+                continue;
+            }
+
+            transactionHashes.push_back(it->transactionHash);
+            includedFusion.insert(it->transactionHash);
+            transactionsSize += it->size;
+        }
+
+        const size_t sizeLimit = std::max(medianSize, maxTotalSize);
+
+        for (const auto &candidate : m_candidates)
+        {
+            /* Full, nothing else will fit */
+            if (transactionsSize > sizeLimit || sizeLimit - transactionsSize < m_minSize)
+            {
+                break;
+            }
+
+            const size_t blockSizeLimit = candidate.fee == 0 ? medianSize : maxTotalSize;
+
+            if (blockSizeLimit < transactionsSize + candidate.size)
+            {
+                continue;
+            }
+
+            if (candidate.fee == 0 && includedFusion.find(candidate.transactionHash) != includedFusion.end())
+            {
+                continue;
+            }
+
+            if (!isCandidateValid(candidate, height, previousBlockHash, isValid))
+            {
+                continue;
+            }
+
+            transactionHashes.push_back(candidate.transactionHash);
+            transactionsSize += candidate.size;
+            fee += candidate.fee;
+        }
+    }
+
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include <crypto_types.h>
+
+namespace cryptonote
+{
+
+    /* The pool transactions which could go in the next block template, kept
+       in the order they should be picked in, so a template can be filled
+       without copying the pool or sorting it again.
+
+       Whether a transaction is valid on top of a given block is remembered,
+       so each transaction is only validated once per new top block, rather
+       than on every template request. This is keyed on the top block's hash
+       rather than the height, so switching to another chain of the same
+       length validates everything again.
+
+       Pool transactions never spend the same key image twice, so a set of
+       candidates never conflict with each other. */
+    class BlockTemplateCandidates
+    {
+    public:
+        /* Whether the transaction is still in the pool */
+        using PresenceChecker = std::function<bool(const crypto::Hash &transactionHash)>;
+
+        /* Whether the transaction can go in a block at this height */
+        using Validator = std::function<bool(const crypto::Hash &transactionHash, const uint64_t height)>;
+
+        /* Does nothing if the transaction is already a candidate */
+        void add(
+            const crypto::Hash &transactionHash,
+            const uint64_t fee,
+            const size_t size,
+            const uint64_t receiveTime);
+
+        void remove(const crypto::Hash &transactionHash);
+
+        void clear();
+
+        size_t size() const;
+
+        /* Picks the transactions for a block at this height, on top of the
+           block with this hash, the same way the template used to be filled
+           from the pool. Fusion transactions go in
+           first, up to fusionMaxSize, then everything else by fee per byte,
+           with fee paying transactions limited to maxTotalSize and free ones
+           to medianSize.
+
+           Every pool transaction must have been added, but removals from the
+           pool don't have to be reported - if there are more candidates than
+           poolSize, the ones no longer in the pool are found and dropped. */
+        void fill(
+            const uint64_t height,
+            const crypto::Hash &previousBlockHash,
+            const size_t medianSize,
+            const size_t maxTotalSize,
+            const size_t fusionMaxSize,
+            const size_t poolSize,
+            const PresenceChecker &isInPool,
+            const Validator &isValid,
+            std::vector<crypto::Hash> &transactionHashes,
+            size_t &transactionsSize,
+            uint64_t &fee);
+
+    private:
+        struct Candidate
+        {
+            crypto::Hash transactionHash;
+
+            uint64_t fee;
+
+            size_t size;
+
+            uint64_t receiveTime;
+
+            /* The top block the transaction was last validated on, and
+               whether it was valid there. Not part of the ordering. */
+            mutable bool validated = false;
+
+            mutable crypto::Hash validatedPreviousBlockHash;
+
+            mutable bool valid = false;
+        };
+
+        /* Same order as the pool - highest fee per byte, then smallest, then
+           oldest. The hash breaks any remaining ties. */
+        struct CandidateComparator
+        {
+            bool operator()(const Candidate &lhs, const Candidate &rhs) const;
+        };
+
+        using CandidateSet = std::set<Candidate, CandidateComparator>;
+
+        /* Validates the candidate on top of this block, if not done already */
+        bool isCandidateValid(
+            const Candidate &candidate,
+            const uint64_t height,
+            const crypto::Hash &previousBlockHash,
+            const Validator &isValid) const;
+
+        CandidateSet m_candidates;
+
+        /* No larger than the smallest candidate, so we can stop looking once
+           the template has less room left than this */
+        size_t m_minSize = std::numeric_limits<size_t>::max();
+
+        std::unordered_map<crypto::Hash, CandidateSet::iterator> m_byHash;
+    };
+
+}
@@ -765,6 +765,36 @@ namespace cryptonote
         return indexes;
     }
 
+    std::unordered_map<crypto::Hash, std::vector<uint64_t>> BlockchainCache::getGlobalIndexesForRange(
+        const uint64_t startHeight,
+        const uint64_t endHeight) const
+    {
+        if (endHeight <= startIndex)
+        {
+            return parent->getGlobalIndexesForRange(startHeight, endHeight);
+        }
+
+        std::unordered_map<crypto::Hash, std::vector<uint64_t>> indexes;
+
+        if (startHeight < startIndex)
+        {
+            indexes = parent->getGlobalIndexesForRange(startHeight, startIndex);
+        }
+
+        const uint64_t startOffset = std::max(startHeight, static_cast<uint64_t>(startIndex));
+
+        auto &transactionsByBlock = transactions.get<BlockIndexTag>();
+
+        auto it = transactionsByBlock.lower_bound(static_cast<uint32_t>(startOffset));
+
+        for (; it != transactionsByBlock.end() && it->blockIndex < endHeight; ++it)
+        {
+            indexes[it->transactionHash].assign(it->globalIndexes.begin(), it->globalIndexes.end());
+        }
+
+        return indexes;
+    }
+
     RawBlock BlockchainCache::getBlockByIndex(uint32_t index) const
     {
         return index < startIndex ? parent->getBlockByIndex(index) : storage->getBlockByIndex(index - startIndex);
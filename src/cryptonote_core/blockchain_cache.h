@@ -176,6 +176,10 @@ namespace cryptonote
         virtual std::unordered_map<crypto::Hash, std::vector<uint64_t>> getGlobalIndexes(
             const std::vector<crypto::Hash> transactionHashes) const override;
 
+        virtual std::unordered_map<crypto::Hash, std::vector<uint64_t>> getGlobalIndexesForRange(
+            const uint64_t startHeight,
+            const uint64_t endHeight) const override;
+
         virtual RawBlock getBlockByIndex(uint32_t index) const override;
         virtual BinaryArray getRawTransaction(uint32_t blockIndex, uint32_t transactionIndex) const override;
         virtual std::vector<crypto::Hash> getTransactionHashes() const override;
@@ -55,6 +55,12 @@ BlockchainReadBatch &BlockchainReadBatch::requestTransactionHashesByBlock(uint32
     return *this;
 }
 
+BlockchainReadBatch &BlockchainReadBatch::requestGlobalIndexesByBlock(uint32_t blockIndex)
+{
+    state.globalIndexesByBlocks.emplace(blockIndex, BlockGlobalIndexes());
+    return *this;
+}
+
 BlockchainReadBatch &BlockchainReadBatch::requestCachedBlock(uint32_t blockIndex)
 {
     state.cachedBlocks.emplace(blockIndex, CachedBlockInfo());
@@ -163,6 +169,7 @@ std::vector<std::string> BlockchainReadBatch::getRawKeys() const
     db::serializeKeys(rawKeys, db::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX, state.blockIndexesBySpentKeyImages);
     db::serializeKeys(rawKeys, db::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX, state.cachedTransactions);
     db::serializeKeys(rawKeys, db::BLOCK_INDEX_TO_TX_HASHES_PREFIX, state.transactionHashesByBlocks);
+    db::serializeKeys(rawKeys, db::BLOCK_INDEX_TO_GLOBAL_INDEXES_PREFIX, state.globalIndexesByBlocks);
     db::serializeKeys(rawKeys, db::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX, state.cachedBlocks);
     db::serializeKeys(rawKeys, db::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX, state.blockIndexesByBlockHashes);
     db::serializeKeys(rawKeys, db::KEY_OUTPUT_AMOUNT_PREFIX, state.keyOutputGlobalIndexesCountForAmounts);
@@ -222,6 +229,11 @@ const std::unordered_map<uint32_t, std::vector<crypto::Hash>> &BlockchainReadRes
     return state.transactionHashesByBlocks;
 }
 
+const std::unordered_map<uint32_t, BlockGlobalIndexes> &BlockchainReadResult::getGlobalIndexesByBlocks() const
+{
+    return state.globalIndexesByBlocks;
+}
+
 const std::unordered_map<uint32_t, CachedBlockInfo> &BlockchainReadResult::getCachedBlocks() const
 {
     return state.cachedBlocks;
@@ -298,6 +310,7 @@ void BlockchainReadBatch::submitRawResult(const std::vector<std::string> &values
     db::deserializeValues(state.blockIndexesBySpentKeyImages, iter, db::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX);
     db::deserializeValues(state.cachedTransactions, iter, db::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX);
     db::deserializeValues(state.transactionHashesByBlocks, iter, db::BLOCK_INDEX_TO_TX_HASHES_PREFIX);
+    db::deserializeValues(state.globalIndexesByBlocks, iter, db::BLOCK_INDEX_TO_GLOBAL_INDEXES_PREFIX);
     db::deserializeValues(state.cachedBlocks, iter, db::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX);
     db::deserializeValues(state.blockIndexesByBlockHashes, iter, db::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX);
     db::deserializeValues(state.keyOutputGlobalIndexesCountForAmounts, iter, db::KEY_OUTPUT_AMOUNT_PREFIX);
@@ -323,6 +336,7 @@ BlockchainReadState::BlockchainReadState(BlockchainReadState &&state) : spentKey
                                                                         blockIndexesBySpentKeyImages(std::move(state.blockIndexesBySpentKeyImages)),
                                                                         cachedTransactions(std::move(state.cachedTransactions)),
                                                                         transactionHashesByBlocks(std::move(state.transactionHashesByBlocks)),
+                                                                        globalIndexesByBlocks(std::move(state.globalIndexesByBlocks)),
                                                                         cachedBlocks(std::move(state.cachedBlocks)),
                                                                         blockIndexesByBlockHashes(std::move(state.blockIndexesByBlockHashes)),
                                                                         keyOutputGlobalIndexesCountForAmounts(std::move(state.keyOutputGlobalIndexesCountForAmounts)),
@@ -346,6 +360,7 @@ size_t BlockchainReadState::size() const
            blockIndexesBySpentKeyImages.size() +
            cachedTransactions.size() +
            transactionHashesByBlocks.size() +
+           globalIndexesByBlocks.size() +
            cachedBlocks.size() +
            blockIndexesByBlockHashes.size() +
            keyOutputGlobalIndexesCountForAmounts.size() +
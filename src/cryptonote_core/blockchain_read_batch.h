@@ -56,6 +56,7 @@ namespace cryptonote
         std::unordered_map<crypto::KeyImage, uint32_t> blockIndexesBySpentKeyImages;
         std::unordered_map<crypto::Hash, ExtendedTransactionInfo> cachedTransactions;
         std::unordered_map<uint32_t, std::vector<crypto::Hash>> transactionHashesByBlocks;
+        std::unordered_map<uint32_t, BlockGlobalIndexes> globalIndexesByBlocks;
         std::unordered_map<uint32_t, CachedBlockInfo> cachedBlocks;
         std::unordered_map<crypto::Hash, uint32_t> blockIndexesByBlockHashes;
         std::unordered_map<IBlockchainCache::Amount, uint32_t> keyOutputGlobalIndexesCountForAmounts;
@@ -91,6 +92,7 @@ namespace cryptonote
         const std::unordered_map<crypto::KeyImage, uint32_t> &getBlockIndexesBySpentKeyImages() const;
         const std::unordered_map<crypto::Hash, ExtendedTransactionInfo> &getCachedTransactions() const;
         const std::unordered_map<uint32_t, std::vector<crypto::Hash>> &getTransactionHashesByBlocks() const;
+        const std::unordered_map<uint32_t, BlockGlobalIndexes> &getGlobalIndexesByBlocks() const;
         const std::unordered_map<uint32_t, CachedBlockInfo> &getCachedBlocks() const;
         const std::unordered_map<crypto::Hash, uint32_t> &getBlockIndexesByBlockHashes() const;
         const std::unordered_map<IBlockchainCache::Amount, uint32_t> &getKeyOutputGlobalIndexesCountForAmounts() const;
@@ -120,6 +122,7 @@ namespace cryptonote
         BlockchainReadBatch &requestCachedTransaction(const crypto::Hash &txHash);
         BlockchainReadBatch &requestCachedTransactions(const std::vector<crypto::Hash> &transactions);
         BlockchainReadBatch &requestTransactionHashesByBlock(uint32_t blockIndex);
+        BlockchainReadBatch &requestGlobalIndexesByBlock(uint32_t blockIndex);
         BlockchainReadBatch &requestCachedBlock(uint32_t blockIndex);
         BlockchainReadBatch &requestBlockIndexByBlockHash(const crypto::Hash &blockHash);
         BlockchainReadBatch &requestKeyOutputGlobalIndexesCountForAmount(IBlockchainCache::Amount amount);
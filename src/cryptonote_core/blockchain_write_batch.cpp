@@ -108,6 +108,12 @@ BlockchainWriteBatch &BlockchainWriteBatch::insertKeyOutputInfo(IBlockchainCache
     return *this;
 }
 
+BlockchainWriteBatch &BlockchainWriteBatch::insertBlockGlobalIndexes(uint32_t blockIndex, const BlockGlobalIndexes &globalIndexes)
+{
+    rawDataToInsert.emplace_back(db::serialize(db::BLOCK_INDEX_TO_GLOBAL_INDEXES_PREFIX, blockIndex, globalIndexes));
+    return *this;
+}
+
 BlockchainWriteBatch &BlockchainWriteBatch::removeSpentKeyImages(uint32_t blockIndex, const std::vector<crypto::KeyImage> &spentKeyImages)
 {
     rawKeysToRemove.reserve(rawKeysToRemove.size() + spentKeyImages.size() + 1);
@@ -139,6 +145,7 @@ BlockchainWriteBatch &BlockchainWriteBatch::removeCachedBlock(const crypto::Hash
 {
     rawKeysToRemove.emplace_back(db::serializeKey(db::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX, blockIndex));
     rawKeysToRemove.emplace_back(db::serializeKey(db::BLOCK_INDEX_TO_TX_HASHES_PREFIX, blockIndex));
+    rawKeysToRemove.emplace_back(db::serializeKey(db::BLOCK_INDEX_TO_GLOBAL_INDEXES_PREFIX, blockIndex));
     rawKeysToRemove.emplace_back(db::serializeKey(db::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX, blockHash));
     rawDataToInsert.emplace_back(db::serialize(db::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX, db::LAST_BLOCK_INDEX_KEY, blockIndex - 1));
     return *this;
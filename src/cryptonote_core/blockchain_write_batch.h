@@ -32,6 +32,7 @@ namespace cryptonote
         BlockchainWriteBatch &insertKeyOutputAmounts(const std::set<IBlockchainCache::Amount> &amounts, uint32_t totalKeyOutputAmountsCount);
         BlockchainWriteBatch &insertTimestamp(uint64_t timestamp, const std::vector<crypto::Hash> &blockHashes);
         BlockchainWriteBatch &insertKeyOutputInfo(IBlockchainCache::Amount amount, IBlockchainCache::GlobalOutputIndex globalIndex, const KeyOutputInfo &outputInfo);
+        BlockchainWriteBatch &insertBlockGlobalIndexes(uint32_t blockIndex, const BlockGlobalIndexes &globalIndexes);
 
         BlockchainWriteBatch &removeSpentKeyImages(uint32_t blockIndex, const std::vector<crypto::KeyImage> &spentKeyImages);
         BlockchainWriteBatch &removeCachedTransaction(const crypto::Hash &transactionHash, uint64_t totalTxsCount);
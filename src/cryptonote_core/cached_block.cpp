@@ -58,39 +58,42 @@ const crypto::Hash &CachedBlock::getBlockLongHash() const
 {
     if (!blockLongHash.is_initialized())
     {
-        if (block.majorVersion == BLOCK_MAJOR_VERSION_1)
-        {
-            const auto &rawHashingBlock = getBlockHashingBinaryArray();
-            blockLongHash = Hash();
-            cn_slow_hash_v0(rawHashingBlock.data(), rawHashingBlock.size(), blockLongHash.get());
-        }
-        else if ((block.majorVersion == BLOCK_MAJOR_VERSION_2) || (block.majorVersion == BLOCK_MAJOR_VERSION_3))
+        const auto &rawHashingBlock = getBlockLongHashingBinaryArray();
+        blockLongHash = Hash();
+
+        if ((block.majorVersion == BLOCK_MAJOR_VERSION_1) || (block.majorVersion == BLOCK_MAJOR_VERSION_2) || (block.majorVersion == BLOCK_MAJOR_VERSION_3))
         {
-            const auto &rawHashingBlock = getParentBlockHashingBinaryArray(true);
-            blockLongHash = Hash();
             cn_slow_hash_v0(rawHashingBlock.data(), rawHashingBlock.size(), blockLongHash.get());
         }
         else if (block.majorVersion == BLOCK_MAJOR_VERSION_4)
         {
-            const auto &rawHashingBlock = getParentBlockHashingBinaryArray(true);
-            blockLongHash = Hash();
             cn_lite_slow_hash_v1(rawHashingBlock.data(), rawHashingBlock.size(), blockLongHash.get());
         }
-        else if (block.majorVersion >= BLOCK_MAJOR_VERSION_5)
-        {
-            const auto &rawHashingBlock = getParentBlockHashingBinaryArray(true);
-            blockLongHash = Hash();
-            cn_turtle_lite_slow_hash_v2(rawHashingBlock.data(), rawHashingBlock.size(), blockLongHash.get());
-        }
         else
         {
-            throw std::runtime_error("Unknown block major version.");
+            cn_turtle_lite_slow_hash_v2(rawHashingBlock.data(), rawHashingBlock.size(), blockLongHash.get());
         }
     }
 
     return blockLongHash.get();
 }
 
+const BinaryArray &CachedBlock::getBlockLongHashingBinaryArray() const
+{
+    if (block.majorVersion == BLOCK_MAJOR_VERSION_1)
+    {
+        return getBlockHashingBinaryArray();
+    }
+    else if (block.majorVersion >= BLOCK_MAJOR_VERSION_2)
+    {
+        return getParentBlockHashingBinaryArray(true);
+    }
+    else
+    {
+        throw std::runtime_error("Unknown block major version.");
+    }
+}
+
 const crypto::Hash &CachedBlock::getAuxiliaryBlockHeaderHash() const
 {
     if (!auxiliaryBlockHeaderHash.is_initialized())
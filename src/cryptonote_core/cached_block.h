@@ -21,6 +21,8 @@ namespace cryptonote
         const crypto::Hash &getTransactionTreeHash() const;
         const crypto::Hash &getBlockHash() const;
         const crypto::Hash &getBlockLongHash() const;
+        /* What getBlockLongHash() hashes, which depends on the version */
+        const BinaryArray &getBlockLongHashingBinaryArray() const;
         const crypto::Hash &getAuxiliaryBlockHeaderHash() const;
         const BinaryArray &getBlockHashingBinaryArray() const;
         const BinaryArray &getParentBlockBinaryArray(bool headerOnly) const;
@@ -6,8 +6,10 @@
 // Please see the included LICENSE file for more information.
 
 #include <algorithm>
+#include <atomic>
 
 #include <numeric>
+#include <optional>
 #include <iostream>
 #include <ctime>
 #include <common/shuffle_generator.h>
@@ -35,6 +37,7 @@
 
 #include <set>
 
+#include <syst/remote_context.h>
 #include <syst/timer.h>
 
 #include <utilities/format_tools.h>
@@ -61,30 +64,6 @@ namespace cryptonote
         }
         UseGenesis addGenesisBlock = UseGenesis(true);
 
-        class TransactionSpentInputsChecker
-        {
-        public:
-            bool haveSpentInputs(const Transaction &transaction)
-            {
-                for (const auto &input : transaction.inputs)
-                {
-                    if (input.type() == typeid(KeyInput))
-                    {
-                        auto inserted = alreadSpentKeyImages.insert(boost::get<KeyInput>(input).keyImage);
-                        if (!inserted.second)
-                        {
-                            return true;
-                        }
-                    }
-                }
-
-                return false;
-            }
-
-        private:
-            std::unordered_set<crypto::KeyImage> alreadSpentKeyImages;
-        };
-
         inline IBlockchainCache *findIndexInChain(IBlockchainCache *blockSegment, const crypto::Hash &blockHash)
         {
             assert(blockSegment != nullptr);
@@ -228,10 +207,12 @@ namespace cryptonote
     }
 
     Core::Core(const Currency &currency, std::shared_ptr<logging::ILogger> logger, Checkpoints &&checkpoints, syst::Dispatcher &dispatcher,
-               std::unique_ptr<IBlockchainCacheFactory> &&blockchainCacheFactory, std::unique_ptr<IMainChainStorage> &&mainchainStorage)
+               std::unique_ptr<IBlockchainCacheFactory> &&blockchainCacheFactory, std::unique_ptr<IMainChainStorage> &&mainchainStorage,
+               const uint32_t transactionValidationThreads)
         : currency(currency), dispatcher(dispatcher), contextGroup(dispatcher), logger(logger, "Core"), checkpoints(std::move(checkpoints)),
           upgradeManager(new UpgradeManager()), blockchainCacheFactory(std::move(blockchainCacheFactory)),
-          mainChainStorage(std::move(mainchainStorage)), initialized(false)
+          mainChainStorage(std::move(mainchainStorage)), initialized(false), validationThreadPool(transactionValidationThreads),
+          ringMemberCache(RING_MEMBER_CACHE_DEFAULT_SIZE), walletSyncDataCache(WALLET_SYNC_DATA_CACHE_SIZE)
     {
 
         upgradeManager->addMajorBlockVersion(BLOCK_MAJOR_VERSION_2, currency.upgradeHeight(BLOCK_MAJOR_VERSION_2));
@@ -771,31 +752,20 @@ namespace cryptonote
                 return true;
             }
 
-            std::vector<RawBlock> rawBlocks = mainChain->getBlocksByHeight(startIndex, endIndex);
+            /* Recent blocks are usually cached, anything older than the cache
+               or missing from it is read from the database */
+            std::vector<wallet_types::WalletBlockInfo> cachedBlocks;
 
-            for (const auto rawBlock : rawBlocks)
-            {
-                BlockTemplate block;
+            const uint64_t cachedStartIndex = walletSyncDataCache.getBlocks(startIndex, endIndex, cachedBlocks);
+            const uint64_t cachedEndIndex = cachedBlocks.empty() ? endIndex : cachedStartIndex + cachedBlocks.size();
 
-                fromBinaryArray(block, rawBlock.block);
+            walletBlocks.reserve(walletBlocks.size() + (endIndex - startIndex));
 
-                wallet_types::WalletBlockInfo walletBlock;
+            getWalletSyncDataFromStorage(mainChain, startIndex, cachedStartIndex, walletBlocks);
 
-                walletBlock.blockHeight = startIndex++;
-                walletBlock.blockHash = CachedBlock(block).getBlockHash();
-                walletBlock.blockTimestamp = block.timestamp;
+            std::move(cachedBlocks.begin(), cachedBlocks.end(), std::back_inserter(walletBlocks));
 
-                walletBlock.coinbaseTransaction = getRawCoinbaseTransaction(
-                    block.baseTransaction);
-
-                for (const auto &transaction : rawBlock.transactions)
-                {
-                    walletBlock.transactions.push_back(
-                        getRawTransaction(transaction));
-                }
-
-                walletBlocks.push_back(walletBlock);
-            }
+            getWalletSyncDataFromStorage(mainChain, cachedEndIndex, endIndex, walletBlocks);
 
             return true;
         }
@@ -806,6 +776,68 @@ namespace cryptonote
         }
     }
 
+    void Core::getWalletSyncDataFromStorage(
+        IBlockchainCache *mainChain,
+        uint64_t startIndex,
+        const uint64_t endIndex,
+        std::vector<wallet_types::WalletBlockInfo> &walletBlocks) const
+    {
+        if (startIndex >= endIndex)
+        {
+            return;
+        }
+
+        std::vector<RawBlock> rawBlocks = mainChain->getBlocksByHeight(startIndex, endIndex);
+
+        for (const auto &rawBlock : rawBlocks)
+        {
+            BlockTemplate block;
+
+            fromBinaryArray(block, rawBlock.block);
+
+            wallet_types::WalletBlockInfo walletBlock;
+
+            walletBlock.blockHeight = startIndex++;
+            walletBlock.blockHash = CachedBlock(block).getBlockHash();
+            walletBlock.blockTimestamp = block.timestamp;
+
+            walletBlock.coinbaseTransaction = getRawCoinbaseTransaction(
+                block.baseTransaction);
+
+            for (const auto &transaction : rawBlock.transactions)
+            {
+                walletBlock.transactions.push_back(
+                    getRawTransaction(transaction));
+            }
+
+            walletBlocks.push_back(std::move(walletBlock));
+        }
+    }
+
+    void Core::addWalletSyncData(const CachedBlock &cachedBlock, const std::vector<CachedTransaction> &transactions)
+    {
+        const auto &block = cachedBlock.getBlock();
+
+        wallet_types::WalletBlockInfo walletBlock;
+
+        walletBlock.blockHeight = cachedBlock.getBlockIndex();
+        walletBlock.blockHash = cachedBlock.getBlockHash();
+        walletBlock.blockTimestamp = block.timestamp;
+
+        walletBlock.coinbaseTransaction = getRawCoinbaseTransaction(
+            block.baseTransaction);
+
+        walletBlock.transactions.reserve(transactions.size());
+
+        for (const auto &transaction : transactions)
+        {
+            walletBlock.transactions.push_back(
+                getRawTransaction(transaction.getTransaction(), transaction.getTransactionHash()));
+        }
+
+        walletSyncDataCache.addBlock(std::move(walletBlock));
+    }
+
     wallet_types::RawCoinbaseTransaction Core::getRawCoinbaseTransaction(
         const cryptonote::Transaction &t)
     {
@@ -839,10 +871,17 @@ namespace cryptonote
         /* Convert the binary array to a transaction */
         fromBinaryArray(t, rawTX);
 
+        /* Get the transaction hash from the binary array */
+        return getRawTransaction(t, getBinaryArrayHash(rawTX));
+    }
+
+    wallet_types::RawTransaction Core::getRawTransaction(
+        const Transaction &t,
+        const crypto::Hash &hash)
+    {
         wallet_types::RawTransaction transaction;
 
-        /* Get the transaction hash from the binary array */
-        transaction.hash = getBinaryArrayHash(rawTX);
+        transaction.hash = hash;
 
         /* Transaction public key, used for decrypting transactions along with
            private view key */
@@ -1087,6 +1126,38 @@ namespace cryptonote
     std::error_code Core::addBlock(const CachedBlock &cachedBlock, RawBlock &&rawBlock)
     {
         throwIfNotInitialized();
+
+        /* Don't bother deserializing the transactions of a block we have */
+        if (hasBlock(cachedBlock.getBlockHash()))
+        {
+            logger(logging::DEBUGGING) << "Block " << cachedBlock.getBlockIndex() << " (" << cachedBlock.getBlockHash() << ") already exists";
+            return error::AddBlockErrorCode::ALREADY_EXISTS;
+        }
+
+        /* Nor of one we can't add */
+        if (findSegmentContainingBlock(cachedBlock.getBlock().previousBlockHash) == nullptr)
+        {
+            logger(logging::DEBUGGING) << "Block " << cachedBlock.getBlockIndex() << " (" << cachedBlock.getBlockHash() << ") rejected as orphaned";
+            return error::AddBlockErrorCode::REJECTED_AS_ORPHANED;
+        }
+
+        std::vector<CachedTransaction> transactions;
+        uint64_t cumulativeSize = 0;
+        if (!extractTransactions(rawBlock.transactions, transactions, cumulativeSize))
+        {
+            logger(logging::DEBUGGING) << "Couldn't deserialize raw block transactions in block " << cachedBlock.getBlockHash();
+            return error::AddBlockErrorCode::DESERIALIZATION_FAILED;
+        }
+
+        return addBlock(cachedBlock, std::move(rawBlock), std::move(transactions));
+    }
+
+    std::error_code Core::addBlock(const CachedBlock &cachedBlock, RawBlock &&rawBlock, std::vector<CachedTransaction> &&transactions)
+    {
+        throwIfNotInitialized();
+
+        StateWriteLock stateLock(*this);
+
         uint32_t blockIndex = cachedBlock.getBlockIndex();
         crypto::Hash blockHash = cachedBlock.getBlockHash();
         std::ostringstream os;
@@ -1112,12 +1183,20 @@ namespace cryptonote
             return error::AddBlockErrorCode::REJECTED_AS_ORPHANED;
         }
 
-        std::vector<CachedTransaction> transactions;
+        assert(transactions.size() == rawBlock.transactions.size());
+
+        /* The transactions may have been deserialized by the caller, so
+           check the sizes again here */
         uint64_t cumulativeSize = 0;
-        if (!extractTransactions(rawBlock.transactions, transactions, cumulativeSize))
+        for (const auto &rawTransaction : rawBlock.transactions)
         {
-            logger(logging::DEBUGGING) << "Couldn't deserialize raw block transactions in block " << blockStr;
-            return error::AddBlockErrorCode::DESERIALIZATION_FAILED;
+            if (rawTransaction.size() > currency.maxTxSize())
+            {
+                logger(logging::DEBUGGING) << "Raw transaction size " << rawTransaction.size() << " is too big in block " << blockStr;
+                return error::AddBlockErrorCode::DESERIALIZATION_FAILED;
+            }
+
+            cumulativeSize += rawTransaction.size();
         }
 
         auto coinbaseTransactionSize = getObjectBinarySize(blockTemplate.baseTransaction);
@@ -1220,10 +1299,16 @@ namespace cryptonote
 
         uint64_t cumulativeFee = 0;
 
+        /* Key image and output checks depend on the chain state and the
+           inputs of the previous transactions, so these are done serially.
+           The ring signatures only depend on data we gather here, so we
+           check them all at once afterwards. */
+        std::vector<RingSignatureCheck> ringSignatures;
+
         for (const auto &transaction : transactions)
         {
             uint64_t fee = 0;
-            auto transactionValidationResult = validateTransaction(transaction, validatorState, cache, fee, previousBlockIndex);
+            auto transactionValidationResult = validateTransaction(transaction, validatorState, cache, fee, previousBlockIndex, ringSignatures);
             if (transactionValidationResult)
             {
                 logger(logging::DEBUGGING) << "Failed to validate transaction " << transaction.getTransactionHash() << ": " << transactionValidationResult.message();
@@ -1233,6 +1318,12 @@ namespace cryptonote
             cumulativeFee += fee;
         }
 
+        if (auto signatureValidationResult = checkRingSignatures(ringSignatures))
+        {
+            logger(logging::DEBUGGING) << "Failed to validate signatures in block " << blockStr << ": " << signatureValidationResult.message();
+            return signatureValidationResult;
+        }
+
         uint64_t reward = 0;
         int64_t emissionChange = 0;
         auto alreadyGeneratedCoins = cache->getAlreadyGeneratedCoins(previousBlockIndex);
@@ -1283,12 +1374,15 @@ namespace cryptonote
 
                     cache->pushBlock(cachedBlock, transactions, validatorState, cumulativeBlockSize, emissionChange, currentDifficulty, std::move(rawBlock));
 
+                    addWalletSyncData(cachedBlock, transactions);
+
                     updateBlockMedianSize();
 
                     // we've used these transactions, remove them from the pool if they are there
                     for (const auto tx : transactions)
                     {
                         transactionPool->removeTransaction(tx.getTransactionHash());
+                        blockTemplateCandidates.remove(tx.getTransactionHash());
                     }
 
                     actualizePoolTransactionsLite(validatorState);
@@ -1323,6 +1417,7 @@ namespace cryptonote
                         for (const auto tx : transactions)
                         {
                             transactionPool->removeTransaction(tx.getTransactionHash());
+                            blockTemplateCandidates.remove(tx.getTransactionHash());
                         }
 
                         actualizePoolTransactions();
@@ -1407,6 +1502,7 @@ namespace cryptonote
         {
             auto tx = pool.getTransaction(hash);
             pool.removeTransaction(hash);
+            blockTemplateCandidates.remove(hash);
 
             if (!addTransactionToPool(std::move(tx)))
             {
@@ -1429,6 +1525,7 @@ namespace cryptonote
             if (hasIntersections(validatorState, txState) || tx.getTransactionBinaryArray().size() > getMaximumTransactionAllowedSize(blockMedianSize, currency))
             {
                 pool.removeTransaction(hash);
+                blockTemplateCandidates.remove(hash);
                 notifyObservers(makeDelTransactionMessage({hash}, Messages::DeleteTransaction::Reason::NotActual));
             }
         }
@@ -1438,6 +1535,9 @@ namespace cryptonote
     {
         assert(mainChainStorage->getBlockCount() > splitBlockIndex);
 
+        /* Blocks from the split onwards are now from the other chain */
+        walletSyncDataCache.removeBlocksFrom(splitBlockIndex);
+
         auto blocksToPop = mainChainStorage->getBlockCount() - splitBlockIndex;
         for (size_t i = 0; i < blocksToPop; ++i)
         {
@@ -1475,6 +1575,16 @@ namespace cryptonote
         }
     }
 
+    bool Core::isInCheckpointZone(uint32_t blockIndex) const
+    {
+        return checkpoints.isInCheckpointZone(blockIndex);
+    }
+
+    ThreadPool &Core::getThreadPool()
+    {
+        return validationThreadPool;
+    }
+
     std::error_code Core::addBlock(RawBlock &&rawBlock)
     {
         throwIfNotInitialized();
@@ -1609,26 +1719,7 @@ namespace cryptonote
 
         try
         {
-            IBlockchainCache *mainChain = chainsLeaves[0];
-
-            std::vector<crypto::Hash> transactionHashes;
-
-            for (const auto rawBlock : mainChain->getBlocksByHeight(startHeight, endHeight))
-            {
-                for (const auto transaction : rawBlock.transactions)
-                {
-                    transactionHashes.push_back(getBinaryArrayHash(transaction));
-                }
-
-                BlockTemplate block;
-
-                fromBinaryArray(block, rawBlock.block);
-
-                transactionHashes.push_back(
-                    getBinaryArrayHash(toBinaryArray(block.baseTransaction)));
-            }
-
-            indexes = mainChain->getGlobalIndexes(transactionHashes);
+            indexes = chainsLeaves[0]->getGlobalIndexesForRange(startHeight, endHeight);
 
             return true;
         }
@@ -1653,17 +1744,198 @@ namespace cryptonote
         CachedTransaction cachedTransaction(std::move(transaction));
         auto transactionHash = cachedTransaction.getTransactionHash();
 
+        /* Already known, not a rejection */
+        if (transactionPool->checkIfTransactionPresent(transactionHash))
+        {
+            return false;
+        }
+
         if (!addTransactionToPool(std::move(cachedTransaction)))
         {
+            poolTransactionsRejected.add();
             return false;
         }
 
+        poolTransactionsAdmitted.add();
+
         notifyObservers(makeAddTransactionMessage({transactionHash}));
         return true;
     }
 
+    std::vector<bool> Core::addTransactionsToPool(const std::vector<BinaryArray> &transactionBinaryArrays)
+    {
+        throwIfNotInitialized();
+
+        const size_t count = transactionBinaryArrays.size();
+
+        std::vector<bool> added(count, false);
+
+        std::vector<std::optional<CachedTransaction>> transactions(count);
+
+        /* Parse and hash the batch on the worker threads. The dispatcher
+           carries on serving everything else in the meantime. */
+        syst::RemoteContext<void> parseContext(dispatcher, [this, &transactionBinaryArrays, &transactions]()
+        {
+            std::vector<std::future<void>> parsed;
+            parsed.reserve(transactions.size());
+
+            for (size_t index = 0; index < transactions.size(); index++)
+            {
+                parsed.push_back(validationThreadPool.addJob([&transactionBinaryArrays, &transactions, index]()
+                {
+                    Transaction transaction;
+
+                    if (!fromBinaryArray<Transaction>(transaction, transactionBinaryArrays[index]))
+                    {
+                        return;
+                    }
+
+                    transactions[index].emplace(std::move(transaction));
+
+                    /* Computed lazily, and not safe to share between threads
+                       until they have been */
+                    transactions[index]->getTransactionHash();
+                    transactions[index]->getTransactionPrefixHash();
+                }));
+            }
+
+            for (auto &result : parsed)
+            {
+                result.get();
+            }
+        });
+
+        parseContext.get();
+
+        struct PendingTransaction
+        {
+            size_t index;
+            TransactionValidatorState validatorState;
+            /* Its ring signatures, in ringSignatures */
+            size_t signaturesStart;
+            size_t signaturesEnd;
+        };
+
+        std::vector<PendingTransaction> pending;
+
+        std::vector<RingSignatureCheck> ringSignatures;
+
+        std::unordered_set<crypto::Hash> seen;
+
+        /* Everything which needs the chain or the pool is checked here, on
+           the dispatcher */
+        for (size_t index = 0; index < count; index++)
+        {
+            if (!transactions[index])
+            {
+                logger(logging::WARNING) << "Couldn't add transaction to pool due to deserialization error";
+                poolTransactionsRejected.add();
+                continue;
+            }
+
+            const CachedTransaction &cachedTransaction = *transactions[index];
+            const auto transactionHash = cachedTransaction.getTransactionHash();
+
+            /* Already known, or in the batch twice */
+            if (transactionPool->checkIfTransactionPresent(transactionHash) || !seen.insert(transactionHash).second)
+            {
+                continue;
+            }
+
+            PendingTransaction transaction;
+            transaction.index = index;
+            transaction.signaturesStart = ringSignatures.size();
+
+            if (!isTransactionValidForPool(cachedTransaction, transaction.validatorState, ringSignatures))
+            {
+                ringSignatures.resize(transaction.signaturesStart);
+                poolTransactionsRejected.add();
+                continue;
+            }
+
+            transaction.signaturesEnd = ringSignatures.size();
+
+            pending.push_back(std::move(transaction));
+        }
+
+        if (pending.empty())
+        {
+            return added;
+        }
+
+        const crypto::Hash topBlockHash = getTopBlockHash();
+
+        /* Check every signature in the batch at once, rather than stopping at
+           the first bad one, so one bad transaction doesn't sink the rest */
+        syst::RemoteContext<std::vector<uint8_t>> signatureContext(dispatcher, [this, &ringSignatures]()
+        {
+            return findInvalidRingSignatures(ringSignatures, false);
+        });
+
+        const std::vector<uint8_t> invalidSignatures = signatureContext.get();
+
+        /* Taking it can wait on RPC readers, so taken before we look at the
+           chain again - nothing can change it under us after this */
+        StateWriteLock stateLock(*this);
+
+        /* If a block arrived while we were waiting, what we checked against
+           the chain may no longer hold, so go through the full checks again */
+        const bool chainChanged = getTopBlockHash() != topBlockHash;
+
+        std::vector<crypto::Hash> addedHashes;
+
+        for (auto &transaction : pending)
+        {
+            CachedTransaction &cachedTransaction = *transactions[transaction.index];
+            const auto transactionHash = cachedTransaction.getTransactionHash();
+
+            const auto signaturesStart = invalidSignatures.begin() + transaction.signaturesStart;
+            const auto signaturesEnd = invalidSignatures.begin() + transaction.signaturesEnd;
+
+            if (std::find(signaturesStart, signaturesEnd, 1) != signaturesEnd)
+            {
+                logger(logging::DEBUGGING) << "Transaction " << transactionHash
+                                           << " is not valid. Reason: " << make_error_code(error::TransactionValidationError::INPUT_INVALID_SIGNATURES).message();
+                poolTransactionsRejected.add();
+                continue;
+            }
+
+            /* Another connection may have relayed it to us in the meantime */
+            if (transactionPool->checkIfTransactionPresent(transactionHash))
+            {
+                continue;
+            }
+
+            const bool pushed = chainChanged
+                                    ? addTransactionToPool(std::move(cachedTransaction))
+                                    : pushTransactionToPool(std::move(cachedTransaction), std::move(transaction.validatorState));
+
+            if (!pushed)
+            {
+                poolTransactionsRejected.add();
+                continue;
+            }
+
+            poolTransactionsAdmitted.add();
+
+            added[transaction.index] = true;
+            addedHashes.push_back(transactionHash);
+        }
+
+        if (!addedHashes.empty())
+        {
+            notifyObservers(makeAddTransactionMessage(std::move(addedHashes)));
+        }
+
+        return added;
+    }
+
     bool Core::addTransactionToPool(CachedTransaction &&cachedTransaction)
     {
+        /* Held from before we validate, so a block added while we wait for it
+           can't make the checks stale */
+        StateWriteLock stateLock(*this);
+
         TransactionValidatorState validatorState;
 
         auto transactionHash = cachedTransaction.getTransactionHash();
@@ -1678,22 +1950,51 @@ namespace cryptonote
             return false;
         }
 
-        if (!isTransactionValidForPool(cachedTransaction, validatorState))
+        std::vector<RingSignatureCheck> ringSignatures;
+
+        if (!isTransactionValidForPool(cachedTransaction, validatorState, ringSignatures))
         {
             return false;
         }
 
+        if (auto signatureValidationResult = checkRingSignatures(ringSignatures))
+        {
+            logger(logging::DEBUGGING) << "Transaction " << transactionHash
+                                       << " is not valid. Reason: " << signatureValidationResult.message();
+            return false;
+        }
+
+        return pushTransactionToPool(std::move(cachedTransaction), std::move(validatorState));
+    }
+
+    bool Core::pushTransactionToPool(CachedTransaction &&cachedTransaction, TransactionValidatorState &&validatorState)
+    {
+        StateWriteLock stateLock(*this);
+
+        const auto transactionHash = cachedTransaction.getTransactionHash();
+
         if (!transactionPool->pushTransaction(std::move(cachedTransaction), std::move(validatorState)))
         {
             logger(logging::DEBUGGING) << "Failed to push transaction " << transactionHash << " to pool, already exists";
             return false;
         }
 
+        const CachedTransaction &poolTransaction = transactionPool->getTransaction(transactionHash);
+
+        blockTemplateCandidates.add(
+            transactionHash,
+            poolTransaction.getTransactionFee(),
+            poolTransaction.getTransactionBinaryArray().size(),
+            transactionPool->getTransactionReceiveTime(transactionHash));
+
         logger(logging::DEBUGGING) << "Transaction " << transactionHash << " has been added to pool";
         return true;
     }
 
-    bool Core::isTransactionValidForPool(const CachedTransaction &cachedTransaction, TransactionValidatorState &validatorState)
+    bool Core::isTransactionValidForPool(
+        const CachedTransaction &cachedTransaction,
+        TransactionValidatorState &validatorState,
+        std::vector<RingSignatureCheck> &ringSignatures)
     {
         const auto transactionHash = cachedTransaction.getTransactionHash();
 
@@ -1715,7 +2016,7 @@ namespace cryptonote
 
         uint64_t fee;
 
-        if (auto validationResult = validateTransaction(cachedTransaction, validatorState, chainsLeaves[0], fee, getTopBlockIndex()))
+        if (auto validationResult = validateTransaction(cachedTransaction, validatorState, chainsLeaves[0], fee, getTopBlockIndex(), ringSignatures))
         {
             logger(logging::DEBUGGING) << "Transaction " << transactionHash
                                        << " is not valid. Reason: " << validationResult.message();
@@ -1827,6 +2128,9 @@ namespace cryptonote
     {
         throwIfNotInitialized();
 
+        /* Transactions which are no longer valid are dropped from the pool */
+        StateWriteLock stateLock(*this);
+
         height = getTopBlockIndex() + 1;
         difficulty = getDifficultyForNextBlock();
         if (difficulty == 0)
@@ -2081,7 +2385,8 @@ namespace cryptonote
     }
 
     std::error_code Core::validateTransaction(const CachedTransaction &cachedTransaction, TransactionValidatorState &state,
-                                              IBlockchainCache *cache, uint64_t &fee, uint32_t blockIndex)
+                                              IBlockchainCache *cache, uint64_t &fee, uint32_t blockIndex,
+                                              std::vector<RingSignatureCheck> &ringSignatures)
     {
         // TransactionValidatorState currentState;
         const auto &transaction = cachedTransaction.getTransaction();
@@ -2135,10 +2440,8 @@ namespace cryptonote
                         return error::TransactionValidationError::INPUT_INVALID_SIGNATURES_COUNT;
                     }
 
-                    if (!crypto::crypto_ops::checkRingSignature(cachedTransaction.getTransactionPrefixHash(), in.keyImage, outputKeys, transaction.signatures[inputIndex]))
-                    {
-                        return error::TransactionValidationError::INPUT_INVALID_SIGNATURES;
-                    }
+                    /* The signatures themselves are checked by checkRingSignatures() */
+                    ringSignatures.push_back({&cachedTransaction, cachedTransaction.getTransactionPrefixHash(), inputIndex, std::move(outputKeys)});
                 }
             }
             else
@@ -2153,6 +2456,117 @@ namespace cryptonote
         return error::TransactionValidationError::VALIDATION_SUCCESS;
     }
 
+    std::error_code Core::checkRingSignatures(const std::vector<RingSignatureCheck> &ringSignatures)
+    {
+        const std::vector<uint8_t> invalid = findInvalidRingSignatures(ringSignatures, true);
+
+        const auto failed = std::find(invalid.begin(), invalid.end(), 1);
+
+        if (failed != invalid.end())
+        {
+            const size_t failedSignature = failed - invalid.begin();
+
+            logger(logging::DEBUGGING) << "Transaction " << ringSignatures[failedSignature].transaction->getTransactionHash()
+                                       << " has an invalid signature for input " << ringSignatures[failedSignature].inputIndex;
+
+            return error::TransactionValidationError::INPUT_INVALID_SIGNATURES;
+        }
+
+        return error::TransactionValidationError::VALIDATION_SUCCESS;
+    }
+
+    std::vector<uint8_t> Core::findInvalidRingSignatures(const std::vector<RingSignatureCheck> &ringSignatures, const bool stopAtFirst)
+    {
+        /* Set for each invalid signature. Not std::vector<bool>, as the
+           workers write to it at the same time. */
+        std::vector<uint8_t> invalid(ringSignatures.size(), 0);
+
+        /* Signatures are checked in small batches, so the point encoding
+           work can be shared between them, whilst still leaving enough
+           batches to keep every worker busy */
+        const size_t batchSize = 16;
+
+        const size_t batchCount = (ringSignatures.size() + batchSize - 1) / batchSize;
+
+        std::atomic<size_t> nextBatch(0);
+
+        std::atomic<bool> failed(false);
+
+        /* Workers take the next unchecked batch until we run out, so large
+           and small rings are spread evenly over the threads */
+        const auto checkSignatures = [&]()
+        {
+            size_t batchIndex;
+
+            std::vector<crypto::RingSignatureBatchEntry> batch;
+
+            while (!(stopAtFirst && failed) && (batchIndex = nextBatch++) < batchCount)
+            {
+                size_t start = batchIndex * batchSize;
+                const size_t end = std::min(start + batchSize, ringSignatures.size());
+
+                /* The batch check stops at the first invalid signature, so
+                   carry on from the one after it if we want them all */
+                while (start < end)
+                {
+                    batch.clear();
+
+                    for (size_t i = start; i < end; i++)
+                    {
+                        const auto &ringSignature = ringSignatures[i];
+                        const auto &transaction = ringSignature.transaction->getTransaction();
+
+                        batch.push_back({
+                            &ringSignature.prefixHash,
+                            &boost::get<KeyInput>(transaction.inputs[ringSignature.inputIndex]).keyImage,
+                            &ringSignature.outputKeys,
+                            &transaction.signatures[ringSignature.inputIndex]});
+                    }
+
+                    const size_t firstInvalid = crypto::crypto_ops::checkRingSignatures(batch, &ringMemberCache);
+
+                    if (firstInvalid == batch.size())
+                    {
+                        break;
+                    }
+
+                    invalid[start + firstInvalid] = 1;
+                    failed = true;
+
+                    if (stopAtFirst)
+                    {
+                        break;
+                    }
+
+                    start += firstInvalid + 1;
+                }
+            }
+        };
+
+        const size_t workerCount = std::min(validationThreadPool.size(), batchCount);
+
+        if (workerCount <= 1)
+        {
+            checkSignatures();
+        }
+        else
+        {
+            std::vector<std::future<void>> workers;
+
+            for (size_t i = 0; i < workerCount; i++)
+            {
+                workers.push_back(validationThreadPool.addJob(checkSignatures));
+            }
+
+            for (auto &worker : workers)
+            {
+                worker.get();
+            }
+        }
+
+        return invalid;
+    }
+
     std::error_code Core::validateSemantic(const Transaction &transaction, uint64_t &fee, uint32_t blockIndex)
     {
         if (transaction.inputs.empty())
@@ -2405,6 +2819,8 @@ namespace cryptonote
     {
         throwIfNotInitialized();
 
+        StateWriteLock stateLock(*this);
+
         deleteAlternativeChains();
         mergeMainChainSegments();
         chainsLeaves[0]->save();
@@ -2903,91 +3319,50 @@ namespace cryptonote
         size_t &transactionsSize,
         uint64_t &fee) const
     {
-
-        transactionsSize = 0;
-        fee = 0;
-
         size_t maxTotalSize = (125 * medianSize) / 100;
         maxTotalSize = std::min(maxTotalSize, maxCumulativeSize) - currency.minerTxBlobReservedSize();
 
-        TransactionSpentInputsChecker spentInputsChecker;
-
-        std::vector<CachedTransaction> poolTransactions = transactionPool->getPoolTransactions();
-        for (auto it = poolTransactions.rbegin(); it != poolTransactions.rend() && it->getTransactionFee() == 0; ++it)
-        {
-            const CachedTransaction &transaction = *it;
-
-            auto transactionBlobSize = transaction.getTransactionBinaryArray().size();
-            if (currency.fusionTxMaxSize() < transactionsSize + transactionBlobSize)
-            {
-                continue;
-            }
+        const auto isInPool = [this](const crypto::Hash &transactionHash) {
+            return transactionPool->checkIfTransactionPresent(transactionHash);
+        };
 
-            if (!validateBlockTemplateTransaction(transaction, height))
+        const auto isValid = [this](const crypto::Hash &transactionHash, const uint64_t blockHeight) {
+            if (validateBlockTemplateTransaction(transactionPool->getTransaction(transactionHash), blockHeight))
             {
-
-                std::time_t currentTime = std::time(0);
-                uint64_t transactionAge = currentTime - transactionPool->getTransactionReceiveTime(transaction.getTransactionHash());
-
-                logger(logging::DEBUGGING) << "Transaction age is "
-                                           << transactionAge;
-
-                if (transactionAge >= cryptonote::parameters::CRYPTONOTE_MEMPOOL_TX_LIVETIME)
-                {
-                    logger(logging::INFO) << "Removing.. ";
-                    transactionPool->removeTransaction(transaction.getTransactionHash());
-                }
-
-                continue;
+                return true;
             }
 
-            if (!spentInputsChecker.haveSpentInputs(transaction.getTransaction()))
-            {
-                block.transactionHashes.emplace_back(transaction.getTransactionHash());
-                transactionsSize += transactionBlobSize;
-                logger(logging::TRACE) << "Fusion transaction " << transaction.getTransactionHash() << " included to block template";
-            }
-        }
+            std::time_t currentTime = std::time(0);
+            uint64_t transactionAge = currentTime - transactionPool->getTransactionReceiveTime(transactionHash);
 
-        for (const auto &cachedTransaction : poolTransactions)
-        {
-            size_t blockSizeLimit = (cachedTransaction.getTransactionFee() == 0) ? medianSize : maxTotalSize;
+            logger(logging::DEBUGGING) << "Transaction age is "
+                                       << transactionAge;
 
-            if (blockSizeLimit < transactionsSize + cachedTransaction.getTransactionBinaryArray().size())
+            /* Can't drop it from the candidates while they're being walked,
+               it's found and dropped next time round */
+            if (transactionAge >= cryptonote::parameters::CRYPTONOTE_MEMPOOL_TX_LIVETIME)
             {
-                continue;
+                logger(logging::INFO) << "Removing.. ";
+                transactionPool->removeTransaction(transactionHash);
             }
 
-            if (!validateBlockTemplateTransaction(cachedTransaction, height))
-            {
-                std::time_t currentTime = std::time(0);
-                uint64_t transactionAge = currentTime - transactionPool->getTransactionReceiveTime(cachedTransaction.getTransactionHash());
-
-                logger(logging::DEBUGGING) << "Transaction age is "
-                                           << transactionAge;
-
-                if (transactionAge >= cryptonote::parameters::CRYPTONOTE_MEMPOOL_TX_LIVETIME)
-                {
-                    logger(logging::INFO) << "Removing.. ";
-
-                    transactionPool->removeTransaction(cachedTransaction.getTransactionHash());
-                }
+            return false;
+        };
 
-                continue;
-            }
+        blockTemplateCandidates.fill(
+            height,
+            block.previousBlockHash,
+            medianSize,
+            maxTotalSize,
+            currency.fusionTxMaxSize(),
+            transactionPool->getTransactionCount(),
+            isInPool,
+            isValid,
+            block.transactionHashes,
+            transactionsSize,
+            fee);
 
-            if (!spentInputsChecker.haveSpentInputs(cachedTransaction.getTransaction()))
-            {
-                transactionsSize += cachedTransaction.getTransactionBinaryArray().size();
-                fee += cachedTransaction.getTransactionFee();
-                block.transactionHashes.emplace_back(cachedTransaction.getTransactionHash());
-                logger(logging::TRACE) << "Transaction " << cachedTransaction.getTransactionHash() << " included to block template";
-            }
-            else
-            {
-                logger(logging::TRACE) << "Transaction " << cachedTransaction.getTransactionHash() << " is failed to include to block template";
-            }
-        }
+        logger(logging::TRACE) << block.transactionHashes.size() << " transactions included to block template";
     }
 
     void Core::deleteAlternativeChains()
@@ -3468,7 +3843,18 @@ namespace cryptonote
 
                 logger(logging::DEBUGGING) << "Running pool transaction cleaning sequence... ";
 
-                auto deletedTransactions = transactionPool->clean(getTopBlockIndex());
+                std::vector<crypto::Hash> deletedTransactions;
+
+                {
+                    StateWriteLock stateLock(*this);
+
+                    deletedTransactions = transactionPool->clean(getTopBlockIndex());
+
+                    for (const auto &hash : deletedTransactions)
+                    {
+                        blockTemplateCandidates.remove(hash);
+                    }
+                }
 
                 logger(logging::DEBUGGING) << "Pool transaction cleaning sequence, done... ";
 
@@ -3502,6 +3888,55 @@ namespace cryptonote
         return mainChainStorage->getBlockCount();
     }
 
+    uint64_t Core::getRingMemberCacheHits() const
+    {
+        return ringMemberCache.getHits();
+    }
+
+    uint64_t Core::getRingMemberCacheMisses() const
+    {
+        return ringMemberCache.getMisses();
+    }
+
+    double Core::getPoolTransactionsAdmittedPerSecond() const
+    {
+        return poolTransactionsAdmitted.perSecond();
+    }
+
+    double Core::getPoolTransactionsRejectedPerSecond() const
+    {
+        return poolTransactionsRejected.perSecond();
+    }
+
+    std::shared_lock<WriterPreferringSharedMutex> Core::lockForReading() const
+    {
+        return std::shared_lock<WriterPreferringSharedMutex>(stateMutex);
+    }
+
+    Core::StateWriteLock::StateWriteLock(const Core &core) : core(core)
+    {
+        /* Only counted once we hold it, so another context which runs while
+           we wait for it doesn't think it holds it too */
+        if (core.stateWriteDepth == 0 && !core.stateMutex.try_lock())
+        {
+            /* An RPC worker is reading. Wait for it on another thread, rather
+               than stalling P2P and everything else on the dispatcher. */
+            syst::RemoteContext<void>(core.dispatcher, [&core]()
+                                      { core.stateMutex.lock(); })
+                .get();
+        }
+
+        core.stateWriteDepth++;
+    }
+
+    Core::StateWriteLock::~StateWriteLock()
+    {
+        if (--core.stateWriteDepth == 0)
+        {
+            core.stateMutex.unlock();
+        }
+    }
+
     std::time_t Core::getStartTime() const
     {
         return start_time;
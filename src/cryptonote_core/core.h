@@ -6,9 +6,11 @@
 
 #pragma once
 #include <ctime>
+#include <shared_mutex>
 #include <vector>
 #include <unordered_map>
 #include "blockchain_cache.h"
+#include "block_template_candidates.h"
 #include "blockchain_messages.h"
 #include "cached_block.h"
 #include "cached_transaction.h"
@@ -25,6 +27,15 @@
 #include <logging/logger_message.h>
 #include "message_queue.h"
 #include "transaction_validatior_state.h"
+#include "wallet_sync_data_cache.h"
+
+#include <common/rate_counter.h>
+
+#include <common/thread_pool.h>
+
+#include <common/writer_preferring_shared_mutex.h>
+
+#include <crypto/ring_member_cache.h>
 
 #include <syst/context_group.h>
 
@@ -37,7 +48,8 @@ namespace cryptonote
     {
     public:
         Core(const Currency &currency, std::shared_ptr<logging::ILogger> logger, Checkpoints &&checkpoints, syst::Dispatcher &dispatcher,
-             std::unique_ptr<IBlockchainCacheFactory> &&blockchainCacheFactory, std::unique_ptr<IMainChainStorage> &&mainChainStorage);
+             std::unique_ptr<IBlockchainCacheFactory> &&blockchainCacheFactory, std::unique_ptr<IMainChainStorage> &&mainChainStorage,
+             const uint32_t transactionValidationThreads = std::thread::hardware_concurrency());
         virtual ~Core();
 
         virtual bool addMessageQueue(MessageQueue<BlockchainMessage> &messageQueue) override;
@@ -86,8 +98,13 @@ namespace cryptonote
         virtual uint64_t getDifficultyForNextBlock() const override;
 
         virtual std::error_code addBlock(const CachedBlock &cachedBlock, RawBlock &&rawBlock) override;
+        virtual std::error_code addBlock(const CachedBlock &cachedBlock, RawBlock &&rawBlock, std::vector<CachedTransaction> &&transactions) override;
         virtual std::error_code addBlock(RawBlock &&rawBlock) override;
 
+        virtual bool isInCheckpointZone(uint32_t blockIndex) const override;
+
+        virtual ThreadPool &getThreadPool() override;
+
         virtual std::error_code submitBlock(BinaryArray &&rawBlockTemplate) override;
 
         virtual bool getTransactionGlobalIndexes(const crypto::Hash &transactionHash, std::vector<uint32_t> &globalIndexes) const override;
@@ -99,6 +116,7 @@ namespace cryptonote
             std::unordered_map<crypto::Hash, std::vector<uint64_t>> &indexes) const override;
 
         virtual bool addTransactionToPool(const BinaryArray &transactionBinaryArray) override;
+        virtual std::vector<bool> addTransactionsToPool(const std::vector<BinaryArray> &transactionBinaryArrays) override;
 
         virtual std::vector<crypto::Hash> getPoolTransactionHashes() const override;
         virtual std::tuple<bool, BinaryArray> getPoolTransaction(const crypto::Hash &transactionHash) const override;
@@ -133,7 +151,55 @@ namespace cryptonote
 
         virtual uint64_t get_current_blockchain_height() const;
 
+        uint64_t getRingMemberCacheHits() const;
+
+        uint64_t getRingMemberCacheMisses() const;
+
+        /* Relayed and submitted transactions added to / turned away from the
+           pool, per second */
+        double getPoolTransactionsAdmittedPerSecond() const;
+
+        double getPoolTransactionsRejectedPerSecond() const;
+
+        /* For reading from a thread other than the dispatcher's - held, the
+           chain and the pool won't change, so everything read is from the
+           same top block. The dispatcher thread is the only one which
+           changes them, so it reads without this. Keep it short - a block
+           waiting to be added holds up new readers until it's in. */
+        std::shared_lock<WriterPreferringSharedMutex> lockForReading() const;
+
     private:
+        /* Held around everything which changes the chain or the pool. Can be
+           taken again by the same code path, as those call each other.
+
+           If readers hold the state, it's waited for on another thread, with
+           the dispatcher serving everything else in the meantime - so check
+           anything read before taking it again after. */
+        class StateWriteLock
+        {
+        public:
+            explicit StateWriteLock(const Core &core);
+            ~StateWriteLock();
+
+            StateWriteLock(const StateWriteLock &) = delete;
+            StateWriteLock &operator=(const StateWriteLock &) = delete;
+
+        private:
+            const Core &core;
+        };
+
+        /* A ring signature with its output keys already resolved from the
+           chain, so it can be checked without touching any chain state */
+        struct RingSignatureCheck
+        {
+            const CachedTransaction *transaction;
+            /* Copied out, as CachedTransaction computes it lazily and is not
+               safe to share between threads until it has been */
+            crypto::Hash prefixHash;
+            size_t inputIndex;
+            std::vector<crypto::PublicKey> outputKeys;
+        };
+
         const Currency &currency;
         syst::Dispatcher &dispatcher;
         syst::ContextGroup contextGroup;
@@ -156,11 +222,37 @@ namespace cryptonote
 
         size_t blockMedianSize;
 
+        /* Used to check the ring signatures of a block / transaction in parallel */
+        ThreadPool validationThreadPool;
+
+        /* Decompressed ring member keys, shared by block and pool validation */
+        crypto::RingMemberCache ringMemberCache;
+
+        /* Wallet sync data of the most recent main chain blocks */
+        WalletSyncDataCache walletSyncDataCache;
+
+        /* The pool transactions in the order they go into block templates,
+           with their validity for the next block remembered */
+        mutable BlockTemplateCandidates blockTemplateCandidates;
+
+        RateCounter poolTransactionsAdmitted;
+
+        RateCounter poolTransactionsRejected;
+
+        /* Shared by lockForReading(), exclusive by StateWriteLock */
+        mutable WriterPreferringSharedMutex stateMutex;
+
+        /* How many StateWriteLocks the dispatcher thread holds */
+        mutable size_t stateWriteDepth = 0;
+
         void throwIfNotInitialized() const;
         bool extractTransactions(const std::vector<BinaryArray> &rawTransactions, std::vector<CachedTransaction> &transactions, uint64_t &cumulativeSize);
 
         std::error_code validateSemantic(const Transaction &transaction, uint64_t &fee, uint32_t blockIndex);
-        std::error_code validateTransaction(const CachedTransaction &transaction, TransactionValidatorState &state, IBlockchainCache *cache, uint64_t &fee, uint32_t blockIndex);
+        std::error_code validateTransaction(const CachedTransaction &transaction, TransactionValidatorState &state, IBlockchainCache *cache,
+                                            uint64_t &fee, uint32_t blockIndex, std::vector<RingSignatureCheck> &ringSignatures);
+        std::error_code checkRingSignatures(const std::vector<RingSignatureCheck> &ringSignatures);
+        std::vector<uint8_t> findInvalidRingSignatures(const std::vector<RingSignatureCheck> &ringSignatures, const bool stopAtFirst);
 
         uint32_t findBlockchainSupplement(const std::vector<crypto::Hash> &remoteBlockIds) const;
         bool checkBlockchainSupplement(const std::vector<crypto::Hash> &remoteBlockIds) const;
@@ -227,7 +319,13 @@ namespace cryptonote
         void huginCleaningProcedure();
         void updateBlockMedianSize();
         bool addTransactionToPool(CachedTransaction &&cachedTransaction);
-        bool isTransactionValidForPool(const CachedTransaction &cachedTransaction, TransactionValidatorState &validatorState);
+        bool pushTransactionToPool(CachedTransaction &&cachedTransaction, TransactionValidatorState &&validatorState);
+
+        /* Everything but the ring signatures, which are returned for checking */
+        bool isTransactionValidForPool(
+            const CachedTransaction &cachedTransaction,
+            TransactionValidatorState &validatorState,
+            std::vector<RingSignatureCheck> &ringSignatures);
 
         void initRootSegment();
         void importBlocksFromStorage();
@@ -241,6 +339,18 @@ namespace cryptonote
         static wallet_types::RawTransaction getRawTransaction(
             const std::vector<uint8_t> &rawTX);
 
+        static wallet_types::RawTransaction getRawTransaction(
+            const Transaction &t,
+            const crypto::Hash &hash);
+
+        void addWalletSyncData(const CachedBlock &cachedBlock, const std::vector<CachedTransaction> &transactions);
+
+        void getWalletSyncDataFromStorage(
+            IBlockchainCache *mainChain,
+            uint64_t startIndex,
+            const uint64_t endIndex,
+            std::vector<wallet_types::WalletBlockInfo> &walletBlocks) const;
+
         static crypto::PublicKey getPubKeyFromExtra(const std::vector<uint8_t> &extra);
 
         static std::string getPaymentIDFromExtra(const std::vector<uint8_t> &extra);
@@ -8,11 +8,11 @@
 
 #include <ctime>
 #include <cstdlib>
+#include <cstring>
+#include <numeric>
 
 #include <boost/iterator/iterator_facade.hpp>
 
-#include <common/shuffle_generator.h>
-
 #include "blockchain_utils.h"
 
 #include "crypto/hash.h"
@@ -20,6 +20,7 @@
 #include <cryptonote_core/blockchain_storage.h>
 #include <cryptonote_core/cryptonote_tools.h>
 #include <cryptonote_core/cryptonote_basic_impl.h>
+#include <cryptonote_core/database_errors.h>
 #include "cryptonote_core/transaction_extra.h"
 
 namespace cryptonote
@@ -64,44 +65,6 @@ namespace cryptonote
             return true;
         }
 
-        bool requestTransactionHashesForGlobalOutputIndexes(const std::vector<PackedOutIndex> &packedOuts, IDataBase &database, std::vector<crypto::Hash> &transactionHashes)
-        {
-            BlockchainReadBatch readHashesBatch;
-
-            std::set<uint32_t> blockIndexes;
-            std::for_each(packedOuts.begin(), packedOuts.end(), [&blockIndexes](PackedOutIndex out)
-                          { blockIndexes.insert(out.blockIndex); });
-            std::for_each(blockIndexes.begin(), blockIndexes.end(), [&readHashesBatch](uint32_t blockIndex)
-                          { readHashesBatch.requestTransactionHashesByBlock(blockIndex); });
-
-            auto dbResult = database.read(readHashesBatch);
-            if (dbResult)
-            {
-                return false;
-            }
-
-            auto readResult = readHashesBatch.extractResult();
-            const auto &transactionHashesMap = readResult.getTransactionHashesByBlocks();
-
-            if (transactionHashesMap.size() != blockIndexes.size())
-            {
-                return false;
-            }
-
-            transactionHashes.reserve(transactionHashes.size() + packedOuts.size());
-            for (const auto &output : packedOuts)
-            {
-                if (output.transactionIndex >= transactionHashesMap.at(output.blockIndex).size())
-                {
-                    return false;
-                }
-
-                transactionHashes.push_back(transactionHashesMap.at(output.blockIndex)[output.transactionIndex]);
-            }
-
-            return true;
-        }
-
         bool requestCachedTransactionInfos(const std::vector<crypto::Hash> &transactionHashes, IDataBase &database, std::vector<CachedTransactionInfo> &result)
         {
             result.reserve(result.size() + transactionHashes.size());
@@ -172,18 +135,6 @@ namespace cryptonote
             return true;
         }
 
-        // returns ExtendedTransactionInfos in the same order as packedOuts are
-        bool requestExtendedTransactionInfos(const std::vector<PackedOutIndex> &packedOuts, IDataBase &database, std::vector<ExtendedTransactionInfo> &result)
-        {
-            std::vector<crypto::Hash> transactionHashes;
-            if (!requestTransactionHashesForGlobalOutputIndexes(packedOuts, database, transactionHashes))
-            {
-                return false;
-            }
-
-            return requestExtendedTransactionInfos(transactionHashes, database, result);
-        }
-
         uint64_t roundToMidnight(uint64_t timestamp)
         {
             if (timestamp > static_cast<uint64_t>(std::numeric_limits<time_t>::max()))
@@ -499,7 +450,69 @@ namespace cryptonote
             uint32_t schemeVersion;
         };
 
-        const uint32_t CURRENT_DB_SCHEME_VERSION = 2;
+        const uint32_t CURRENT_DB_SCHEME_VERSION = 3;
+
+        const std::string SPENT_KEY_IMAGE_FILTER_KEY = "spent_key_image_filter";
+
+        /* Number of blocks to read spent key images for at once when filling
+           in the spent key image filter */
+        const uint32_t SPENT_KEY_IMAGE_FILTER_READ_BATCH_SIZE = 1000;
+
+        /* The stored filter is prefixed by the index and hash of the top block
+           it was saved at, so we can tell if it is still valid */
+        const size_t SPENT_KEY_IMAGE_FILTER_HEADER_SIZE = sizeof(uint32_t) + sizeof(crypto::Hash);
+
+        class SpentKeyImageFilterReadBatch : public IReadBatch
+        {
+        public:
+            virtual ~SpentKeyImageFilterReadBatch() {}
+
+            virtual std::vector<std::string> getRawKeys() const override
+            {
+                return {SPENT_KEY_IMAGE_FILTER_KEY};
+            }
+
+            virtual void submitRawResult(const std::vector<std::string> &values, const std::vector<bool> &resultStates) override
+            {
+                assert(values.size() == 1);
+                assert(resultStates.size() == values.size());
+
+                if (!resultStates[0])
+                {
+                    return;
+                }
+
+                filter = values[0];
+            }
+
+            boost::optional<std::string> getFilter()
+            {
+                return filter;
+            }
+
+        private:
+            boost::optional<std::string> filter;
+        };
+
+        class SpentKeyImageFilterWriteBatch : public IWriteBatch
+        {
+        public:
+            SpentKeyImageFilterWriteBatch(std::string filter) : filter(std::move(filter)) {}
+            virtual ~SpentKeyImageFilterWriteBatch() {}
+
+            virtual std::vector<std::pair<std::string, std::string>> extractRawDataToInsert() override
+            {
+                return {make_pair(SPENT_KEY_IMAGE_FILTER_KEY, std::move(filter))};
+            }
+
+            virtual std::vector<std::string> extractRawKeysToRemove() override
+            {
+                return {};
+            }
+
+        private:
+            std::string filter;
+        };
 
     }
 
@@ -510,7 +523,8 @@ namespace cryptonote
     };
 
     DatabaseBlockchainCache::DatabaseBlockchainCache(const Currency &curr, IDataBase &dataBase, IBlockchainCacheFactory &blockchainCacheFactory, std::shared_ptr<logging::ILogger> _logger)
-        : currency(curr), database(dataBase), blockchainCacheFactory(blockchainCacheFactory), logger(_logger, "DatabaseBlockchainCache")
+        : currency(curr), database(dataBase), blockchainCacheFactory(blockchainCacheFactory), logger(_logger, "DatabaseBlockchainCache"),
+          spentKeyImageFilter(SPENT_KEY_IMAGE_FILTER_SIZE)
     {
         DatabaseVersionReadBatch readBatch;
         auto ec = database.read(readBatch);
@@ -693,6 +707,17 @@ namespace cryptonote
         topBlockHash = boost::none;
         transactionsCount = boost::none;
 
+        /* And read them again straight away - RPC worker threads read these
+           while holding the core's shared lock, so they mustn't be the ones
+           to fill them in */
+        getTopBlockIndex();
+        getTopBlockHash();
+        getCachedTransactionsCount();
+
+        /* The key images spent in the removed blocks are left in the spent key
+           image filter. It only needs to hold at least every spent key image,
+           and rollbacks are rare enough the extra false positives don't matter. */
+
         logger(logging::DEBUGGING) << "split completed";
         // return new cache
         return cache;
@@ -838,6 +863,8 @@ namespace cryptonote
             writeBatch.removeKeyOutputInfo(amount, index);
         }
 
+        keyOutputIndex.truncate(amount, boundary);
+
         updateKeyOutputCount(amount, boundary - outputsCount);
     }
 
@@ -870,7 +897,8 @@ namespace cryptonote
     void DatabaseBlockchainCache::pushTransaction(const CachedTransaction &cachedTransaction,
                                                   uint32_t blockIndex,
                                                   uint16_t transactionBlockIndex,
-                                                  BlockchainWriteBatch &batch)
+                                                  BlockchainWriteBatch &batch,
+                                                  BlockGlobalIndexes &blockGlobalIndexes)
     {
 
         logger(logging::DEBUGGING) << "push transaction with hash " << cachedTransaction.getTransactionHash();
@@ -922,6 +950,8 @@ namespace cryptonote
                 outputInfo.outputIndex = poi.outputIndex;
 
                 batch.insertKeyOutputInfo(output.amount, globalIndex, outputInfo);
+
+                keyOutputIndex.push(output.amount, globalIndex, blockIndex, outputInfo.unlockTime);
             }
         }
 
@@ -943,6 +973,11 @@ namespace cryptonote
             insertPaymentId(batch, cachedTransaction.getTransactionHash(), paymentId);
         }
 
+        blockGlobalIndexes.outputCounts.push_back(static_cast<uint16_t>(transactionCacheInfo.globalIndexes.size()));
+        blockGlobalIndexes.globalIndexes.insert(blockGlobalIndexes.globalIndexes.end(),
+                                                transactionCacheInfo.globalIndexes.begin(),
+                                                transactionCacheInfo.globalIndexes.end());
+
         batch.insertCachedTransaction(transactionCacheInfo, getCachedTransactionsCount() + 1);
         transactionsCount = *transactionsCount + 1;
         logger(logging::DEBUGGING) << "push transaction with hash " << cachedTransaction.getTransactionHash() << " finished";
@@ -1053,14 +1088,19 @@ namespace cryptonote
         batch.insertCachedBlock(blockInfo, getTopBlockIndex() + 1, txHashes);
         batch.insertRawBlock(getTopBlockIndex() + 1, std::move(rawBlock));
 
+        BlockGlobalIndexes blockGlobalIndexes;
+        blockGlobalIndexes.outputCounts.reserve(txHashes.size());
+
         auto transactionIndex = 0;
-        pushTransaction(cachedBaseTransaction, getTopBlockIndex() + 1, transactionIndex++, batch);
+        pushTransaction(cachedBaseTransaction, getTopBlockIndex() + 1, transactionIndex++, batch, blockGlobalIndexes);
 
         for (const auto &transaction : cachedTransactions)
         {
-            pushTransaction(transaction, getTopBlockIndex() + 1, transactionIndex++, batch);
+            pushTransaction(transaction, getTopBlockIndex() + 1, transactionIndex++, batch, blockGlobalIndexes);
         }
 
+        batch.insertBlockGlobalIndexes(getTopBlockIndex() + 1, blockGlobalIndexes);
+
         auto closestBlockIndexDb = requestClosestBlockIndexByTimestamp(roundToMidnight(cachedBlock.getBlock().timestamp), database);
         if (!closestBlockIndexDb.second)
         {
@@ -1084,6 +1124,12 @@ namespace cryptonote
 
         topBlockIndex = *topBlockIndex + 1;
         topBlockHash = cachedBlock.getBlockHash();
+
+        for (const auto &keyImage : validatorState.spentKeyImages)
+        {
+            spentKeyImageFilter.add(keyImage);
+        }
+
         logger(logging::DEBUGGING) << "push block " << cachedBlock.getBlockHash() << " completed";
 
         unitsCache.push_back(blockInfo);
@@ -1100,6 +1146,12 @@ namespace cryptonote
 
     bool DatabaseBlockchainCache::checkIfSpent(const crypto::KeyImage &keyImage, uint32_t blockIndex) const
     {
+        /* Not in the filter, definitely not spent */
+        if (spentKeyImageFilterLoaded && !spentKeyImageFilter.mightContain(keyImage))
+        {
+            return false;
+        }
+
         auto batch = BlockchainReadBatch().requestBlockIndexBySpentKeyImage(keyImage);
         auto res = database.read(batch);
         if (res)
@@ -1665,10 +1717,117 @@ namespace cryptonote
 
     void DatabaseBlockchainCache::save()
     {
+        saveSpentKeyImageFilter();
     }
 
     void DatabaseBlockchainCache::load()
     {
+        loadSpentKeyImageFilter();
+    }
+
+    void DatabaseBlockchainCache::loadSpentKeyImageFilter()
+    {
+        SpentKeyImageFilterReadBatch readBatch;
+        auto ec = database.read(readBatch);
+        if (ec)
+        {
+            throw std::system_error(ec);
+        }
+
+        const uint32_t topIndex = getTopBlockIndex();
+
+        /* First block not yet in the filter */
+        uint32_t startIndex = 0;
+
+        auto stored = readBatch.getFilter();
+
+        if (stored && stored->size() > SPENT_KEY_IMAGE_FILTER_HEADER_SIZE)
+        {
+            uint32_t filterTopIndex;
+            crypto::Hash filterTopHash;
+
+            std::memcpy(&filterTopIndex, stored->data(), sizeof(filterTopIndex));
+            std::memcpy(&filterTopHash, stored->data() + sizeof(filterTopIndex), sizeof(filterTopHash));
+
+            /* The filter is still good as long as the block it was saved at is
+               still in the chain, we only need to add the blocks since */
+            if (filterTopIndex <= topIndex &&
+                getBlockHash(filterTopIndex) == filterTopHash &&
+                spentKeyImageFilter.fromString(stored->substr(SPENT_KEY_IMAGE_FILTER_HEADER_SIZE)))
+            {
+                startIndex = filterTopIndex + 1;
+            }
+        }
+
+        if (startIndex == 0)
+        {
+            logger(logging::INFO) << "Building spent key image filter, this may take a while...";
+            spentKeyImageFilter.clear();
+        }
+        else
+        {
+            logger(logging::DEBUGGING) << "Loaded spent key image filter at block index " << startIndex - 1;
+        }
+
+        addBlocksToSpentKeyImageFilter(startIndex, topIndex);
+
+        spentKeyImageFilterLoaded = true;
+    }
+
+    void DatabaseBlockchainCache::saveSpentKeyImageFilter()
+    {
+        if (!spentKeyImageFilterLoaded)
+        {
+            return;
+        }
+
+        const uint32_t topIndex = getTopBlockIndex();
+        const crypto::Hash topHash = getTopBlockHash();
+
+        std::string data(SPENT_KEY_IMAGE_FILTER_HEADER_SIZE, '\0');
+
+        std::memcpy(&data[0], &topIndex, sizeof(topIndex));
+        std::memcpy(&data[sizeof(topIndex)], &topHash, sizeof(topHash));
+
+        data += spentKeyImageFilter.toString();
+
+        SpentKeyImageFilterWriteBatch writeBatch(std::move(data));
+        auto ec = database.write(writeBatch);
+        if (ec)
+        {
+            logger(logging::ERROR) << "Failed to save spent key image filter: " << ec.message();
+        }
+    }
+
+    void DatabaseBlockchainCache::addBlocksToSpentKeyImageFilter(uint32_t startIndex, uint32_t endIndex)
+    {
+        for (uint32_t batchStart = startIndex; batchStart <= endIndex; batchStart += SPENT_KEY_IMAGE_FILTER_READ_BATCH_SIZE)
+        {
+            const uint32_t batchEnd = std::min(endIndex, batchStart + SPENT_KEY_IMAGE_FILTER_READ_BATCH_SIZE - 1);
+
+            BlockchainReadBatch batch;
+
+            for (uint32_t blockIndex = batchStart; blockIndex <= batchEnd; blockIndex++)
+            {
+                batch.requestSpentKeyImagesByBlock(blockIndex);
+            }
+
+            auto result = readDatabase(batch);
+
+            for (const auto &block : result.getSpentKeyImagesByBlock())
+            {
+                for (const auto &keyImage : block.second)
+                {
+                    spentKeyImageFilter.add(keyImage);
+                }
+            }
+
+            /* Don't overflow on the last batch */
+            if (batchEnd == endIndex)
+            {
+                break;
+            }
+        }
     }
 
     std::vector<BinaryArray>
@@ -1759,69 +1918,83 @@ namespace cryptonote
         return {};
     }
 
-    std::vector<uint32_t> DatabaseBlockchainCache::getRandomOutsByAmount(uint64_t amount, size_t count,
-                                                                         uint32_t blockIndex) const
+    void DatabaseBlockchainCache::loadKeyOutputIndex(Amount amount) const
     {
-        auto batch = BlockchainReadBatch().requestKeyOutputGlobalIndexesCountForAmount(amount);
-        auto result = readDatabase(batch);
-        auto outputsCount = result.getKeyOutputGlobalIndexesCountForAmounts();
-        auto outputsToPick = std::min(static_cast<uint32_t>(count), outputsCount[amount]);
+        auto countBatch = BlockchainReadBatch().requestKeyOutputGlobalIndexesCountForAmount(amount);
+        auto counts = readDatabase(countBatch).getKeyOutputGlobalIndexesCountForAmounts();
+        const uint32_t outputsCount = counts[amount];
 
-        std::vector<uint32_t> resultOuts;
-        resultOuts.reserve(outputsToPick);
+        logger(logging::DEBUGGING) << "Loading " << outputsCount << " key outputs for amount " << amount;
+
+        std::vector<uint32_t> blockIndexes;
+        std::vector<uint64_t> unlockTimes;
 
-        ShuffleGenerator<uint32_t> generator(outputsCount[amount]);
+        blockIndexes.reserve(outputsCount);
+        unlockTimes.reserve(outputsCount);
 
-        while (outputsToPick)
+        /* Read in chunks, so a popular amount doesn't need one huge batch */
+        const uint32_t chunkSize = 10000;
+
+        std::vector<uint32_t> globalIndexes;
+        std::vector<PackedOutIndex> packedOutputs;
+
+        for (uint32_t start = 0; start < outputsCount; start += chunkSize)
         {
-            std::vector<uint32_t> globalIndexes;
-            globalIndexes.reserve(outputsToPick);
+            const uint32_t end = std::min(outputsCount, start + chunkSize);
 
-            try
-            {
-                for (uint32_t i = 0; i < outputsToPick; ++i, globalIndexes.push_back(generator()))
-                {
-                }
-                // std::generate_n(std::back_inserter(globalIndexes), outputsToPick, generator);
-            }
-            catch (const SequenceEnded &)
+            globalIndexes.clear();
+            packedOutputs.clear();
+
+            BlockchainReadBatch infoBatch;
+
+            for (uint32_t globalIndex = start; globalIndex < end; ++globalIndex)
             {
-                logger(logging::TRACE) << "getRandomOutsByAmount: generator reached sequence end";
-                return resultOuts;
+                globalIndexes.push_back(globalIndex);
+                infoBatch.requestKeyOutputInfo(amount, globalIndex);
             }
 
-            std::vector<PackedOutIndex> outputs;
-            if (extractKeyOtputIndexes(amount, common::ArrayView<uint32_t>(globalIndexes.data(), globalIndexes.size()), outputs) != ExtractOutputKeysResult::SUCCESS)
+            if (!requestPackedOutputs(amount, common::ArrayView<uint32_t>(globalIndexes.data(), globalIndexes.size()), database, packedOutputs))
             {
-                logger(logging::DEBUGGING) << "getRandomOutsByAmount: failed to extract key output indexes";
+                logger(logging::ERROR) << "loadKeyOutputIndex: failed to read key output indexes";
                 throw std::runtime_error("Invalid output index"); // TODO: make error code
             }
 
-            std::vector<ExtendedTransactionInfo> transactions;
-            if (!requestExtendedTransactionInfos(outputs, database, transactions))
+            auto infos = readDatabase(infoBatch).getKeyOutputInfo();
+
+            for (uint32_t globalIndex = start; globalIndex < end; ++globalIndex)
             {
-                logger(logging::TRACE) << "getRandomOutsByAmount: requestExtendedTransactionInfos failed";
-                throw std::runtime_error("Error while requesting transactions"); // TODO: make error code
+                blockIndexes.push_back(packedOutputs[globalIndex - start].blockIndex);
+                unlockTimes.push_back(infos.at(std::make_pair(amount, globalIndex)).unlockTime);
             }
+        }
 
-            assert(globalIndexes.size() == transactions.size());
+        keyOutputIndex.load(amount, std::move(blockIndexes), std::move(unlockTimes));
+    }
 
-            uint32_t uppperBlockIndex = 0;
-            if (blockIndex > currency.minedMoneyUnlockWindow())
-            {
-                uppperBlockIndex = blockIndex - currency.minedMoneyUnlockWindow();
-            }
+    std::vector<uint32_t> DatabaseBlockchainCache::getRandomOutsByAmount(uint64_t amount, size_t count,
+                                                                         uint32_t blockIndex) const
+    {
+        if (!keyOutputIndex.isLoaded(amount))
+        {
+            loadKeyOutputIndex(amount);
+        }
 
-            for (size_t i = 0; i < transactions.size(); ++i)
-            {
-                if (!isTransactionSpendTimeUnlocked(transactions[i].unlockTime, blockIndex) || transactions[i].blockIndex > uppperBlockIndex)
-                {
-                    continue;
-                }
+        uint32_t uppperBlockIndex = 0;
+        if (blockIndex > currency.minedMoneyUnlockWindow())
+        {
+            uppperBlockIndex = blockIndex - currency.minedMoneyUnlockWindow();
+        }
 
-                resultOuts.push_back(globalIndexes[i]);
-                --outputsToPick;
-            }
+        std::vector<uint32_t> resultOuts;
+
+        const bool found = keyOutputIndex.getRandomOuts(amount, count, uppperBlockIndex, [this, blockIndex](uint64_t unlockTime)
+                                                        { return isTransactionSpendTimeUnlocked(unlockTime, blockIndex); },
+                                                        resultOuts);
+
+        if (!found)
+        {
+            logger(logging::DEBUGGING) << "getRandomOutsByAmount: key output index for amount " << amount << " not loaded";
+            throw std::system_error(make_error_code(error::DataBaseErrorCodes::INTERNAL_ERROR), "Key output index not loaded");
         }
 
         return resultOuts;
@@ -1952,6 +2125,65 @@ namespace cryptonote
         return indexes;
     }
 
+    std::unordered_map<crypto::Hash, std::vector<uint64_t>> DatabaseBlockchainCache::getGlobalIndexesForRange(
+        const uint64_t startHeight,
+        const uint64_t endHeight) const
+    {
+        const uint64_t end = std::min(endHeight, static_cast<uint64_t>(getTopBlockIndex()) + 1);
+
+        BlockchainReadBatch batch;
+
+        for (uint64_t height = startHeight; height < end; height++)
+        {
+            batch.requestTransactionHashesByBlock(static_cast<uint32_t>(height));
+            batch.requestGlobalIndexesByBlock(static_cast<uint32_t>(height));
+        }
+
+        auto result = readDatabase(batch);
+
+        const auto &transactionHashesByBlocks = result.getTransactionHashesByBlocks();
+        const auto &globalIndexesByBlocks = result.getGlobalIndexesByBlocks();
+
+        std::unordered_map<crypto::Hash, std::vector<uint64_t>> indexes;
+
+        /* Blocks stored before the per block global indexes were, which have
+           to be looked up transaction by transaction */
+        std::vector<crypto::Hash> remainingTransactions;
+
+        for (const auto &[blockIndex, transactionHashes] : transactionHashesByBlocks)
+        {
+            const auto blockIndexes = globalIndexesByBlocks.find(blockIndex);
+
+            if (blockIndexes == globalIndexesByBlocks.end() ||
+                blockIndexes->second.outputCounts.size() != transactionHashes.size() ||
+                std::accumulate(blockIndexes->second.outputCounts.begin(), blockIndexes->second.outputCounts.end(), size_t(0)) != blockIndexes->second.globalIndexes.size())
+            {
+                remainingTransactions.insert(remainingTransactions.end(), transactionHashes.begin(), transactionHashes.end());
+                continue;
+            }
+
+            auto globalIndex = blockIndexes->second.globalIndexes.begin();
+
+            for (size_t i = 0; i < transactionHashes.size(); i++)
+            {
+                const uint16_t outputCount = blockIndexes->second.outputCounts[i];
+
+                indexes[transactionHashes[i]].assign(globalIndex, globalIndex + outputCount);
+
+                globalIndex += outputCount;
+            }
+        }
+
+        if (!remainingTransactions.empty())
+        {
+            auto remainingIndexes = getGlobalIndexes(remainingTransactions);
+
+            indexes.insert(remainingIndexes.begin(), remainingIndexes.end());
+        }
+
+        return indexes;
+    }
+
     DatabaseBlockchainCache::ExtendedPushedBlockInfo DatabaseBlockchainCache::getExtendedPushedBlockInfo(uint32_t blockIndex) const
     {
         assert(blockIndex <= getTopBlockIndex());
@@ -2040,9 +2272,11 @@ namespace cryptonote
         auto baseTransaction = genesisBlock.getBlock().baseTransaction;
         auto cachedBaseTransaction = CachedTransaction{std::move(baseTransaction)};
 
-        pushTransaction(cachedBaseTransaction, 0, 0, batch);
+        BlockGlobalIndexes blockGlobalIndexes;
+        pushTransaction(cachedBaseTransaction, 0, 0, batch, blockGlobalIndexes);
 
         batch.insertCachedBlock(blockInfo, 0, {cachedBaseTransaction.getTransactionHash()});
+        batch.insertBlockGlobalIndexes(0, blockGlobalIndexes);
         batch.insertRawBlock(0, {toBinaryArray(genesisBlock.getBlock()), {}});
         batch.insertClosestTimestampBlockIndex(roundToMidnight(genesisBlock.getBlock().timestamp), 0);
 
@@ -16,6 +16,8 @@
 #include <cryptonote_core/blockchain_write_batch.h>
 #include <cryptonote_core/database_cache_data.h>
 #include <cryptonote_core/iblockchain_cache_factory.h>
+#include <cryptonote_core/key_output_index.h>
+#include <cryptonote_core/spent_key_image_filter.h>
 
 namespace cryptonote
 {
@@ -116,6 +118,10 @@ namespace cryptonote
         virtual std::unordered_map<crypto::Hash, std::vector<uint64_t>> getGlobalIndexes(
             const std::vector<crypto::Hash> transactionHashes) const override;
 
+        virtual std::unordered_map<crypto::Hash, std::vector<uint64_t>> getGlobalIndexesForRange(
+            const uint64_t startHeight,
+            const uint64_t endHeight) const override;
+
         virtual bool getTransactionGlobalIndexes(const crypto::Hash &transactionHash,
                                                  std::vector<uint32_t> &globalIndexes) const override;
         virtual size_t getTransactionCount() const override;
@@ -174,6 +180,16 @@ namespace cryptonote
         std::deque<CachedBlockInfo> unitsCache;
         const size_t unitsCacheSize = 1000;
 
+        /* Holds every key image spent in the DB, so checkIfSpent() can skip
+           the DB read for the vast majority of key images, which are unspent.
+           Not used for lookups until load() has filled it in. */
+        SpentKeyImageFilter spentKeyImageFilter;
+        bool spentKeyImageFilterLoaded = false;
+
+        /* Block index and unlock time of each key output, for picking random
+           outputs without reading every candidate from the DB */
+        mutable KeyOutputIndex keyOutputIndex;
+
         struct ExtendedPushedBlockInfo;
         ExtendedPushedBlockInfo getExtendedPushedBlockInfo(uint32_t blockIndex) const;
 
@@ -185,7 +201,8 @@ namespace cryptonote
         void pushTransaction(const CachedTransaction &cachedTransaction,
                              uint32_t blockIndex,
                              uint16_t transactionBlockIndex,
-                             BlockchainWriteBatch &batch);
+                             BlockchainWriteBatch &batch,
+                             BlockGlobalIndexes &blockGlobalIndexes);
 
         uint32_t insertKeyOutputToGlobalIndex(uint64_t amount, PackedOutIndex output); // TODO not implemented. Should it be removed?
         uint32_t updateKeyOutputCount(Amount amount, int32_t diff) const;
@@ -194,6 +211,12 @@ namespace cryptonote
 
         void addGenesisBlock(CachedBlock &&genesisBlock);
 
+        void loadSpentKeyImageFilter();
+        void saveSpentKeyImageFilter();
+        void addBlocksToSpentKeyImageFilter(uint32_t startIndex, uint32_t endIndex);
+
+        void loadKeyOutputIndex(Amount amount) const;
+
         enum class OutputSearchResult : uint8_t
         {
             FOUND,
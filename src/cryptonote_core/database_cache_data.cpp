@@ -19,6 +19,12 @@ namespace cryptonote
         s(amountToKeyIndexes, "key_indexes");
     }
 
+    void BlockGlobalIndexes::serialize(ISerializer &s)
+    {
+        s(outputCounts, "output_counts");
+        s(globalIndexes, "global_indexes");
+    }
+
     void KeyOutputInfo::serialize(ISerializer &s)
     {
         s(publicKey, "public_key");
@@ -23,6 +23,21 @@ namespace cryptonote
         void serialize(cryptonote::ISerializer &s);
     };
 
+    /* The global output indexes of every transaction in a block, in the order
+       the transaction hashes are stored for the block, base transaction first.
+       Lets the indexes for a range of blocks be read without reading each
+       transaction. */
+    struct BlockGlobalIndexes
+    {
+        /* Number of key outputs of each transaction */
+        std::vector<uint16_t> outputCounts;
+
+        /* The global indexes of every transaction, one after another */
+        std::vector<IBlockchainCache::GlobalOutputIndex> globalIndexes;
+
+        void serialize(ISerializer &s);
+    };
+
     // inherit here to avoid breaking IBlockchainCache interface
     struct ExtendedTransactionInfo : CachedTransactionInfo
     {
@@ -7,6 +7,10 @@
 
 #include "dbutils.h"
 
+#include <cstring>
+
+#include "serialization/kv_binary_common.h"
+
 namespace
 {
     const std::string RAW_BLOCK_NAME = "raw_block";
@@ -37,5 +41,43 @@ namespace cryptonote
             serializer(value.block, RAW_BLOCK_NAME);
             serializer(value.transactions, RAW_TXS_NAME);
         }
+
+        std::string_view getKeyPrefix(const std::string &rawKey)
+        {
+            /* serializeKey() produces a KV binary storage with a single root
+               element, named after the prefix. That is, the storage header,
+               the root element count, then the length prefixed element name. */
+            const size_t headerSize = sizeof(KVBinaryStorageBlockHeader);
+
+            if (rawKey.size() < headerSize + 2)
+            {
+                return std::string_view();
+            }
+
+            KVBinaryStorageBlockHeader header;
+            std::memcpy(&header, rawKey.data(), headerSize);
+
+            if (header.m_signature_a != PORTABLE_STORAGE_SIGNATUREA ||
+                header.m_signature_b != PORTABLE_STORAGE_SIGNATUREB ||
+                header.m_ver != PORTABLE_STORAGE_FORMAT_VER)
+            {
+                return std::string_view();
+            }
+
+            /* Root element count, a single byte varint holding 1 */
+            if (static_cast<uint8_t>(rawKey[headerSize]) != (1 << 2))
+            {
+                return std::string_view();
+            }
+
+            const size_t nameSize = static_cast<uint8_t>(rawKey[headerSize + 1]);
+
+            if (rawKey.size() < headerSize + 2 + nameSize)
+            {
+                return std::string_view();
+            }
+
+            return std::string_view(rawKey).substr(headerSize + 2, nameSize);
+        }
     }
 }
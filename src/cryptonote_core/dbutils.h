@@ -8,6 +8,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <sstream>
 
 #include "common/std_output_stream.h"
@@ -53,6 +54,8 @@ namespace cryptonote
 
         const std::string KEY_OUTPUT_KEY_PREFIX = "j";
 
+        const std::string BLOCK_INDEX_TO_GLOBAL_INDEXES_PREFIX = "k";
+
         template <class Value>
         std::string serialize(const Value &value, const std::string &name)
         {
@@ -91,6 +94,12 @@ namespace cryptonote
 
         void deserialize(const std::string &serialized, RawBlock &value, const std::string &name);
 
+        /* Returns the record prefix a key produced by serializeKey() was
+           created with, or an empty string if the key wasn't created by
+           serializeKey(), such as the db scheme version key. Points into
+           rawKey, rather than copying it. */
+        std::string_view getKeyPrefix(const std::string &rawKey);
+
         template <class Key, class Value>
         void serializeKeys(std::vector<std::string> &rawKeys, const std::string keyPrefix, const std::unordered_map<Key, Value> &map)
         {
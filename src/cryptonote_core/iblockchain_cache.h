@@ -163,6 +163,12 @@ namespace cryptonote
         virtual std::unordered_map<crypto::Hash, std::vector<uint64_t>> getGlobalIndexes(
             const std::vector<crypto::Hash> transactionHashes) const = 0;
 
+        /* The global indexes of every transaction in the blocks from
+           startHeight up to, but not including, endHeight */
+        virtual std::unordered_map<crypto::Hash, std::vector<uint64_t>> getGlobalIndexesForRange(
+            const uint64_t startHeight,
+            const uint64_t endHeight) const = 0;
+
         virtual size_t getTransactionCount() const = 0;
 
         virtual uint32_t getBlockIndexContainingTx(const crypto::Hash &transactionHash) const = 0;
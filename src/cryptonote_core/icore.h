@@ -12,6 +12,8 @@
 #include <optional>
 #include <cryptonote.h>
 
+#include <common/thread_pool.h>
+
 #include "add_block_errors.h"
 #include "add_block_error_condition.h"
 #include "blockchain_explorer_data.h"
@@ -96,8 +98,18 @@ namespace cryptonote
         virtual uint64_t getDifficultyForNextBlock() const = 0;
 
         virtual std::error_code addBlock(const CachedBlock &cachedBlock, RawBlock &&rawBlock) = 0;
+        /* As above, but with rawBlock.transactions already deserialized */
+        virtual std::error_code addBlock(const CachedBlock &cachedBlock, RawBlock &&rawBlock, std::vector<CachedTransaction> &&transactions) = 0;
         virtual std::error_code addBlock(RawBlock &&rawBlock) = 0;
 
+        /* Blocks in the checkpoint zone are checked against the checkpoints
+           rather than by their proof of work */
+        virtual bool isInCheckpointZone(uint32_t blockIndex) const = 0;
+
+        /* The workers the core checks signatures on. For other CPU bound jobs
+           to share, so the node doesn't run more threads than it has cores. */
+        virtual ThreadPool &getThreadPool() = 0;
+
         virtual std::error_code submitBlock(BinaryArray &&rawBlockTemplate) = 0;
 
         virtual bool getTransactionGlobalIndexes(const crypto::Hash &transactionHash,
@@ -112,6 +124,10 @@ namespace cryptonote
 
         virtual bool addTransactionToPool(const BinaryArray &transactionBinaryArray) = 0;
 
+        /* Adds a batch of relayed transactions, checking their signatures in
+           parallel. Returns whether each one was added. */
+        virtual std::vector<bool> addTransactionsToPool(const std::vector<BinaryArray> &transactionBinaryArrays) = 0;
+
         virtual std::vector<crypto::Hash> getPoolTransactionHashes() const = 0;
         virtual std::tuple<bool, cryptonote::BinaryArray> getPoolTransaction(const crypto::Hash &transactionHash) const = 0;
         virtual bool getPoolChanges(const crypto::Hash &lastBlockHash, const std::vector<crypto::Hash> &knownHashes,
@@ -0,0 +1,70 @@
+// Copyright (c) 2012-2017, The CryptoNote developers, The Bytecoin developers
+// Copyright (c) 2014-2018, The Monero Project
+// Copyright (c) 2018-2019, The TurtleCoin Developers
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include <cryptonote_core/icore_definitions.h>
+
+#include <cryptonote_core/cryptonote_serialization.h>
+
+#include <serialization/serialization_overloads.h>
+
+namespace cryptonote
+{
+
+    void serialize(BlockFullInfo &blockFullInfo, ISerializer &s)
+    {
+        KV_MEMBER(blockFullInfo.block_id);
+        KV_MEMBER(blockFullInfo.block);
+        s(blockFullInfo.transactions, "txs");
+    }
+
+    void serialize(TransactionPrefixInfo &transactionPrefixInfo, ISerializer &s)
+    {
+        KV_MEMBER(transactionPrefixInfo.txHash);
+        KV_MEMBER(transactionPrefixInfo.txPrefix);
+    }
+
+    void serialize(BlockShortInfo &blockShortInfo, ISerializer &s)
+    {
+        KV_MEMBER(blockShortInfo.blockId);
+        KV_MEMBER(blockShortInfo.block);
+        KV_MEMBER(blockShortInfo.txPrefixes);
+    }
+
+    void serialize(wallet_types::WalletBlockInfo &walletBlockInfo, ISerializer &s)
+    {
+        s(walletBlockInfo.coinbaseTransaction, "coinbaseTX");
+        s(walletBlockInfo.transactions, "transactions");
+        s(walletBlockInfo.blockHeight, "blockHeight");
+        s(walletBlockInfo.blockHash, "blockHash");
+        s(walletBlockInfo.blockTimestamp, "blockTimestamp");
+    }
+
+    void serialize(wallet_types::RawTransaction &rawTransaction, ISerializer &s)
+    {
+        s(rawTransaction.keyInputs, "inputs");
+        s(rawTransaction.paymentID, "paymentID");
+        s(rawTransaction.keyOutputs, "outputs");
+        s(rawTransaction.hash, "hash");
+        s(rawTransaction.transactionPublicKey, "txPublicKey");
+        s(rawTransaction.unlockTime, "unlockTime");
+    }
+
+    void serialize(wallet_types::RawCoinbaseTransaction &rawCoinbaseTransaction, ISerializer &s)
+    {
+        s(rawCoinbaseTransaction.keyOutputs, "outputs");
+        s(rawCoinbaseTransaction.hash, "hash");
+        s(rawCoinbaseTransaction.transactionPublicKey, "txPublicKey");
+        s(rawCoinbaseTransaction.unlockTime, "unlockTime");
+    }
+
+    void serialize(wallet_types::KeyOutput &keyOutput, ISerializer &s)
+    {
+        s(keyOutput.key, "key");
+        s(keyOutput.amount, "amount");
+    }
+
+}
@@ -12,6 +12,8 @@
 #include <crypto_types.h>
 #include <wallet_types.h>
 
+#include <serialization/iserializer.h>
+
 namespace cryptonote
 {
 
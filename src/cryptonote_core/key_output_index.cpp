@@ -0,0 +1,134 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "key_output_index.h"
+
+#include <algorithm>
+
+#include <common/shuffle_generator.h>
+
+namespace cryptonote
+{
+
+    bool KeyOutputIndex::isLoaded(const uint64_t amount) const
+    {
+        std::scoped_lock lock(m_mutex);
+
+        return m_amounts.find(amount) != m_amounts.end();
+    }
+
+    void KeyOutputIndex::load(
+        const uint64_t amount,
+        std::vector<uint32_t> &&blockIndexes,
+        std::vector<uint64_t> &&unlockTimes)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        AmountOutputs &outputs = m_amounts[amount];
+
+        outputs.blockIndexes = std::move(blockIndexes);
+        outputs.unlockTimes = std::move(unlockTimes);
+    }
+
+    void KeyOutputIndex::push(
+        const uint64_t amount,
+        const uint32_t globalIndex,
+        const uint32_t blockIndex,
+        const uint64_t unlockTime)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        const auto it = m_amounts.find(amount);
+
+        if (it == m_amounts.end())
+        {
+            return;
+        }
+
+        AmountOutputs &outputs = it->second;
+
+        if (globalIndex != outputs.blockIndexes.size())
+        {
+            m_amounts.erase(it);
+            return;
+        }
+
+        outputs.blockIndexes.push_back(blockIndex);
+        outputs.unlockTimes.push_back(unlockTime);
+    }
+
+    void KeyOutputIndex::truncate(const uint64_t amount, const uint32_t globalIndex)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        const auto it = m_amounts.find(amount);
+
+        if (it == m_amounts.end())
+        {
+            return;
+        }
+
+        AmountOutputs &outputs = it->second;
+
+        if (globalIndex < outputs.blockIndexes.size())
+        {
+            outputs.blockIndexes.resize(globalIndex);
+            outputs.unlockTimes.resize(globalIndex);
+        }
+    }
+
+    void KeyOutputIndex::clear()
+    {
+        std::scoped_lock lock(m_mutex);
+
+        m_amounts.clear();
+    }
+
+    bool KeyOutputIndex::getRandomOuts(
+        const uint64_t amount,
+        const size_t count,
+        const uint32_t maxBlockIndex,
+        const UnlockChecker &isUnlocked,
+        std::vector<uint32_t> &globalIndexes) const
+    {
+        std::scoped_lock lock(m_mutex);
+
+        const auto it = m_amounts.find(amount);
+
+        if (it == m_amounts.end())
+        {
+            return false;
+        }
+
+        const AmountOutputs &outputs = it->second;
+
+        /* Block indexes are sorted, so every output past this one is too new
+           and there's no point drawing it */
+        const auto end = std::upper_bound(outputs.blockIndexes.begin(), outputs.blockIndexes.end(), maxBlockIndex);
+
+        const uint32_t candidates = static_cast<uint32_t>(end - outputs.blockIndexes.begin());
+
+        ShuffleGenerator<uint32_t> generator(candidates);
+
+        globalIndexes.reserve(globalIndexes.size() + std::min<size_t>(count, candidates));
+
+        size_t picked = 0;
+
+        while (picked < count && !generator.empty())
+        {
+            const uint32_t globalIndex = generator();
+
+            if (!isUnlocked(outputs.unlockTimes[globalIndex]))
+            {
+                continue;
+            }
+
+            globalIndexes.push_back(globalIndex);
+            picked++;
+        }
+
+        return true;
+    }
+
+}
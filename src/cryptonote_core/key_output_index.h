@@ -0,0 +1,77 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace cryptonote
+{
+
+    /* The block index and unlock time of every key output of an amount, by
+       global output index, so random outputs can be picked for ring members
+       without going to the database for each candidate.
+
+       Amounts are loaded one at a time, the first time they are asked for,
+       and are then kept up to date as blocks are pushed and popped. That is
+       12 bytes per output of each amount in use. */
+    class KeyOutputIndex
+    {
+    public:
+        /* Whether an output with this unlock time can be spent yet */
+        using UnlockChecker = std::function<bool(uint64_t unlockTime)>;
+
+        bool isLoaded(const uint64_t amount) const;
+
+        /* Replaces whatever is held for the amount */
+        void load(
+            const uint64_t amount,
+            std::vector<uint32_t> &&blockIndexes,
+            std::vector<uint64_t> &&unlockTimes);
+
+        /* Does nothing if the amount isn't loaded. If the output doesn't
+           directly follow the last one held, the amount is dropped, and will
+           be loaded again next time it's used. */
+        void push(
+            const uint64_t amount,
+            const uint32_t globalIndex,
+            const uint32_t blockIndex,
+            const uint64_t unlockTime);
+
+        /* Forget every output of the amount from globalIndex onwards */
+        void truncate(const uint64_t amount, const uint32_t globalIndex);
+
+        void clear();
+
+        /* Picks up to count distinct global indexes, at random, out of the
+           outputs of the amount included in a block no higher than
+           maxBlockIndex, and unlocked according to isUnlocked. Returns false
+           if the amount isn't loaded. */
+        bool getRandomOuts(
+            const uint64_t amount,
+            const size_t count,
+            const uint32_t maxBlockIndex,
+            const UnlockChecker &isUnlocked,
+            std::vector<uint32_t> &globalIndexes) const;
+
+    private:
+        struct AmountOutputs
+        {
+            /* Never decreasing, as outputs are numbered in chain order */
+            std::vector<uint32_t> blockIndexes;
+
+            std::vector<uint64_t> unlockTimes;
+        };
+
+        std::unordered_map<uint64_t, AmountOutputs> m_amounts;
+
+        mutable std::mutex m_mutex;
+    };
+
+}
@@ -31,16 +31,22 @@ namespace cryptonote
 
     void MainChainStorage::pushBlock(const RawBlock &rawBlock)
     {
+        std::scoped_lock lock(mutex);
+
         storage.push_back(rawBlock);
     }
 
     void MainChainStorage::popBlock()
     {
+        std::scoped_lock lock(mutex);
+
         storage.pop_back();
     }
 
     RawBlock MainChainStorage::getBlockByIndex(uint32_t index) const
     {
+        std::scoped_lock lock(mutex);
+
         if (index >= storage.size())
         {
             throw std::out_of_range("Block index " + std::to_string(index) + " is out of range. Blocks count: " + std::to_string(storage.size()));
@@ -51,11 +57,15 @@ namespace cryptonote
 
     uint32_t MainChainStorage::getBlockCount() const
     {
+        std::scoped_lock lock(mutex);
+
         return static_cast<uint32_t>(storage.size());
     }
 
     void MainChainStorage::clear()
     {
+        std::scoped_lock lock(mutex);
+
         storage.clear();
     }
 
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <mutex>
+
 #include "imain_chain_storage.h"
 #include "currency.h"
 #include "swapped_vector.h"
@@ -29,6 +31,10 @@ namespace cryptonote
         virtual void clear() override;
 
     private:
+        /* Reading moves blocks in and out of the swap cache, and blocks are
+           read from RPC worker threads as well as the dispatcher */
+        mutable std::mutex mutex;
+
         mutable SwappedVector<RawBlock> storage;
     };
 
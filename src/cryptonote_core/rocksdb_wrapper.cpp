@@ -7,12 +7,21 @@
 
 #include "rocksdb_wrapper.h"
 
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+
 #include "rocksdb/cache.h"
+#include "rocksdb/convenience.h"
+#include "rocksdb/filter_policy.h"
 #include "rocksdb/table.h"
 #include "rocksdb/db.h"
 #include "rocksdb/utilities/backupable_db.h"
 
 #include "database_errors.h"
+#include "dbutils.h"
 
 using namespace cryptonote;
 using namespace logging;
@@ -21,6 +30,24 @@ namespace
 {
     const std::string DB_NAME = "DB";
     const std::string TESTNET_DB_NAME = "testnet_DB";
+
+    /* Indexed by RocksDBWrapper::ColumnFamily. Literals rather than
+       rocksdb::kDefaultColumnFamilyName, which is a global in another
+       translation unit, so may not be initialized before this is. */
+    const char *const COLUMN_FAMILY_NAMES[] = {
+        "default",
+        "raw_blocks",
+        "blocks",
+        "key_images",
+        "transactions",
+        "outputs"};
+
+    bool isCompressionSupported(const rocksdb::CompressionType type)
+    {
+        const std::vector<rocksdb::CompressionType> supported = rocksdb::GetSupportedCompressions();
+
+        return std::find(supported.begin(), supported.end(), type) != supported.end();
+    }
 }
 
 RocksDBWrapper::RocksDBWrapper(std::shared_ptr<logging::ILogger> logger) : logger(logger, "RocksDBWrapper"), state(NOT_INITIALIZED)
@@ -43,9 +70,13 @@ void RocksDBWrapper::init(const DataBaseConfig &config)
     logger(INFO) << "Opening DB in " << dataDir;
 
     rocksdb::DB *dbPtr;
+    std::vector<rocksdb::ColumnFamilyHandle *> handles;
+
+    blockCache = rocksdb::NewLRUCache(config.getReadCacheSize());
 
     rocksdb::Options dbOptions = getDBOptions(config);
-    rocksdb::Status status = rocksdb::DB::Open(dbOptions, dataDir, &dbPtr);
+    std::vector<rocksdb::ColumnFamilyDescriptor> families = getColumnFamilyDescriptors(config);
+    rocksdb::Status status = rocksdb::DB::Open(dbOptions, dataDir, families, &handles, &dbPtr);
     if (status.ok())
     {
         logger(INFO) << "DB opened in " << dataDir;
@@ -54,7 +85,7 @@ void RocksDBWrapper::init(const DataBaseConfig &config)
     {
         logger(INFO) << "DB not found in " << dataDir << ". Creating new DB...";
         dbOptions.create_if_missing = true;
-        rocksdb::Status status = rocksdb::DB::Open(dbOptions, dataDir, &dbPtr);
+        rocksdb::Status status = rocksdb::DB::Open(dbOptions, dataDir, families, &handles, &dbPtr);
         if (!status.ok())
         {
             logger(ERROR) << "DB Error. DB can't be created in " << dataDir << ". Error: " << status.ToString();
@@ -73,6 +104,7 @@ void RocksDBWrapper::init(const DataBaseConfig &config)
     }
 
     db.reset(dbPtr);
+    columnFamilies = handles;
     state.store(INITIALIZED);
 }
 
@@ -84,9 +116,22 @@ void RocksDBWrapper::shutdown()
     }
 
     logger(INFO) << "Closing DB.";
-    db->Flush(rocksdb::FlushOptions());
+
+    for (rocksdb::ColumnFamilyHandle *handle : columnFamilies)
+    {
+        db->Flush(rocksdb::FlushOptions(), handle);
+    }
+
     db->SyncWAL();
+
+    for (rocksdb::ColumnFamilyHandle *handle : columnFamilies)
+    {
+        db->DestroyColumnFamilyHandle(handle);
+    }
+
+    columnFamilies.clear();
     db.reset();
+    blockCache.reset();
     state.store(NOT_INITIALIZED);
 }
 
@@ -102,7 +147,7 @@ void RocksDBWrapper::destroy(const DataBaseConfig &config)
     logger(WARNING) << "Destroying DB in " << dataDir;
 
     rocksdb::Options dbOptions = getDBOptions(config);
-    rocksdb::Status status = rocksdb::DestroyDB(dataDir, dbOptions);
+    rocksdb::Status status = rocksdb::DestroyDB(dataDir, dbOptions, getColumnFamilyDescriptors(config));
 
     if (status.ok())
     {
@@ -134,13 +179,13 @@ std::error_code RocksDBWrapper::write(IWriteBatch &batch, bool sync)
     std::vector<std::pair<std::string, std::string>> rawData(batch.extractRawDataToInsert());
     for (const std::pair<std::string, std::string> &kvPair : rawData)
     {
-        rocksdbBatch.Put(rocksdb::Slice(kvPair.first), rocksdb::Slice(kvPair.second));
+        rocksdbBatch.Put(getColumnFamily(kvPair.first), rocksdb::Slice(kvPair.first), rocksdb::Slice(kvPair.second));
     }
 
     std::vector<std::string> rawKeys(batch.extractRawKeysToRemove());
     for (const std::string &key : rawKeys)
     {
-        rocksdbBatch.Delete(rocksdb::Slice(key));
+        rocksdbBatch.Delete(getColumnFamily(key), rocksdb::Slice(key));
     }
 
     rocksdb::Status status = db->Write(writeOptions, &rocksdbBatch);
@@ -167,15 +212,18 @@ std::error_code RocksDBWrapper::read(IReadBatch &batch)
 
     std::vector<std::string> rawKeys(batch.getRawKeys());
     std::vector<rocksdb::Slice> keySlices;
+    std::vector<rocksdb::ColumnFamilyHandle *> keyFamilies;
     keySlices.reserve(rawKeys.size());
+    keyFamilies.reserve(rawKeys.size());
     for (const std::string &key : rawKeys)
     {
         keySlices.emplace_back(rocksdb::Slice(key));
+        keyFamilies.push_back(getColumnFamily(key));
     }
 
     std::vector<std::string> values;
     values.reserve(rawKeys.size());
-    std::vector<rocksdb::Status> statuses = db->MultiGet(readOptions, keySlices, &values);
+    std::vector<rocksdb::Status> statuses = db->MultiGet(readOptions, keyFamilies, keySlices, &values);
 
     std::error_code error;
     std::vector<bool> resultStates;
@@ -198,7 +246,17 @@ rocksdb::Options RocksDBWrapper::getDBOptions(const DataBaseConfig &config)
     dbOptions.IncreaseParallelism(config.getBackgroundThreadsCount());
     dbOptions.info_log_level = rocksdb::InfoLogLevel::WARN_LEVEL;
     dbOptions.max_open_files = config.getMaxOpenFiles();
+    // column families are added to databases created before they were used
+    dbOptions.create_missing_column_families = true;
+    // every family gets its own memtables, cap the total at what a single
+    // family could previously use in the worst case.
+    dbOptions.db_write_buffer_size = config.getWriteBufferSize() * 6;
 
+    return rocksdb::Options(dbOptions, getColumnFamilyOptions(config, DEFAULT_FAMILY));
+}
+
+rocksdb::ColumnFamilyOptions RocksDBWrapper::getColumnFamilyOptions(const DataBaseConfig &config, const ColumnFamily family)
+{
     rocksdb::ColumnFamilyOptions fOptions;
     fOptions.write_buffer_size = static_cast<size_t>(config.getWriteBufferSize());
     // merge two memtables when flushing to L0
@@ -230,11 +288,109 @@ rocksdb::Options RocksDBWrapper::getDBOptions(const DataBaseConfig &config)
     }
 
     rocksdb::BlockBasedTableOptions tableOptions;
-    tableOptions.block_cache = rocksdb::NewLRUCache(config.getReadCacheSize());
+    tableOptions.block_cache = blockCache;
+
+    if (family == RAW_BLOCKS_FAMILY)
+    {
+        // raw blocks are the bulk of the DB, and unlike the hashes and keys
+        // in the other families, compress well. Leave the levels which are
+        // still being churned by compaction alone, and compress the rest
+        // with whatever the rocksdb build supports.
+        rocksdb::CompressionType compression = rocksdb::kNoCompression;
+
+        if (isCompressionSupported(rocksdb::kLZ4Compression))
+        {
+            compression = rocksdb::kLZ4Compression;
+        }
+        else if (isCompressionSupported(rocksdb::kSnappyCompression))
+        {
+            compression = rocksdb::kSnappyCompression;
+        }
+
+        for (int i = 2; i < fOptions.num_levels; ++i)
+        {
+            fOptions.compression_per_level[i] = compression;
+        }
+
+        if (isCompressionSupported(rocksdb::kZSTD))
+        {
+            fOptions.bottommost_compression = rocksdb::kZSTD;
+        }
+
+        // blocks are read sequentially while syncing, bigger blocks compress
+        // better and mean fewer index entries.
+        tableOptions.block_size = 64 * 1024;
+    }
+    else if (family != DEFAULT_FAMILY)
+    {
+        // everything else is point lookups by hash or index, often for keys
+        // which don't exist (unspent key images, unknown block hashes).
+        // Whole key bloom filters let most of those skip the disk entirely.
+        tableOptions.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, false));
+        tableOptions.whole_key_filtering = true;
+        tableOptions.cache_index_and_filter_blocks = true;
+        tableOptions.pin_l0_filter_and_index_blocks_in_cache = true;
+    }
+
     std::shared_ptr<rocksdb::TableFactory> tfp(NewBlockBasedTableFactory(tableOptions));
     fOptions.table_factory = tfp;
 
-    return rocksdb::Options(dbOptions, fOptions);
+    return fOptions;
+}
+
+std::vector<rocksdb::ColumnFamilyDescriptor> RocksDBWrapper::getColumnFamilyDescriptors(const DataBaseConfig &config)
+{
+    static_assert(std::size(COLUMN_FAMILY_NAMES) == COLUMN_FAMILY_COUNT);
+
+    std::vector<rocksdb::ColumnFamilyDescriptor> descriptors;
+
+    for (size_t i = 0; i < COLUMN_FAMILY_COUNT; i++)
+    {
+        descriptors.emplace_back(COLUMN_FAMILY_NAMES[i], getColumnFamilyOptions(config, static_cast<ColumnFamily>(i)));
+    }
+
+    return descriptors;
+}
+
+rocksdb::ColumnFamilyHandle *RocksDBWrapper::getColumnFamily(const std::string &rawKey) const
+{
+    static const std::unordered_map<std::string_view, ColumnFamily> prefixToFamily = {
+        {db::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, KEY_IMAGES_FAMILY},
+        {db::BLOCK_INDEX_TO_TX_HASHES_PREFIX, BLOCKS_FAMILY},
+        {db::BLOCK_INDEX_TO_GLOBAL_INDEXES_PREFIX, BLOCKS_FAMILY},
+        {db::BLOCK_INDEX_TO_TRANSACTION_INFO_PREFIX, BLOCKS_FAMILY},
+        {db::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX, RAW_BLOCKS_FAMILY},
+        {db::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX, BLOCKS_FAMILY},
+        {db::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX, BLOCKS_FAMILY},
+        {db::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX, KEY_IMAGES_FAMILY},
+        {db::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX, BLOCKS_FAMILY},
+        {db::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX, TRANSACTIONS_FAMILY},
+        {db::KEY_OUTPUT_AMOUNT_PREFIX, OUTPUTS_FAMILY},
+        {db::CLOSEST_TIMESTAMP_BLOCK_INDEX_PREFIX, BLOCKS_FAMILY},
+        {db::PAYMENT_ID_TO_TX_HASH_PREFIX, TRANSACTIONS_FAMILY},
+        {db::TIMESTAMP_TO_BLOCKHASHES_PREFIX, BLOCKS_FAMILY},
+        {db::KEY_OUTPUT_AMOUNTS_COUNT_PREFIX, OUTPUTS_FAMILY},
+        {db::KEY_OUTPUT_KEY_PREFIX, OUTPUTS_FAMILY}};
+
+    const std::string_view prefix = db::getKeyPrefix(rawKey);
+
+    /* Not made with serializeKey(), such as the db scheme version key */
+    if (prefix.empty())
+    {
+        return columnFamilies[DEFAULT_FAMILY];
+    }
+
+    const auto it = prefixToFamily.find(prefix);
+
+    /* Every record type must be routed to its family above */
+    if (it == prefixToFamily.end())
+    {
+        logger(ERROR) << "No column family for DB key prefix " << std::string(prefix);
+        assert(false);
+        throw std::system_error(make_error_code(cryptonote::error::DataBaseErrorCodes::INTERNAL_ERROR));
+    }
+
+    return columnFamilies[it->second];
 }
 
 std::string RocksDBWrapper::getDataDir(const DataBaseConfig &config)
@@ -10,7 +10,9 @@
 #include <atomic>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "rocksdb/cache.h"
 #include "rocksdb/db.h"
 
 #include "idatabase.h"
@@ -41,9 +43,31 @@ namespace cryptonote
         std::error_code read(IReadBatch &batch) override;
 
     private:
+        /* Each kind of record is stored in its own column family, so it can
+           be tuned for how it is accessed */
+        enum ColumnFamily
+        {
+            /* The db scheme version, and anything we don't know about */
+            DEFAULT_FAMILY,
+            /* Raw blocks, large and rarely read once synced */
+            RAW_BLOCKS_FAMILY,
+            /* Block info, block hash to index, timestamps, tx hashes */
+            BLOCKS_FAMILY,
+            /* Spent key images */
+            KEY_IMAGES_FAMILY,
+            /* Transaction info and the payment id index */
+            TRANSACTIONS_FAMILY,
+            /* Key outputs and the per amount global indexes */
+            OUTPUTS_FAMILY,
+            COLUMN_FAMILY_COUNT
+        };
+
         std::error_code write(IWriteBatch &batch, bool sync);
 
         rocksdb::Options getDBOptions(const DataBaseConfig &config);
+        rocksdb::ColumnFamilyOptions getColumnFamilyOptions(const DataBaseConfig &config, const ColumnFamily family);
+        std::vector<rocksdb::ColumnFamilyDescriptor> getColumnFamilyDescriptors(const DataBaseConfig &config);
+        rocksdb::ColumnFamilyHandle *getColumnFamily(const std::string &rawKey) const;
         std::string getDataDir(const DataBaseConfig &config);
 
         enum State
@@ -54,6 +78,10 @@ namespace cryptonote
 
         logging::LoggerRef logger;
         std::unique_ptr<rocksdb::DB> db;
+        /* Indexed by ColumnFamily */
+        std::vector<rocksdb::ColumnFamilyHandle *> columnFamilies;
+        /* Shared between all column families */
+        std::shared_ptr<rocksdb::Cache> blockCache;
         std::atomic<State> state;
     };
 }
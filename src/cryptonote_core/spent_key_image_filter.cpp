@@ -0,0 +1,100 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "spent_key_image_filter.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cryptonote
+{
+
+    SpentKeyImageFilter::SpentKeyImageFilter(const size_t sizeBytes)
+    {
+        const size_t blockBytes = WORDS_PER_BLOCK * sizeof(uint64_t);
+
+        m_blockCount = 1;
+
+        while (m_blockCount * 2 * blockBytes <= sizeBytes)
+        {
+            m_blockCount *= 2;
+        }
+
+        m_words.resize(m_blockCount * WORDS_PER_BLOCK, 0);
+    }
+
+    size_t SpentKeyImageFilter::getBlock(const crypto::KeyImage &keyImage, uint64_t &h1, uint64_t &h2) const
+    {
+        /* Key images are curve points, so are already uniformly distributed
+           and don't need hashing again. */
+        uint64_t blockHash;
+
+        std::memcpy(&blockHash, keyImage.data, sizeof(blockHash));
+        std::memcpy(&h1, keyImage.data + 8, sizeof(h1));
+        std::memcpy(&h2, keyImage.data + 16, sizeof(h2));
+
+        /* An even h2 would only ever touch half the bits */
+        h2 |= 1;
+
+        return (blockHash & (m_blockCount - 1)) * WORDS_PER_BLOCK;
+    }
+
+    void SpentKeyImageFilter::add(const crypto::KeyImage &keyImage)
+    {
+        uint64_t h1;
+        uint64_t h2;
+
+        uint64_t *block = &m_words[getBlock(keyImage, h1, h2)];
+
+        for (size_t i = 0; i < BITS_PER_KEY; i++)
+        {
+            const uint64_t bit = (h1 + i * h2) % (WORDS_PER_BLOCK * 64);
+
+            block[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+
+    bool SpentKeyImageFilter::mightContain(const crypto::KeyImage &keyImage) const
+    {
+        uint64_t h1;
+        uint64_t h2;
+
+        const uint64_t *block = &m_words[getBlock(keyImage, h1, h2)];
+
+        for (size_t i = 0; i < BITS_PER_KEY; i++)
+        {
+            const uint64_t bit = (h1 + i * h2) % (WORDS_PER_BLOCK * 64);
+
+            if ((block[bit / 64] & (uint64_t(1) << (bit % 64))) == 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void SpentKeyImageFilter::clear()
+    {
+        std::fill(m_words.begin(), m_words.end(), 0);
+    }
+
+    std::string SpentKeyImageFilter::toString() const
+    {
+        return std::string(reinterpret_cast<const char *>(m_words.data()), m_words.size() * sizeof(uint64_t));
+    }
+
+    bool SpentKeyImageFilter::fromString(const std::string &data)
+    {
+        if (data.size() != m_words.size() * sizeof(uint64_t))
+        {
+            return false;
+        }
+
+        std::memcpy(m_words.data(), data.data(), data.size());
+
+        return true;
+    }
+
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <crypto_types.h>
+
+namespace cryptonote
+{
+
+    /* A blocked bloom filter over spent key images. Each key image maps to a
+       single 64 byte block, (one cache line) and sets a handful of bits inside
+       it, so a lookup costs at most one cache miss.
+
+       There are no false negatives - if mightContain() returns false, the key
+       image was never added. Key images can't be removed, so after a rollback
+       the filter may claim more key images are spent than really are, which
+       just means a few more lookups fall through to the database. */
+    class SpentKeyImageFilter
+    {
+    public:
+        /* The size is rounded down to a power of two number of blocks */
+        explicit SpentKeyImageFilter(const size_t sizeBytes);
+
+        void add(const crypto::KeyImage &keyImage);
+
+        /* False means the key image is definitely not in the filter */
+        bool mightContain(const crypto::KeyImage &keyImage) const;
+
+        void clear();
+
+        /* The raw filter bits, for storing in the database */
+        std::string toString() const;
+
+        /* Returns false and leaves the filter untouched if the data is not a
+           filter of the same size */
+        bool fromString(const std::string &data);
+
+    private:
+        static const size_t WORDS_PER_BLOCK = 8;
+
+        static const size_t BITS_PER_KEY = 8;
+
+        /* Index of the first word of the block this key image uses, and the
+           two hashes the bit positions inside it are derived from */
+        size_t getBlock(const crypto::KeyImage &keyImage, uint64_t &h1, uint64_t &h2) const;
+
+        std::vector<uint64_t> m_words;
+
+        size_t m_blockCount;
+    };
+
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "wallet_sync_data_cache.h"
+
+#include <algorithm>
+
+namespace cryptonote
+{
+
+    WalletSyncDataCache::WalletSyncDataCache(const size_t maxBlocks) : m_maxBlocks(maxBlocks)
+    {
+    }
+
+    void WalletSyncDataCache::addBlock(wallet_types::WalletBlockInfo block)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (m_blocks.empty() || block.blockHeight != m_startHeight + m_blocks.size())
+        {
+            m_blocks.clear();
+            m_startHeight = block.blockHeight;
+        }
+
+        m_blocks.push_back(std::move(block));
+
+        if (m_blocks.size() > m_maxBlocks)
+        {
+            m_blocks.pop_front();
+            m_startHeight++;
+        }
+    }
+
+    void WalletSyncDataCache::removeBlocksFrom(const uint64_t height)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (height <= m_startHeight)
+        {
+            m_blocks.clear();
+            return;
+        }
+
+        if (height < m_startHeight + m_blocks.size())
+        {
+            m_blocks.resize(height - m_startHeight);
+        }
+    }
+
+    void WalletSyncDataCache::clear()
+    {
+        std::scoped_lock lock(m_mutex);
+
+        m_blocks.clear();
+    }
+
+    uint64_t WalletSyncDataCache::getBlocks(
+        const uint64_t startHeight,
+        const uint64_t endHeight,
+        std::vector<wallet_types::WalletBlockInfo> &blocks) const
+    {
+        std::scoped_lock lock(m_mutex);
+
+        const uint64_t first = std::max(startHeight, m_startHeight);
+        const uint64_t last = std::min(endHeight, m_startHeight + m_blocks.size());
+
+        if (first >= last)
+        {
+            return endHeight;
+        }
+
+        blocks.insert(
+            blocks.end(),
+            m_blocks.begin() + (first - m_startHeight),
+            m_blocks.begin() + (last - m_startHeight));
+
+        return first;
+    }
+
+}
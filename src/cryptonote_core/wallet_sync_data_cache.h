@@ -0,0 +1,58 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <wallet_types.h>
+
+namespace cryptonote
+{
+
+    /* The wallet sync data of the most recent main chain blocks, extracted as
+       the blocks are added, so wallets polling the top of the chain don't make
+       us reread and reparse the same blocks for every request.
+
+       Only holds a contiguous run of blocks ending at the top block. Blocks
+       are added in order as the main chain grows, and anything above a split
+       point is removed when the main chain switches. */
+    class WalletSyncDataCache
+    {
+    public:
+        explicit WalletSyncDataCache(const size_t maxBlocks);
+
+        /* Append the next main chain block. If it doesn't follow on from the
+           last cached block, the cache starts again from this block. */
+        void addBlock(wallet_types::WalletBlockInfo block);
+
+        /* Drop the blocks at and above this height */
+        void removeBlocksFrom(const uint64_t height);
+
+        void clear();
+
+        /* Appends the cached blocks in the range [startHeight, endHeight) to
+           blocks, and returns the height of the first one appended. If none
+           are cached, nothing is appended and endHeight is returned. */
+        uint64_t getBlocks(
+            const uint64_t startHeight,
+            const uint64_t endHeight,
+            std::vector<wallet_types::WalletBlockInfo> &blocks) const;
+
+    private:
+        const size_t m_maxBlocks;
+
+        /* Height of m_blocks.front() */
+        uint64_t m_startHeight = 0;
+
+        std::deque<wallet_types::WalletBlockInfo> m_blocks;
+
+        mutable std::mutex m_mutex;
+    };
+
+}
@@ -0,0 +1,165 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <config/cli_header.h>
+#include <cryptonote_core/block_template_candidates.h>
+
+using namespace cryptonote;
+
+namespace
+{
+    crypto::Hash makeHash(const uint8_t id)
+    {
+        crypto::Hash hash = crypto::Hash();
+        hash.data[0] = id;
+        return hash;
+    }
+
+    /* A pool, and a validator which counts how often it's asked, and which
+       can reject transactions on top of particular blocks */
+    struct TestPool
+    {
+        BlockTemplateCandidates candidates;
+
+        std::unordered_set<crypto::Hash> inPool;
+
+        /* The transactions which can't go on top of each block */
+        std::unordered_map<crypto::Hash, std::unordered_set<crypto::Hash>> invalidOn;
+
+        crypto::Hash previousBlockHash;
+
+        size_t validations = 0;
+
+        void add(const uint8_t id, const uint64_t fee, const size_t size, const uint64_t receiveTime)
+        {
+            candidates.add(makeHash(id), fee, size, receiveTime);
+            inPool.insert(makeHash(id));
+        }
+
+        std::vector<crypto::Hash> fill(const crypto::Hash &topBlockHash, const uint64_t height = 100)
+        {
+            std::vector<crypto::Hash> hashes;
+            size_t transactionsSize;
+            uint64_t fee;
+
+            const auto isInPool = [this](const crypto::Hash &hash) {
+                return inPool.find(hash) != inPool.end();
+            };
+
+            const auto isValid = [this, &topBlockHash](const crypto::Hash &hash, const uint64_t) {
+                validations++;
+
+                const auto it = invalidOn.find(topBlockHash);
+
+                return it == invalidOn.end() || it->second.find(hash) == it->second.end();
+            };
+
+            candidates.fill(height, topBlockHash, 100000, 100000, 100000, inPool.size(), isInPool, isValid, hashes, transactionsSize, fee);
+
+            return hashes;
+        }
+    };
+
+    void testOrdering()
+    {
+        TestPool pool;
+
+        pool.add(1, 1000, 100, 10); /* 10 per byte */
+        pool.add(2, 1000, 200, 10); /* 5 per byte */
+        pool.add(3, 3000, 200, 10); /* 15 per byte */
+        pool.add(4, 1000, 100, 20); /* Same as 1, but newer */
+        pool.add(5, 0, 300, 10);    /* Fusion */
+
+        /* Adding again does nothing */
+        pool.add(3, 3000, 200, 10);
+
+        assert(pool.candidates.size() == 5);
+
+        const std::vector<crypto::Hash> expected = {
+            makeHash(5), makeHash(3), makeHash(1), makeHash(4), makeHash(2)};
+
+        assert(pool.fill(makeHash(100)) == expected);
+
+        std::cout << "Ordering: OK" << std::endl;
+    }
+
+    void testInvalidation()
+    {
+        TestPool pool;
+
+        pool.add(1, 1000, 100, 10);
+        pool.add(2, 2000, 100, 10);
+
+        pool.invalidOn[makeHash(100)] = {makeHash(2)};
+
+        assert(pool.fill(makeHash(100)) == std::vector<crypto::Hash>({makeHash(1)}));
+        assert(pool.validations == 2);
+
+        /* Same top block - nothing is validated again, and the invalid one
+           stays out */
+        assert(pool.fill(makeHash(100)) == std::vector<crypto::Hash>({makeHash(1)}));
+        assert(pool.validations == 2);
+
+        /* New top block - everything is validated again */
+        assert(pool.fill(makeHash(101), 101) == std::vector<crypto::Hash>({makeHash(2), makeHash(1)}));
+        assert(pool.validations == 4);
+
+        /* A transaction which has left the pool is dropped without being
+           reported */
+        pool.inPool.erase(makeHash(2));
+
+        assert(pool.fill(makeHash(101), 101) == std::vector<crypto::Hash>({makeHash(1)}));
+        assert(pool.candidates.size() == 1);
+
+        pool.candidates.remove(makeHash(1));
+
+        assert(pool.candidates.size() == 0);
+
+        std::cout << "Invalidation: OK" << std::endl;
+    }
+
+    void testReorg()
+    {
+        TestPool pool;
+
+        pool.add(1, 1000, 100, 10);
+        pool.add(2, 2000, 100, 10);
+
+        /* Valid on top of one chain, but not on top of another of the same
+           length - say, its inputs are spent there */
+        pool.invalidOn[makeHash(201)] = {makeHash(2)};
+
+        assert(pool.fill(makeHash(200), 100) == std::vector<crypto::Hash>({makeHash(2), makeHash(1)}));
+        assert(pool.validations == 2);
+
+        /* Switched to the other chain, at the same height */
+        assert(pool.fill(makeHash(201), 100) == std::vector<crypto::Hash>({makeHash(1)}));
+        assert(pool.validations == 4);
+
+        /* And back again */
+        assert(pool.fill(makeHash(200), 100) == std::vector<crypto::Hash>({makeHash(2), makeHash(1)}));
+        assert(pool.validations == 6);
+
+        std::cout << "Reorg: OK" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::cout << getProjectCLIHeader() << std::endl;
+
+    std::cout << "BlockTemplateCandidates:" << std::endl;
+
+    testOrdering();
+    testInvalidation();
+    testReorg();
+}
@@ -0,0 +1,153 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "block_sync_queue.h"
+
+#include <unordered_set>
+
+#include <boost/uuid/uuid_hash.hpp>
+
+namespace cryptonote
+{
+
+    BlockSyncQueue::BlockSyncQueue(const size_t maxBlocks) : m_maxBlocks(maxBlocks)
+    {
+    }
+
+    bool BlockSyncQueue::shouldRequest(const crypto::Hash &blockHash) const
+    {
+        return m_requested.find(blockHash) == m_requested.end() && m_parents.find(blockHash) == m_parents.end();
+    }
+
+    void BlockSyncQueue::markRequested(const crypto::Hash &blockHash, const boost::uuids::uuid &peer)
+    {
+        m_requested[blockHash] = {peer, std::chrono::steady_clock::now()};
+    }
+
+    void BlockSyncQueue::cancelRequests(const boost::uuids::uuid &peer)
+    {
+        for (auto it = m_requested.begin(); it != m_requested.end();)
+        {
+            if (it->second.peer == peer)
+            {
+                it = m_requested.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    std::vector<boost::uuids::uuid> BlockSyncQueue::expiredPeers(const std::chrono::steady_clock::duration timeout) const
+    {
+        const auto deadline = std::chrono::steady_clock::now() - timeout;
+
+        std::unordered_set<boost::uuids::uuid> peers;
+
+        for (const auto &[blockHash, request] : m_requested)
+        {
+            if (request.time < deadline)
+            {
+                peers.insert(request.peer);
+            }
+        }
+
+        return {peers.begin(), peers.end()};
+    }
+
+    void BlockSyncQueue::push(SyncBlock &&block)
+    {
+        m_requested.erase(block.blockHash);
+
+        /* Already have it from someone else */
+        if (m_parents.find(block.blockHash) != m_parents.end())
+        {
+            return;
+        }
+
+        const crypto::Hash parentHash = block.blockTemplate->previousBlockHash;
+
+        m_parents[block.blockHash] = parentHash;
+        m_blocks.emplace(parentHash, std::move(block));
+    }
+
+    bool BlockSyncQueue::pop(
+        const crypto::Hash &topBlockHash,
+        const std::function<bool(const crypto::Hash &)> &haveBlock,
+        SyncBlock &block)
+    {
+        /* Nearly always the next block extends the top block */
+        auto it = m_blocks.find(topBlockHash);
+
+        if (it == m_blocks.end())
+        {
+            /* Otherwise, it could be a block on an alternative chain, or the
+               top block has moved from under us */
+            for (it = m_blocks.begin(); it != m_blocks.end(); ++it)
+            {
+                /* Parent is still queued, no point asking the core */
+                if (m_parents.find(it->first) != m_parents.end())
+                {
+                    continue;
+                }
+
+                if (haveBlock(it->first))
+                {
+                    break;
+                }
+            }
+
+            if (it == m_blocks.end())
+            {
+                return false;
+            }
+        }
+
+        block = std::move(it->second);
+
+        m_parents.erase(block.blockHash);
+        m_blocks.erase(it);
+
+        return true;
+    }
+
+    void BlockSyncQueue::removePeerBlocks(const boost::uuids::uuid &peer)
+    {
+        for (auto it = m_blocks.begin(); it != m_blocks.end();)
+        {
+            if (it->second.peer == peer)
+            {
+                m_parents.erase(it->second.blockHash);
+                it = m_blocks.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void BlockSyncQueue::clearBlocks()
+    {
+        m_blocks.clear();
+        m_parents.clear();
+    }
+
+    size_t BlockSyncQueue::requestedCount() const
+    {
+        return m_requested.size();
+    }
+
+    size_t BlockSyncQueue::queuedCount() const
+    {
+        return m_blocks.size();
+    }
+
+    bool BlockSyncQueue::isFull() const
+    {
+        return m_requested.size() + m_blocks.size() >= m_maxBlocks;
+    }
+
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/uuid/uuid.hpp>
+
+#include "cryptonote.h"
+#include "cryptonote_core/cached_block.h"
+#include "cryptonote_core/cached_transaction.h"
+
+namespace cryptonote
+{
+
+    /* A block downloaded while syncing, waiting to be added to the core */
+    struct SyncBlock
+    {
+        crypto::Hash blockHash;
+
+        /* On the heap, as cachedBlock holds a reference to it, and the block
+           is moved around between the queue and the caller */
+        std::unique_ptr<BlockTemplate> blockTemplate;
+
+        /* Hashes already computed, off the dispatcher thread */
+        std::unique_ptr<CachedBlock> cachedBlock;
+
+        RawBlock rawBlock;
+
+        /* rawBlock.transactions, already deserialized and hashed. Only valid
+           if transactionsPrepared is set. */
+        std::vector<CachedTransaction> transactions;
+
+        bool transactionsPrepared = false;
+
+        /* The connection the block was downloaded from */
+        boost::uuids::uuid peer;
+    };
+
+    /* Keeps track of which blocks have been requested from which peer while
+       syncing, and reorders the blocks as they come back so they can be added
+       to the core parent first, no matter which peer sent them or when.
+
+       The number of blocks requested or waiting to be added is bounded, so a
+       slow peer can't make us buffer the whole chain while waiting on it. */
+    class BlockSyncQueue
+    {
+    public:
+        explicit BlockSyncQueue(const size_t maxBlocks);
+
+        /* Whether the block is neither requested from a peer, nor downloaded
+           and waiting to be added */
+        bool shouldRequest(const crypto::Hash &blockHash) const;
+
+        void markRequested(const crypto::Hash &blockHash, const boost::uuids::uuid &peer);
+
+        /* Forget the blocks requested from a peer, so they can be requested
+           from another one */
+        void cancelRequests(const boost::uuids::uuid &peer);
+
+        /* The peers with a request outstanding for longer than timeout */
+        std::vector<boost::uuids::uuid> expiredPeers(const std::chrono::steady_clock::duration timeout) const;
+
+        /* Store a downloaded block until its parent has been added */
+        void push(SyncBlock &&block);
+
+        /* Remove the next block which can be added - that is, one whose parent
+           is the top block, or failing that, any block haveBlock() returns true
+           for. Returns false if no queued block can be added yet. */
+        bool pop(
+            const crypto::Hash &topBlockHash,
+            const std::function<bool(const crypto::Hash &)> &haveBlock,
+            SyncBlock &block);
+
+        /* Drop every downloaded block which came from this peer */
+        void removePeerBlocks(const boost::uuids::uuid &peer);
+
+        /* Drop every downloaded block. Outstanding requests are kept. */
+        void clearBlocks();
+
+        size_t requestedCount() const;
+
+        size_t queuedCount() const;
+
+        /* Whether no more blocks should be requested until some are added */
+        bool isFull() const;
+
+    private:
+        struct Request
+        {
+            boost::uuids::uuid peer;
+
+            std::chrono::steady_clock::time_point time;
+        };
+
+        const size_t m_maxBlocks;
+
+        /* Block hash to the peer it was requested from, and when */
+        std::unordered_map<crypto::Hash, Request> m_requested;
+
+        /* Downloaded blocks, by their parent's hash */
+        std::unordered_multimap<crypto::Hash, SyncBlock> m_blocks;
+
+        /* Hashes of the downloaded blocks, so we don't request them again */
+        std::unordered_map<crypto::Hash, crypto::Hash> m_parents;
+    };
+
+}
@@ -11,11 +11,13 @@
 #include <boost/scope_exit.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <syst/dispatcher.h>
+#include <syst/remote_context.h>
 
 #include "cryptonote_core/cryptonote_basic_impl.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "cryptonote_core/cryptonote_tools.h"
 #include "cryptonote_core/currency.h"
+#include "common/scope_exit.h"
 #include "p2p/levin_protocol.h"
 
 #include <utilities/format_tools.h>
@@ -71,6 +73,88 @@ namespace cryptonote
             return rawBlocks;
         }
 
+        /* Deserializes and hashes a downloaded block and its transactions.
+           Slow, and touches nothing shared, so is run on the worker threads
+           rather than the dispatcher. The proof of work hash is skipped in the
+           checkpoint zone, as the core doesn't check it there. */
+        bool prepareSyncBlock(
+            RawBlock &&rawBlock,
+            const ICore &core,
+            const size_t maxBlockSize,
+            const size_t maxTransactionSize,
+            SyncBlock &syncBlock)
+        {
+            /* Don't spend time parsing a block which is too big to be valid */
+            size_t transactionsSize = 0;
+
+            for (const auto &rawTransaction : rawBlock.transactions)
+            {
+                if (rawTransaction.size() > maxTransactionSize)
+                {
+                    return false;
+                }
+
+                transactionsSize += rawTransaction.size();
+            }
+
+            /* The coinbase and the transactions count towards the cumulative
+               size. The block blob only adds a header and a hash for each
+               transaction to the coinbase, so can't come near the limit. */
+            if (transactionsSize > maxBlockSize || rawBlock.block.size() + transactionsSize > 2 * maxBlockSize)
+            {
+                return false;
+            }
+
+            syncBlock.blockTemplate = std::make_unique<BlockTemplate>();
+
+            if (!fromBinaryArray(*syncBlock.blockTemplate, rawBlock.block))
+            {
+                return false;
+            }
+
+            try
+            {
+                syncBlock.cachedBlock = std::make_unique<CachedBlock>(*syncBlock.blockTemplate);
+                syncBlock.blockHash = syncBlock.cachedBlock->getBlockHash();
+
+                if (!core.isInCheckpointZone(syncBlock.cachedBlock->getBlockIndex()))
+                {
+                    syncBlock.cachedBlock->getBlockLongHash();
+
+                    if (syncBlock.blockTemplate->majorVersion >= BLOCK_MAJOR_VERSION_2)
+                    {
+                        syncBlock.cachedBlock->getAuxiliaryBlockHeaderHash();
+                    }
+                }
+
+                syncBlock.transactions.reserve(rawBlock.transactions.size());
+
+                for (const auto &rawTransaction : rawBlock.transactions)
+                {
+                    syncBlock.transactions.emplace_back(rawTransaction);
+                    syncBlock.transactions.back().getTransactionHash();
+                    syncBlock.transactions.back().getTransactionPrefixHash();
+                }
+
+                syncBlock.transactionsPrepared = true;
+            }
+            catch (const std::exception &)
+            {
+                /* A block we can't even hash is garbage. Bad transactions are
+                   left for the core to reject as usual. */
+                if (!syncBlock.cachedBlock)
+                {
+                    return false;
+                }
+
+                syncBlock.transactions.clear();
+            }
+
+            syncBlock.rawBlock = std::move(rawBlock);
+
+            return true;
+        }
+
     }
 
     // unpack to strings to maintain protocol compatibility with older versions
@@ -172,6 +256,8 @@ namespace cryptonote
                                                                                                                                                                                                     m_observedHeight(0),
                                                                                                                                                                                                     m_blockchainHeight(0),
                                                                                                                                                                                                     m_peersCount(0),
+                                                                                                                                                                                                    m_syncQueue(BLOCKS_SYNCHRONIZING_MAX_QUEUED_COUNT),
+                                                                                                                                                                                                    m_processingSyncQueue(false),
                                                                                                                                                                                                     logger(log, "protocol")
     {
 
@@ -222,6 +308,21 @@ namespace cryptonote
             m_peersCount--;
             m_observerManager.notify(&ICryptoNoteProtocolObserver::peerCountUpdated, m_peersCount.load());
         }
+
+        if (!context.m_requested_objects.empty())
+        {
+            /* Let the other peers pick up the blocks we were waiting on. Make
+               sure we don't hand any more to this one while doing so. */
+            m_syncQueue.cancelRequests(context.m_connection_id);
+            context.m_requested_objects.clear();
+            context.m_needed_objects.clear();
+            context.m_state = CryptoNoteConnectionContext::state_shutdown;
+
+            if (!m_stop)
+            {
+                requestMissingObjectsFromIdlePeers();
+            }
+        }
     }
 
     void CryptoNoteProtocolHandler::stop()
@@ -283,6 +384,12 @@ namespace cryptonote
 
         if (context.m_state == CryptoNoteConnectionContext::state_synchronizing)
         {
+            /* Timed syncs come in even when no blocks do, so a peer sitting
+               on our requests can't stall the sync */
+            if (dropSlowPeers() && !m_stop)
+            {
+                requestMissingObjectsFromIdlePeers();
+            }
         }
         else if (m_core.hasBlock(hshd.top_id))
         {
@@ -487,21 +594,31 @@ namespace cryptonote
         }
         else
         {
-            const auto it = std::remove_if(arg.txs.begin(), arg.txs.end(), [this, &context](const auto &tx)
-                                           {
-            bool failed = !this->m_core.addTransactionToPool(tx);
+            /* The signatures of the whole batch are checked on the worker
+               threads, the dispatcher isn't held up in the meantime */
+            const std::vector<bool> added = m_core.addTransactionsToPool(arg.txs);
 
-             if (failed)
-             {
-                 this->logger(logging::DEBUGGING) << context << "Tx verification failed";
-             }
+            if (m_stop)
+            {
+                return 1;
+            }
 
-            return failed; });
-            if (it != arg.txs.end())
+            std::vector<BinaryArray> relayed;
+
+            for (size_t i = 0; i < arg.txs.size(); i++)
             {
-                arg.txs.erase(it, arg.txs.end());
+                if (added[i])
+                {
+                    relayed.push_back(std::move(arg.txs[i]));
+                }
+                else
+                {
+                    logger(logging::DEBUGGING) << context << "Tx verification failed";
+                }
             }
 
+            arg.txs = std::move(relayed);
+
             if (arg.txs.size() > 0)
             {
                 // TODO: add announce usage here
@@ -549,124 +666,262 @@ namespace cryptonote
             return 1;
         }
 
+        if (context.m_requested_objects.empty())
+        {
+            logger(logging::ERROR) << context << "sent NOTIFY_RESPONSE_GET_OBJECTS without being asked for any blocks, dropping connection";
+            context.m_state = CryptoNoteConnectionContext::state_shutdown;
+            return 1;
+        }
+
         updateObservedHeight(arg.current_blockchain_height, context);
         context.m_remote_blockchain_height = arg.current_blockchain_height;
-        std::vector<BlockTemplate> blockTemplates;
-        std::vector<CachedBlock> cachedBlocks;
-        blockTemplates.resize(arg.blocks.size());
-        cachedBlocks.reserve(arg.blocks.size());
+
+        /* Don't waste time hashing blocks we can already tell are wrong */
+        if (arg.blocks.size() != context.m_requested_objects.front().size())
+        {
+            logger(logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: blocks.size()=" << arg.blocks.size()
+                                   << ", requested " << context.m_requested_objects.front().size() << ", dropping connection";
+            context.m_state = CryptoNoteConnectionContext::state_shutdown;
+            return 1;
+        }
 
         std::vector<RawBlock> rawBlocks = convertRawBlocksLegacyToRawBlocks(arg.blocks);
+        std::vector<SyncBlock> syncBlocks(rawBlocks.size());
+        std::vector<size_t> transactionCounts;
+        transactionCounts.reserve(rawBlocks.size());
 
-        for (size_t index = 0; index < rawBlocks.size(); ++index)
+        for (const auto &rawBlock : rawBlocks)
         {
-            if (!fromBinaryArray(blockTemplates[index], rawBlocks[index].block))
+            transactionCounts.push_back(rawBlock.transactions.size());
+        }
+
+        /* The limit only grows with height, so the limit at the furthest
+           block we could have queued holds for all of them */
+        const size_t maxBlockSize = m_currency.maxBlockCumulativeSize(m_core.getTopBlockIndex() + BLOCKS_SYNCHRONIZING_MAX_QUEUED_COUNT);
+        const size_t maxTransactionSize = m_currency.maxTxSize();
+
+        ThreadPool &threadPool = m_core.getThreadPool();
+
+        /* Parse and hash the blocks on the core's worker threads. The
+           dispatcher carries on serving the other connections in the
+           meantime. */
+        syst::RemoteContext<size_t> prepareContext(m_dispatcher, [&]()
+        {
+            std::vector<std::future<bool>> prepared;
+            prepared.reserve(rawBlocks.size());
+
+            for (size_t index = 0; index < rawBlocks.size(); ++index)
             {
-                logger(logging::ERROR) << context << "sent wrong block: failed to parse and validate block: \r\n"
-                                       << toHex(rawBlocks[index].block) << "\r\n dropping connection";
-                context.m_state = CryptoNoteConnectionContext::state_shutdown;
-                return 1;
+                prepared.push_back(threadPool.addJob([&, index]()
+                {
+                    return prepareSyncBlock(std::move(rawBlocks[index]), m_core, maxBlockSize, maxTransactionSize, syncBlocks[index]);
+                }));
             }
 
-            cachedBlocks.emplace_back(blockTemplates[index]);
-            if (index == 1)
+            size_t firstFailure = rawBlocks.size();
+
+            for (size_t index = 0; index < prepared.size(); ++index)
             {
-                if (m_core.hasBlock(cachedBlocks.back().getBlockHash()))
-                { // TODO
-                    context.m_state = CryptoNoteConnectionContext::state_idle;
-                    context.m_needed_objects.clear();
-                    context.m_requested_objects.clear();
-                    logger(logging::DEBUGGING) << context << "Connection set to idle state.";
-                    return 1;
+                if (!prepared[index].get() && firstFailure == rawBlocks.size())
+                {
+                    firstFailure = index;
                 }
             }
 
-            auto req_it = context.m_requested_objects.find(cachedBlocks.back().getBlockHash());
-            if (req_it == context.m_requested_objects.end())
+            return firstFailure;
+        });
+
+        const size_t firstFailure = prepareContext.get();
+
+        /* The connection may have been dropped, or we may be stopping, while
+           we were waiting */
+        if (m_stop || context.m_state == CryptoNoteConnectionContext::state_shutdown || context.m_requested_objects.empty())
+        {
+            return 1;
+        }
+
+        if (firstFailure != rawBlocks.size())
+        {
+            logger(logging::ERROR) << context << "sent wrong block: failed to parse and validate block: \r\n"
+                                   << toHex(arg.blocks[firstFailure].blockTemplate) << "\r\n dropping connection";
+            context.m_state = CryptoNoteConnectionContext::state_shutdown;
+            return 1;
+        }
+
+        /* Peers answer requests in the order they were sent */
+        auto &requested = context.m_requested_objects.front();
+
+        for (size_t index = 0; index < syncBlocks.size(); ++index)
+        {
+            SyncBlock &syncBlock = syncBlocks[index];
+
+            auto req_it = requested.find(syncBlock.blockHash);
+            if (req_it == requested.end())
             {
-                logger(logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << common::podToHex(cachedBlocks.back().getBlockHash())
+                logger(logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << common::podToHex(syncBlock.blockHash)
                                        << " wasn't requested, dropping connection";
                 context.m_state = CryptoNoteConnectionContext::state_shutdown;
                 return 1;
             }
 
-            if (cachedBlocks.back().getBlock().transactionHashes.size() != rawBlocks[index].transactions.size())
+            if (syncBlock.blockTemplate->transactionHashes.size() != transactionCounts[index])
             {
                 logger(logging::ERROR) << context
-                                       << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << common::podToHex(cachedBlocks.back().getBlockHash())
-                                       << ", transactionHashes.size()=" << cachedBlocks.back().getBlock().transactionHashes.size()
-                                       << " mismatch with block_complete_entry.m_txs.size()=" << rawBlocks[index].transactions.size()
+                                       << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << common::podToHex(syncBlock.blockHash)
+                                       << ", transactionHashes.size()=" << syncBlock.blockTemplate->transactionHashes.size()
+                                       << " mismatch with block_complete_entry.m_txs.size()=" << transactionCounts[index]
                                        << ", dropping connection";
                 context.m_state = CryptoNoteConnectionContext::state_shutdown;
                 return 1;
             }
 
-            context.m_requested_objects.erase(req_it);
+            requested.erase(req_it);
+
+            syncBlock.peer = context.m_connection_id;
         }
 
-        if (context.m_requested_objects.size())
+        if (requested.size())
         {
-            logger(logging::ERROR, logging::BRIGHT_RED) << context << "returned not all requested objects (context.m_requested_objects.size()="
-                                                        << context.m_requested_objects.size() << "), dropping connection";
+            logger(logging::ERROR, logging::BRIGHT_RED) << context << "returned not all requested objects (requested.size()="
+                                                        << requested.size() << "), dropping connection";
             context.m_state = CryptoNoteConnectionContext::state_shutdown;
             return 1;
         }
 
+        context.m_requested_objects.pop_front();
+
+        for (auto &syncBlock : syncBlocks)
         {
-            int result = processObjects(context, std::move(rawBlocks), cachedBlocks);
-            if (result != 0)
-            {
-                return result;
-            }
+            m_syncQueue.push(std::move(syncBlock));
         }
 
-        logger(DEBUGGING, BRIGHT_YELLOW) << "Local blockchain updated, new index = " << m_core.getTopBlockIndex();
+        /* Keep this peer busy before we go off and validate blocks, so the
+           next blocks are downloading while we do */
         if (!m_stop && context.m_state == CryptoNoteConnectionContext::state_synchronizing)
         {
             request_missing_objects(context, true);
         }
 
+        processSyncQueue();
+
+        logger(DEBUGGING, BRIGHT_YELLOW) << "Local blockchain updated, new index = " << m_core.getTopBlockIndex();
+
         return 1;
     }
 
-    int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext &context, std::vector<RawBlock> &&rawBlocks, const std::vector<CachedBlock> &cachedBlocks)
+    void CryptoNoteProtocolHandler::processSyncQueue()
     {
-        assert(rawBlocks.size() == cachedBlocks.size());
-        for (size_t index = 0; index < rawBlocks.size(); ++index)
+        /* Another connection is already adding blocks, and will pick up any
+           we just queued once it gets to them */
+        if (m_processingSyncQueue)
         {
-            if (m_stop)
-            {
-                break;
-            }
+            return;
+        }
+
+        m_processingSyncQueue = true;
 
-            auto addResult = m_core.addBlock(cachedBlocks[index], std::move(rawBlocks[index]));
+        tools::ScopeExit processingDone([this]()
+                                        { m_processingSyncQueue = false; });
+
+        SyncBlock block;
+
+        const auto haveBlock = [this](const crypto::Hash &hash)
+        {
+            return m_core.hasBlock(hash);
+        };
+
+        while (!m_stop && m_syncQueue.pop(m_core.getTopBlockHash(), haveBlock, block))
+        {
+            auto addResult = block.transactionsPrepared
+                                 ? m_core.addBlock(*block.cachedBlock, std::move(block.rawBlock), std::move(block.transactions))
+                                 : m_core.addBlock(*block.cachedBlock, std::move(block.rawBlock));
             if (addResult == error::AddBlockErrorCondition::BLOCK_VALIDATION_FAILED ||
                 addResult == error::AddBlockErrorCondition::TRANSACTION_VALIDATION_FAILED ||
                 addResult == error::AddBlockErrorCondition::DESERIALIZATION_FAILED)
             {
-                logger(logging::DEBUGGING) << context << "Block verification failed, dropping connection: " << addResult.message();
-                context.m_state = CryptoNoteConnectionContext::state_shutdown;
-                return 1;
+                logger(logging::DEBUGGING) << "Block " << block.blockHash << " verification failed, dropping connection: " << addResult.message();
+                m_syncQueue.removePeerBlocks(block.peer);
+                dropConnection(block.peer);
             }
             else if (addResult == error::AddBlockErrorCondition::BLOCK_REJECTED)
             {
-                logger(logging::INFO) << context << "Block received at sync phase was marked as orphaned, dropping connection: " << addResult.message();
-                context.m_state = CryptoNoteConnectionContext::state_shutdown;
-                return 1;
+                logger(logging::INFO) << "Block " << block.blockHash << " received at sync phase was marked as orphaned, dropping connection: " << addResult.message();
+                m_syncQueue.removePeerBlocks(block.peer);
+                dropConnection(block.peer);
             }
             else if (addResult == error::AddBlockErrorCode::ALREADY_EXISTS)
             {
-                logger(logging::DEBUGGING) << context << "Block already exists, switching to idle state: " << addResult.message();
-                context.m_state = CryptoNoteConnectionContext::state_idle;
-                context.m_needed_objects.clear();
-                context.m_requested_objects.clear();
-                return 1;
+                logger(logging::DEBUGGING) << "Block " << block.blockHash << " already exists: " << addResult.message();
             }
 
+            /* Let the other connections receive blocks and send requests
+               while we validate */
             m_dispatcher.yield();
         }
 
-        return 0;
+        /* Nothing can be added, nothing is coming, and there's no room to ask
+           for anything else - whatever we have doesn't connect to our chain */
+        if (m_syncQueue.isFull() && m_syncQueue.requestedCount() == 0)
+        {
+            logger(logging::DEBUGGING) << "Dropping " << m_syncQueue.queuedCount() << " downloaded blocks which don't connect to our chain";
+            m_syncQueue.clearBlocks();
+        }
+
+        if (!m_stop)
+        {
+            requestMissingObjectsFromIdlePeers();
+        }
+    }
+
+    void CryptoNoteProtocolHandler::requestMissingObjectsFromIdlePeers()
+    {
+        /* Peers with nothing in flight may have been waiting on blocks another
+           peer was downloading, for space in the queue, or for the queue to
+           empty before they can finish syncing. Peers with no block ids left
+           which aren't done have asked for more ids, and will carry on when
+           those come in. */
+        m_p2p->for_each_connection([this](CryptoNoteConnectionContext &context, uint64_t peerId)
+        {
+            if (context.m_state != CryptoNoteConnectionContext::state_synchronizing || !context.m_requested_objects.empty())
+            {
+                return;
+            }
+
+            if (!context.m_needed_objects.empty() || context.m_last_response_height >= context.m_remote_blockchain_height - 1)
+            {
+                request_missing_objects(context, true);
+            }
+        });
+    }
+
+    void CryptoNoteProtocolHandler::dropConnection(const boost::uuids::uuid &connectionId)
+    {
+        /* The connection only closes later on, let the other peers pick up
+           the blocks we were waiting on from it straight away */
+        m_syncQueue.cancelRequests(connectionId);
+
+        m_p2p->for_each_connection([&connectionId](CryptoNoteConnectionContext &context, uint64_t peerId)
+        {
+            if (context.m_connection_id == connectionId)
+            {
+                context.m_requested_objects.clear();
+                context.m_needed_objects.clear();
+                context.m_state = CryptoNoteConnectionContext::state_shutdown;
+            }
+        });
+    }
+
+    bool CryptoNoteProtocolHandler::dropSlowPeers()
+    {
+        const auto slowPeers = m_syncQueue.expiredPeers(std::chrono::seconds(BLOCKS_SYNCHRONIZING_REQUEST_TIMEOUT));
+
+        for (const auto &peer : slowPeers)
+        {
+            logger(logging::DEBUGGING) << "Peer " << peer << " didn't send the blocks we requested in time, dropping connection";
+            dropConnection(peer);
+        }
+
+        return !slowPeers.empty();
     }
 
     int CryptoNoteProtocolHandler::doPushLiteBlock(NOTIFY_NEW_LITE_BLOCK::request arg, CryptoNoteConnectionContext &context, std::vector<BinaryArray> missingTxs)
@@ -840,25 +1095,58 @@ namespace cryptonote
 
     bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionContext &context, bool check_having_blocks)
     {
-        if (context.m_needed_objects.size())
+        /* Hand out the blocks slow peers are sitting on first, this
+           connection may be able to pick them up */
+        dropSlowPeers();
+
+        if (context.m_state == CryptoNoteConnectionContext::state_shutdown)
         {
-            // we know objects that we need, request this objects
-            NOTIFY_REQUEST_GET_OBJECTS::request req;
-            size_t count = 0;
-            auto it = context.m_needed_objects.begin();
+            return true;
+        }
 
-            while (it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+        if (context.m_needed_objects.size())
+        {
+            // we know objects that we need, request them, skipping any another peer is already sending us
+            while (context.m_requested_objects.size() < BLOCKS_SYNCHRONIZING_MAX_REQUESTS_PER_PEER && !m_syncQueue.isFull())
             {
-                if (!(check_having_blocks && m_core.hasBlock(*it)))
+                NOTIFY_REQUEST_GET_OBJECTS::request req;
+                std::unordered_set<crypto::Hash> requested;
+                auto it = context.m_needed_objects.begin();
+
+                while (it != context.m_needed_objects.end() && requested.size() < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
                 {
-                    req.blocks.push_back(*it);
-                    ++count;
-                    context.m_requested_objects.insert(*it);
+                    if (check_having_blocks && m_core.hasBlock(*it))
+                    {
+                        it = context.m_needed_objects.erase(it);
+                    }
+                    else if (!m_syncQueue.shouldRequest(*it))
+                    {
+                        // keep it, in case the other peer drops out
+                        ++it;
+                    }
+                    else
+                    {
+                        req.blocks.push_back(*it);
+                        requested.insert(*it);
+                        m_syncQueue.markRequested(*it, context.m_connection_id);
+                        it = context.m_needed_objects.erase(it);
+                    }
                 }
-                it = context.m_needed_objects.erase(it);
+
+                if (req.blocks.empty())
+                {
+                    break;
+                }
+
+                context.m_requested_objects.push_back(std::move(requested));
+
+                logger(logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
+                post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
             }
-            logger(logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
-            post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
+        }
+        else if (context.m_requested_objects.size())
+        {
+            // wait for the blocks we've asked for before asking for more ids
         }
         else if (context.m_last_response_height < context.m_remote_blockchain_height - 1)
         { // we have to fetch more objects ids, request blockchain entry
@@ -870,6 +1158,12 @@ namespace cryptonote
         }
         else
         {
+            if (m_syncQueue.requestedCount() || m_syncQueue.queuedCount())
+            {
+                // other peers are still sending us blocks, we're not synced until they're added
+                return true;
+            }
+
             if (!(context.m_last_response_height ==
                       context.m_remote_blockchain_height - 1 &&
                   !context.m_needed_objects.size() &&
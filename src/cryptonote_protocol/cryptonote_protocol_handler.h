@@ -13,6 +13,7 @@
 
 #include "cryptonote_core/icore.h"
 
+#include "cryptonote_protocol/block_sync_queue.h"
 #include "cryptonote_protocol/cryptonote_protocol_definitions.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler_common.h"
 #include "cryptonote_protocol/icryptonote_protocol_observer.h"
@@ -82,7 +83,10 @@ namespace cryptonote
         bool on_connection_synchronized();
         void updateObservedHeight(uint32_t peerHeight, const CryptoNoteConnectionContext &context);
         void recalculateMaxObservedHeight(const CryptoNoteConnectionContext &context);
-        int processObjects(CryptoNoteConnectionContext &context, std::vector<RawBlock> &&rawBlocks, const std::vector<CachedBlock> &cachedBlocks);
+        void processSyncQueue();
+        void requestMissingObjectsFromIdlePeers();
+        void dropConnection(const boost::uuids::uuid &connectionId);
+        bool dropSlowPeers();
         logging::LoggerRef logger;
 
     private:
@@ -105,6 +109,12 @@ namespace cryptonote
         uint32_t m_blockchainHeight;
 
         std::atomic<size_t> m_peersCount;
+
+        /* Blocks being downloaded from, or downloaded from, synchronizing peers */
+        BlockSyncQueue m_syncQueue;
+        /* Whether a connection is currently adding blocks from m_syncQueue */
+        bool m_processingSyncQueue;
+
         tools::ObserverManager<ICryptoNoteProtocolObserver> m_observerManager;
     };
 }
@@ -326,7 +326,8 @@ int main(int argc, char *argv[])
             std::move(checkpoints),
             dispatcher,
             std::unique_ptr<IBlockchainCacheFactory>(new DatabaseBlockchainCacheFactory(database, logger.getLogger())),
-            createSwappedMainChainStorage(config.dataDirectory, currency));
+            createSwappedMainChainStorage(config.dataDirectory, currency),
+            config.transactionValidationThreads);
 
         ccore.load();
         logger(INFO) << "Core initialized OK";
@@ -356,6 +357,7 @@ int main(int argc, char *argv[])
         rpcServer.setFeeAddress(config.feeAddress);
         rpcServer.setFeeAmount(config.feeAmount);
         rpcServer.enableCors(config.enableCors);
+        rpcServer.setWorkerThreads(config.rpcWorkerThreads);
         rpcServer.start(config.rpcInterface, config.rpcPort);
         logger(INFO) << "Core rpc server started ok";
 
@@ -31,7 +31,7 @@ namespace DaemonConfig
     {
         cxxopts::Options options(argv[0], cryptonote::getProjectCLIHeader());
 
-        options.add_options("Core")("help", "Display this help message", cxxopts::value<bool>()->implicit_value("true"))("os-version", "Output Operating System version information", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))("version", "Output daemon version information", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))("rewind", "Rewinds the local blockchain cache to the specified height. 0 = Normal Operation", cxxopts::value<uint32_t>()->default_value(std::to_string(config.rewindToHeight)), "#");
+        options.add_options("Core")("help", "Display this help message", cxxopts::value<bool>()->implicit_value("true"))("os-version", "Output Operating System version information", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))("version", "Output daemon version information", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))("rewind", "Rewinds the local blockchain cache to the specified height. 0 = Normal Operation", cxxopts::value<uint32_t>()->default_value(std::to_string(config.rewindToHeight)), "#")("transaction-validation-threads", "Number of threads used to check transaction signatures", cxxopts::value<uint32_t>()->default_value(std::to_string(config.transactionValidationThreads)), "#");
 
         options.add_options("Genesis Block")("genesis-block-reward-address", "Specify the address for any premine genesis block rewards", cxxopts::value<std::vector<std::string>>(), "<address>")("print-genesis-tx", "Print the genesis block transaction hex and exits", cxxopts::value<bool>()->default_value("false")->implicit_value("true"));
 
@@ -39,7 +39,7 @@ namespace DaemonConfig
                                                                                                                                                                                                                                                                                                                                                                                                                                         cxxopts::value<std::string>()->default_value(config.checkPoints), "<path>")("log-file", "Specify the <path> to the log file", cxxopts::value<std::string>()->default_value(config.logFile), "<path>")("log-level", "Specify log level", cxxopts::value<int>()->default_value(std::to_string(config.logLevel)), "#")("no-console", "Disable daemon console commands", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))("save-config", "Save the configuration to the specified <file>", cxxopts::value<std::string>(), "<file>");
 
         options.add_options("RPC")("enable-blockexplorer", "Enable the Blockchain Explorer RPC", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))("enable-cors", "Adds header 'Access-Control-Allow-Origin' to the RPC responses using the <domain>. Uses the value specified as the domain. Use * for all.",
-                                                                                                                                                                         cxxopts::value<std::vector<std::string>>(), "<domain>")("fee-address", "Sets the convenience charge <address> for light wallets that use the daemon", cxxopts::value<std::string>(), "<address>")("fee-amount", "Sets the convenience charge amount for light wallets that use the daemon", cxxopts::value<int>()->default_value("0"), "#");
+                                                                                                                                                                         cxxopts::value<std::vector<std::string>>(), "<domain>")("fee-address", "Sets the convenience charge <address> for light wallets that use the daemon", cxxopts::value<std::string>(), "<address>")("fee-amount", "Sets the convenience charge amount for light wallets that use the daemon", cxxopts::value<int>()->default_value("0"), "#")("rpc-worker-threads", "Number of threads used to answer RPC requests which only read the blockchain. 0 = answer them all on the main thread", cxxopts::value<uint32_t>()->default_value(std::to_string(config.rpcWorkerThreads)), "#");
 
         options.add_options("Network")("allow-local-ip", "Allow the local IP to be added to the peer list", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))("hide-my-port", "Do not announce yourself as a peerlist candidate", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))("p2p-bind-ip", "Interface IP address for the P2P service", cxxopts::value<std::string>()->default_value(config.p2pInterface), "<ip>")("p2p-bind-port", "TCP port for the P2P service", cxxopts::value<int>()->default_value(std::to_string(config.p2pPort)), "#")("p2p-external-port", "External TCP port for the P2P service (NAT port forward)", cxxopts::value<int>()->default_value("0"), "#")("rpc-bind-ip", "Interface IP address for the RPC service", cxxopts::value<std::string>()->default_value(config.rpcInterface), "<ip>")("rpc-bind-port", "TCP port for the RPC service", cxxopts::value<int>()->default_value(std::to_string(config.rpcPort)), "#");
 
@@ -86,6 +86,11 @@ namespace DaemonConfig
                 config.rewindToHeight = cli["rewind"].as<uint32_t>();
             }
 
+            if (cli.count("transaction-validation-threads") > 0)
+            {
+                config.transactionValidationThreads = cli["transaction-validation-threads"].as<uint32_t>();
+            }
+
             if (cli.count("print-genesis-tx") > 0)
             {
                 config.printGenesisTx = cli["print-genesis-tx"].as<bool>();
@@ -176,6 +181,11 @@ namespace DaemonConfig
                 config.rpcPort = cli["rpc-bind-port"].as<int>();
             }
 
+            if (cli.count("rpc-worker-threads") > 0)
+            {
+                config.rpcWorkerThreads = cli["rpc-worker-threads"].as<uint32_t>();
+            }
+
             if (cli.count("add-exclusive-node") > 0)
             {
                 config.exclusiveNodes = cli["add-exclusive-node"].as<std::vector<std::string>>();
@@ -359,6 +369,18 @@ namespace DaemonConfig
                         throw std::runtime_error(std::string(e.what()) + " - Invalid value for " + cfgKey);
                     }
                 }
+                else if (cfgKey.compare("transaction-validation-threads") == 0)
+                {
+                    try
+                    {
+                        config.transactionValidationThreads = std::stoi(cfgValue);
+                        updated = true;
+                    }
+                    catch (std::exception &e)
+                    {
+                        throw std::runtime_error(std::string(e.what()) + " - Invalid value for " + cfgKey);
+                    }
+                }
                 else if (cfgKey.compare("allow-local-ip") == 0)
                 {
                     config.localIp = cfgValue.at(0) == '1' ? true : false;
@@ -415,6 +437,18 @@ namespace DaemonConfig
                         throw std::runtime_error(std::string(e.what()) + " - Invalid value for " + cfgKey);
                     }
                 }
+                else if (cfgKey.compare("rpc-worker-threads") == 0)
+                {
+                    try
+                    {
+                        config.rpcWorkerThreads = std::stoi(cfgValue);
+                        updated = true;
+                    }
+                    catch (std::exception &e)
+                    {
+                        throw std::runtime_error(std::string(e.what()) + " - Invalid value for " + cfgKey);
+                    }
+                }
                 else if (cfgKey.compare("add-exclusive-node") == 0)
                 {
 
@@ -557,6 +591,11 @@ namespace DaemonConfig
             config.dbWriteBufferSizeMB = j["db-write-buffer-size"].get<int>();
         }
 
+        if (j.find("transaction-validation-threads") != j.end())
+        {
+            config.transactionValidationThreads = j["transaction-validation-threads"].get<uint32_t>();
+        }
+
         if (j.find("allow-local-ip") != j.end())
         {
             config.localIp = j["allow-local-ip"].get<bool>();
@@ -592,6 +631,11 @@ namespace DaemonConfig
             config.rpcPort = j["rpc-bind-port"].get<int>();
         }
 
+        if (j.find("rpc-worker-threads") != j.end())
+        {
+            config.rpcWorkerThreads = j["rpc-worker-threads"].get<uint32_t>();
+        }
+
         if (j.find("add-exclusive-node") != j.end())
         {
             config.exclusiveNodes = j["add-exclusive-node"].get<std::vector<std::string>>();
@@ -645,6 +689,7 @@ namespace DaemonConfig
             {"db-read-buffer-size", (config.dbReadCacheSizeMB)},
             {"db-threads", config.dbThreads},
             {"db-write-buffer-size", (config.dbWriteBufferSizeMB)},
+            {"transaction-validation-threads", config.transactionValidationThreads},
             {"allow-local-ip", config.localIp},
             {"hide-my-port", config.hideMyPort},
             {"p2p-bind-ip", config.p2pInterface},
@@ -652,6 +697,7 @@ namespace DaemonConfig
             {"p2p-external-port", config.p2pExternalPort},
             {"rpc-bind-ip", config.rpcInterface},
             {"rpc-bind-port", config.rpcPort},
+            {"rpc-worker-threads", config.rpcWorkerThreads},
             {"add-exclusive-node", config.exclusiveNodes},
             {"add-peer", config.peers},
             {"add-priority-node", config.priorityNodes},
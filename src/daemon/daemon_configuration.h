@@ -6,6 +6,7 @@
 #pragma once
 
 #include <json.hpp>
+#include <thread>
 #include <config/cryptonote_config.h>
 #include <logging/ilogger.h>
 #include "common/path_tools.h"
@@ -31,11 +32,13 @@ namespace DaemonConfig
             dbThreads = cryptonote::DATABASE_DEFAULT_BACKGROUND_THREADS_COUNT;
             dbWriteBufferSizeMB = cryptonote::DATABASE_WRITE_BUFFER_MB_DEFAULT_SIZE;
             rewindToHeight = 0;
+            transactionValidationThreads = std::thread::hardware_concurrency();
             p2pInterface = "0.0.0.0";
             p2pPort = cryptonote::P2P_DEFAULT_PORT;
             p2pExternalPort = 0;
             rpcInterface = "127.0.0.1";
             rpcPort = cryptonote::RPC_DEFAULT_PORT;
+            rpcWorkerThreads = 2;
             noConsole = false;
             enableBlockExplorer = false;
             localIp = false;
@@ -70,6 +73,8 @@ namespace DaemonConfig
         int dbWriteBufferSizeMB;
         int dbReadCacheSizeMB;
         uint32_t rewindToHeight;
+        uint32_t transactionValidationThreads;
+        uint32_t rpcWorkerThreads;
         bool noConsole;
         bool enableBlockExplorer;
         bool localIp;
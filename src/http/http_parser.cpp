@@ -8,12 +8,75 @@
 #include "http_parser.h"
 
 #include <algorithm>
+#include <cctype>
 
 #include "http_parser_error_codes.h"
 
 namespace
 {
 
+    /* Generous for a request to a JSON API - anything bigger is not one */
+    const size_t MAX_HEADERS_SIZE = 64 * 1024;
+
+    /* Room for the largest block or transaction, hex encoded, in JSON */
+    const size_t MAX_BODY_SIZE = 16 * 1024 * 1024;
+
+    /* Takes the next CRLF terminated line off the front of lines */
+    std::string_view nextLine(std::string_view &lines)
+    {
+        const size_t end = lines.find("\r\n");
+
+        const std::string_view line = lines.substr(0, end);
+
+        lines.remove_prefix(end == std::string_view::npos ? lines.size() : end + 2);
+
+        return line;
+    }
+
+    std::string_view trim(std::string_view value)
+    {
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+        {
+            value.remove_prefix(1);
+        }
+
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+        {
+            value.remove_suffix(1);
+        }
+
+        return value;
+    }
+
+    bool equalsIgnoringCase(std::string_view value, std::string_view expected)
+    {
+        return value.size() == expected.size()
+            && std::equal(value.begin(), value.end(), expected.begin(), [](char a, char b)
+                          { return ::tolower(a) == ::tolower(b); });
+    }
+
+    size_t parseLength(std::string_view value)
+    {
+        if (value.empty() || value.size() > 18)
+        {
+            throw std::system_error(make_error_code(cryptonote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+        }
+
+        size_t length = 0;
+
+        for (const char c : value)
+        {
+            if (c < '0' || c > '9')
+            {
+                throw std::system_error(make_error_code(cryptonote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+            }
+
+            length = length * 10 + (c - '0');
+        }
+
+        return length;
+    }
+
     void throwIfNotGood(std::istream &stream)
     {
         if (!stream.good())
@@ -40,6 +103,8 @@ namespace cryptonote
             return cryptonote::HttpResponse::STATUS_200;
         else if (status == "404 Not Found")
             return cryptonote::HttpResponse::STATUS_404;
+        else if (status == "413 Payload Too Large")
+            return cryptonote::HttpResponse::STATUS_413;
         else if (status == "500 Internal Server Error")
             return cryptonote::HttpResponse::STATUS_500;
         else
@@ -49,22 +114,98 @@ namespace cryptonote
         return cryptonote::HttpResponse::STATUS_200; // unaccessible
     }
 
-    void HttpParser::receiveRequest(std::istream &stream, HttpRequest &request)
+    size_t HttpParser::parseRequest(std::string_view data, HttpRequest &request)
     {
-        readWord(stream, request.method);
-        readWord(stream, request.url);
+        const size_t headersEnd = data.find("\r\n\r\n");
 
-        std::string httpVersion;
-        readWord(stream, httpVersion);
+        if (headersEnd == std::string_view::npos)
+        {
+            if (data.size() > MAX_HEADERS_SIZE)
+            {
+                throw std::system_error(make_error_code(cryptonote::error::HttpParserErrorCodes::HEADERS_TOO_LARGE));
+            }
 
-        readHeaders(stream, request.headers);
+            return 0;
+        }
 
-        std::string body;
-        size_t bodyLen = getBodyLen(request.headers);
-        if (bodyLen)
+        /* Request line, then one header per line */
+        std::string_view lines = data.substr(0, headersEnd + 2);
+
+        const std::string_view requestLine = nextLine(lines);
+
+        const size_t methodEnd = requestLine.find(' ');
+        const size_t urlEnd = requestLine.find(' ', methodEnd + 1);
+
+        if (methodEnd == 0 || methodEnd == std::string_view::npos || urlEnd == std::string_view::npos || urlEnd == methodEnd + 1)
+        {
+            throw std::system_error(make_error_code(cryptonote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+        }
+
+        const std::string_view method = requestLine.substr(0, methodEnd);
+        const std::string_view url = requestLine.substr(methodEnd + 1, urlEnd - methodEnd - 1);
+        const std::string_view version = requestLine.substr(urlEnd + 1);
+
+        /* Keep alive is the default from 1.1 on, 1.0 has to ask for it */
+        bool keepAlive = version != "HTTP/1.0";
+        size_t bodyLength = 0;
+
+        HttpRequest::Headers headers;
+
+        while (!lines.empty())
         {
-            readBody(stream, request.body, bodyLen);
+            const std::string_view line = nextLine(lines);
+
+            const size_t colon = line.find(':');
+
+            if (colon == 0 || colon == std::string_view::npos)
+            {
+                throw std::system_error(make_error_code(cryptonote::error::HttpParserErrorCodes::EMPTY_HEADER));
+            }
+
+            std::string name(line.substr(0, colon));
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+            const std::string_view value = trim(line.substr(colon + 1));
+
+            if (name == "content-length")
+            {
+                bodyLength = parseLength(value);
+
+                /* Don't wait for the body to arrive before turning it down */
+                if (bodyLength > MAX_BODY_SIZE)
+                {
+                    throw std::system_error(make_error_code(cryptonote::error::HttpParserErrorCodes::BODY_TOO_LARGE));
+                }
+            }
+            else if (name == "connection")
+            {
+                if (equalsIgnoringCase(value, "close"))
+                {
+                    keepAlive = false;
+                }
+                else if (equalsIgnoringCase(value, "keep-alive"))
+                {
+                    keepAlive = true;
+                }
+            }
+
+            headers[std::move(name)] = std::string(value);
         }
+
+        const size_t bodyStart = headersEnd + 4;
+
+        if (data.size() - bodyStart < bodyLength)
+        {
+            return 0;
+        }
+
+        request.method.assign(method.data(), method.size());
+        request.url.assign(url.data(), url.size());
+        request.headers = std::move(headers);
+        request.body.assign(data.data() + bodyStart, bodyLength);
+        request.keepAlive = keepAlive;
+
+        return bodyStart + bodyLength;
     }
 
     void HttpParser::receiveResponse(std::istream &stream, HttpResponse &response)
@@ -146,21 +287,6 @@ namespace cryptonote
         }
     }
 
-    void HttpParser::readHeaders(std::istream &stream, HttpRequest::Headers &headers)
-    {
-        std::string name;
-        std::string value;
-
-        while (readHeader(stream, name, value))
-        {
-            headers[name] = value; // use insert
-            name.clear();
-            value.clear();
-        }
-
-        headers[name] = value; // use insert
-    }
-
     bool HttpParser::readHeader(std::istream &stream, std::string &name, std::string &value)
     {
         char c;
@@ -226,18 +352,6 @@ namespace cryptonote
         return true;
     }
 
-    size_t HttpParser::getBodyLen(const HttpRequest::Headers &headers)
-    {
-        auto it = headers.find("content-length");
-        if (it != headers.end())
-        {
-            size_t bytes = std::stoul(it->second);
-            return bytes;
-        }
-
-        return 0;
-    }
-
     void HttpParser::readBody(std::istream &stream, std::string &body, const size_t bodyLen)
     {
         size_t read = 0;
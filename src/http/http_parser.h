@@ -11,27 +11,36 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
 #include "http_request.h"
 #include "http_response.h"
 
 namespace cryptonote
 {
 
-    // Blocking HttpParser
     class HttpParser
     {
     public:
         HttpParser(){};
 
-        void receiveRequest(std::istream &stream, HttpRequest &request);
+        /* Parses the request at the start of data, which is whatever has
+           been received on the connection so far. The request line and the
+           headers are split up in place, only the url, the headers and the
+           body are copied out into the request, each in one go.
+
+           Returns how many bytes the request took up - anything after that
+           is the next request, if the client is pipelining. Returns 0 if the
+           request hasn't all arrived yet. Throws if it is malformed, or its
+           headers or body are too large. */
+        size_t parseRequest(std::string_view data, HttpRequest &request);
+
+        // Blocking
         void receiveResponse(std::istream &stream, HttpResponse &response);
         static HttpResponse::HTTP_STATUS parseResponseStatusFromString(const std::string &status);
 
     private:
         void readWord(std::istream &stream, std::string &word);
-        void readHeaders(std::istream &stream, HttpRequest::Headers &headers);
         bool readHeader(std::istream &stream, std::string &name, std::string &value);
-        size_t getBodyLen(const HttpRequest::Headers &headers);
         void readBody(std::istream &stream, std::string &body, const size_t bodyLen);
     };
 
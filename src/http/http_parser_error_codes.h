@@ -20,7 +20,9 @@ namespace cryptonote
             STREAM_NOT_GOOD = 1,
             END_OF_STREAM,
             UNEXPECTED_SYMBOL,
-            EMPTY_HEADER
+            EMPTY_HEADER,
+            HEADERS_TOO_LARGE,
+            BODY_TOO_LARGE
         };
 
         // custom category:
@@ -51,6 +53,10 @@ namespace cryptonote
                     return "Unexpected symbol";
                 case EMPTY_HEADER:
                     return "The header name is empty";
+                case HEADERS_TOO_LARGE:
+                    return "The headers are too large";
+                case BODY_TOO_LARGE:
+                    return "The body is too large";
                 default:
                     return "Unknown error";
                 }
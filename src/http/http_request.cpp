@@ -30,6 +30,11 @@ namespace cryptonote
         return body;
     }
 
+    bool HttpRequest::isKeepAlive() const
+    {
+        return keepAlive;
+    }
+
     void HttpRequest::addHeader(const std::string &name, const std::string &value)
     {
         headers[name] = value;
@@ -23,6 +23,10 @@ namespace cryptonote
         const Headers &getHeaders() const;
         const std::string &getBody() const;
 
+        /* False if the client asked for the connection to be closed after
+           the response */
+        bool isKeepAlive() const;
+
         void addHeader(const std::string &name, const std::string &value);
         void setBody(const std::string &b);
         void setUrl(const std::string &uri);
@@ -34,6 +38,7 @@ namespace cryptonote
         std::string url;
         Headers headers;
         std::string body;
+        bool keepAlive = true;
 
         friend std::ostream &operator<<(std::ostream &os, const HttpRequest &resp);
         std::ostream &printHttpRequest(std::ostream &os) const;
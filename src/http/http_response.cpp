@@ -20,6 +20,8 @@ namespace
             return "200 OK";
         case cryptonote::HttpResponse::STATUS_404:
             return "404 Not Found";
+        case cryptonote::HttpResponse::STATUS_413:
+            return "413 Payload Too Large";
         case cryptonote::HttpResponse::STATUS_500:
             return "500 Internal Server Error";
         default:
@@ -35,6 +37,8 @@ namespace
         {
         case cryptonote::HttpResponse::STATUS_404:
             return "Requested url is not found\n";
+        case cryptonote::HttpResponse::STATUS_413:
+            return "Request body is too large\n";
         case cryptonote::HttpResponse::STATUS_500:
             return "Internal server error is occurred\n";
         default:
@@ -73,7 +77,12 @@ namespace cryptonote
 
     void HttpResponse::setBody(const std::string &b)
     {
-        body = b;
+        setBody(std::string(b));
+    }
+
+    void HttpResponse::setBody(std::string &&b)
+    {
+        body = std::move(b);
         if (!body.empty())
         {
             headers["Content-Length"] = std::to_string(body.size());
@@ -84,15 +93,31 @@ namespace cryptonote
         }
     }
 
-    std::ostream &HttpResponse::printHttpResponse(std::ostream &os) const
+    std::string HttpResponse::getHead() const
     {
-        os << "HTTP/1.1 " << getStatusString(status) << "\r\n";
+        std::string head;
+        head.reserve(256);
+
+        head += "HTTP/1.1 ";
+        head += getStatusString(status);
+        head += "\r\n";
 
-        for (auto pair : headers)
+        for (const auto &[name, value] : headers)
         {
-            os << pair.first << ": " << pair.second << "\r\n";
+            head += name;
+            head += ": ";
+            head += value;
+            head += "\r\n";
         }
-        os << "\r\n";
+
+        head += "\r\n";
+
+        return head;
+    }
+
+    std::ostream &HttpResponse::printHttpResponse(std::ostream &os) const
+    {
+        os << getHead();
 
         if (!body.empty())
         {
@@ -21,6 +21,7 @@ namespace cryptonote
         {
             STATUS_200,
             STATUS_404,
+            STATUS_413,
             STATUS_500
         };
 
@@ -29,11 +30,16 @@ namespace cryptonote
         void setStatus(HTTP_STATUS s);
         void addHeader(const std::string &name, const std::string &value);
         void setBody(const std::string &b);
+        void setBody(std::string &&b);
 
         const std::map<std::string, std::string> &getHeaders() const { return headers; }
         HTTP_STATUS getStatus() const { return status; }
         const std::string &getBody() const { return body; }
 
+        /* The status line and the headers, up to and including the blank
+           line before the body */
+        std::string getHead() const;
+
     private:
         friend std::ostream &operator<<(std::ostream &os, const HttpResponse &resp);
         std::ostream &printHttpResponse(std::ostream &os) const;
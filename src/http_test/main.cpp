@@ -0,0 +1,178 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <config/cli_header.h>
+#include <http/http_parser.h>
+#include <http/http_parser_error_codes.h>
+
+using namespace cryptonote;
+
+namespace
+{
+    const std::string GET = "GET /info HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+    const std::string POST = "POST /json_rpc HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello";
+
+    /* The error parsing data throws, or a default constructed one if it
+       doesn't throw */
+    std::error_code parseError(const std::string &data)
+    {
+        HttpParser parser;
+        HttpRequest request;
+
+        try
+        {
+            parser.parseRequest(data, request);
+        }
+        catch (const std::system_error &e)
+        {
+            return e.code();
+        }
+
+        return {};
+    }
+
+    void testComplete()
+    {
+        HttpParser parser;
+        HttpRequest request;
+
+        assert(parser.parseRequest(POST, request) == POST.size());
+        assert(request.getMethod() == "POST");
+        assert(request.getUrl() == "/json_rpc");
+        assert(request.getHeaders().at("content-length") == "5");
+        assert(request.getBody() == "hello");
+        assert(request.isKeepAlive());
+
+        std::cout << "Complete: OK" << std::endl;
+    }
+
+    void testIncomplete()
+    {
+        HttpParser parser;
+
+        /* Every prefix is waited on, headers or body */
+        for (size_t size = 0; size < POST.size(); size++)
+        {
+            HttpRequest request;
+            assert(parser.parseRequest(POST.substr(0, size), request) == 0);
+        }
+
+        std::cout << "Incomplete: OK" << std::endl;
+    }
+
+    void testPipelined()
+    {
+        HttpParser parser;
+
+        const std::string data = POST + GET + POST.substr(0, 10);
+
+        HttpRequest first;
+        const size_t firstSize = parser.parseRequest(data, first);
+        assert(firstSize == POST.size());
+        assert(first.getBody() == "hello");
+
+        HttpRequest second;
+        const size_t secondSize = parser.parseRequest(std::string_view(data).substr(firstSize), second);
+        assert(secondSize == GET.size());
+        assert(second.getMethod() == "GET");
+        assert(second.getUrl() == "/info");
+        assert(second.getBody().empty());
+
+        /* The start of the third has arrived, not the rest */
+        HttpRequest third;
+        assert(parser.parseRequest(std::string_view(data).substr(firstSize + secondSize), third) == 0);
+
+        std::cout << "Pipelined: OK" << std::endl;
+    }
+
+    void testKeepAlive()
+    {
+        HttpParser parser;
+
+        const auto keepAlive = [&parser](const std::string &data) {
+            HttpRequest request;
+            assert(parser.parseRequest(data, request) == data.size());
+            return request.isKeepAlive();
+        };
+
+        assert(keepAlive("GET / HTTP/1.1\r\n\r\n"));
+        assert(!keepAlive("GET / HTTP/1.1\r\nConnection: close\r\n\r\n"));
+        assert(!keepAlive("GET / HTTP/1.1\r\nconnection: Close\r\n\r\n"));
+
+        /* 1.0 closes unless it asks not to */
+        assert(!keepAlive("GET / HTTP/1.0\r\n\r\n"));
+        assert(keepAlive("GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"));
+
+        std::cout << "Keep alive: OK" << std::endl;
+    }
+
+    void testOversizedHeaders()
+    {
+        const std::string headers = "GET / HTTP/1.1\r\nX-Padding: " + std::string(64 * 1024, 'a');
+
+        assert(parseError(headers) == make_error_code(error::HttpParserErrorCodes::HEADERS_TOO_LARGE));
+
+        /* Just short of the limit is still waited on */
+        assert(!parseError(headers.substr(0, 60 * 1024)));
+
+        std::cout << "Oversized headers: OK" << std::endl;
+    }
+
+    void testBadContentLength()
+    {
+        const auto withLength = [](const std::string &length) {
+            return parseError("POST / HTTP/1.1\r\nContent-Length: " + length + "\r\n\r\n");
+        };
+
+        const auto unexpected = make_error_code(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+
+        assert(withLength("abc") == unexpected);
+        assert(withLength("-1") == unexpected);
+        assert(withLength("1 2") == unexpected);
+        assert(withLength("") == unexpected);
+        assert(withLength("99999999999999999999") == unexpected);
+
+        /* Turned down before any of the body arrives */
+        assert(withLength(std::to_string(64 * 1024 * 1024)) == make_error_code(error::HttpParserErrorCodes::BODY_TOO_LARGE));
+
+        HttpResponse response;
+        response.setStatus(HttpResponse::STATUS_413);
+        assert(response.getHead().find("HTTP/1.1 413 Payload Too Large\r\n") == 0);
+
+        std::cout << "Bad content length: OK" << std::endl;
+    }
+
+    void testMalformed()
+    {
+        assert(parseError("GET\r\n\r\n") == make_error_code(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+        assert(parseError("GET  HTTP/1.1\r\n\r\n") == make_error_code(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+        assert(parseError("GET / HTTP/1.1\r\nNoColon\r\n\r\n") == make_error_code(error::HttpParserErrorCodes::EMPTY_HEADER));
+        assert(parseError("GET / HTTP/1.1\r\n: value\r\n\r\n") == make_error_code(error::HttpParserErrorCodes::EMPTY_HEADER));
+
+        std::cout << "Malformed: OK" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::cout << getProjectCLIHeader() << std::endl;
+
+    std::cout << "HttpParser:" << std::endl;
+
+    testComplete();
+    testIncomplete();
+    testPipelined();
+    testKeepAlive();
+    testOversizedHeaders();
+    testBadContentLength();
+    testMalformed();
+}
@@ -8,11 +8,15 @@
 
 #include <iostream>
 
+#include <cstring>
 #include <functional>
+#include <limits>
 #include <mutex>
 #include "common/string_tools.h"
 
 #include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include <config/cryptonote_config.h>
 #include <crypto/random.h>
 #include "cryptonote_core/cached_block.h"
 #include "cryptonote_core/check_difficulty.h"
@@ -25,19 +29,72 @@
 namespace cryptonote
 {
 
+    namespace
+    {
+
+        const size_t NO_NONCE_OFFSET = std::numeric_limits<size_t>::max();
+
+        /* Where the nonce's four bytes are in the blob the long hash is taken
+           of, found by serializing the block with two different nonces and
+           seeing what changes. NO_NONCE_OFFSET if it isn't just those. */
+        size_t findNonceOffset(BlockTemplate block)
+        {
+            block.nonce = 0;
+            const BinaryArray zeroes = CachedBlock(block).getBlockLongHashingBinaryArray();
+
+            block.nonce = std::numeric_limits<uint32_t>::max();
+            const BinaryArray ones = CachedBlock(block).getBlockLongHashingBinaryArray();
+
+            if (zeroes.size() != ones.size())
+            {
+                return NO_NONCE_OFFSET;
+            }
+
+            size_t offset = 0;
+
+            while (offset < zeroes.size() && zeroes[offset] == ones[offset])
+            {
+                offset++;
+            }
+
+            if (offset + sizeof(block.nonce) > zeroes.size())
+            {
+                return NO_NONCE_OFFSET;
+            }
+
+            for (size_t i = offset; i < zeroes.size(); i++)
+            {
+                const bool inNonce = i < offset + sizeof(block.nonce);
+
+                if (inNonce ? (zeroes[i] != 0 || ones[i] != 0xFF) : zeroes[i] != ones[i])
+                {
+                    return NO_NONCE_OFFSET;
+                }
+            }
+
+            return offset;
+        }
+
+    }
+
     Miner::Miner(syst::Dispatcher &dispatcher) : m_dispatcher(dispatcher),
                                                  m_miningStopped(dispatcher),
                                                  m_state(MiningState::MINING_STOPPED)
     {
     }
 
-    BlockTemplate Miner::mine(const BlockMiningParameters &blockMiningParameters, size_t threadCount)
+    BlockTemplate Miner::mine(const BlockMiningParameters &blockMiningParameters, size_t threadCount, size_t ways)
     {
         if (threadCount == 0)
         {
             throw std::runtime_error("Miner requires at least one thread");
         }
 
+        if (ways != 1 && ways != 2 && ways != 4)
+        {
+            throw std::runtime_error("Miner can only hash 1, 2 or 4 nonces at once");
+        }
+
         if (m_state == MiningState::MINING_IN_PROGRESS)
         {
             throw std::runtime_error("Mining is already in progress");
@@ -46,7 +103,7 @@ namespace cryptonote
         m_state = MiningState::MINING_IN_PROGRESS;
         m_miningStopped.clear();
 
-        runWorkers(blockMiningParameters, threadCount);
+        runWorkers(blockMiningParameters, threadCount, ways);
 
         if (m_state == MiningState::MINING_STOPPED)
         {
@@ -67,7 +124,7 @@ namespace cryptonote
         }
     }
 
-    void Miner::runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount)
+    void Miner::runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount, size_t ways)
     {
         std::cout << InformationMsg("Started mining for difficulty of ")
                   << InformationMsg(blockMiningParameters.difficulty)
@@ -77,10 +134,19 @@ namespace cryptonote
         {
             blockMiningParameters.blockTemplate.nonce = rnd::randomValue<uint32_t>();
 
+            {
+                std::scoped_lock lock(m_hashes_mutex);
+
+                while (m_thread_hash_counts.size() < threadCount)
+                {
+                    m_thread_hash_counts.push_back(std::make_unique<std::atomic<uint64_t>>(0));
+                }
+            }
+
             for (size_t i = 0; i < threadCount; ++i)
             {
                 m_workers.emplace_back(std::unique_ptr<syst::RemoteContext<void>>(
-                    new syst::RemoteContext<void>(m_dispatcher, std::bind(&Miner::workerFunc, this, blockMiningParameters.blockTemplate, blockMiningParameters.difficulty, static_cast<uint32_t>(threadCount)))));
+                    new syst::RemoteContext<void>(m_dispatcher, std::bind(&Miner::workerFunc, this, blockMiningParameters.blockTemplate, blockMiningParameters.difficulty, static_cast<uint32_t>(threadCount), ways, std::ref(*m_thread_hash_counts[i])))));
 
                 blockMiningParameters.blockTemplate.nonce++;
             }
@@ -98,31 +164,87 @@ namespace cryptonote
         m_miningStopped.set();
     }
 
-    void Miner::workerFunc(const BlockTemplate &blockTemplate, uint64_t difficulty, uint32_t nonceStep)
+    void Miner::workerFunc(const BlockTemplate &blockTemplate, uint64_t difficulty, uint32_t nonceStep, size_t ways, std::atomic<uint64_t> &threadHashCount)
     {
         try
         {
             BlockTemplate block = blockTemplate;
 
+            const size_t nonceOffset = block.majorVersion >= BLOCK_MAJOR_VERSION_5 ? findNonceOffset(block) : NO_NONCE_OFFSET;
+
+            if (nonceOffset == NO_NONCE_OFFSET)
+            {
+                while (m_state == MiningState::MINING_IN_PROGRESS)
+                {
+                    CachedBlock cachedBlock(block);
+                    crypto::Hash hash = cachedBlock.getBlockLongHash();
+
+                    if (check_hash(hash, difficulty))
+                    {
+                        if (!setStateBlockFound())
+                        {
+                            return;
+                        }
+
+                        m_block = block;
+                        return;
+                    }
+
+                    incrementHashCount(threadHashCount);
+                    block.nonce += nonceStep;
+                }
+
+                return;
+            }
+
+            /* Only the nonce changes between hashes, so serialize the block
+               once, keep a copy of it for each way, and overwrite the nonce
+               in place */
+            const BinaryArray blob = CachedBlock(block).getBlockLongHashingBinaryArray();
+            const size_t length = blob.size();
+
+            BinaryArray blobs;
+            blobs.reserve(length * ways);
+
+            for (size_t i = 0; i < ways; i++)
+            {
+                blobs.insert(blobs.end(), blob.begin(), blob.end());
+            }
+
+            std::vector<crypto::Hash> hashes(ways);
+
             while (m_state == MiningState::MINING_IN_PROGRESS)
             {
-                CachedBlock cachedBlock(block);
-                crypto::Hash hash = cachedBlock.getBlockLongHash();
+                for (size_t i = 0; i < ways; i++)
+                {
+                    const uint32_t nonce = block.nonce + static_cast<uint32_t>(i) * nonceStep;
+                    std::memcpy(&blobs[i * length + nonceOffset], &nonce, sizeof(nonce));
+                }
+
+                crypto::cn_turtle_lite_slow_hash_v2_multi(blobs.data(), length, hashes.data(), ways);
 
-                if (check_hash(hash, difficulty))
+                for (size_t i = 0; i < ways; i++)
                 {
-                    if (!setStateBlockFound())
+                    if (check_hash(hashes[i], difficulty))
                     {
+                        crypto::cn_slow_hash_free_multi_state();
+
+                        if (!setStateBlockFound())
+                        {
+                            return;
+                        }
+
+                        block.nonce += static_cast<uint32_t>(i) * nonceStep;
+                        m_block = block;
                         return;
                     }
-
-                    m_block = block;
-                    return;
                 }
 
-                incrementHashCount();
-                block.nonce += nonceStep;
+                incrementHashCount(threadHashCount, ways);
+                block.nonce += static_cast<uint32_t>(ways) * nonceStep;
             }
+
+            crypto::cn_slow_hash_free_multi_state();
         }
         catch (const std::exception &e)
         {
@@ -166,9 +288,10 @@ namespace cryptonote
         }
     }
 
-    void Miner::incrementHashCount()
+    void Miner::incrementHashCount(std::atomic<uint64_t> &threadHashCount, uint64_t count)
     {
-        m_hash_count++;
+        threadHashCount.fetch_add(count, std::memory_order_relaxed);
+        m_hash_count.fetch_add(count, std::memory_order_relaxed);
     }
 
     uint64_t Miner::getHashCount()
@@ -176,4 +299,18 @@ namespace cryptonote
         return m_hash_count.load();
     }
 
+    std::vector<uint64_t> Miner::getThreadHashCounts()
+    {
+        std::scoped_lock lock(m_hashes_mutex);
+
+        std::vector<uint64_t> counts;
+
+        for (const auto &count : m_thread_hash_counts)
+        {
+            counts.push_back(count->load(std::memory_order_relaxed));
+        }
+
+        return counts;
+    }
+
 } // namespace cryptonote
@@ -8,8 +8,10 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
 #include <thread>
 #include <mutex>
+#include <vector>
 
 #include <syst/dispatcher.h>
 #include <syst/event.h>
@@ -31,9 +33,13 @@ namespace cryptonote
     public:
         Miner(syst::Dispatcher &dispatcher);
 
-        BlockTemplate mine(const BlockMiningParameters &blockMiningParameters, size_t threadCount);
+        /* Each thread hashes ways nonces at a time, which has to be 1, 2 or 4 */
+        BlockTemplate mine(const BlockMiningParameters &blockMiningParameters, size_t threadCount, size_t ways = 1);
         uint64_t getHashCount();
 
+        /* Hashes done by each thread of the current or last mine() call */
+        std::vector<uint64_t> getThreadHashCounts();
+
         // NOTE! this is blocking method
         void stop();
 
@@ -55,10 +61,14 @@ namespace cryptonote
         std::atomic<uint64_t> m_hash_count = 0;
         std::mutex m_hashes_mutex;
 
-        void runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount);
-        void workerFunc(const BlockTemplate &blockTemplate, uint64_t difficulty, uint32_t nonceStep);
+        /* One per worker. Guarded by m_hashes_mutex, the counters themselves
+           are only written by their worker. */
+        std::vector<std::unique_ptr<std::atomic<uint64_t>>> m_thread_hash_counts;
+
+        void runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount, size_t ways);
+        void workerFunc(const BlockTemplate &blockTemplate, uint64_t difficulty, uint32_t nonceStep, size_t ways, std::atomic<uint64_t> &threadHashCount);
         bool setStateBlockFound();
-        void incrementHashCount();
+        void incrementHashCount(std::atomic<uint64_t> &threadHashCount, uint64_t count = 1);
     };
 
 } // namespace cryptonote
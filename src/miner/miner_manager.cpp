@@ -110,12 +110,14 @@ namespace miner
     void MinerManager::printHashRate()
     {
         uint64_t last_hash_count = m_miner.getHashCount();
+        std::vector<uint64_t> last_thread_hash_counts = m_miner.getThreadHashCounts();
 
         while (isRunning)
         {
             std::this_thread::sleep_for(std::chrono::seconds(60));
 
             uint64_t current_hash_count = m_miner.getHashCount();
+            std::vector<uint64_t> current_thread_hash_counts = m_miner.getThreadHashCounts();
 
             double hashes = static_cast<double>((current_hash_count - last_hash_count) / 60);
 
@@ -123,7 +125,20 @@ namespace miner
 
             std::cout << SuccessMsg("\nMining at ")
                       << SuccessMsg(utilities::get_mining_speed(hashes))
-                      << "\n\n";
+                      << "\n";
+
+            for (size_t i = 0; i < current_thread_hash_counts.size(); i++)
+            {
+                const uint64_t last = i < last_thread_hash_counts.size() ? last_thread_hash_counts[i] : 0;
+
+                std::cout << InformationMsg("Thread " + std::to_string(i) + ": ")
+                          << InformationMsg(utilities::get_mining_speed((current_thread_hash_counts[i] - last) / 60))
+                          << "\n";
+            }
+
+            std::cout << "\n";
+
+            last_thread_hash_counts = current_thread_hash_counts;
         }
     }
 
@@ -201,7 +216,7 @@ namespace miner
                              {
         try
         {
-            m_minedBlock = m_miner.mine(params, m_config.threadCount);
+            m_minedBlock = m_miner.mine(params, m_config.threadCount, m_config.hashWays);
             pushEvent(BlockMinedEvent());
         }
         catch (const std::exception &)
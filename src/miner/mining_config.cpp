@@ -98,7 +98,7 @@ namespace cryptonote
                                       cxxopts::value<std::string>(daemonAddress), "<host:port>")("daemon-host", "The daemon host to use for node operations", cxxopts::value<std::string>(daemonHost)->default_value("127.0.0.1"), "<host>")("daemon-rpc-port", "The daemon RPC port to use for node operations", cxxopts::value<int>(daemonPort)->default_value(std::to_string(cryptonote::RPC_DEFAULT_PORT)), "#")("scan-time", "Blockchain polling interval (seconds). How often miner will check the Blockchain for updates", cxxopts::value<size_t>(scanPeriod)->default_value("1"), "#");
 
         options.add_options("Mining")("address", "The valid CryptoNote miner's address", cxxopts::value<std::string>(miningAddress), "<address>")("block-timestamp-interval", "Timestamp incremental step for each subsequent block. May be set only if --first-block-timestamp has been set.",
-                                                                                                                                                  cxxopts::value<int64_t>(blockTimestampInterval)->default_value("0"), "#")("first-block-timestamp", "Set timestamp to the first mined block. 0 means leave timestamp unchanged", cxxopts::value<uint64_t>(firstBlockTimestamp)->default_value("0"), "#")("limit", "Mine this exact quantity of blocks and then stop. 0 means no limit", cxxopts::value<size_t>(blocksLimit)->default_value("0"), "#")("threads", "The mining threads count. Must not exceed hardware capabilities.", cxxopts::value<size_t>(threadCount)->default_value(std::to_string(CONCURRENCY_LEVEL)), "#");
+                                                                                                                                                  cxxopts::value<int64_t>(blockTimestampInterval)->default_value("0"), "#")("first-block-timestamp", "Set timestamp to the first mined block. 0 means leave timestamp unchanged", cxxopts::value<uint64_t>(firstBlockTimestamp)->default_value("0"), "#")("limit", "Mine this exact quantity of blocks and then stop. 0 means no limit", cxxopts::value<size_t>(blocksLimit)->default_value("0"), "#")("threads", "The mining threads count. Must not exceed hardware capabilities.", cxxopts::value<size_t>(threadCount)->default_value(std::to_string(CONCURRENCY_LEVEL)), "#")("ways", "How many nonces each thread hashes at once - 1, 2 or 4", cxxopts::value<size_t>(hashWays)->default_value("2"), "#");
 
         try
         {
@@ -157,6 +157,11 @@ namespace cryptonote
             throw std::runtime_error("--threads option must be 1.." + std::to_string(CONCURRENCY_LEVEL));
         }
 
+        if (hashWays != 1 && hashWays != 2 && hashWays != 4)
+        {
+            throw std::runtime_error("--ways option must be 1, 2 or 4");
+        }
+
         if (scanPeriod == 0)
         {
             throw std::runtime_error("--scan-time must not be zero");
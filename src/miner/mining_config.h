@@ -25,6 +25,7 @@ namespace cryptonote
         std::string daemonHost;
         int daemonPort;
         size_t threadCount;
+        size_t hashWays;
         size_t scanPeriod;
         size_t blocksLimit;
         uint64_t firstBlockTimestamp;
@@ -7,9 +7,12 @@
 #include <nigel/nigel.h>
 ////////////////////////
 
+#include <common/memory_input_stream.h>
 #include <config/cryptonote_config.h>
 #include <cryptonote_core/cryptonote_tools.h>
+#include <cryptonote_core/icore_definitions.h>
 #include <errors/validate_parameters.h>
+#include <serialization/binary_input_stream_serializer.h>
 #include <utilities/utilities.h>
 #include <version.h>
 
@@ -52,6 +55,7 @@ void Nigel::swapNode(const std::string daemonHost, const uint16_t daemonPort)
     m_networkBlockCount = 0;
     m_peerCount = 0;
     m_lastKnownHashrate = 0;
+    m_binaryWalletSyncDataUnsupported = false;
 
     m_daemonHost = daemonHost;
     m_daemonPort = daemonPort;
@@ -72,6 +76,46 @@ std::tuple<bool, std::vector<wallet_types::WalletBlockInfo>> Nigel::getWalletSyn
         {"startHeight", startHeight},
         {"startTimestamp", startTimestamp}};
 
+    if (!m_binaryWalletSyncDataUnsupported)
+    {
+        const auto res = m_httpClient->Post(
+            "/getwalletsyncdata.bin", j.dump(), "application/json");
+
+        if (res && res->status == 200)
+        {
+            try
+            {
+                cryptonote::COMMAND_RPC_GET_WALLET_SYNC_DATA::response response;
+
+                common::MemoryInputStream stream(res->body.data(), res->body.size());
+                cryptonote::BinaryInputStreamSerializer serializer(stream);
+
+                response.serialize(serializer);
+
+                if (response.status != "OK" || !stream.endOfStream())
+                {
+                    return {false, {}};
+                }
+
+                return {true, std::move(response.items)};
+            }
+            catch (const std::exception &)
+            {
+            }
+
+            return {false, {}};
+        }
+
+        /* Daemon is up, but too old to support the binary format. Fall back
+           to JSON from now on. */
+        if (!res || res->status != 404)
+        {
+            return {false, {}};
+        }
+
+        m_binaryWalletSyncDataUnsupported = true;
+    }
+
     const auto res = m_httpClient->Post(
         "/getwalletsyncdata", j.dump(), "application/json");
 
@@ -124,6 +124,10 @@ private:
     /* The hashrate (based on the last local block the daemon has synced) */
     std::atomic<uint64_t> m_lastKnownHashrate = 0;
 
+    /* Whether the daemon only serves wallet sync data as JSON. Set the first
+       time the binary endpoint is not found. */
+    mutable std::atomic<bool> m_binaryWalletSyncDataUnsupported = false;
+
     /* The address to send the node fee to (May be "") */
     std::string m_nodeFeeAddress;
 
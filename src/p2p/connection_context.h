@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <deque>
 #include <list>
 #include <ostream>
 #include <unordered_set>
@@ -44,7 +45,8 @@ namespace cryptonote
         state m_state = state_befor_handshake;
         std::optional<PendingLiteBlock> m_pending_lite_block;
         std::list<crypto::Hash> m_needed_objects;
-        std::unordered_set<crypto::Hash> m_requested_objects;
+        /* Blocks requested from this peer, one set per request, oldest first */
+        std::deque<std::unordered_set<crypto::Hash>> m_requested_objects;
         uint32_t m_remote_blockchain_height = 0;
         uint32_t m_last_response_height = 0;
     };
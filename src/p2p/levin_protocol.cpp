@@ -6,6 +6,9 @@
 // Please see the included LICENSE file for more information.
 
 #include "levin_protocol.h"
+
+#include <cstring>
+
 #include <syst/tcp_connection.h>
 
 using namespace cryptonote;
@@ -33,6 +36,30 @@ namespace
     };
 #pragma pack(pop)
 
+    static_assert(sizeof(bucket_head2) == LEVIN_HEADER_SIZE, "Levin header size mismatch");
+
+    std::array<uint8_t, LEVIN_HEADER_SIZE> encodeHeader(
+        uint32_t command,
+        size_t bodySize,
+        bool needResponse,
+        uint32_t flags,
+        int32_t returnCode)
+    {
+        bucket_head2 head = {0};
+        head.m_signature = LEVIN_SIGNATURE;
+        head.m_cb = bodySize;
+        head.m_have_to_return_data = needResponse;
+        head.m_command = command;
+        head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+        head.m_flags = flags;
+        head.m_return_code = returnCode;
+
+        std::array<uint8_t, LEVIN_HEADER_SIZE> header;
+        std::memcpy(header.data(), &head, sizeof(head));
+
+        return header;
+    }
+
 }
 
 bool LevinProtocol::Command::needReply() const
@@ -45,23 +72,12 @@ LevinProtocol::LevinProtocol(syst::TcpConnection &connection)
 
 void LevinProtocol::sendMessage(uint32_t command, const BinaryArray &out, bool needResponse)
 {
-    bucket_head2 head = {0};
-    head.m_signature = LEVIN_SIGNATURE;
-    head.m_cb = out.size();
-    head.m_have_to_return_data = needResponse;
-    head.m_command = command;
-    head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-    head.m_flags = LEVIN_PACKET_REQUEST;
-
-    // write header and body in one operation
-    BinaryArray writeBuffer;
-    writeBuffer.reserve(sizeof(head) + out.size());
-
-    common::VectorOutputStream stream(writeBuffer);
-    stream.writeSome(&head, sizeof(head));
-    stream.writeSome(out.data(), out.size());
-
-    writeStrict(writeBuffer.data(), writeBuffer.size());
+    const auto header = encodeHeader(command, out.size(), needResponse, LEVIN_PACKET_REQUEST, 0);
+
+    // write header and body in one operation, without copying the body
+    std::vector<std::pair<const uint8_t *, size_t>> buffers{{header.data(), header.size()}, {out.data(), out.size()}};
+
+    m_conn.writevAll(buffers);
 }
 
 bool LevinProtocol::readCommand(Command &cmd)
@@ -104,32 +120,43 @@ bool LevinProtocol::readCommand(Command &cmd)
 
 void LevinProtocol::sendReply(uint32_t command, const BinaryArray &out, int32_t returnCode)
 {
-    bucket_head2 head = {0};
-    head.m_signature = LEVIN_SIGNATURE;
-    head.m_cb = out.size();
-    head.m_have_to_return_data = false;
-    head.m_command = command;
-    head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-    head.m_flags = LEVIN_PACKET_RESPONSE;
-    head.m_return_code = returnCode;
-
-    BinaryArray writeBuffer;
-    writeBuffer.reserve(sizeof(head) + out.size());
-
-    common::VectorOutputStream stream(writeBuffer);
-    stream.writeSome(&head, sizeof(head));
-    stream.writeSome(out.data(), out.size());
-
-    writeStrict(writeBuffer.data(), writeBuffer.size());
+    const auto header = encodeHeader(command, out.size(), false, LEVIN_PACKET_RESPONSE, returnCode);
+
+    std::vector<std::pair<const uint8_t *, size_t>> buffers{{header.data(), header.size()}, {out.data(), out.size()}};
+
+    m_conn.writevAll(buffers);
 }
 
-void LevinProtocol::writeStrict(const uint8_t *ptr, size_t size)
+void LevinProtocol::sendMessages(const std::vector<std::shared_ptr<const LevinMessage>> &messages)
 {
-    size_t offset = 0;
-    while (offset < size)
+    std::vector<std::pair<const uint8_t *, size_t>> buffers;
+    buffers.reserve(messages.size() * 2);
+
+    for (const auto &message : messages)
     {
-        offset += m_conn.write(ptr + offset, size - offset);
+        buffers.emplace_back(message->header.data(), message->header.size());
+        buffers.emplace_back(message->body.data(), message->body.size());
     }
+
+    m_conn.writevAll(buffers);
+}
+
+std::shared_ptr<const LevinMessage> LevinProtocol::encodeMessage(uint32_t command, BinaryArray &&body, bool needResponse)
+{
+    auto message = std::make_shared<LevinMessage>();
+    message->header = encodeHeader(command, body.size(), needResponse, LEVIN_PACKET_REQUEST, 0);
+    message->body = std::move(body);
+
+    return message;
+}
+
+std::shared_ptr<const LevinMessage> LevinProtocol::encodeReply(uint32_t command, BinaryArray &&body, int32_t returnCode)
+{
+    auto message = std::make_shared<LevinMessage>();
+    message->header = encodeHeader(command, body.size(), false, LEVIN_PACKET_RESPONSE, returnCode);
+    message->body = std::move(body);
+
+    return message;
 }
 
 bool LevinProtocol::readStrict(uint8_t *ptr, size_t size)
@@ -7,6 +7,11 @@
 
 #pragma once
 
+#include <array>
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "cryptonote.h"
 #include <common/memory_input_stream.h>
 #include <common/vector_output_stream.h>
@@ -35,6 +40,17 @@ namespace cryptonote
 
     const int32_t LEVIN_PROTOCOL_RETCODE_SUCCESS = 1;
 
+    const size_t LEVIN_HEADER_SIZE = 33;
+
+    /* A message with its levin header already encoded, ready to go on the
+       wire. It never changes once built, so one can be shared by every
+       connection it is sent to. */
+    struct LevinMessage
+    {
+        std::array<uint8_t, LEVIN_HEADER_SIZE> header;
+        BinaryArray body;
+    };
+
     class LevinProtocol
     {
     public:
@@ -77,6 +93,13 @@ namespace cryptonote
         void sendMessage(uint32_t command, const BinaryArray &out, bool needResponse);
         void sendReply(uint32_t command, const BinaryArray &out, int32_t returnCode);
 
+        /* Writes the messages back to back, header and body straight from
+           where they are, with as few gathering writes as possible */
+        void sendMessages(const std::vector<std::shared_ptr<const LevinMessage>> &messages);
+
+        static std::shared_ptr<const LevinMessage> encodeMessage(uint32_t command, BinaryArray &&body, bool needResponse);
+        static std::shared_ptr<const LevinMessage> encodeReply(uint32_t command, BinaryArray &&body, int32_t returnCode);
+
         template <typename T>
         static bool decode(const BinaryArray &buf, T &value)
         {
@@ -107,7 +130,6 @@ namespace cryptonote
 
     private:
         bool readStrict(uint8_t *ptr, size_t size);
-        void writeStrict(const uint8_t *ptr, size_t size);
         syst::TcpConnection &m_conn;
     };
 
@@ -339,20 +339,25 @@ namespace cryptonote
     //-----------------------------------------------------------------------------------
     void NodeServer::externalRelayNotifyToAll(int command, const BinaryArray &data_buff, const boost::uuids::uuid *excludeConnection)
     {
-        m_dispatcher.remoteSpawn([this, command, data_buff, excludeConnection]
-                                 { relay_notify_to_all(command, data_buff, excludeConnection); });
+        /* Encoded here, once, and shared by every connection it goes to */
+        auto message = LevinProtocol::encodeMessage(command, BinaryArray(data_buff), false);
+
+        m_dispatcher.remoteSpawn([this, command, message, excludeConnection]
+                                 { relay_notify_to_all(command, message, excludeConnection); });
     }
 
     //-----------------------------------------------------------------------------------
     void NodeServer::externalRelayNotifyToList(int command, const BinaryArray &data_buff, const std::list<boost::uuids::uuid> relayList)
     {
-        m_dispatcher.remoteSpawn([this, command, data_buff, relayList]
+        auto message = LevinProtocol::encodeMessage(command, BinaryArray(data_buff), false);
+
+        m_dispatcher.remoteSpawn([this, command, message, relayList]
                                  { forEachConnection([&](P2pConnectionContext &conn)
                                                      {
         if (std::find(relayList.begin(), relayList.end(), conn.m_connection_id) != relayList.end()) {
           if (conn.peerId && (conn.m_state == CryptoNoteConnectionContext::state_normal ||
                conn.m_state == CryptoNoteConnectionContext::state_synchronizing)) {
-            conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
+            conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, message));
           }
         } }); });
     }
@@ -1133,6 +1138,11 @@ namespace cryptonote
     //-----------------------------------------------------------------------------------
 
     void NodeServer::relay_notify_to_all(int command, const BinaryArray &data_buff, const boost::uuids::uuid *excludeConnection)
+    {
+        relay_notify_to_all(command, LevinProtocol::encodeMessage(command, BinaryArray(data_buff), false), excludeConnection);
+    }
+
+    void NodeServer::relay_notify_to_all(int command, const std::shared_ptr<const LevinMessage> &message, const boost::uuids::uuid *excludeConnection)
     {
         boost::uuids::uuid excludeId = excludeConnection ? *excludeConnection : boost::value_initialized<boost::uuids::uuid>();
 
@@ -1141,7 +1151,7 @@ namespace cryptonote
       if (conn.peerId && conn.m_connection_id != excludeId &&
           (conn.m_state == CryptoNoteConnectionContext::state_normal ||
            conn.m_state == CryptoNoteConnectionContext::state_synchronizing)) {
-        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
+        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, message));
       } });
     }
 
@@ -1584,24 +1594,18 @@ namespace cryptonote
                     break;
                 }
 
+                std::vector<std::shared_ptr<const LevinMessage>> messages;
+                messages.reserve(msgs.size());
+
                 for (const auto &msg : msgs)
                 {
                     logger(DEBUGGING) << ctx << "msg " << msg.type << ':' << msg.command;
-                    switch (msg.type)
-                    {
-                    case P2pMessage::COMMAND:
-                        proto.sendMessage(msg.command, msg.buffer, true);
-                        break;
-                    case P2pMessage::NOTIFY:
-                        proto.sendMessage(msg.command, msg.buffer, false);
-                        break;
-                    case P2pMessage::REPLY:
-                        proto.sendReply(msg.command, msg.buffer, msg.returnCode);
-                        break;
-                    default:
-                        assert(false);
-                    }
+                    messages.push_back(msg.message);
                 }
+
+                /* Everything queued goes out together, straight from the
+                   shared buffers */
+                proto.sendMessages(messages);
             }
         }
         catch (syst::InterruptedException &)
@@ -50,23 +50,27 @@ namespace cryptonote
             NOTIFY
         };
 
-        P2pMessage(Type type, uint32_t command, const BinaryArray &buffer, int32_t returnCode = 0) : type(type), command(command), buffer(buffer), returnCode(returnCode)
+        P2pMessage(Type type, uint32_t command, BinaryArray buffer, int32_t returnCode = 0) : type(type), command(command),
+                                                                                               message(type == REPLY
+                                                                                                           ? LevinProtocol::encodeReply(command, std::move(buffer), returnCode)
+                                                                                                           : LevinProtocol::encodeMessage(command, std::move(buffer), type == COMMAND))
         {
         }
 
-        P2pMessage(P2pMessage &&msg) : type(msg.type), command(msg.command), buffer(std::move(msg.buffer)), returnCode(msg.returnCode)
+        /* Shares an already encoded message, so relaying one to many
+           connections doesn't copy it for each of them */
+        P2pMessage(Type type, uint32_t command, std::shared_ptr<const LevinMessage> message) : type(type), command(command), message(std::move(message))
         {
         }
 
-        size_t size()
+        size_t size() const
         {
-            return buffer.size();
+            return message->header.size() + message->body.size();
         }
 
         Type type;
         uint32_t command;
-        const BinaryArray buffer;
-        int32_t returnCode;
+        std::shared_ptr<const LevinMessage> message;
     };
 
     struct P2pConnectionContext : public CryptoNoteConnectionContext
@@ -164,6 +168,7 @@ namespace cryptonote
 
         //----------------- i_p2p_endpoint -------------------------------------------------------------
         virtual void relay_notify_to_all(int command, const BinaryArray &data_buff, const boost::uuids::uuid *excludeConnection) override;
+        void relay_notify_to_all(int command, const std::shared_ptr<const LevinMessage> &message, const boost::uuids::uuid *excludeConnection);
         virtual bool invoke_notify_to_peer(int command, const BinaryArray &req_buff, const CryptoNoteConnectionContext &context) override;
         virtual void for_each_connection(std::function<void(cryptonote::CryptoNoteConnectionContext &, uint64_t)> f) override;
         virtual void externalRelayNotifyToAll(int command, const BinaryArray &data_buff, const boost::uuids::uuid *excludeConnection) override;
@@ -0,0 +1,130 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "context.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(__x86_64__) && !defined(__aarch64__)
+#include <ucontext.h>
+
+#include "error_message.h"
+#endif
+
+#if defined(__x86_64__) || defined(__aarch64__)
+/* context_switch.S */
+extern "C" void syst_switch_context(void **from, void *to);
+extern "C" void syst_context_entry();
+#endif
+
+namespace syst
+{
+
+#if defined(__x86_64__)
+
+    void *makeContext(uint8_t *stack, size_t stackSize, void (*entry)(void *), void *argument)
+    {
+        /* The frame syst_switch_context() restores: x87 control word and
+           MXCSR, r15, r14, r13, r12, rbx, rbp, and the return address. It
+           returns into syst_context_entry, which calls r13(r12) with the
+           stack 16 byte aligned, as a call expects. */
+        uintptr_t top = reinterpret_cast<uintptr_t>(stack + stackSize) & ~static_cast<uintptr_t>(15);
+
+        uint64_t *frame = reinterpret_cast<uint64_t *>(top - 72);
+
+        std::memset(frame, 0, 72);
+
+        const uint16_t x87ControlWord = 0x037F;
+        const uint32_t mxcsr = 0x1F80;
+
+        std::memcpy(&frame[0], &x87ControlWord, sizeof(x87ControlWord));
+        std::memcpy(&frame[1], &mxcsr, sizeof(mxcsr));
+
+        frame[4] = reinterpret_cast<uint64_t>(entry);    /* r13 */
+        frame[5] = reinterpret_cast<uint64_t>(argument); /* r12 */
+        frame[8] = reinterpret_cast<uint64_t>(&syst_context_entry);
+
+        return frame;
+    }
+
+#elif defined(__aarch64__)
+
+    void *makeContext(uint8_t *stack, size_t stackSize, void (*entry)(void *), void *argument)
+    {
+        /* The frame syst_switch_context() restores: x19 - x28, x29, x30 and
+           d8 - d15. It returns to x30, syst_context_entry, which calls
+           x20(x19). */
+        uintptr_t top = reinterpret_cast<uintptr_t>(stack + stackSize) & ~static_cast<uintptr_t>(15);
+
+        uint64_t *frame = reinterpret_cast<uint64_t *>(top - 160);
+
+        std::memset(frame, 0, 160);
+
+        frame[0] = reinterpret_cast<uint64_t>(argument); /* x19 */
+        frame[1] = reinterpret_cast<uint64_t>(entry);    /* x20 */
+        frame[11] = reinterpret_cast<uint64_t>(&syst_context_entry);
+
+        return frame;
+    }
+
+#else
+
+    void *makeContext(uint8_t *stack, size_t stackSize, void (*entry)(void *), void *argument)
+    {
+        ucontext_t *context = new ucontext_t;
+
+        if (getcontext(context) == -1)
+        {
+            delete context;
+            throw std::runtime_error("makeContext, getcontext failed, " + lastErrorMessage());
+        }
+
+        context->uc_stack.ss_sp = stack;
+        context->uc_stack.ss_size = stackSize;
+        context->uc_link = nullptr;
+
+        makecontext(context, reinterpret_cast<void (*)()>(entry), 1, argument);
+
+        return context;
+    }
+
+#endif
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+    void switchContext(void **from, void *to)
+    {
+        syst_switch_context(from, to);
+    }
+
+    void freeContext(void *)
+    {
+    }
+
+#else
+
+    void switchContext(void **from, void *to)
+    {
+        /* The first time a context is switched away from, it has nowhere to
+           be saved to yet */
+        if (*from == nullptr)
+        {
+            *from = new ucontext_t;
+        }
+
+        if (swapcontext(static_cast<ucontext_t *>(*from), static_cast<ucontext_t *>(to)) == -1)
+        {
+            throw std::runtime_error("switchContext, swapcontext failed, " + lastErrorMessage());
+        }
+    }
+
+    void freeContext(void *context)
+    {
+        delete static_cast<ucontext_t *>(context);
+    }
+
+#endif
+
+}
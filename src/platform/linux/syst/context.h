@@ -0,0 +1,34 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace syst
+{
+
+    /* Dispatcher contexts are switched with a few instructions of assembly
+       on x86-64 and AArch64, which only save the registers a function call
+       has to preserve. swapcontext() also saves and restores the signal
+       mask, which costs a system call on every switch. Anything else falls
+       back to ucontext.
+
+       A context is an opaque handle - the saved stack pointer, or a
+       ucontext_t. */
+
+    /* Prepares a context on the stack which calls entry(argument) when it is
+       first switched to. entry must never return. */
+    void *makeContext(uint8_t *stack, size_t stackSize, void (*entry)(void *), void *argument);
+
+    /* Suspends the running context, storing its handle in *from, and resumes
+       the context to. Returns when something switches back to *from. */
+    void switchContext(void **from, void *to);
+
+    /* Frees anything makeContext() or switchContext() allocated for the
+       handle. The stack belongs to the caller. */
+    void freeContext(void *context);
+
+}
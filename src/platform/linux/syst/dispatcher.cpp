@@ -14,9 +14,10 @@
 #include <sys/timerfd.h>
 #include <fcntl.h>
 #include <string.h>
-#include <ucontext.h>
 #include <unistd.h>
+#include "context.h"
 #include "error_message.h"
+#include "uring.h"
 
 #include <pthread.h>
 #include <stdio.h>
@@ -62,6 +63,9 @@ namespace syst
 
         const size_t STACK_SIZE = 64 * 1024;
 
+        /* How many ready events are taken from epoll at once */
+        const int MAX_EVENTS = 128;
+
     };
 
     Dispatcher::Dispatcher()
@@ -74,57 +78,53 @@ namespace syst
         }
         else
         {
-            mainContext.ucontext = new ucontext_t;
-            if (getcontext(reinterpret_cast<ucontext_t *>(mainContext.ucontext)) == -1)
+            /* Filled in the first time we switch away from it */
+            mainContext.ucontext = nullptr;
+
+            remoteSpawnEvent = eventfd(0, O_NONBLOCK);
+            if (remoteSpawnEvent == -1)
             {
-                message = "getcontext failed, " + lastErrorMessage();
+                message = "eventfd failed, " + lastErrorMessage();
             }
             else
             {
-                remoteSpawnEvent = eventfd(0, O_NONBLOCK);
-                if (remoteSpawnEvent == -1)
+                remoteSpawnEventContext.writeContext = nullptr;
+                remoteSpawnEventContext.readContext = nullptr;
+
+                epoll_event remoteSpawnEventEpollEvent;
+                remoteSpawnEventEpollEvent.events = EPOLLIN;
+                remoteSpawnEventEpollEvent.data.ptr = &remoteSpawnEventContext;
+
+                if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1)
                 {
-                    message = "eventfd failed, " + lastErrorMessage();
+                    message = "epoll_ctl failed, " + lastErrorMessage();
                 }
                 else
                 {
-                    remoteSpawnEventContext.writeContext = nullptr;
-                    remoteSpawnEventContext.readContext = nullptr;
-
-                    epoll_event remoteSpawnEventEpollEvent;
-                    remoteSpawnEventEpollEvent.events = EPOLLIN;
-                    remoteSpawnEventEpollEvent.data.ptr = &remoteSpawnEventContext;
-
-                    if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1)
-                    {
-                        message = "epoll_ctl failed, " + lastErrorMessage();
-                    }
-                    else
-                    {
-                        *reinterpret_cast<pthread_mutex_t *>(this->mutex) = pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
-
-                        mainContext.interrupted = false;
-                        mainContext.group = &contextGroup;
-                        mainContext.groupPrev = nullptr;
-                        mainContext.groupNext = nullptr;
-                        mainContext.inExecutionQueue = false;
-                        contextGroup.firstContext = nullptr;
-                        contextGroup.lastContext = nullptr;
-                        contextGroup.firstWaiter = nullptr;
-                        contextGroup.lastWaiter = nullptr;
-                        currentContext = &mainContext;
-                        firstResumingContext = nullptr;
-                        firstReusableContext = nullptr;
-                        runningContextCount = 0;
-                        return;
-                    }
+                    *reinterpret_cast<pthread_mutex_t *>(this->mutex) = pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
+
+                    mainContext.interrupted = false;
+                    mainContext.group = &contextGroup;
+                    mainContext.groupPrev = nullptr;
+                    mainContext.groupNext = nullptr;
+                    mainContext.inExecutionQueue = false;
+                    contextGroup.firstContext = nullptr;
+                    contextGroup.lastContext = nullptr;
+                    contextGroup.firstWaiter = nullptr;
+                    contextGroup.lastWaiter = nullptr;
+                    currentContext = &mainContext;
+                    firstResumingContext = nullptr;
+                    firstReusableContext = nullptr;
+                    runningContextCount = 0;
+                    setupRing();
+                    return;
+                }
 
-                    auto result = close(remoteSpawnEvent);
-                    if (result)
-                    {
-                    }
-                    assert(result == 0);
+                auto result = close(remoteSpawnEvent);
+                if (result)
+                {
                 }
+                assert(result == 0);
             }
 
             auto result = close(epoll);
@@ -145,17 +145,28 @@ namespace syst
         }
 
         yield();
+
+#ifdef SYST_IO_URING
+        /* Cancelled ring operations only finish once the kernel says so */
+        while (ring != nullptr && contextGroup.firstContext != nullptr)
+        {
+            yield();
+        }
+
+        delete ring;
+#endif
+
         assert(contextGroup.firstContext == nullptr);
         assert(contextGroup.firstWaiter == nullptr);
         assert(firstResumingContext == nullptr);
         assert(runningContextCount == 0);
         while (firstReusableContext != nullptr)
         {
-            auto ucontext = static_cast<ucontext_t *>(firstReusableContext->ucontext);
+            auto ucontext = firstReusableContext->ucontext;
             auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
             firstReusableContext = firstReusableContext->next;
             delete[] stackPtr;
-            delete ucontext;
+            freeContext(ucontext);
         }
 
         while (!timers.empty())
@@ -177,17 +188,18 @@ namespace syst
         assert(result == 0);
         result = pthread_mutex_destroy(reinterpret_cast<pthread_mutex_t *>(this->mutex));
         assert(result == 0);
+        freeContext(mainContext.ucontext);
     }
 
     void Dispatcher::clear()
     {
         while (firstReusableContext != nullptr)
         {
-            auto ucontext = static_cast<ucontext_t *>(firstReusableContext->ucontext);
+            auto ucontext = firstReusableContext->ucontext;
             auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
             firstReusableContext = firstReusableContext->next;
             delete[] stackPtr;
-            delete ucontext;
+            freeContext(ucontext);
         }
 
         while (!timers.empty())
@@ -218,63 +230,119 @@ namespace syst
                 break;
             }
 
-            epoll_event event;
-            int count = epoll_wait(epoll, &event, 1, -1);
-            if (count == 1)
+            /* Queue every context with something to do, rather than waking
+               up once per event */
+#ifdef SYST_IO_URING
+            /* Everything started since the last wait goes to the kernel in
+               one go. It may well complete straight away. */
+            if (ring != nullptr)
             {
-                ContextPair *contextPair = static_cast<ContextPair *>(event.data.ptr);
-                if (((event.events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr)
-                {
-                    uint64_t buf;
-                    auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
-                    if (transferred == -1)
-                    {
-                        throw std::runtime_error("Dispatcher::dispatch, read(remoteSpawnEvent) failed, " + lastErrorMessage());
-                    }
-
-                    MutextGuard guard(*reinterpret_cast<pthread_mutex_t *>(this->mutex));
-                    while (!remoteSpawningProcedures.empty())
-                    {
-                        spawn(std::move(remoteSpawningProcedures.front()));
-                        remoteSpawningProcedures.pop();
-                    }
+                ring->submit();
 
+                if (ring->processCompletions())
+                {
                     continue;
                 }
+            }
+#endif
 
-                if ((event.events & EPOLLOUT) != 0)
+            epoll_event events[MAX_EVENTS];
+            int count = epoll_wait(epoll, events, MAX_EVENTS, -1);
+            if (count == -1)
+            {
+                if (errno != EINTR)
                 {
-                    context = contextPair->writeContext->context;
-                    contextPair->writeContext->events = event.events;
+                    throw std::runtime_error("Dispatcher::dispatch, epoll_wait failed, " + lastErrorMessage());
                 }
-                else if ((event.events & EPOLLIN) != 0)
+
+                continue;
+            }
+
+            processEvents(events, count);
+        }
+
+        if (context != currentContext)
+        {
+            void **oldContext = &currentContext->ucontext;
+            currentContext = context;
+            switchContext(oldContext, context->ucontext);
+        }
+    }
+
+    void Dispatcher::processEvents(const epoll_event *events, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            ContextPair *contextPair = static_cast<ContextPair *>(events[i].data.ptr);
+
+            /* Disarmed registrations still report errors and hang ups */
+            if (contextPair == nullptr)
+            {
+                continue;
+            }
+
+            if (contextPair == &remoteSpawnEventContext)
+            {
+                uint64_t buf;
+                auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
+                if (transferred == -1)
                 {
-                    context = contextPair->readContext->context;
-                    contextPair->readContext->events = event.events;
+                    throw std::runtime_error("Dispatcher::dispatch, read(remoteSpawnEvent) failed, " + lastErrorMessage());
                 }
-                else
+
+                MutextGuard guard(*reinterpret_cast<pthread_mutex_t *>(this->mutex));
+                while (!remoteSpawningProcedures.empty())
                 {
-                    continue;
+                    spawn(std::move(remoteSpawningProcedures.front()));
+                    remoteSpawningProcedures.pop();
                 }
 
-                assert(context != nullptr);
-                break;
+                continue;
             }
 
-            if (errno != EINTR)
+#ifdef SYST_IO_URING
+            if (contextPair == &ringEventContext)
             {
-                throw std::runtime_error("Dispatcher::dispatch, epoll_wait failed, " + lastErrorMessage());
+                uint64_t buf;
+                if (read(ring->getEventFd(), &buf, sizeof buf) == -1 && errno != EAGAIN)
+                {
+                    throw std::runtime_error("Dispatcher::dispatch, read(ringEvent) failed, " + lastErrorMessage());
+                }
+
+                ring->processCompletions();
+                continue;
             }
-        }
+#endif
 
-        if (context != currentContext)
-        {
-            ucontext_t *oldContext = static_cast<ucontext_t *>(currentContext->ucontext);
-            currentContext = context;
-            if (swapcontext(oldContext, static_cast<ucontext_t *>(context->ucontext)) == -1)
+            /* A connection's registration is permanent, so a read and a write
+               can both be waiting on one event. An error or hang up wakes
+               both, so they find out. Nobody waiting is fine too, the next
+               read or write tries the socket before waiting. */
+            const uint32_t readEvents = EPOLLIN | EPOLLERR | EPOLLHUP;
+            const uint32_t writeEvents = EPOLLOUT | EPOLLERR | EPOLLHUP;
+
+            if ((events[i].events & readEvents) != 0 && contextPair->readContext != nullptr)
             {
-                throw std::runtime_error("Dispatcher::dispatch, swapcontext failed, " + lastErrorMessage());
+                resumeOperation(contextPair->readContext, events[i].events);
             }
+
+            if ((events[i].events & writeEvents) != 0 && contextPair->writeContext != nullptr)
+            {
+                resumeOperation(contextPair->writeContext, events[i].events);
+            }
+        }
+    }
+
+    void Dispatcher::resumeOperation(OperationContext *operation, uint32_t events)
+    {
+        operation->events = events;
+
+        if (operation->context != nullptr)
+        {
+            /* It has what it was waiting for, interrupting it now would
+               only undo that */
+            operation->context->interruptProcedure = nullptr;
+            pushContext(operation->context);
         }
     }
 
@@ -379,10 +447,18 @@ namespace syst
 
     void Dispatcher::yield()
     {
+#ifdef SYST_IO_URING
+        if (ring != nullptr)
+        {
+            ring->submit();
+            ring->processCompletions();
+        }
+#endif
+
         for (;;)
         {
-            epoll_event events[16];
-            int count = epoll_wait(epoll, events, 16, 0);
+            epoll_event events[MAX_EVENTS];
+            int count = epoll_wait(epoll, events, MAX_EVENTS, 0);
             if (count == 0)
             {
                 break;
@@ -390,56 +466,12 @@ namespace syst
 
             if (count > 0)
             {
-                for (int i = 0; i < count; ++i)
-                {
-                    ContextPair *contextPair = static_cast<ContextPair *>(events[i].data.ptr);
-                    if (((events[i].events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr)
-                    {
-                        uint64_t buf;
-                        auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
-                        if (transferred == -1)
-                        {
-                            throw std::runtime_error("Dispatcher::dispatch, read(remoteSpawnEvent) failed, " + lastErrorMessage());
-                        }
+                processEvents(events, count);
 
-                        MutextGuard guard(*reinterpret_cast<pthread_mutex_t *>(this->mutex));
-                        while (!remoteSpawningProcedures.empty())
-                        {
-                            spawn(std::move(remoteSpawningProcedures.front()));
-                            remoteSpawningProcedures.pop();
-                        }
-
-                        continue;
-                    }
-
-                    if ((events[i].events & EPOLLOUT) != 0)
-                    {
-                        if (contextPair->writeContext != nullptr)
-                        {
-                            if (contextPair->writeContext->context != nullptr)
-                            {
-                                contextPair->writeContext->context->interruptProcedure = nullptr;
-                            }
-                            pushContext(contextPair->writeContext->context);
-                            contextPair->writeContext->events = events[i].events;
-                        }
-                    }
-                    else if ((events[i].events & EPOLLIN) != 0)
-                    {
-                        if (contextPair->readContext != nullptr)
-                        {
-                            if (contextPair->readContext->context != nullptr)
-                            {
-                                contextPair->readContext->context->interruptProcedure = nullptr;
-                            }
-                            pushContext(contextPair->readContext->context);
-                            contextPair->readContext->events = events[i].events;
-                        }
-                    }
-                    else
-                    {
-                        continue;
-                    }
+                /* Got a full batch, there may be more */
+                if (count < MAX_EVENTS)
+                {
+                    break;
                 }
             }
             else
@@ -463,33 +495,58 @@ namespace syst
         return epoll;
     }
 
+    Uring *Dispatcher::getRing() const
+    {
+        return ring;
+    }
+
+    void Dispatcher::setupRing()
+    {
+        ring = nullptr;
+
+#ifdef SYST_IO_URING
+        /* io_uring is often disabled, in containers especially, so carry on
+           with epoll if it's not available */
+        try
+        {
+            ring = new Uring(*this);
+        }
+        catch (std::exception &)
+        {
+            return;
+        }
+
+        ringEventContext.readContext = nullptr;
+        ringEventContext.writeContext = nullptr;
+
+        epoll_event ringEvent;
+        ringEvent.events = EPOLLIN;
+        ringEvent.data.ptr = &ringEventContext;
+
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, ring->getEventFd(), &ringEvent) == -1)
+        {
+            delete ring;
+            ring = nullptr;
+        }
+#endif
+    }
+
     NativeContext &Dispatcher::getReusableContext()
     {
         if (firstReusableContext == nullptr)
         {
-            ucontext_t *newlyCreatedContext = new ucontext_t;
-            if (getcontext(newlyCreatedContext) == -1)
-            { // makecontext precondition
-                throw std::runtime_error("Dispatcher::getReusableContext, getcontext failed, " + lastErrorMessage());
-            }
-
             auto stackPointer = new uint8_t[STACK_SIZE];
-            newlyCreatedContext->uc_stack.ss_sp = stackPointer;
-            newlyCreatedContext->uc_stack.ss_size = STACK_SIZE;
 
-            ContextMakingData makingContextData{this, newlyCreatedContext};
-            makecontext(newlyCreatedContext, (void (*)())contextProcedureStatic, 1, reinterpret_cast<int *>(&makingContextData));
+            ContextMakingData makingContextData{this, nullptr};
+            void *newlyCreatedContext = makeContext(stackPointer, STACK_SIZE, contextProcedureStatic, &makingContextData);
+            makingContextData.ucontext = newlyCreatedContext;
 
-            ucontext_t *oldContext = static_cast<ucontext_t *>(currentContext->ucontext);
-            if (swapcontext(oldContext, newlyCreatedContext) == -1)
-            {
-                throw std::runtime_error("Dispatcher::getReusableContext, swapcontext failed, " + lastErrorMessage());
-            }
+            /* Runs until the new context has set itself up, and switches back */
+            switchContext(&currentContext->ucontext, newlyCreatedContext);
 
             assert(firstReusableContext != nullptr);
-            assert(firstReusableContext->ucontext == newlyCreatedContext);
             firstReusableContext->stackPtr = stackPointer;
-        };
+        }
 
         NativeContext *context = firstReusableContext;
         firstReusableContext = firstReusableContext->next;
@@ -541,11 +598,7 @@ namespace syst
         context.next = nullptr;
         context.inExecutionQueue = false;
         firstReusableContext = &context;
-        ucontext_t *oldContext = static_cast<ucontext_t *>(context.ucontext);
-        if (swapcontext(oldContext, static_cast<ucontext_t *>(currentContext->ucontext)) == -1)
-        {
-            throw std::runtime_error("Dispatcher::contextProcedure, swapcontext failed, " + lastErrorMessage());
-        }
+        switchContext(&context.ucontext, currentContext->ucontext);
 
         for (;;)
         {
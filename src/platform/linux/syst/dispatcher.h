@@ -16,13 +16,17 @@
 #include <bits/reg.h>
 #endif
 
+struct epoll_event;
+
 namespace syst
 {
 
     struct NativeContextGroup;
+    class Uring;
 
     struct NativeContext
     {
+        /* See context.h */
         void *ucontext;
         void *stackPtr;
         bool interrupted;
@@ -80,6 +84,10 @@ namespace syst
         int getTimer();
         void pushTimer(int timer);
 
+        /* The io_uring the completion based operations use, or nullptr if
+           built without SYST_IO_URING, or the kernel won't set one up */
+        Uring *getRing() const;
+
 #ifdef __x86_64__
 #if __WORDSIZE == 64
         static const int SIZEOF_PTHREAD_MUTEX_T = 40;
@@ -94,12 +102,17 @@ namespace syst
 
     private:
         void spawn(std::function<void()> &&procedure);
+        void processEvents(const epoll_event *events, int count);
+        void resumeOperation(OperationContext *operation, uint32_t events);
+        void setupRing();
         int epoll;
         alignas(void *) uint8_t mutex[SIZEOF_PTHREAD_MUTEX_T];
         int remoteSpawnEvent;
         ContextPair remoteSpawnEventContext;
         std::queue<std::function<void()>> remoteSpawningProcedures;
         std::stack<int> timers;
+        Uring *ring;
+        ContextPair ringEventContext;
 
         NativeContext mainContext;
         NativeContextGroup contextGroup;
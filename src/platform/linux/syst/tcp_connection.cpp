@@ -7,19 +7,33 @@
 
 #include "tcp_connection.h"
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <arpa/inet.h>
 #include <cassert>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <syst/error_message.h>
 #include <syst/interrupted_exception.h>
 #include <syst/ipv4_address.h>
 
+#include "uring.h"
+
 namespace syst
 {
 
+    namespace
+    {
+
+        /* Well under IOV_MAX, and plenty to fill the socket buffer */
+        const std::size_t MAX_WRITE_BUFFERS = 64;
+
+    }
+
     TcpConnection::TcpConnection() : dispatcher(nullptr)
     {
     }
@@ -33,6 +47,11 @@ namespace syst
             connection = other.connection;
             contextPair = other.contextPair;
             other.dispatcher = nullptr;
+
+            if (dispatcher->getRing() == nullptr)
+            {
+                registerConnection(EPOLL_CTL_MOD);
+            }
         }
     }
 
@@ -70,6 +89,11 @@ namespace syst
             connection = other.connection;
             contextPair = other.contextPair;
             other.dispatcher = nullptr;
+
+            if (dispatcher->getRing() == nullptr)
+            {
+                registerConnection(EPOLL_CTL_MOD);
+            }
         }
 
         return *this;
@@ -84,107 +108,44 @@ namespace syst
             throw InterruptedException();
         }
 
-        std::string message;
-        ssize_t transferred = ::recv(connection, (void *)data, size, 0);
-        if (transferred == -1)
+#ifdef SYST_IO_URING
+        if (dispatcher->getRing() != nullptr)
+        {
+            return ringRead(data, size);
+        }
+#endif
+
+        for (;;)
         {
+            ssize_t transferred = ::recv(connection, (void *)data, size, 0);
+            if (transferred != -1)
+            {
+                assert(transferred <= static_cast<ssize_t>(size));
+                return transferred;
+            }
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wlogical-op"
             if (errno != EAGAIN && errno != EWOULDBLOCK)
             {
 #pragma GCC diagnostic pop
-                message = "recv failed, " + lastErrorMessage();
+                throw std::runtime_error("TcpConnection::read, recv failed, " + lastErrorMessage());
             }
-            else
+
+            if ((waitForEvent(contextPair.readContext) & (EPOLLERR | EPOLLHUP)) != 0)
             {
-                epoll_event connectionEvent;
-                OperationContext operationContext;
-                operationContext.interrupted = false;
-                operationContext.context = dispatcher->getCurrentContext();
-                contextPair.readContext = &operationContext;
-                connectionEvent.data.ptr = &contextPair;
-
-                if (contextPair.writeContext != nullptr)
+                /* Whatever is left in the socket can still be read, and an
+                   error is returned by recv, so only give up if neither */
+                transferred = ::recv(connection, (void *)data, size, 0);
+                if (transferred != -1)
                 {
-                    connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLONESHOT;
-                }
-                else
-                {
-                    connectionEvent.events = EPOLLIN | EPOLLONESHOT;
+                    assert(transferred <= static_cast<ssize_t>(size));
+                    return transferred;
                 }
 
-                if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1)
-                {
-                    message = "epoll_ctl failed, " + lastErrorMessage();
-                }
-                else
-                {
-                    dispatcher->getCurrentContext()->interruptProcedure = [&]()
-                    {
-                        assert(dispatcher != nullptr);
-                        assert(contextPair.readContext != nullptr);
-                        epoll_event connectionEvent;
-                        connectionEvent.events = EPOLLONESHOT;
-                        connectionEvent.data.ptr = nullptr;
-
-                        if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1)
-                        {
-                            throw std::runtime_error("TcpConnection::read, interrupt procedure, epoll_ctl failed, " + lastErrorMessage());
-                        }
-
-                        contextPair.readContext->interrupted = true;
-                        dispatcher->pushContext(contextPair.readContext->context);
-                    };
-
-                    dispatcher->dispatch();
-                    dispatcher->getCurrentContext()->interruptProcedure = nullptr;
-                    assert(dispatcher != nullptr);
-                    assert(operationContext.context == dispatcher->getCurrentContext());
-                    assert(contextPair.readContext == &operationContext);
-
-                    if (operationContext.interrupted)
-                    {
-                        contextPair.readContext = nullptr;
-                        throw InterruptedException();
-                    }
-
-                    contextPair.readContext = nullptr;
-                    if (contextPair.writeContext != nullptr)
-                    { // write is presented, rearm
-                        epoll_event connectionEvent;
-                        connectionEvent.events = EPOLLOUT | EPOLLONESHOT;
-                        connectionEvent.data.ptr = &contextPair;
-
-                        if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1)
-                        {
-                            message = "epoll_ctl failed, " + lastErrorMessage();
-                            throw std::runtime_error("TcpConnection::read");
-                        }
-                    }
-
-                    if ((operationContext.events & (EPOLLERR | EPOLLHUP)) != 0)
-                    {
-                        throw std::runtime_error("TcpConnection::read");
-                    }
-
-                    ssize_t transferred = ::recv(connection, (void *)data, size, 0);
-                    if (transferred == -1)
-                    {
-                        message = "recv failed, " + lastErrorMessage();
-                    }
-                    else
-                    {
-                        assert(transferred <= static_cast<ssize_t>(size));
-                        return transferred;
-                    }
-                }
+                throw std::runtime_error("TcpConnection::read, recv failed, " + lastErrorMessage());
             }
-
-            throw std::runtime_error("TcpConnection::read, " + message);
         }
-
-        assert(transferred <= static_cast<ssize_t>(size));
-        return transferred;
     }
 
     std::size_t TcpConnection::write(const uint8_t *data, size_t size)
@@ -196,7 +157,6 @@ namespace syst
             throw InterruptedException();
         }
 
-        std::string message;
         if (size == 0)
         {
             if (shutdown(connection, SHUT_WR) == -1)
@@ -207,106 +167,204 @@ namespace syst
             return 0;
         }
 
-        ssize_t transferred = ::send(connection, (void *)data, size, MSG_NOSIGNAL);
-        if (transferred == -1)
+        const std::pair<const uint8_t *, std::size_t> buffer(data, size);
+
+        return writev(&buffer, 1);
+    }
+
+    std::size_t TcpConnection::writev(const std::pair<const uint8_t *, std::size_t> *buffers, std::size_t count)
+    {
+        assert(dispatcher != nullptr);
+        assert(contextPair.writeContext == nullptr);
+        if (dispatcher->interrupted())
+        {
+            throw InterruptedException();
+        }
+
+        iovec vectors[MAX_WRITE_BUFFERS];
+        count = std::min(count, MAX_WRITE_BUFFERS);
+
+        size_t size = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            vectors[i].iov_base = const_cast<uint8_t *>(buffers[i].first);
+            vectors[i].iov_len = buffers[i].second;
+            size += buffers[i].second;
+        }
+
+        msghdr header = {};
+        header.msg_iov = vectors;
+        header.msg_iovlen = count;
+
+#ifdef SYST_IO_URING
+        if (dispatcher->getRing() != nullptr)
+        {
+            const size_t transferred = ringWrite(header);
+            assert(transferred <= size);
+            return transferred;
+        }
+#endif
+
+        for (;;)
         {
+            ssize_t transferred = ::sendmsg(connection, &header, MSG_NOSIGNAL);
+            if (transferred != -1)
+            {
+                assert(transferred <= static_cast<ssize_t>(size));
+                return transferred;
+            }
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wlogical-op"
             if (errno != EAGAIN && errno != EWOULDBLOCK)
             {
 #pragma GCC diagnostic pop
-                message = "send failed, " + lastErrorMessage();
+                throw std::runtime_error("TcpConnection::write, send failed, " + lastErrorMessage());
             }
-            else
+
+            if ((waitForEvent(contextPair.writeContext) & (EPOLLERR | EPOLLHUP)) != 0)
             {
-                epoll_event connectionEvent;
-                OperationContext operationContext;
-                operationContext.interrupted = false;
-                operationContext.context = dispatcher->getCurrentContext();
-                contextPair.writeContext = &operationContext;
-                connectionEvent.data.ptr = &contextPair;
-
-                if (contextPair.readContext != nullptr)
-                {
-                    connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLONESHOT;
-                }
-                else
+                transferred = ::sendmsg(connection, &header, MSG_NOSIGNAL);
+                if (transferred != -1)
                 {
-                    connectionEvent.events = EPOLLOUT | EPOLLONESHOT;
+                    assert(transferred <= static_cast<ssize_t>(size));
+                    return transferred;
                 }
 
-                if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1)
-                {
-                    message = "epoll_ctl failed, " + lastErrorMessage();
-                }
-                else
-                {
-                    dispatcher->getCurrentContext()->interruptProcedure = [&]()
-                    {
-                        assert(dispatcher != nullptr);
-                        assert(contextPair.writeContext != nullptr);
-                        epoll_event connectionEvent;
-                        connectionEvent.events = EPOLLONESHOT;
-                        connectionEvent.data.ptr = nullptr;
-
-                        if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1)
-                        {
-                            throw std::runtime_error("TcpConnection::write, interrupt procedure, epoll_ctl failed, " + lastErrorMessage());
-                        }
-
-                        contextPair.writeContext->interrupted = true;
-                        dispatcher->pushContext(contextPair.writeContext->context);
-                    };
-
-                    dispatcher->dispatch();
-                    dispatcher->getCurrentContext()->interruptProcedure = nullptr;
-                    assert(dispatcher != nullptr);
-                    assert(operationContext.context == dispatcher->getCurrentContext());
-                    assert(contextPair.writeContext == &operationContext);
-
-                    if (operationContext.interrupted)
-                    {
-                        contextPair.writeContext = nullptr;
-                        throw InterruptedException();
-                    }
-
-                    contextPair.writeContext = nullptr;
-                    if (contextPair.readContext != nullptr)
-                    { // read is presented, rearm
-                        epoll_event connectionEvent;
-                        connectionEvent.events = EPOLLIN | EPOLLONESHOT;
-                        connectionEvent.data.ptr = &contextPair;
-
-                        if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1)
-                        {
-                            message = "epoll_ctl failed, " + lastErrorMessage();
-                            throw std::runtime_error("TcpConnection::write, " + message);
-                        }
-                    }
-
-                    if ((operationContext.events & (EPOLLERR | EPOLLHUP)) != 0)
-                    {
-                        throw std::runtime_error("TcpConnection::write, events & (EPOLLERR | EPOLLHUP) != 0");
-                    }
-
-                    ssize_t transferred = ::send(connection, (void *)data, size, 0);
-                    if (transferred == -1)
-                    {
-                        message = "send failed, " + lastErrorMessage();
-                    }
-                    else
-                    {
-                        assert(transferred <= static_cast<ssize_t>(size));
-                        return transferred;
-                    }
-                }
+                throw std::runtime_error("TcpConnection::write, send failed, " + lastErrorMessage());
             }
+        }
+    }
+
+#ifdef SYST_IO_URING
+
+    size_t TcpConnection::ringRead(uint8_t *data, size_t size)
+    {
+        Uring &ring = *dispatcher->getRing();
+
+        /* Levin headers, and most messages, fit in a registered buffer, which
+           saves the kernel pinning the pages of the caller's buffer for each
+           read. Anything bigger goes straight to the caller's buffer. */
+        const int buffer = size <= ring.getBufferSize() ? ring.takeBuffer() : -1;
 
-            throw std::runtime_error("TcpConnection::write, " + message);
+        io_uring_sqe &submission = ring.getSubmission();
+        submission.fd = connection;
+        submission.len = static_cast<uint32_t>(size);
+
+        if (buffer != -1)
+        {
+            submission.opcode = IORING_OP_READ_FIXED;
+            submission.addr = reinterpret_cast<uint64_t>(ring.getBuffer(buffer));
+            submission.buf_index = static_cast<uint16_t>(buffer);
         }
+        else
+        {
+            submission.opcode = IORING_OP_RECV;
+            submission.addr = reinterpret_cast<uint64_t>(data);
+        }
+
+        UringOperation operation;
+        ring.wait(submission, operation);
+
+        if (buffer != -1)
+        {
+            if (operation.result > 0)
+            {
+                std::memcpy(data, ring.getBuffer(buffer), operation.result);
+            }
 
-        assert(transferred <= static_cast<ssize_t>(size));
-        return transferred;
+            ring.returnBuffer(buffer);
+        }
+
+        if (operation.interrupted)
+        {
+            throw InterruptedException();
+        }
+
+        if (operation.result < 0)
+        {
+            throw std::runtime_error("TcpConnection::read, recv failed, " + errorMessage(-operation.result));
+        }
+
+        assert(static_cast<size_t>(operation.result) <= size);
+        return operation.result;
+    }
+
+    size_t TcpConnection::ringWrite(msghdr &header)
+    {
+        Uring &ring = *dispatcher->getRing();
+
+        io_uring_sqe &submission = ring.getSubmission();
+        submission.opcode = IORING_OP_SENDMSG;
+        submission.fd = connection;
+        submission.addr = reinterpret_cast<uint64_t>(&header);
+        submission.msg_flags = MSG_NOSIGNAL;
+
+        UringOperation operation;
+        ring.wait(submission, operation);
+
+        if (operation.interrupted)
+        {
+            throw InterruptedException();
+        }
+
+        if (operation.result < 0)
+        {
+            throw std::runtime_error("TcpConnection::write, send failed, " + errorMessage(-operation.result));
+        }
+
+        return operation.result;
+    }
+
+#endif
+
+    uint32_t TcpConnection::waitForEvent(OperationContext *&operation)
+    {
+        /* The socket stays registered for both directions, so waiting is only
+           a matter of saying who to wake. Being woken doesn't promise the
+           socket is ready - an edge may have been reported for data that was
+           already read - so callers retry until it is. */
+        OperationContext operationContext;
+        operationContext.interrupted = false;
+        operationContext.context = dispatcher->getCurrentContext();
+        operationContext.events = 0;
+        operation = &operationContext;
+
+        dispatcher->getCurrentContext()->interruptProcedure = [&]()
+        {
+            assert(dispatcher != nullptr);
+            assert(operation == &operationContext);
+            operationContext.interrupted = true;
+            dispatcher->pushContext(operationContext.context);
+        };
+
+        dispatcher->dispatch();
+        dispatcher->getCurrentContext()->interruptProcedure = nullptr;
+        assert(dispatcher != nullptr);
+        assert(operationContext.context == dispatcher->getCurrentContext());
+        assert(operation == &operationContext);
+
+        operation = nullptr;
+
+        if (operationContext.interrupted)
+        {
+            throw InterruptedException();
+        }
+
+        return operationContext.events;
+    }
+
+    void TcpConnection::registerConnection(int operation)
+    {
+        epoll_event connectionEvent;
+        connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        connectionEvent.data.ptr = &contextPair;
+
+        if (epoll_ctl(dispatcher->getEpoll(), operation, connection, &connectionEvent) == -1)
+        {
+            throw std::runtime_error("TcpConnection, epoll_ctl failed, " + lastErrorMessage());
+        }
     }
 
     std::pair<Ipv4Address, uint16_t> TcpConnection::getPeerAddressAndPort() const
@@ -326,13 +384,14 @@ namespace syst
     {
         contextPair.readContext = nullptr;
         contextPair.writeContext = nullptr;
-        epoll_event connectionEvent;
-        connectionEvent.events = EPOLLONESHOT;
-        connectionEvent.data.ptr = nullptr;
 
-        if (epoll_ctl(dispatcher.getEpoll(), EPOLL_CTL_ADD, socket, &connectionEvent) == -1)
+        /* Registered once, for good. Edge triggered, so it only reports new
+           data or new buffer space, and reads and writes don't have to
+           re-arm it every time they wait. Not needed at all when reads and
+           writes go through the ring. */
+        if (dispatcher.getRing() == nullptr)
         {
-            throw std::runtime_error("TcpConnection::TcpConnection, epoll_ctl failed, " + lastErrorMessage());
+            registerConnection(EPOLL_CTL_ADD);
         }
     }
 
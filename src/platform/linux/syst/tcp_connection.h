@@ -10,8 +10,12 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 #include "dispatcher.h"
 
+struct msghdr;
+
 namespace syst
 {
 
@@ -28,6 +32,15 @@ namespace syst
         TcpConnection &operator=(TcpConnection &&other);
         std::size_t read(uint8_t *data, std::size_t size);
         std::size_t write(const uint8_t *data, std::size_t size);
+
+        /* Writes as much of the buffers, in order, as can go in one gathering
+           write, and returns how many bytes that was */
+        std::size_t writev(const std::pair<const uint8_t *, std::size_t> *buffers, std::size_t count);
+
+        /* Writes all of the buffers, in order, however many writes that
+           takes. The buffers are used up as they're written. Defined once for
+           every platform, in syst/tcp_connection_write.cpp. */
+        void writevAll(std::vector<std::pair<const uint8_t *, std::size_t>> &buffers);
         std::pair<Ipv4Address, uint16_t> getPeerAddressAndPort() const;
 
     private:
@@ -39,6 +52,13 @@ namespace syst
         ContextPair contextPair;
 
         TcpConnection(Dispatcher &dispatcher, int socket);
+        uint32_t waitForEvent(OperationContext *&operation);
+        void registerConnection(int operation);
+
+#ifdef SYST_IO_URING
+        std::size_t ringRead(uint8_t *data, std::size_t size);
+        std::size_t ringWrite(msghdr &header);
+#endif
     };
 
 }
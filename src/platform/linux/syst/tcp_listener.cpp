@@ -7,6 +7,7 @@
 
 #include "tcp_listener.h"
 #include <cassert>
+#include <deque>
 #include <stdexcept>
 
 #include <fcntl.h>
@@ -17,6 +18,7 @@
 
 #include "dispatcher.h"
 #include "tcp_connection.h"
+#include "uring.h"
 #include <syst/error_message.h>
 #include <syst/interrupted_exception.h>
 #include <syst/ipv4_address.h>
@@ -24,10 +26,145 @@
 namespace syst
 {
 
+#ifdef SYST_IO_URING
+
+    namespace
+    {
+
+        /* Accepted connections held while nobody is accepting, any more wait
+           in the listen backlog instead */
+        const size_t MAX_QUEUED_ACCEPTS = 64;
+
+        /* A multishot accept - armed once, it completes with every connection
+           the listener accepts until it's cancelled or fails, so a busy
+           listener doesn't need a system call per connection. Lives on the
+           heap, as the kernel holds its address, and may outlive the listener
+           until its last completion arrives. */
+        struct RingAccept : public UringOperation
+        {
+            std::deque<int> accepted;
+            int error = 0;
+            bool armed = false;
+
+            /* Cancelled as the queue is full, armed again once it's empty */
+            bool cancelling = false;
+
+            /* Multishot accept needs 5.19 */
+            bool multishot = true;
+
+            /* The listener has gone, free this once the kernel is done */
+            bool orphaned = false;
+
+            void arm(Uring &ring, int listener)
+            {
+                io_uring_sqe &submission = ring.getSubmission();
+                submission.opcode = IORING_OP_ACCEPT;
+                submission.fd = listener;
+                submission.accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+
+                if (multishot)
+                {
+                    submission.ioprio = IORING_ACCEPT_MULTISHOT;
+                }
+
+                ring.start(submission, *this);
+                armed = true;
+            }
+
+            void closeAccepted()
+            {
+                for (const int socket : accepted)
+                {
+                    close(socket);
+                }
+
+                accepted.clear();
+            }
+
+            void complete(Dispatcher &dispatcher, int32_t result, uint32_t flags) override
+            {
+                if ((flags & IORING_CQE_F_MORE) == 0)
+                {
+                    armed = false;
+                    cancelling = false;
+                }
+
+                if (result >= 0)
+                {
+                    accepted.push_back(result);
+
+                    if (armed && !cancelling && accepted.size() >= MAX_QUEUED_ACCEPTS)
+                    {
+                        dispatcher.getRing()->cancel(*this);
+                        cancelling = true;
+                    }
+                }
+                else if (result == -EINVAL && multishot)
+                {
+                    /* Older kernel, fall back to arming it per connection */
+                    multishot = false;
+                }
+                else if (result != -ECANCELED)
+                {
+                    error = -result;
+                }
+
+                if (orphaned)
+                {
+                    closeAccepted();
+
+                    if (!armed)
+                    {
+                        delete this;
+                    }
+
+                    return;
+                }
+
+                /* Cleared, so an interrupt before the context runs doesn't
+                   resume it a second time */
+                if (context != nullptr)
+                {
+                    dispatcher.pushContext(context);
+                    context = nullptr;
+                }
+            }
+        };
+
+    }
+
+#endif
+
     TcpListener::TcpListener() : dispatcher(nullptr)
     {
     }
 
+    void TcpListener::releaseRingAccept()
+    {
+#ifdef SYST_IO_URING
+        if (ringAccept == nullptr)
+        {
+            return;
+        }
+
+        RingAccept *state = static_cast<RingAccept *>(ringAccept);
+        ringAccept = nullptr;
+
+        state->closeAccepted();
+
+        if (state->armed)
+        {
+            /* Its last completion frees it */
+            state->orphaned = true;
+            dispatcher->getRing()->cancel(*state);
+        }
+        else
+        {
+            delete state;
+        }
+#endif
+    }
+
     TcpListener::TcpListener(Dispatcher &dispatcher, const Ipv4Address &addr, uint16_t port) : dispatcher(&dispatcher)
     {
         std::string message;
@@ -77,6 +214,15 @@ namespace syst
                         else
                         {
                             context = nullptr;
+                            ringAccept = nullptr;
+
+#ifdef SYST_IO_URING
+                            if (dispatcher.getRing() != nullptr)
+                            {
+                                ringAccept = new RingAccept();
+                            }
+#endif
+
                             return;
                         }
                     }
@@ -100,6 +246,7 @@ namespace syst
             assert(other.context == nullptr);
             listener = other.listener;
             context = nullptr;
+            ringAccept = other.ringAccept;
             other.dispatcher = nullptr;
         }
     }
@@ -109,6 +256,7 @@ namespace syst
         if (dispatcher != nullptr)
         {
             assert(context == nullptr);
+            releaseRingAccept();
             int result = close(listener);
             if (result)
             {
@@ -122,6 +270,7 @@ namespace syst
         if (dispatcher != nullptr)
         {
             assert(context == nullptr);
+            releaseRingAccept();
             if (close(listener) == -1)
             {
                 throw std::runtime_error("TcpListener::operator=, close failed, " + lastErrorMessage());
@@ -134,6 +283,7 @@ namespace syst
             assert(other.context == nullptr);
             listener = other.listener;
             context = nullptr;
+            ringAccept = other.ringAccept;
             other.dispatcher = nullptr;
         }
 
@@ -149,6 +299,13 @@ namespace syst
             throw InterruptedException();
         }
 
+#ifdef SYST_IO_URING
+        if (ringAccept != nullptr)
+        {
+            return ringAcceptConnection();
+        }
+#endif
+
         ContextPair contextPair;
         OperationContext listenerContext;
         listenerContext.interrupted = false;
@@ -237,4 +394,60 @@ namespace syst
         throw std::runtime_error("TcpListener::accept, " + message);
     }
 
+#ifdef SYST_IO_URING
+
+    TcpConnection TcpListener::ringAcceptConnection()
+    {
+        RingAccept &state = *static_cast<RingAccept *>(ringAccept);
+
+        while (state.accepted.empty())
+        {
+            if (state.error != 0)
+            {
+                const int error = state.error;
+                state.error = 0;
+                throw std::runtime_error("TcpListener::accept, accept failed, " + errorMessage(error));
+            }
+
+            if (!state.armed)
+            {
+                state.arm(*dispatcher->getRing(), listener);
+            }
+
+            /* The accept carries on regardless, so an interrupt only has to
+               stop waiting for it */
+            bool interrupted = false;
+
+            state.context = dispatcher->getCurrentContext();
+            context = &state;
+            dispatcher->getCurrentContext()->interruptProcedure = [&]()
+            {
+                interrupted = true;
+
+                if (state.context != nullptr)
+                {
+                    dispatcher->pushContext(state.context);
+                    state.context = nullptr;
+                }
+            };
+
+            dispatcher->dispatch();
+            dispatcher->getCurrentContext()->interruptProcedure = nullptr;
+            assert(state.context == nullptr);
+            context = nullptr;
+
+            if (interrupted)
+            {
+                throw InterruptedException();
+            }
+        }
+
+        const int connection = state.accepted.front();
+        state.accepted.pop_front();
+
+        return TcpConnection(*dispatcher, connection);
+    }
+
+#endif
+
 }
@@ -33,6 +33,15 @@ namespace syst
         Dispatcher *dispatcher;
         void *context;
         int listener;
+
+        /* Connections accepted by the ring, when there is one */
+        void *ringAccept;
+
+        void releaseRingAccept();
+
+#ifdef SYST_IO_URING
+        TcpConnection ringAcceptConnection();
+#endif
     };
 
 }
@@ -7,6 +7,7 @@
 
 #include "timer.h"
 #include <cassert>
+#include <cerrno>
 #include <stdexcept>
 
 #include <sys/timerfd.h>
@@ -14,6 +15,7 @@
 #include <unistd.h>
 
 #include "dispatcher.h"
+#include "uring.h"
 #include <syst/error_message.h>
 #include <syst/interrupted_exception.h>
 
@@ -73,6 +75,39 @@ namespace syst
         {
             dispatcher->yield();
         }
+#ifdef SYST_IO_URING
+        else if (dispatcher->getRing() != nullptr)
+        {
+            /* A ring timeout needs no timerfd, nor a system call to arm it */
+            Uring &ring = *dispatcher->getRing();
+
+            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(duration);
+            __kernel_timespec expires;
+            expires.tv_sec = seconds.count();
+            expires.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(duration - seconds).count();
+
+            io_uring_sqe &submission = ring.getSubmission();
+            submission.opcode = IORING_OP_TIMEOUT;
+            submission.fd = -1;
+            submission.addr = reinterpret_cast<uint64_t>(&expires);
+            submission.len = 1;
+
+            UringOperation operation;
+            context = &operation;
+            ring.wait(submission, operation);
+            context = nullptr;
+
+            if (operation.interrupted)
+            {
+                throw InterruptedException();
+            }
+
+            if (operation.result != -ETIME)
+            {
+                throw std::runtime_error("Timer::sleep, timeout failed, " + errorMessage(-operation.result));
+            }
+        }
+#endif
         else
         {
             timer = dispatcher->getTimer();
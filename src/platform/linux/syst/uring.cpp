@@ -0,0 +1,424 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "uring.h"
+
+#ifdef SYST_IO_URING
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "dispatcher.h"
+#include "error_message.h"
+
+namespace syst
+{
+
+    namespace
+    {
+
+        const unsigned RING_ENTRIES = 256;
+
+        /* Enough for a levin header and most small messages in one go */
+        const size_t REGISTERED_BUFFER_SIZE = 16 * 1024;
+        const size_t REGISTERED_BUFFER_COUNT = 64;
+
+        int setup(unsigned entries, io_uring_params &params)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        }
+
+        int enter(int ring, unsigned toSubmit, unsigned minComplete, unsigned flags)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, nullptr, 0));
+        }
+
+        int registerRing(int ring, unsigned opcode, const void *argument, unsigned count)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_register, ring, opcode, argument, count));
+        }
+
+        uint32_t loadAcquire(const uint32_t *value)
+        {
+            return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+        }
+
+        void storeRelease(uint32_t *value, uint32_t newValue)
+        {
+            __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+        }
+
+    }
+
+    void UringOperation::complete(Dispatcher &dispatcher, int32_t result, uint32_t)
+    {
+        this->result = result;
+        completed = true;
+        dispatcher.pushContext(context);
+    }
+
+    Uring::Uring(Dispatcher &dispatcher) : dispatcher(dispatcher), pending(0), inFlight(0)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        /* Nothing here needs completions the moment they happen, as the
+           dispatcher only looks when it's about to wait anyway, so don't
+           interrupt the thread for them. Needs 5.19. */
+        params.flags = IORING_SETUP_COOP_TASKRUN;
+
+        ring = setup(RING_ENTRIES, params);
+
+        if (ring == -1 && errno == EINVAL)
+        {
+            std::memset(&params, 0, sizeof(params));
+            ring = setup(RING_ENTRIES, params);
+        }
+
+        if (ring == -1)
+        {
+            throw std::runtime_error("Uring::Uring, io_uring_setup failed, " + lastErrorMessage());
+        }
+
+        std::string message;
+
+        submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        submissionsSize = params.sq_entries * sizeof(io_uring_sqe);
+
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+        {
+            submissionRingSize = std::max(submissionRingSize, completionRingSize);
+            completionRingSize = submissionRingSize;
+        }
+
+        void *mapped = mmap(nullptr, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        if (mapped == MAP_FAILED)
+        {
+            message = "mmap failed, " + lastErrorMessage();
+        }
+        else
+        {
+            submissionRing = static_cast<uint8_t *>(mapped);
+
+            if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+            {
+                completionRing = submissionRing;
+            }
+            else
+            {
+                mapped = mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+                completionRing = mapped == MAP_FAILED ? nullptr : static_cast<uint8_t *>(mapped);
+            }
+
+            if (completionRing == nullptr)
+            {
+                message = "mmap failed, " + lastErrorMessage();
+            }
+            else
+            {
+                mapped = mmap(nullptr, submissionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+                if (mapped == MAP_FAILED)
+                {
+                    message = "mmap failed, " + lastErrorMessage();
+                }
+                else
+                {
+                    submissions = static_cast<io_uring_sqe *>(mapped);
+
+                    submissionHead = reinterpret_cast<uint32_t *>(submissionRing + params.sq_off.head);
+                    submissionTail = reinterpret_cast<uint32_t *>(submissionRing + params.sq_off.tail);
+                    submissionFlags = reinterpret_cast<uint32_t *>(submissionRing + params.sq_off.flags);
+                    submissionMask = *reinterpret_cast<uint32_t *>(submissionRing + params.sq_off.ring_mask);
+                    submissionEntries = *reinterpret_cast<uint32_t *>(submissionRing + params.sq_off.ring_entries);
+                    submissionArray = reinterpret_cast<uint32_t *>(submissionRing + params.sq_off.array);
+
+                    completionHead = reinterpret_cast<uint32_t *>(completionRing + params.cq_off.head);
+                    completionTail = reinterpret_cast<uint32_t *>(completionRing + params.cq_off.tail);
+                    completionMask = *reinterpret_cast<uint32_t *>(completionRing + params.cq_off.ring_mask);
+                    completions = reinterpret_cast<io_uring_cqe *>(completionRing + params.cq_off.cqes);
+
+                    eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                    if (eventFd == -1)
+                    {
+                        message = "eventfd failed, " + lastErrorMessage();
+                    }
+                    else if (registerRing(ring, IORING_REGISTER_EVENTFD, &eventFd, 1) == -1)
+                    {
+                        message = "io_uring_register failed, " + lastErrorMessage();
+                        close(eventFd);
+                    }
+                    else
+                    {
+                        /* Registered buffers count against the locked memory
+                           limit on older kernels. Reads work without them,
+                           just not as cheaply, so that's not fatal. */
+                        buffers.resize(REGISTERED_BUFFER_SIZE * REGISTERED_BUFFER_COUNT);
+
+                        std::vector<iovec> vectors(REGISTERED_BUFFER_COUNT);
+                        for (size_t i = 0; i < REGISTERED_BUFFER_COUNT; i++)
+                        {
+                            vectors[i].iov_base = buffers.data() + i * REGISTERED_BUFFER_SIZE;
+                            vectors[i].iov_len = REGISTERED_BUFFER_SIZE;
+                        }
+
+                        if (registerRing(ring, IORING_REGISTER_BUFFERS, vectors.data(), vectors.size()) == -1)
+                        {
+                            buffers.clear();
+                        }
+                        else
+                        {
+                            for (int i = REGISTERED_BUFFER_COUNT - 1; i >= 0; i--)
+                            {
+                                freeBuffers.push_back(i);
+                            }
+                        }
+
+                        return;
+                    }
+
+                    munmap(submissions, submissionsSize);
+                }
+
+                if (completionRing != submissionRing)
+                {
+                    munmap(completionRing, completionRingSize);
+                }
+            }
+
+            munmap(submissionRing, submissionRingSize);
+        }
+
+        close(ring);
+
+        throw std::runtime_error("Uring::Uring, " + message);
+    }
+
+    Uring::~Uring()
+    {
+        /* Contexts have all finished by now, but something like a listener's
+           accept may have been cancelled without anyone waiting for it, and
+           owns memory its last completion frees */
+        submit();
+
+        while (inFlight > 0)
+        {
+            if (!processCompletions())
+            {
+                enter(ring, 0, 1, IORING_ENTER_GETEVENTS);
+            }
+        }
+
+        munmap(submissions, submissionsSize);
+
+        if (completionRing != submissionRing)
+        {
+            munmap(completionRing, completionRingSize);
+        }
+
+        munmap(submissionRing, submissionRingSize);
+
+        auto result = close(ring);
+        if (result)
+        {
+        }
+        assert(result == 0);
+
+        result = close(eventFd);
+        assert(result == 0);
+    }
+
+    int Uring::getEventFd() const
+    {
+        return eventFd;
+    }
+
+    io_uring_sqe &Uring::getSubmission()
+    {
+        uint32_t tail = *submissionTail;
+
+        if (tail - loadAcquire(submissionHead) >= submissionEntries)
+        {
+            submit();
+            tail = *submissionTail;
+
+            assert(tail - loadAcquire(submissionHead) < submissionEntries);
+        }
+
+        const uint32_t index = tail & submissionMask;
+
+        io_uring_sqe &submission = submissions[index];
+        std::memset(&submission, 0, sizeof(submission));
+
+        submissionArray[index] = index;
+        storeRelease(submissionTail, tail + 1);
+        ++pending;
+
+        return submission;
+    }
+
+    void Uring::submit()
+    {
+        while (pending > 0)
+        {
+            const int submitted = enter(ring, pending, 0, 0);
+
+            if (submitted == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                /* Completions have to be reaped before it takes more */
+                if (errno == EBUSY || errno == EAGAIN)
+                {
+                    processCompletions();
+                    enter(ring, 0, 0, IORING_ENTER_GETEVENTS);
+                    continue;
+                }
+
+                throw std::runtime_error("Uring::submit, io_uring_enter failed, " + lastErrorMessage());
+            }
+
+            if (submitted == 0)
+            {
+                break;
+            }
+
+            pending -= std::min<uint32_t>(pending, submitted);
+        }
+    }
+
+    bool Uring::processCompletions()
+    {
+        /* The kernel keeps completions which didn't fit, until asked */
+        if ((loadAcquire(submissionFlags) & IORING_SQ_CQ_OVERFLOW) != 0)
+        {
+            enter(ring, 0, 0, IORING_ENTER_GETEVENTS);
+        }
+
+        uint32_t head = *completionHead;
+        const uint32_t tail = loadAcquire(completionTail);
+
+        if (head == tail)
+        {
+            return false;
+        }
+
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe &completion = completions[head & completionMask];
+
+            const auto operation = reinterpret_cast<UringOperation *>(completion.user_data);
+            const int32_t result = completion.res;
+            const uint32_t flags = completion.flags;
+
+            /* The slot can be reused once the head moves past it */
+            storeRelease(completionHead, head + 1);
+
+            /* Cancellations don't have anyone waiting for them */
+            if (operation != nullptr)
+            {
+                if ((flags & IORING_CQE_F_MORE) == 0)
+                {
+                    --inFlight;
+                }
+
+                operation->complete(dispatcher, result, flags);
+            }
+        }
+
+        return true;
+    }
+
+    void Uring::start(io_uring_sqe &submission, UringOperation &op)
+    {
+        submission.user_data = reinterpret_cast<uint64_t>(&op);
+        ++inFlight;
+    }
+
+    void Uring::cancel(UringOperation &op)
+    {
+        io_uring_sqe &cancel = getSubmission();
+        cancel.opcode = IORING_OP_ASYNC_CANCEL;
+        cancel.fd = -1;
+        cancel.addr = reinterpret_cast<uint64_t>(&op);
+    }
+
+    void Uring::wait(io_uring_sqe &submission, UringOperation &op)
+    {
+        op.context = dispatcher.getCurrentContext();
+        op.completed = false;
+        op.interrupted = false;
+        start(submission, op);
+
+        /* The operation may have completed, with this context not resumed
+           yet, by the time it's interrupted - nothing to cancel then */
+        dispatcher.getCurrentContext()->interruptProcedure = [&]() {
+            if (!op.completed)
+            {
+                cancel(op);
+            }
+
+            op.interrupted = true;
+        };
+
+        /* A cancelled operation still completes, with -ECANCELED, and nothing
+           else resumes this context while the operation is outstanding */
+        while (!op.completed)
+        {
+            dispatcher.dispatch();
+        }
+
+        dispatcher.getCurrentContext()->interruptProcedure = nullptr;
+        assert(op.context == dispatcher.getCurrentContext());
+
+        /* Too late to cancel - it finished anyway */
+        if (op.interrupted && op.result != -ECANCELED && op.result != -EINTR)
+        {
+            op.interrupted = false;
+            dispatcher.getCurrentContext()->interrupted = true;
+        }
+    }
+
+    int Uring::takeBuffer()
+    {
+        if (freeBuffers.empty())
+        {
+            return -1;
+        }
+
+        const int index = freeBuffers.back();
+        freeBuffers.pop_back();
+        return index;
+    }
+
+    void Uring::returnBuffer(int index)
+    {
+        freeBuffers.push_back(index);
+    }
+
+    uint8_t *Uring::getBuffer(int index)
+    {
+        return buffers.data() + index * REGISTERED_BUFFER_SIZE;
+    }
+
+    size_t Uring::getBufferSize() const
+    {
+        return buffers.empty() ? 0 : REGISTERED_BUFFER_SIZE;
+    }
+
+}
+
+#endif
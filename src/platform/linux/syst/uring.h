@@ -0,0 +1,125 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#ifdef SYST_IO_URING
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <linux/io_uring.h>
+
+namespace syst
+{
+
+    class Dispatcher;
+    struct NativeContext;
+
+    /* Something submitted to the ring. The address of the operation is the
+       user data of its submission, and it has to outlive its completion. */
+    struct UringOperation
+    {
+        NativeContext *context = nullptr;
+        int32_t result = 0;
+        bool completed = false;
+        bool interrupted = false;
+
+        virtual ~UringOperation() = default;
+
+        /* Stores the result and resumes the context waiting for it. A
+           multishot operation completes several times, with IORING_CQE_F_MORE
+           set in the flags of all but the last. */
+        virtual void complete(Dispatcher &dispatcher, int32_t result, uint32_t flags);
+    };
+
+    /* An io_uring instance, used by the dispatcher alongside epoll. Set up
+       with the raw system calls, the interface is small enough not to need
+       liburing.
+
+       Submissions are not passed to the kernel one at a time - they queue up
+       until the dispatcher is about to wait, or the queue is full, so one
+       io_uring_enter() covers everything every context started since the
+       last one. Completions are signalled on an eventfd the dispatcher
+       watches with epoll. */
+    class Uring
+    {
+    public:
+        /* Throws if the kernel doesn't support io_uring, or it's disabled */
+        explicit Uring(Dispatcher &dispatcher);
+        Uring(const Uring &) = delete;
+        ~Uring();
+        Uring &operator=(const Uring &) = delete;
+
+        int getEventFd() const;
+
+        /* A zeroed submission to fill in, queued once this returns */
+        io_uring_sqe &getSubmission();
+
+        /* Passes the queued submissions to the kernel */
+        void submit();
+
+        /* Completes every operation with a completion waiting. Returns false
+           if there weren't any. */
+        bool processCompletions();
+
+        /* Marks the submission as being for op, whose complete() is called
+           when it completes, without waiting */
+        void start(io_uring_sqe &submission, UringOperation &op);
+
+        /* Asks the kernel to cancel op, which still completes */
+        void cancel(UringOperation &op);
+
+        /* Queues op, which the caller has filled in the submission for, and
+           waits for it to complete. Interrupting the waiting context cancels
+           the operation, but still waits for the kernel to finish with it,
+           since it may be using the caller's buffers. The operation is marked
+           as interrupted if it was cancelled. */
+        void wait(io_uring_sqe &submission, UringOperation &op);
+
+        /* Registered buffers - the kernel maps these once, rather than on
+           every read. Returns -1 if none are free. */
+        int takeBuffer();
+        void returnBuffer(int index);
+        uint8_t *getBuffer(int index);
+        size_t getBufferSize() const;
+
+    private:
+        Dispatcher &dispatcher;
+        int ring;
+        int eventFd;
+
+        uint8_t *submissionRing;
+        size_t submissionRingSize;
+        uint8_t *completionRing;
+        size_t completionRingSize;
+        io_uring_sqe *submissions;
+        size_t submissionsSize;
+
+        uint32_t *submissionHead;
+        uint32_t *submissionTail;
+        uint32_t *submissionFlags;
+        uint32_t submissionMask;
+        uint32_t submissionEntries;
+        uint32_t *submissionArray;
+
+        uint32_t *completionHead;
+        uint32_t *completionTail;
+        uint32_t completionMask;
+        io_uring_cqe *completions;
+
+        /* Queued, but not passed to the kernel yet */
+        uint32_t pending;
+
+        /* Started, and not completed for the last time */
+        size_t inFlight;
+
+        std::vector<uint8_t> buffers;
+        std::vector<int> freeBuffers;
+    };
+
+}
+
+#endif
@@ -6,12 +6,14 @@
 // Please see the included LICENSE file for more information.
 
 #include "tcp_connection.h"
+#include <algorithm>
 #include <cassert>
 
 #include <netinet/in.h>
 #include <sys/event.h>
 #include <sys/errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "dispatcher.h"
@@ -22,6 +24,14 @@
 namespace syst
 {
 
+    namespace
+    {
+
+        /* Well under IOV_MAX, and plenty to fill the socket buffer */
+        const std::size_t MAX_WRITE_BUFFERS = 64;
+
+    }
+
     TcpConnection::TcpConnection() : dispatcher(nullptr)
     {
     }
@@ -171,7 +181,6 @@ namespace syst
             throw InterruptedException();
         }
 
-        std::string message;
         if (size == 0)
         {
             if (shutdown(connection, SHUT_WR) == -1)
@@ -182,7 +191,38 @@ namespace syst
             return 0;
         }
 
-        ssize_t transferred = ::send(connection, (void *)data, size, 0);
+        const std::pair<const uint8_t *, std::size_t> buffer(data, size);
+
+        return writev(&buffer, 1);
+    }
+
+    std::size_t TcpConnection::writev(const std::pair<const uint8_t *, std::size_t> *buffers, std::size_t count)
+    {
+        assert(dispatcher != nullptr);
+        assert(writeContext == nullptr);
+        if (dispatcher->interrupted())
+        {
+            throw InterruptedException();
+        }
+
+        iovec vectors[MAX_WRITE_BUFFERS];
+        count = std::min(count, MAX_WRITE_BUFFERS);
+
+        size_t size = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            vectors[i].iov_base = const_cast<uint8_t *>(buffers[i].first);
+            vectors[i].iov_len = buffers[i].second;
+            size += buffers[i].second;
+        }
+
+        msghdr header = {};
+        header.msg_iov = vectors;
+        header.msg_iovlen = count;
+
+        std::string message;
+        ssize_t transferred = ::sendmsg(connection, &header, 0);
         if (transferred == -1)
         {
             if (errno != EAGAIN && errno != EWOULDBLOCK)
@@ -235,7 +275,7 @@ namespace syst
                         throw InterruptedException();
                     }
 
-                    ssize_t transferred = ::send(connection, (void *)data, size, 0);
+                    ssize_t transferred = ::sendmsg(connection, &header, 0);
                     if (transferred == -1)
                     {
                         message = "send failed, " + lastErrorMessage();
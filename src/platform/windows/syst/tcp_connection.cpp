@@ -8,6 +8,7 @@
 #include "tcp_connection.h"
 #include <cassert>
 #include <stdexcept>
+#include <vector>
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -182,10 +183,34 @@ namespace syst
             return 0;
         }
 
-        WSABUF buf{static_cast<ULONG>(size), reinterpret_cast<char *>(const_cast<uint8_t *>(data))};
+        const std::pair<const uint8_t *, size_t> buffer(data, size);
+
+        return writev(&buffer, 1);
+    }
+
+    size_t TcpConnection::writev(const std::pair<const uint8_t *, size_t> *buffers, size_t count)
+    {
+        assert(dispatcher != nullptr);
+        assert(writeContext == nullptr);
+        if (dispatcher->interrupted())
+        {
+            throw InterruptedException();
+        }
+
+        std::vector<WSABUF> bufs;
+        bufs.reserve(count);
+
+        size_t size = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            bufs.push_back(WSABUF{static_cast<ULONG>(buffers[i].second), reinterpret_cast<char *>(const_cast<uint8_t *>(buffers[i].first))});
+            size += buffers[i].second;
+        }
+
         TcpConnectionContext context;
         context.hEvent = NULL;
-        if (WSASend(connection, &buf, 1, NULL, 0, &context, NULL) != 0)
+        if (WSASend(connection, bufs.data(), static_cast<DWORD>(bufs.size()), NULL, 0, &context, NULL) != 0)
         {
             int lastError = WSAGetLastError();
             if (lastError != WSA_IO_PENDING)
@@ -9,6 +9,8 @@
 
 #include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace syst
 {
@@ -27,6 +29,15 @@ namespace syst
         TcpConnection &operator=(TcpConnection &&other);
         size_t read(uint8_t *data, size_t size);
         size_t write(const uint8_t *data, size_t size);
+
+        /* Writes as much of the buffers, in order, as can go in one gathering
+           write, and returns how many bytes that was */
+        size_t writev(const std::pair<const uint8_t *, size_t> *buffers, size_t count);
+
+        /* Writes all of the buffers, in order, however many writes that
+           takes. The buffers are used up as they're written. Defined once for
+           every platform, in syst/tcp_connection_write.cpp. */
+        void writevAll(std::vector<std::pair<const uint8_t *, size_t>> &buffers);
         std::pair<Ipv4Address, uint16_t> getPeerAddressAndPort() const;
 
     private:
@@ -409,6 +409,10 @@ namespace cryptonote
             uint8_t minor_version;
             std::string version;
             uint64_t start_time;
+            uint64_t ring_member_cache_hits;
+            uint64_t ring_member_cache_misses;
+            double tx_pool_admitted_per_second;
+            double tx_pool_rejected_per_second;
             bool synced;
             bool testnet;
 
@@ -432,6 +436,10 @@ namespace cryptonote
                 KV_MEMBER(major_version)
                 KV_MEMBER(minor_version)
                 KV_MEMBER(start_time)
+                KV_MEMBER(ring_member_cache_hits)
+                KV_MEMBER(ring_member_cache_misses)
+                KV_MEMBER(tx_pool_admitted_per_second)
+                KV_MEMBER(tx_pool_rejected_per_second)
                 KV_MEMBER(synced)
                 KV_MEMBER(testnet)
                 KV_MEMBER(version)
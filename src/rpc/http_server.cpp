@@ -8,9 +8,14 @@
 #include "http_server.h"
 #include <boost/scope_exit.hpp>
 
+#include <algorithm>
+#include <exception>
+#include <string_view>
+#include <vector>
+
 #include <http/http_parser.h>
+#include <http/http_parser_error_codes.h>
 #include <syst/interrupted_exception.h>
-#include <syst/tcp_stream.h>
 #include <syst/ipv4_address.h>
 
 using namespace logging;
@@ -18,6 +23,14 @@ using namespace logging;
 namespace cryptonote
 {
 
+    namespace
+    {
+
+        /* How much is read from the connection at a time */
+        const size_t READ_SIZE = 16 * 1024;
+
+    }
+
     HttpServer::HttpServer(syst::Dispatcher &dispatcher, std::shared_ptr<logging::ILogger> log)
         : m_dispatcher(dispatcher), workingContextGroup(dispatcher), logger(log, "HttpServer")
     {
@@ -71,25 +84,108 @@ namespace cryptonote
 
             logger(DEBUGGING) << "Incoming connection from " << addr.first.toDottedDecimal() << ":" << addr.second;
 
-            syst::TcpStreambuf streambuf(connection);
-            std::iostream stream(&streambuf);
             HttpParser parser;
 
-            for (;;)
-            {
-                HttpRequest req;
-                HttpResponse resp;
+            /* Whatever has been received and not parsed yet */
+            std::vector<char> received(READ_SIZE);
+            size_t receivedSize = 0;
+
+            bool keepAlive = true;
 
-                parser.receiveRequest(stream, req);
-                processRequest(req, resp);
+            while (keepAlive)
+            {
+                if (received.size() - receivedSize < READ_SIZE)
+                {
+                    received.resize(receivedSize + READ_SIZE);
+                }
 
-                stream << resp;
-                stream.flush();
+                const size_t read = connection.read(reinterpret_cast<uint8_t *>(received.data() + receivedSize), READ_SIZE);
 
-                if (stream.peek() == std::iostream::traits_type::eof())
+                if (read == 0)
                 {
                     break;
                 }
+
+                receivedSize += read;
+
+                /* A pipelining client sends several requests without waiting
+                   for the responses. Answer every complete request that's
+                   arrived, then send all the responses in one go. */
+                std::vector<HttpResponse> responses;
+                std::vector<std::string> heads;
+                size_t parsed = 0;
+
+                /* The requests before a malformed one are still answered,
+                   then the connection is closed */
+                std::exception_ptr parseError;
+
+                while (keepAlive)
+                {
+                    HttpRequest req;
+                    size_t requestSize = 0;
+
+                    try
+                    {
+                        requestSize = parser.parseRequest(std::string_view(received.data() + parsed, receivedSize - parsed), req);
+                    }
+                    catch (const std::system_error &e)
+                    {
+                        if (e.code() == make_error_code(error::HttpParserErrorCodes::BODY_TOO_LARGE))
+                        {
+                            responses.emplace_back();
+                            responses.back().setStatus(HttpResponse::STATUS_413);
+                            responses.back().addHeader("Connection", "close");
+                        }
+
+                        parseError = std::current_exception();
+                        break;
+                    }
+
+                    if (requestSize == 0)
+                    {
+                        break;
+                    }
+
+                    parsed += requestSize;
+                    keepAlive = req.isKeepAlive();
+
+                    responses.emplace_back();
+                    processRequest(req, responses.back());
+
+                    if (!keepAlive)
+                    {
+                        responses.back().addHeader("Connection", "close");
+                    }
+                }
+
+                if (!responses.empty())
+                {
+                    std::vector<std::pair<const uint8_t *, size_t>> buffers;
+                    buffers.reserve(responses.size() * 2);
+                    heads.reserve(responses.size());
+
+                    for (const auto &response : responses)
+                    {
+                        heads.push_back(response.getHead());
+                        buffers.emplace_back(reinterpret_cast<const uint8_t *>(heads.back().data()), heads.back().size());
+
+                        if (!response.getBody().empty())
+                        {
+                            buffers.emplace_back(reinterpret_cast<const uint8_t *>(response.getBody().data()), response.getBody().size());
+                        }
+                    }
+
+                    connection.writevAll(buffers);
+                }
+
+                if (parseError)
+                {
+                    std::rethrow_exception(parseError);
+                }
+
+                /* Keep the start of a request which hasn't all arrived */
+                std::copy(received.begin() + parsed, received.begin() + receivedSize, received.begin());
+                receivedSize -= parsed;
             }
 
             logger(DEBUGGING) << "Closing connection from " << addr.first.toDottedDecimal() << ":" << addr.second << " total=" << m_connections.size();
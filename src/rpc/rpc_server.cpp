@@ -10,6 +10,7 @@
 
 #include <cmath>
 
+#include <common/string_output_stream.h>
 #include <common/string_tools.h>
 
 #include <config/cryptonote_config.h>
@@ -27,6 +28,10 @@
 #include <rpc/core_rpc_server_error_codes.h>
 #include <rpc/json_rpc.h>
 
+#include <serialization/binary_output_stream_serializer.h>
+
+#include <syst/remote_context.h>
+
 #include "version.h"
 
 #include <unordered_map>
@@ -50,64 +55,48 @@ namespace cryptonote
         KV_MEMBER(response.status)
     }
 
-    void serialize(BlockFullInfo &blockFullInfo, ISerializer &s)
-    {
-        KV_MEMBER(blockFullInfo.block_id);
-        KV_MEMBER(blockFullInfo.block);
-        s(blockFullInfo.transactions, "txs");
-    }
-
-    void serialize(TransactionPrefixInfo &transactionPrefixInfo, ISerializer &s)
+    namespace
     {
-        KV_MEMBER(transactionPrefixInfo.txHash);
-        KV_MEMBER(transactionPrefixInfo.txPrefix);
-    }
 
-    void serialize(BlockShortInfo &blockShortInfo, ISerializer &s)
-    {
-        KV_MEMBER(blockShortInfo.blockId);
-        KV_MEMBER(blockShortInfo.block);
-        KV_MEMBER(blockShortInfo.txPrefixes);
-    }
+        /* Set on the RPC worker threads, which must take the core's read
+           lock. Never on the dispatcher, which the core's writers wait on. */
+        thread_local bool onRpcWorker = false;
 
-    void serialize(wallet_types::WalletBlockInfo &walletBlockInfo, ISerializer &s)
-    {
-        s(walletBlockInfo.coinbaseTransaction, "coinbaseTX");
-        s(walletBlockInfo.transactions, "transactions");
-        s(walletBlockInfo.blockHeight, "blockHeight");
-        s(walletBlockInfo.blockHash, "blockHash");
-        s(walletBlockInfo.blockTimestamp, "blockTimestamp");
-    }
+        template <typename Command>
+        RpcServer::HandlerFunction jsonMethod(bool (RpcServer::*handler)(typename Command::request const &, typename Command::response &))
+        {
+            return [handler](RpcServer *obj, const HttpRequest &request, HttpResponse &response)
+            {
+                boost::value_initialized<typename Command::request> req;
+                boost::value_initialized<typename Command::response> res;
 
-    void serialize(wallet_types::RawTransaction &rawTransaction, ISerializer &s)
-    {
-        s(rawTransaction.keyInputs, "inputs");
-        s(rawTransaction.paymentID, "paymentID");
-        s(rawTransaction.keyOutputs, "outputs");
-        s(rawTransaction.hash, "hash");
-        s(rawTransaction.transactionPublicKey, "txPublicKey");
-        s(rawTransaction.unlockTime, "unlockTime");
-    }
+                if (!loadFromJson(static_cast<typename Command::request &>(req), request.getBody()))
+                {
+                    return false;
+                }
 
-    void serialize(wallet_types::RawCoinbaseTransaction &rawCoinbaseTransaction, ISerializer &s)
-    {
-        s(rawCoinbaseTransaction.keyOutputs, "outputs");
-        s(rawCoinbaseTransaction.hash, "hash");
-        s(rawCoinbaseTransaction.transactionPublicKey, "txPublicKey");
-        s(rawCoinbaseTransaction.unlockTime, "unlockTime");
-    }
+                bool result;
 
-    void serialize(wallet_types::KeyOutput &keyOutput, ISerializer &s)
-    {
-        s(keyOutput.key, "key");
-        s(keyOutput.amount, "amount");
-    }
+                obj->readCore([&]()
+                              { result = (obj->*handler)(req, res); });
 
-    namespace
-    {
+                for (const auto &cors_domain : obj->getCorsDomains())
+                {
+                    response.addHeader("Access-Control-Allow-Origin", cors_domain);
+                }
+                response.addHeader("Content-Type", "application/json");
+                response.setBody(storeToJson(res.data()));
+                return result;
+            };
+        }
 
+        /* Takes the same JSON request as jsonMethod, but writes the response
+           in the binary serialization format - varint lengths and raw hashes
+           and keys - straight into the response body. For large responses
+           polled by many clients, where building and printing a JSON tree
+           costs far more than the query. */
         template <typename Command>
-        RpcServer::HandlerFunction jsonMethod(bool (RpcServer::*handler)(typename Command::request const &, typename Command::response &))
+        RpcServer::HandlerFunction binaryMethod(bool (RpcServer::*handler)(typename Command::request const &, typename Command::response &))
         {
             return [handler](RpcServer *obj, const HttpRequest &request, HttpResponse &response)
             {
@@ -119,13 +108,23 @@ namespace cryptonote
                     return false;
                 }
 
-                bool result = (obj->*handler)(req, res);
+                bool result;
+
+                obj->readCore([&]()
+                              { result = (obj->*handler)(req, res); });
+
                 for (const auto &cors_domain : obj->getCorsDomains())
                 {
                     response.addHeader("Access-Control-Allow-Origin", cors_domain);
                 }
-                response.addHeader("Content-Type", "application/json");
-                response.setBody(storeToJson(res.data()));
+
+                std::string body;
+                common::StringOutputStream stream(body);
+                BinaryOutputStreamSerializer serializer(stream);
+                static_cast<typename Command::response &>(res).serialize(serializer);
+
+                response.addHeader("Content-Type", "application/octet-stream");
+                response.setBody(std::move(body));
                 return result;
             };
         }
@@ -134,41 +133,42 @@ namespace cryptonote
 
     std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction>> RpcServer::s_handlers = {
         // old json handlers - remove me in 2019
-        {"/getinfo", {jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true}},
-        {"/getheight", {jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true}},
-        {"/feeinfo", {jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_info), true}},
-        {"/getpeers", {jsonMethod<COMMAND_RPC_GET_PEERS>(&RpcServer::on_get_peers), true}},
+        {"/getinfo", {jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true, false}},
+        {"/getheight", {jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true, false}},
+        {"/feeinfo", {jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_info), true, false}},
+        {"/getpeers", {jsonMethod<COMMAND_RPC_GET_PEERS>(&RpcServer::on_get_peers), true, false}},
 
         // new json handlers
-        {"/info", {jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true}},
-        {"/height", {jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true}},
-        {"/fee", {jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_info), true}},
-        {"/peers", {jsonMethod<COMMAND_RPC_GET_PEERS>(&RpcServer::on_get_peers), true}},
-
-        {"/gettransactions", {jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false}},
-        {"/sendrawtransaction", {jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false}},
-
-        {"/getblocks", {jsonMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false}},
-        {"/queryblocks", {jsonMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false}},
-        {"/queryblockslite", {jsonMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false}},
-        {"/queryblocksdetailed", {jsonMethod<COMMAND_RPC_QUERY_BLOCKS_DETAILED>(&RpcServer::on_query_blocks_detailed), false}},
-        {"/getwalletsyncdata", {jsonMethod<COMMAND_RPC_GET_WALLET_SYNC_DATA>(&RpcServer::on_get_wallet_sync_data), false}},
-        {"/get_o_indexes", {jsonMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false}},
-        {"/getrandom_outs", {jsonMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false}},
-        {"/get_pool", {jsonMethod<COMMAND_RPC_GET_POOL>(&RpcServer::onGetPool), false}},
-        {"/get_pool_changes", {jsonMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false}},
-        {"/get_pool_changes_lite", {jsonMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false}},
-        {"/get_block_details_by_height", {jsonMethod<COMMAND_RPC_GET_BLOCK_DETAILS_BY_HEIGHT>(&RpcServer::onGetBlockDetailsByHeight), false}},
-        {"/get_blocks_details_by_heights", {jsonMethod<COMMAND_RPC_GET_BLOCKS_DETAILS_BY_HEIGHTS>(&RpcServer::onGetBlocksDetailsByHeights), false}},
-        {"/get_blocks_details_by_hashes", {jsonMethod<COMMAND_RPC_GET_BLOCKS_DETAILS_BY_HASHES>(&RpcServer::onGetBlocksDetailsByHashes), false}},
-        {"/get_blocks_hashes_by_timestamps", {jsonMethod<COMMAND_RPC_GET_BLOCKS_HASHES_BY_TIMESTAMPS>(&RpcServer::onGetBlocksHashesByTimestamps), false}},
-        {"/get_transaction_details_by_hashes", {jsonMethod<COMMAND_RPC_GET_TRANSACTION_DETAILS_BY_HASHES>(&RpcServer::onGetTransactionDetailsByHashes), false}},
-        {"/get_transaction_hashes_by_payment_id", {jsonMethod<COMMAND_RPC_GET_TRANSACTION_HASHES_BY_PAYMENT_ID>(&RpcServer::onGetTransactionHashesByPaymentId), false}},
-        {"/get_global_indexes_for_range", {jsonMethod<COMMAND_RPC_GET_GLOBAL_INDEXES_FOR_RANGE>(&RpcServer::onGetGlobalIndexesForRange), false}},
-        {"/get_transactions_status", {jsonMethod<COMMAND_RPC_GET_TRANSACTIONS_STATUS>(&RpcServer::onGetTransactionsStatus), false}},
+        {"/info", {jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true, false}},
+        {"/height", {jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true, false}},
+        {"/fee", {jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_info), true, false}},
+        {"/peers", {jsonMethod<COMMAND_RPC_GET_PEERS>(&RpcServer::on_get_peers), true, false}},
+
+        {"/gettransactions", {jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false, true}},
+        {"/sendrawtransaction", {jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false, false}},
+
+        {"/getblocks", {jsonMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false, true}},
+        {"/queryblocks", {jsonMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false, true}},
+        {"/queryblockslite", {jsonMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false, true}},
+        {"/queryblocksdetailed", {jsonMethod<COMMAND_RPC_QUERY_BLOCKS_DETAILED>(&RpcServer::on_query_blocks_detailed), false, true}},
+        {"/getwalletsyncdata", {jsonMethod<COMMAND_RPC_GET_WALLET_SYNC_DATA>(&RpcServer::on_get_wallet_sync_data), false, true}},
+        {"/getwalletsyncdata.bin", {binaryMethod<COMMAND_RPC_GET_WALLET_SYNC_DATA>(&RpcServer::on_get_wallet_sync_data), false, true}},
+        {"/get_o_indexes", {jsonMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false, true}},
+        {"/getrandom_outs", {jsonMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false, true}},
+        {"/get_pool", {jsonMethod<COMMAND_RPC_GET_POOL>(&RpcServer::onGetPool), false, true}},
+        {"/get_pool_changes", {jsonMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false, true}},
+        {"/get_pool_changes_lite", {jsonMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false, true}},
+        {"/get_block_details_by_height", {jsonMethod<COMMAND_RPC_GET_BLOCK_DETAILS_BY_HEIGHT>(&RpcServer::onGetBlockDetailsByHeight), false, true}},
+        {"/get_blocks_details_by_heights", {jsonMethod<COMMAND_RPC_GET_BLOCKS_DETAILS_BY_HEIGHTS>(&RpcServer::onGetBlocksDetailsByHeights), false, true}},
+        {"/get_blocks_details_by_hashes", {jsonMethod<COMMAND_RPC_GET_BLOCKS_DETAILS_BY_HASHES>(&RpcServer::onGetBlocksDetailsByHashes), false, true}},
+        {"/get_blocks_hashes_by_timestamps", {jsonMethod<COMMAND_RPC_GET_BLOCKS_HASHES_BY_TIMESTAMPS>(&RpcServer::onGetBlocksHashesByTimestamps), false, true}},
+        {"/get_transaction_details_by_hashes", {jsonMethod<COMMAND_RPC_GET_TRANSACTION_DETAILS_BY_HASHES>(&RpcServer::onGetTransactionDetailsByHashes), false, true}},
+        {"/get_transaction_hashes_by_payment_id", {jsonMethod<COMMAND_RPC_GET_TRANSACTION_HASHES_BY_PAYMENT_ID>(&RpcServer::onGetTransactionHashesByPaymentId), false, true}},
+        {"/get_global_indexes_for_range", {jsonMethod<COMMAND_RPC_GET_GLOBAL_INDEXES_FOR_RANGE>(&RpcServer::onGetGlobalIndexesForRange), false, true}},
+        {"/get_transactions_status", {jsonMethod<COMMAND_RPC_GET_TRANSACTIONS_STATUS>(&RpcServer::onGetTransactionsStatus), false, true}},
 
         // json rpc
-        {"/json_rpc", {std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true}}};
+        {"/json_rpc", {std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true, false}}};
 
     RpcServer::RpcServer(syst::Dispatcher &dispatcher, std::shared_ptr<logging::ILogger> log, Core &c, NodeServer &p2p, ICryptoNoteProtocolHandler &protocol) : HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_protocol(protocol)
     {
@@ -201,7 +201,8 @@ namespace cryptonote
             return;
         }
 
-        it->second.handler(this, request, response);
+        runHandler(it->second, [&]()
+                   { it->second.handler(this, request, response); });
     }
 
     bool RpcServer::processJsonRpcRequest(const HttpRequest &request, HttpResponse &response)
@@ -225,18 +226,18 @@ namespace cryptonote
             jsonResponse.setId(jsonRequest.getId()); // copy id
 
             static std::unordered_map<std::string, RpcServer::RpcHandler<JsonMemberMethod>> jsonRpcHandlers = {
-                {"f_blocks_list_json", {makeMemberMethod(&RpcServer::f_on_blocks_list_json), false}},
-                {"f_block_json", {makeMemberMethod(&RpcServer::f_on_block_json), false}},
-                {"f_transaction_json", {makeMemberMethod(&RpcServer::f_on_transaction_json), false}},
-                {"f_on_transactions_pool_json", {makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false}},
-                {"getblockcount", {makeMemberMethod(&RpcServer::on_getblockcount), true}},
-                {"on_getblockhash", {makeMemberMethod(&RpcServer::on_getblockhash), false}},
-                {"getblocktemplate", {makeMemberMethod(&RpcServer::on_getblocktemplate), false}},
-                {"getcurrencyid", {makeMemberMethod(&RpcServer::on_get_currency_id), true}},
-                {"submitblock", {makeMemberMethod(&RpcServer::on_submitblock), false}},
-                {"getlastblockheader", {makeMemberMethod(&RpcServer::on_get_last_block_header), false}},
-                {"getblockheaderbyhash", {makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false}},
-                {"getblockheaderbyheight", {makeMemberMethod(&RpcServer::on_get_block_header_by_height), false}}};
+                {"f_blocks_list_json", {makeMemberMethod(&RpcServer::f_on_blocks_list_json), false, true}},
+                {"f_block_json", {makeMemberMethod(&RpcServer::f_on_block_json), false, true}},
+                {"f_transaction_json", {makeMemberMethod(&RpcServer::f_on_transaction_json), false, true}},
+                {"f_on_transactions_pool_json", {makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false, true}},
+                {"getblockcount", {makeMemberMethod(&RpcServer::on_getblockcount), true, false}},
+                {"on_getblockhash", {makeMemberMethod(&RpcServer::on_getblockhash), false, true}},
+                {"getblocktemplate", {makeMemberMethod(&RpcServer::on_getblocktemplate), false, false}},
+                {"getcurrencyid", {makeMemberMethod(&RpcServer::on_get_currency_id), true, false}},
+                {"submitblock", {makeMemberMethod(&RpcServer::on_submitblock), false, false}},
+                {"getlastblockheader", {makeMemberMethod(&RpcServer::on_get_last_block_header), false, true}},
+                {"getblockheaderbyhash", {makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false, true}},
+                {"getblockheaderbyheight", {makeMemberMethod(&RpcServer::on_get_block_header_by_height), false, true}}};
 
             auto it = jsonRpcHandlers.find(jsonRequest.getMethod());
             if (it == jsonRpcHandlers.end())
@@ -249,7 +250,11 @@ namespace cryptonote
                 throw JsonRpcError(CORE_RPC_ERROR_CODE_CORE_BUSY, "Core is busy");
             }
 
-            it->second.handler(this, jsonRequest, jsonResponse);
+            /* The responses are small, so the read lock is held while
+               they're built too */
+            runHandler(it->second, [&]()
+                       { readCore([&]()
+                                  { it->second.handler(this, jsonRequest, jsonResponse); }); });
         }
         catch (const JsonRpcError &err)
         {
@@ -277,6 +282,20 @@ namespace cryptonote
         return true;
     }
 
+    bool RpcServer::setWorkerThreads(const size_t threadCount)
+    {
+        if (threadCount == 0)
+        {
+            m_workers.reset();
+        }
+        else
+        {
+            m_workers = std::make_unique<ThreadPool>(threadCount);
+        }
+
+        return true;
+    }
+
     bool RpcServer::enableCors(const std::vector<std::string> domains)
     {
         m_cors_domains = domains;
@@ -288,6 +307,43 @@ namespace cryptonote
         return m_cors_domains;
     }
 
+    template <class Handler>
+    void RpcServer::runHandler(const RpcHandler<Handler> &handler, std::function<void()> &&call)
+    {
+        if (!handler.readOnly || !m_workers)
+        {
+            call();
+            return;
+        }
+
+        /* The dispatcher carries on serving P2P and the other connections
+           while this waits. The handler takes the core's read lock with
+           readCore() - only around the query, not while parsing the request
+           or writing the response. */
+        syst::RemoteContext<void>(m_dispatcher, *m_workers, [&call]()
+                                  {
+                                      /* These threads only ever run handlers */
+                                      onRpcWorker = true;
+                                      call(); })
+            .get();
+    }
+
+    void RpcServer::readCore(const std::function<void()> &query)
+    {
+        if (!onRpcWorker)
+        {
+            query();
+            return;
+        }
+
+        /* Keeps the chain and the pool from changing under the query - blocks
+           and transactions are only added on the dispatcher thread, which
+           waits for this to be released */
+        const auto lock = m_core.lockForReading();
+
+        query();
+    }
+
     bool RpcServer::isCoreReady()
     {
         // A testnet must be able to serve block templates from genesis: a fresh
@@ -704,6 +760,10 @@ namespace cryptonote
         res.version = PROJECT_VERSION;
         res.status = CORE_RPC_STATUS_OK;
         res.start_time = (uint64_t)m_core.getStartTime();
+        res.ring_member_cache_hits = m_core.getRingMemberCacheHits();
+        res.ring_member_cache_misses = m_core.getRingMemberCacheMisses();
+        res.tx_pool_admitted_per_second = m_core.getPoolTransactionsAdmittedPerSecond();
+        res.tx_pool_rejected_per_second = m_core.getPoolTransactionsRejectedPerSecond();
         return true;
     }
 
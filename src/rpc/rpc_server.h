@@ -13,6 +13,7 @@
 
 #include <logging/logger_ref.h>
 #include "common/math.h"
+#include "common/thread_pool.h"
 #include "core_rpc_server_commands_definitions.h"
 #include "json_rpc.h"
 
@@ -32,8 +33,14 @@ namespace cryptonote
         bool enableCors(const std::vector<std::string> domains);
         bool setFeeAddress(const std::string fee_address);
         bool setFeeAmount(const uint32_t fee_amount);
+        bool setWorkerThreads(const size_t threadCount);
         std::vector<std::string> getCorsDomains();
 
+        /* Runs query under Core::lockForReading() if we're on a worker thread.
+           Hold it no longer than needed - a block waiting to be added holds up
+           every new reader until it's in. */
+        void readCore(const std::function<void()> &query);
+
         bool on_get_block_headers_range(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request &req, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response &res, json_rpc::JsonRpcError &error_resp);
         bool on_get_info(const COMMAND_RPC_GET_INFO::request &req, COMMAND_RPC_GET_INFO::response &res);
 
@@ -43,6 +50,10 @@ namespace cryptonote
         {
             const Handler handler;
             const bool allowBusyCore;
+
+            /* Only reads the core, so can run on a worker thread under
+               Core::lockForReading(), rather than on the dispatcher */
+            const bool readOnly;
         };
 
         typedef void (RpcServer::*HandlerPtr)(const HttpRequest &request, HttpResponse &response);
@@ -52,6 +63,11 @@ namespace cryptonote
         bool processJsonRpcRequest(const HttpRequest &request, HttpResponse &response);
         bool isCoreReady();
 
+        /* Runs handler on a worker if it is read only and there are workers,
+           otherwise runs it here */
+        template <class Handler>
+        void runHandler(const RpcHandler<Handler> &handler, std::function<void()> &&call);
+
         // json handlers
         bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request &req, COMMAND_RPC_GET_BLOCKS_FAST::response &res);
         bool on_query_blocks(const COMMAND_RPC_QUERY_BLOCKS::request &req, COMMAND_RPC_QUERY_BLOCKS::response &res);
@@ -110,6 +126,9 @@ namespace cryptonote
         std::vector<std::string> m_cors_domains;
         std::string m_fee_address;
         uint32_t m_fee_amount;
+
+        /* Runs the read only handlers, if any threads were asked for */
+        std::unique_ptr<ThreadPool> m_workers;
     };
 
 }
@@ -7,9 +7,15 @@
 #include <sub_wallets/sub_wallet.h>
 /////////////////////////////////
 
+#include <algorithm>
+
+#include <config/cryptonote_config.h>
+
 #include <cryptonote_core/account.h>
 #include <cryptonote_core/cryptonote_basic_impl.h>
 
+#include <ctime>
+
 #include <utilities/utilities.h>
 
 #include <wallet_backend/constants.h>
@@ -103,9 +109,15 @@ void SubWallet::storeTransactionInput(
            sent ourselves, that are now returning as change. Remove from
            vector if found. */
         const auto it = std::remove_if(m_unconfirmedIncomingAmounts.begin(), m_unconfirmedIncomingAmounts.end(),
-                                       [&input](const auto storedInput)
+                                       [&input, this](const auto storedInput)
                                        {
-                                           return storedInput.key == input.key;
+                                           if (storedInput.key == input.key)
+                                           {
+                                               m_unconfirmedIncomingBalance -= storedInput.amount;
+                                               return true;
+                                           }
+
+                                           return false;
                                        });
 
         if (it != m_unconfirmedIncomingAmounts.end())
@@ -114,36 +126,130 @@ void SubWallet::storeTransactionInput(
         }
     }
 
-    m_unspentInputs.push_back(input);
+    addInput(input, false);
 }
 
 std::tuple<uint64_t, uint64_t> SubWallet::getBalance(
     const uint64_t currentHeight) const
 {
-    uint64_t unlockedBalance = 0;
+    updateBalance(currentHeight);
 
-    uint64_t lockedBalance = 0;
+    /* Add the locked balance from incoming transactions */
+    return {m_unlockedBalance, m_pendingBalance + m_unconfirmedIncomingBalance};
+}
 
-    for (const auto input : m_unspentInputs)
+bool SubWallet::isUnlockedAsOfLastUpdate(const uint64_t unlockTime) const
+{
+    /* Same rules as utilities::isInputUnlocked(), against the height and
+       time of the last update rather than now */
+    if (unlockTime == 0)
     {
-        /* If an unlock height is present, check if the input is unlocked */
-        if (utilities::isInputUnlocked(input.unlockTime, currentHeight))
-        {
-            unlockedBalance += input.amount;
-        }
-        else
+        return true;
+    }
+
+    if (unlockTime >= cryptonote::parameters::CRYPTONOTE_MAX_BLOCK_NUMBER)
+    {
+        return m_balanceTimestamp + cryptonote::parameters::CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS >= unlockTime;
+    }
+
+    return m_balanceHeight + cryptonote::parameters::CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS >= unlockTime;
+}
+
+void SubWallet::addToBalance(const wallet_types::TransactionInput &input) const
+{
+    if (isUnlockedAsOfLastUpdate(input.unlockTime))
+    {
+        m_unlockedBalance += input.amount;
+        return;
+    }
+
+    const PendingInputId id{input.key, input.parentTransactionHash};
+
+    m_pendingBalance += input.amount;
+    m_pendingInputs[id] = input.amount;
+
+    auto &unlocks = input.unlockTime >= cryptonote::parameters::CRYPTONOTE_MAX_BLOCK_NUMBER
+                        ? m_timestampUnlocks
+                        : m_heightUnlocks;
+
+    unlocks.push({input.unlockTime, id});
+}
+
+void SubWallet::removeFromBalance(const wallet_types::TransactionInput &input) const
+{
+    /* Its entry in the unlock queue goes stale, and is skipped later */
+    if (m_pendingInputs.erase({input.key, input.parentTransactionHash}) != 0)
+    {
+        m_pendingBalance -= input.amount;
+    }
+    else
+    {
+        m_unlockedBalance -= input.amount;
+    }
+}
+
+void SubWallet::updateBalance(const uint64_t currentHeight) const
+{
+    const uint64_t now = static_cast<uint64_t>(std::time(nullptr));
+
+    /* Inputs can lock again if the height or the clock go backwards - say,
+       after switching to a daemon which is behind. Rare enough to just start
+       over. */
+    if (currentHeight < m_balanceHeight || now < m_balanceTimestamp)
+    {
+        m_balanceHeight = currentHeight;
+        m_balanceTimestamp = now;
+        rebuildBalance();
+        return;
+    }
+
+    m_balanceHeight = currentHeight;
+    m_balanceTimestamp = now;
+
+    const auto release = [this](PendingUnlocks &unlocks, const uint64_t limit)
+    {
+        while (!unlocks.empty() && unlocks.top().unlockTime <= limit)
         {
-            lockedBalance += input.amount;
+            const auto it = m_pendingInputs.find(unlocks.top().input);
+
+            unlocks.pop();
+
+            /* Spent before it unlocked */
+            if (it == m_pendingInputs.end())
+            {
+                continue;
+            }
+
+            m_pendingBalance -= it->second;
+            m_unlockedBalance += it->second;
+
+            m_pendingInputs.erase(it);
         }
-    }
+    };
 
-    /* Add the locked balance from incoming transactions */
-    for (const auto unconfirmedInput : m_unconfirmedIncomingAmounts)
+    release(m_heightUnlocks, currentHeight + cryptonote::parameters::CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+    release(m_timestampUnlocks, now + cryptonote::parameters::CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS);
+}
+
+void SubWallet::rebuildBalance() const
+{
+    m_unlockedBalance = 0;
+    m_pendingBalance = 0;
+    m_unconfirmedIncomingBalance = 0;
+
+    m_pendingInputs.clear();
+    m_heightUnlocks = PendingUnlocks();
+    m_timestampUnlocks = PendingUnlocks();
+
+    for (const auto &input : m_unspentInputs)
     {
-        lockedBalance += unconfirmedInput.amount;
+        addToBalance(input);
     }
 
-    return {unlockedBalance, lockedBalance};
+    for (const auto &unconfirmedInput : m_unconfirmedIncomingAmounts)
+    {
+        m_unconfirmedIncomingBalance += unconfirmedInput.amount;
+    }
 }
 
 void SubWallet::reset(const uint64_t scanHeight)
@@ -155,6 +261,9 @@ void SubWallet::reset(const uint64_t scanHeight)
     m_unconfirmedIncomingAmounts.clear();
     m_unspentInputs.clear();
     m_spentInputs.clear();
+    m_inputSlots.clear();
+
+    rebuildBalance();
 }
 
 bool SubWallet::isPrimaryAddress() const
@@ -169,31 +278,61 @@ std::string SubWallet::address() const
 
 bool SubWallet::hasKeyImage(const crypto::KeyImage keyImage) const
 {
-    auto it = std::find_if(m_unspentInputs.begin(), m_unspentInputs.end(),
-                           [&keyImage](const auto &input)
-                           {
-                               return input.keyImage == keyImage;
-                           });
+    /* Note: We don't need to check the spent inputs - it should never show
+       up there, as the same key image can only be used once */
 
-    /* Found the key image */
-    if (it != m_unspentInputs.end())
+    /* Also don't need to check unconfirmed inputs - we can't spend those yet */
+    return m_inputSlots.find(keyImage) != m_inputSlots.end();
+}
+
+bool SubWallet::isKeyImageLocked(const crypto::KeyImage keyImage) const
+{
+    const auto it = m_inputSlots.find(keyImage);
+
+    return it != m_inputSlots.end() && it->second.locked;
+}
+
+bool SubWallet::hasInput(
+    const crypto::PublicKey &key,
+    const crypto::Hash &parentTransactionHash) const
+{
+    const auto matches = [&](const auto &input)
     {
-        return true;
+        return input.key == key && input.parentTransactionHash == parentTransactionHash;
+    };
+
+    for (const auto inputs : {&m_unspentInputs, &m_lockedInputs, &m_spentInputs})
+    {
+        if (std::any_of(inputs->begin(), inputs->end(), matches))
+        {
+            return true;
+        }
     }
 
-    /* Didn't find it in unlocked inputs, check the locked inputs */
-    it = std::find_if(m_lockedInputs.begin(), m_lockedInputs.end(),
-                      [&keyImage](const auto &input)
-                      {
-                          return input.keyImage == keyImage;
-                      });
+    return false;
+}
 
-    return it != m_lockedInputs.end();
+bool SubWallet::hasUnconfirmedIncomingInput(
+    const crypto::PublicKey &key,
+    const crypto::Hash &parentTransactionHash) const
+{
+    return std::any_of(m_unconfirmedIncomingAmounts.begin(), m_unconfirmedIncomingAmounts.end(),
+                       [&](const auto &input)
+                       { return input.key == key && input.parentTransactionHash == parentTransactionHash; });
+}
 
-    /* Note: We don't need to check the spent inputs - it should never show
-       up there, as the same key image can only be used once */
+std::vector<crypto::KeyImage> SubWallet::getKeyImages() const
+{
+    std::vector<crypto::KeyImage> keyImages;
 
-    /* Also don't need to check unconfirmed inputs - we can't spend those yet */
+    keyImages.reserve(m_inputSlots.size());
+
+    for (const auto &[keyImage, slot] : m_inputSlots)
+    {
+        keyImages.push_back(keyImage);
+    }
+
+    return keyImages;
 }
 
 crypto::PublicKey SubWallet::publicSpendKey() const
@@ -210,72 +349,103 @@ void SubWallet::markInputAsSpent(
     const crypto::KeyImage keyImage,
     const uint64_t spendHeight)
 {
-    /* Find the input */
-    auto it = std::find_if(m_unspentInputs.begin(), m_unspentInputs.end(),
-                           [&keyImage](const auto x)
-                           {
-                               return x.keyImage == keyImage;
-                           });
+    /* Find the input, either unspent or locked */
+    auto input = takeInput(keyImage, false);
 
-    if (it != m_unspentInputs.end())
+    /* Set the spend height */
+    input.spendHeight = spendHeight;
+
+    /* Add to the spent inputs vector */
+    m_spentInputs.push_back(input);
+}
+
+void SubWallet::markInputAsLocked(const crypto::KeyImage keyImage)
+{
+    /* Move it from the unspent inputs to the locked inputs */
+    addInput(takeInput(keyImage, true), true);
+}
+
+void SubWallet::addInput(
+    const wallet_types::TransactionInput &input,
+    const bool locked)
+{
+    auto &inputs = locked ? m_lockedInputs : m_unspentInputs;
+
+    inputs.push_back(input);
+
+    if (!locked)
     {
-        /* Set the spend height */
-        it->spendHeight = spendHeight;
+        addToBalance(input);
+    }
 
-        /* Add to the spent inputs vector */
-        m_spentInputs.push_back(*it);
+    if (input.keyImage != crypto::KeyImage())
+    {
+        m_inputSlots[input.keyImage] = {locked, inputs.size() - 1};
+    }
+}
 
-        /* Remove from the unspent vector */
-        m_unspentInputs.erase(it);
+wallet_types::TransactionInput SubWallet::takeInput(
+    const crypto::KeyImage &keyImage,
+    const bool mustBeUnspent)
+{
+    const auto it = m_inputSlots.find(keyImage);
 
-        return;
+    /* Shouldn't happen */
+    if (it == m_inputSlots.end() || (mustBeUnspent && it->second.locked))
+    {
+        throw std::runtime_error(mustBeUnspent ? "Could not find key image to lock!" : "Could not find key image to remove!");
     }
 
-    /* Didn't find it, lets try in the locked inputs */
-    it = std::find_if(m_lockedInputs.begin(), m_lockedInputs.end(),
-                      [&keyImage](const auto x)
-                      {
-                          return x.keyImage == keyImage;
-                      });
+    const auto [locked, index] = it->second;
 
-    if (it != m_lockedInputs.end())
+    m_inputSlots.erase(it);
+
+    auto &inputs = locked ? m_lockedInputs : m_unspentInputs;
+
+    const wallet_types::TransactionInput input = inputs[index];
+
+    /* Fill the gap with the last input */
+    if (index != inputs.size() - 1)
     {
-        /* Set the spend height */
-        it->spendHeight = spendHeight;
+        inputs[index] = inputs.back();
 
-        /* Add to the spent inputs vector */
-        m_spentInputs.push_back(*it);
+        const auto moved = m_inputSlots.find(inputs[index].keyImage);
 
-        /* Remove from the locked vector */
-        m_lockedInputs.erase(it);
+        if (moved != m_inputSlots.end())
+        {
+            moved->second.index = index;
+        }
+    }
 
-        return;
+    inputs.pop_back();
+
+    if (!locked)
+    {
+        removeFromBalance(input);
     }
 
-    /* Shouldn't happen */
-    throw std::runtime_error("Could not find key image to remove!");
+    return input;
 }
 
-void SubWallet::markInputAsLocked(const crypto::KeyImage keyImage)
+void SubWallet::rebuildInputSlots()
 {
-    /* Find the input */
-    auto it = std::find_if(m_unspentInputs.begin(), m_unspentInputs.end(),
-                           [&keyImage](const auto x)
-                           {
-                               return x.keyImage == keyImage;
-                           });
+    m_inputSlots.clear();
 
-    /* Shouldn't happen */
-    if (it == m_unspentInputs.end())
+    for (size_t i = 0; i < m_unspentInputs.size(); i++)
     {
-        throw std::runtime_error("Could not find key image to lock!");
+        if (m_unspentInputs[i].keyImage != crypto::KeyImage())
+        {
+            m_inputSlots[m_unspentInputs[i].keyImage] = {false, i};
+        }
     }
 
-    /* Add to the spent inputs vector */
-    m_lockedInputs.push_back(*it);
-
-    /* Remove from the unspent vector */
-    m_unspentInputs.erase(it);
+    for (size_t i = 0; i < m_lockedInputs.size(); i++)
+    {
+        if (m_lockedInputs[i].keyImage != crypto::KeyImage())
+        {
+            m_inputSlots[m_lockedInputs[i].keyImage] = {true, i};
+        }
+    }
 }
 
 void SubWallet::removeForkedInputs(const uint64_t forkHeight)
@@ -319,6 +489,9 @@ void SubWallet::removeForkedInputs(const uint64_t forkHeight)
     {
         m_spentInputs.erase(it, m_spentInputs.end());
     }
+
+    rebuildInputSlots();
+    rebuildBalance();
 }
 
 /* Cancelled transactions are transactions we sent, but got cancelled and not
@@ -362,6 +535,9 @@ void SubWallet::removeCancelledTransactions(
     {
         m_unconfirmedIncomingAmounts.erase(it2, m_unconfirmedIncomingAmounts.end());
     }
+
+    rebuildInputSlots();
+    rebuildBalance();
 }
 
 std::vector<wallet_types::TxInputAndOwner> SubWallet::getSpendableInputs(
@@ -394,6 +570,7 @@ void SubWallet::storeUnconfirmedIncomingInput(
     const wallet_types::UnconfirmedInput input)
 {
     m_unconfirmedIncomingAmounts.push_back(input);
+    m_unconfirmedIncomingBalance += input.amount;
 }
 
 void SubWallet::convertSyncTimestampToHeight(
@@ -448,6 +625,9 @@ void SubWallet::fromJSON(const JSONValue &j)
         amount.fromJSON(x);
         m_unconfirmedIncomingAmounts.push_back(amount);
     }
+
+    rebuildInputSlots();
+    rebuildBalance();
 }
 
 void SubWallet::toJSON(rapidjson::Writer<rapidjson::StringBuffer> &writer) const
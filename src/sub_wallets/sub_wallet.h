@@ -13,8 +13,11 @@
 
 #include "rapidjson/document.h"
 
+#include <queue>
+
 #include <string>
 
+#include <unordered_map>
 #include <unordered_set>
 
 #include "wallet_types.h"
@@ -76,6 +79,23 @@ public:
 
     bool hasKeyImage(const crypto::KeyImage keyImage) const;
 
+    /* Whether the key image belongs to a locked input, rather than an
+       unspent one */
+    bool isKeyImageLocked(const crypto::KeyImage keyImage) const;
+
+    /* Whether the input has been stored, spent or not. Searches every
+       input, so is only for replaying the wallet journal. */
+    bool hasInput(
+        const crypto::PublicKey &key,
+        const crypto::Hash &parentTransactionHash) const;
+
+    bool hasUnconfirmedIncomingInput(
+        const crypto::PublicKey &key,
+        const crypto::Hash &parentTransactionHash) const;
+
+    /* The key images of the unspent and locked inputs */
+    std::vector<crypto::KeyImage> getKeyImages() const;
+
     crypto::PublicKey publicSpendKey() const;
 
     crypto::SecretKey privateSpendKey() const;
@@ -110,6 +130,92 @@ public:
     /////////////////////////////
 
 private:
+    //////////////////////////////
+    /* Private member functions */
+    //////////////////////////////
+
+    /* Stores the input at the back of inputs, and indexes it */
+    void addInput(
+        const wallet_types::TransactionInput &input,
+        const bool locked);
+
+    /* Removes the unspent or locked input with this key image, and returns
+       it. Throws if there isn't one. */
+    wallet_types::TransactionInput takeInput(
+        const crypto::KeyImage &keyImage,
+        const bool mustBeUnspent);
+
+    /* Reindexes every unspent and locked input, after they've been moved
+       around wholesale */
+    void rebuildInputSlots();
+
+    /* Adds an input which has just become unspent to the balance, or
+       removes one which is no longer unspent */
+    void addToBalance(const wallet_types::TransactionInput &input) const;
+    void removeFromBalance(const wallet_types::TransactionInput &input) const;
+
+    /* Whether an input with this unlock time had unlocked as of the last
+       balance update */
+    bool isUnlockedAsOfLastUpdate(const uint64_t unlockTime) const;
+
+    /* Moves the pending inputs which have unlocked by the given height, and
+       the current time, into the unlocked balance */
+    void updateBalance(const uint64_t currentHeight) const;
+
+    /* Recomputes the balance from scratch, after the inputs have been moved
+       around wholesale */
+    void rebuildBalance() const;
+
+    //////////////////////////////
+    /* Private member variables */
+    //////////////////////////////
+
+    /* Which input is pending. The output key alone isn't enough, as the
+       same key can be sent to us again in another transaction. */
+    struct PendingInputId
+    {
+        crypto::PublicKey key;
+
+        crypto::Hash parentTransactionHash;
+
+        bool operator==(const PendingInputId &other) const
+        {
+            return key == other.key && parentTransactionHash == other.parentTransactionHash;
+        }
+    };
+
+    struct PendingInputIdHash
+    {
+        size_t operator()(const PendingInputId &id) const
+        {
+            return std::hash<crypto::PublicKey>{}(id.key) ^ std::hash<crypto::Hash>{}(id.parentTransactionHash);
+        }
+    };
+
+    /* When a pending input unlocks - a height or a timestamp */
+    struct PendingUnlock
+    {
+        uint64_t unlockTime;
+
+        PendingInputId input;
+
+        bool operator>(const PendingUnlock &other) const
+        {
+            return unlockTime > other.unlockTime;
+        }
+    };
+
+    typedef std::priority_queue<PendingUnlock, std::vector<PendingUnlock>, std::greater<PendingUnlock>> PendingUnlocks;
+
+    /* Where an input with a given key image is */
+    struct InputSlot
+    {
+        /* In m_lockedInputs, rather than m_unspentInputs */
+        bool locked;
+
+        size_t index;
+    };
+
     /* A vector of the stored transaction input data, to be used for
        sending transactions later */
     std::vector<wallet_types::TransactionInput> m_unspentInputs;
@@ -121,11 +227,44 @@ private:
     /* Inputs which have been spent in a transaction */
     std::vector<wallet_types::TransactionInput> m_spentInputs;
 
+    /* The unspent and locked inputs by key image, so finding one when it's
+       spent doesn't mean searching the vectors. Their order doesn't matter,
+       so an input is removed by moving the last one into its place. View
+       wallets can't generate key images, so their inputs aren't in here. */
+    std::unordered_map<crypto::KeyImage, InputSlot> m_inputSlots;
+
     /* Inputs which have come in from a transaction we sent - either from
        change or from sending to ourself - we use this to display unlocked
        balance correctly */
     std::vector<wallet_types::UnconfirmedInput> m_unconfirmedIncomingAmounts;
 
+    /* The balance is kept up to date as inputs come and go, rather than
+       summed up every time it's asked for. These are mutable as asking for
+       it also moves inputs which have unlocked since the last time from the
+       pending to the unlocked total. */
+
+    /* The unspent inputs which had unlocked as of the last update */
+    mutable uint64_t m_unlockedBalance = 0;
+
+    /* The unspent inputs which hadn't */
+    mutable uint64_t m_pendingBalance = 0;
+
+    /* The total of m_unconfirmedIncomingAmounts */
+    mutable uint64_t m_unconfirmedIncomingBalance = 0;
+
+    /* The amounts of the pending inputs */
+    mutable std::unordered_map<PendingInputId, uint64_t, PendingInputIdHash> m_pendingInputs;
+
+    /* The pending inputs by unlock height and by unlock timestamp, soonest
+       first. Inputs which are spent before they unlock are left in here, and
+       skipped when they come up. */
+    mutable PendingUnlocks m_heightUnlocks;
+    mutable PendingUnlocks m_timestampUnlocks;
+
+    /* The height and time the balance was last updated at */
+    mutable uint64_t m_balanceHeight = 0;
+    mutable uint64_t m_balanceTimestamp = 0;
+
     /* This subwallet's public spend key */
     crypto::PublicKey m_publicSpendKey;
 
@@ -74,7 +74,9 @@ SubWallets::SubWallets(
 
 /* Copy constructor */
 SubWallets::SubWallets(const SubWallets &other) : m_subWallets(other.m_subWallets),
+                                                  m_keyImageOwners(other.m_keyImageOwners),
                                                   m_transactions(other.m_transactions),
+                                                  m_transactionsByAddress(other.m_transactionsByAddress),
                                                   m_lockedTransactions(other.m_lockedTransactions),
                                                   m_privateViewKey(other.m_privateViewKey),
                                                   m_isViewWallet(other.m_isViewWallet),
@@ -115,6 +117,8 @@ std::tuple<Error, std::string, crypto::SecretKey> SubWallets::addSubWallet()
 
     m_publicSpendKeys.push_back(spendKey.publicKey);
 
+    invalidateJournal();
+
     return {SUCCESS, address, spendKey.secretKey};
 }
 
@@ -152,6 +156,8 @@ std::tuple<Error, std::string> SubWallets::importSubWallet(
 
     m_publicSpendKeys.push_back(publicSpendKey);
 
+    invalidateJournal();
+
     return {SUCCESS, address};
 }
 
@@ -188,6 +194,8 @@ std::tuple<Error, std::string> SubWallets::importViewSubWallet(
 
     m_publicSpendKeys.push_back(publicSpendKey);
 
+    invalidateJournal();
+
     return {SUCCESS, address};
 }
 
@@ -212,10 +220,14 @@ Error SubWallets::deleteSubWallet(const std::string address)
 
     m_subWallets.erase(it);
 
+    rebuildKeyImageOwners();
+
     /* Remove or update the transactions */
     deleteAddressTransactions(m_transactions, spendKey);
     deleteAddressTransactions(m_lockedTransactions, spendKey);
 
+    m_transactionsByAddress.erase(spendKey);
+
     const auto it2 = std::remove(m_publicSpendKeys.begin(), m_publicSpendKeys.end(), spendKey);
 
     if (it2 != m_publicSpendKeys.end())
@@ -223,38 +235,59 @@ Error SubWallets::deleteSubWallet(const std::string address)
         m_publicSpendKeys.erase(it2, m_publicSpendKeys.end());
     }
 
+    invalidateJournal();
+
     return SUCCESS;
 }
 
 void SubWallets::deleteAddressTransactions(
-    std::vector<wallet_types::Transaction> &txs,
+    Transactions &txs,
     const crypto::PublicKey spendKey)
 {
-    const auto it = std::remove_if(txs.begin(), txs.end(), [spendKey](auto &tx)
-                                   {
+    for (auto it = txs.begin(); it != txs.end();)
+    {
         /* See if this transaction contains the subwallet we're deleting */
-        const auto key = tx.transfers.find(spendKey);
+        const auto key = it->transfers.find(spendKey);
 
-        /* OK, it does */
-        if (key != tx.transfers.end())
+        /* It doesn't */
+        if (key == it->transfers.end())
         {
-            /* It's the only element, delete the transaction */
-            if (tx.transfers.size() == 1)
-            {
-                return true;
-            }
-            /* Otherwise just delete the transfer in the transaction */
-            else
-            {
-                tx.transfers.erase(key);
-            }
+            ++it;
+        }
+        /* It's the only element, delete the transaction */
+        else if (it->transfers.size() == 1)
+        {
+            it = txs.erase(it);
+        }
+        /* Otherwise just delete the transfer in the transaction */
+        else
+        {
+            txs.modify(it, [&spendKey](auto &tx)
+                       { tx.transfers.erase(spendKey); });
+
+            ++it;
         }
+    }
+}
 
-        return false; });
+void SubWallets::indexTransaction(const wallet_types::Transaction &tx)
+{
+    for (const auto &[publicKey, amount] : tx.transfers)
+    {
+        m_transactionsByAddress[publicKey].insert(tx.cursor());
+    }
+}
 
-    if (it != txs.end())
+void SubWallets::unindexTransaction(const wallet_types::Transaction &tx)
+{
+    for (const auto &[publicKey, amount] : tx.transfers)
     {
-        txs.erase(it, txs.end());
+        const auto it = m_transactionsByAddress.find(publicKey);
+
+        if (it != m_transactionsByAddress.end())
+        {
+            it->second.erase(tx.cursor());
+        }
     }
 }
 
@@ -314,13 +347,7 @@ void SubWallets::addUnconfirmedTransaction(const wallet_types::Transaction tx)
 {
     std::scoped_lock lock(m_mutex);
 
-    const auto it2 = std::find_if(m_lockedTransactions.begin(), m_lockedTransactions.end(),
-                                  [tx](const auto transaction)
-                                  {
-                                      return tx.hash == transaction.hash;
-                                  });
-
-    if (it2 != m_lockedTransactions.end())
+    if (!m_lockedTransactions.push_back(tx).second)
     {
         std::stringstream stream;
 
@@ -329,7 +356,10 @@ void SubWallets::addUnconfirmedTransaction(const wallet_types::Transaction tx)
         throw std::runtime_error(stream.str());
     }
 
-    m_lockedTransactions.push_back(tx);
+    journal("unconfirmedTransaction", [&tx](auto &writer)
+            {
+        writer.Key("transaction");
+        tx.toJSON(writer); });
 }
 
 void SubWallets::addTransaction(const wallet_types::Transaction tx)
@@ -340,25 +370,9 @@ void SubWallets::addTransaction(const wallet_types::Transaction tx)
        vector instantly. This lets us display the data to the user, and then
        when the transaction actually comes in, we will update the transaction
        with the block infomation. */
-    const auto it = std::remove_if(m_lockedTransactions.begin(), m_lockedTransactions.end(),
-                                   [tx](const auto transaction)
-                                   {
-                                       return tx.hash == transaction.hash;
-                                   });
-
-    if (it != m_lockedTransactions.end())
-    {
-        /* Remove from the locked container */
-        m_lockedTransactions.erase(it, m_lockedTransactions.end());
-    }
-
-    const auto it2 = std::find_if(m_transactions.begin(), m_transactions.end(),
-                                  [tx](const auto transaction)
-                                  {
-                                      return tx.hash == transaction.hash;
-                                  });
+    m_lockedTransactions.get<TransactionHashIndex>().erase(tx.hash);
 
-    if (it2 != m_transactions.end())
+    if (!m_transactions.push_back(tx).second)
     {
         std::stringstream stream;
 
@@ -367,7 +381,12 @@ void SubWallets::addTransaction(const wallet_types::Transaction tx)
         throw std::runtime_error(stream.str());
     }
 
-    m_transactions.push_back(tx);
+    indexTransaction(tx);
+
+    journal("transaction", [&tx](auto &writer)
+            {
+        writer.Key("transaction");
+        tx.toJSON(writer); });
 }
 
 crypto::KeyImage SubWallets::getTxInputKeyImage(
@@ -401,6 +420,20 @@ void SubWallets::storeTransactionInput(
     /* Check it exists */
     if (it != m_subWallets.end())
     {
+        /* View wallets don't have key images to index */
+        if (!m_isViewWallet)
+        {
+            m_keyImageOwners[input.keyImage] = publicSpendKey;
+        }
+
+        journal("input", [&publicSpendKey, &input](auto &writer)
+                {
+            writer.Key("publicSpendKey");
+            publicSpendKey.toJSON(writer);
+
+            writer.Key("input");
+            input.toJSON(writer); });
+
         /* If we have a view wallet, don't attempt to derive the key image */
         return it->second.storeTransactionInput(input, m_isViewWallet);
     }
@@ -419,17 +452,23 @@ SubWallets::getKeyImageOwner(const crypto::KeyImage keyImage) const
 
     std::scoped_lock lock(m_mutex);
 
-    for (const auto &[publicKey, subWallet] : m_subWallets)
+    const auto it = m_keyImageOwners.find(keyImage);
+
+    if (it != m_keyImageOwners.end())
     {
-        if (subWallet.hasKeyImage(keyImage))
-        {
-            return {true, subWallet.publicSpendKey()};
-        }
+        return {true, it->second};
     }
 
     return {false, crypto::PublicKey()};
 }
 
+bool SubWallets::hasSpendKey(const crypto::PublicKey &publicSpendKey) const
+{
+    std::scoped_lock lock(m_mutex);
+
+    return m_subWallets.find(publicSpendKey) != m_subWallets.end();
+}
+
 /* Remember if the transaction suceeds, we need to remove these key images
    so we don't double spend.
 
@@ -699,6 +738,20 @@ void SubWallets::markInputAsSpent(
     std::scoped_lock lock(m_mutex);
 
     m_subWallets.at(publicKey).markInputAsSpent(keyImage, spendHeight);
+
+    /* Spent inputs can't be spent again, so aren't looked up */
+    m_keyImageOwners.erase(keyImage);
+
+    journal("spend", [&keyImage, &publicKey, spendHeight](auto &writer)
+            {
+        writer.Key("keyImage");
+        keyImage.toJSON(writer);
+
+        writer.Key("publicSpendKey");
+        publicKey.toJSON(writer);
+
+        writer.Key("spendHeight");
+        writer.Uint64(spendHeight); });
 }
 
 /* Mark a key image as locked, can no longer be used in transactions till it
@@ -713,7 +766,17 @@ void SubWallets::markInputAsLocked(
 
     std::scoped_lock lock(m_mutex);
 
+    /* Still ours until we see it spent in a block, so stays in
+       m_keyImageOwners */
     m_subWallets.at(publicKey).markInputAsLocked(keyImage);
+
+    journal("lock", [&keyImage, &publicKey](auto &writer)
+            {
+        writer.Key("keyImage");
+        keyImage.toJSON(writer);
+
+        writer.Key("publicSpendKey");
+        publicKey.toJSON(writer); });
 }
 
 /* Remove transactions and key images that occured on a forked chain */
@@ -721,23 +784,32 @@ void SubWallets::removeForkedTransactions(uint64_t forkHeight)
 {
     std::scoped_lock lock(m_mutex);
 
-    const auto it = std::remove_if(m_transactions.begin(), m_transactions.end(),
-                                   [forkHeight](auto tx)
-                                   {
-                                       /* Remove the transaction if it's height is >= than the fork height */
-                                       return tx.blockHeight >= forkHeight;
-                                   });
+    auto &byCursor = m_transactions.get<TransactionCursorIndex>();
+
+    /* Remove the transactions with a height >= than the fork height */
+    const auto forked = byCursor.lower_bound(wallet_types::TransactionCursor{forkHeight, crypto::Hash()});
 
-    if (it != m_transactions.end())
+    for (auto it = forked; it != byCursor.end(); ++it)
     {
-        m_transactions.erase(it, m_transactions.end());
+        unindexTransaction(*it);
     }
 
+    byCursor.erase(forked, byCursor.end());
+
     /* Loop through each subwallet */
     for (auto &[publicKey, subWallet] : m_subWallets)
     {
         subWallet.removeForkedInputs(forkHeight);
     }
+
+    /* Inputs received after the fork are gone, and ones spent after it are
+       unspent again */
+    rebuildKeyImageOwners();
+
+    journal("fork", [forkHeight](auto &writer)
+            {
+        writer.Key("forkHeight");
+        writer.Uint64(forkHeight); });
 }
 
 void SubWallets::removeCancelledTransactions(
@@ -748,23 +820,26 @@ void SubWallets::removeCancelledTransactions(
 
     std::scoped_lock lock(m_mutex);
 
-    /* Find any cancelled transactions */
-    const auto it = std::remove_if(m_lockedTransactions.begin(), m_lockedTransactions.end(),
-                                   [&cancelledTransactions](const auto &tx)
-                                   {
-                                       return cancelledTransactions.find(tx.hash) != cancelledTransactions.end();
-                                   });
-
-    if (it != m_lockedTransactions.end())
+    /* Remove the cancelled transactions */
+    for (const auto &hash : cancelledTransactions)
     {
-        /* Remove the cancelled transactions */
-        m_lockedTransactions.erase(it, m_lockedTransactions.end());
+        m_lockedTransactions.get<TransactionHashIndex>().erase(hash);
     }
 
     for (auto &[pubKey, subWallet] : m_subWallets)
     {
         subWallet.removeCancelledTransactions(cancelledTransactions);
     }
+
+    journal("cancel", [&cancelledTransactions](auto &writer)
+            {
+        writer.Key("transactionHashes");
+        writer.StartArray();
+        for (const auto &hash : cancelledTransactions)
+        {
+            hash.toJSON(writer);
+        }
+        writer.EndArray(); });
 }
 
 crypto::SecretKey SubWallets::getPrivateViewKey() const
@@ -804,6 +879,24 @@ std::unordered_set<crypto::Hash> SubWallets::getLockedTransactionsHashes() const
     return result;
 }
 
+void SubWallets::rebuildKeyImageOwners()
+{
+    m_keyImageOwners.clear();
+
+    if (m_isViewWallet)
+    {
+        return;
+    }
+
+    for (const auto &[publicKey, subWallet] : m_subWallets)
+    {
+        for (const auto &keyImage : subWallet.getKeyImages())
+        {
+            m_keyImageOwners[keyImage] = publicKey;
+        }
+    }
+}
+
 void SubWallets::throwIfViewWallet() const
 {
     if (m_isViewWallet)
@@ -823,12 +916,17 @@ void SubWallets::reset(const uint64_t scanHeight)
 
     m_lockedTransactions.clear();
     m_transactions.clear();
+    m_transactionsByAddress.clear();
     m_transactionPrivateKeys.clear();
+    m_keyImageOwners.clear();
 
-    for (auto [pubKey, subWallet] : m_subWallets)
+    for (auto &[pubKey, subWallet] : m_subWallets)
     {
         subWallet.reset(scanHeight);
     }
+
+    /* Little left to save after this anyway */
+    invalidateJournal();
 }
 
 std::vector<crypto::SecretKey> SubWallets::getPrivateSpendKeys() const
@@ -861,7 +959,99 @@ crypto::SecretKey SubWallets::getPrimaryPrivateSpendKey() const
 
 std::vector<wallet_types::Transaction> SubWallets::getTransactions() const
 {
-    return m_transactions;
+    std::scoped_lock lock(m_mutex);
+
+    return {m_transactions.begin(), m_transactions.end()};
+}
+
+std::optional<wallet_types::Transaction> SubWallets::getTransaction(
+    const crypto::Hash &hash) const
+{
+    std::scoped_lock lock(m_mutex);
+
+    const auto &byHash = m_transactions.get<TransactionHashIndex>();
+
+    const auto it = byHash.find(hash);
+
+    if (it == byHash.end())
+    {
+        return std::nullopt;
+    }
+
+    return *it;
+}
+
+std::tuple<std::vector<wallet_types::Transaction>, std::optional<wallet_types::TransactionCursor>>
+SubWallets::getTransactionsInRange(
+    const uint64_t startHeight,
+    const uint64_t endHeight,
+    const std::optional<crypto::PublicKey> spendKey,
+    const std::optional<wallet_types::TransactionCursor> after,
+    const size_t limit) const
+{
+    std::scoped_lock lock(m_mutex);
+
+    std::vector<wallet_types::Transaction> result;
+
+    std::optional<wallet_types::TransactionCursor> next;
+
+    /* The lowest cursor at the start height */
+    const wallet_types::TransactionCursor start{startHeight, crypto::Hash()};
+
+    /* Resume after the cursor, unless it's before the range */
+    const bool resume = after && !(*after < start);
+
+    /* Walks an index ordered by cursor from it until the end of the range,
+       or until we've got enough */
+    const auto collect = [&](auto it, const auto end, const auto &transactionAt)
+    {
+        for (; it != end; ++it)
+        {
+            const wallet_types::Transaction &tx = transactionAt(it);
+
+            if (tx.blockHeight >= endHeight)
+            {
+                break;
+            }
+
+            /* There's more, but this page is full */
+            if (limit != 0 && result.size() == limit)
+            {
+                next = result.back().cursor();
+                break;
+            }
+
+            result.push_back(tx);
+        }
+    };
+
+    if (spendKey)
+    {
+        const auto cursors = m_transactionsByAddress.find(*spendKey);
+
+        if (cursors != m_transactionsByAddress.end())
+        {
+            const auto &byHash = m_transactions.get<TransactionHashIndex>();
+
+            collect(
+                resume ? cursors->second.upper_bound(*after) : cursors->second.lower_bound(start),
+                cursors->second.end(),
+                [&byHash](const auto it) -> const wallet_types::Transaction &
+                { return *byHash.find(it->hash); });
+        }
+    }
+    else
+    {
+        const auto &byCursor = m_transactions.get<TransactionCursorIndex>();
+
+        collect(
+            resume ? byCursor.upper_bound(*after) : byCursor.lower_bound(start),
+            byCursor.end(),
+            [](const auto it) -> const wallet_types::Transaction &
+            { return *it; });
+    }
+
+    return {result, next};
 }
 
 /* Note that this DOES NOT return incoming transactions in the pool. It only
@@ -869,7 +1059,9 @@ std::vector<wallet_types::Transaction> SubWallets::getTransactions() const
    block yet. */
 std::vector<wallet_types::Transaction> SubWallets::getUnconfirmedTransactions() const
 {
-    return m_lockedTransactions;
+    std::scoped_lock lock(m_mutex);
+
+    return {m_lockedTransactions.begin(), m_lockedTransactions.end()};
 }
 
 std::tuple<Error, std::string> SubWallets::getAddress(
@@ -889,7 +1081,17 @@ void SubWallets::storeTxPrivateKey(
     const crypto::SecretKey txPrivateKey,
     const crypto::Hash txHash)
 {
+    std::scoped_lock lock(m_mutex);
+
     m_transactionPrivateKeys[txHash] = txPrivateKey;
+
+    journal("txPrivateKey", [&txHash, &txPrivateKey](auto &writer)
+            {
+        writer.Key("transactionHash");
+        txHash.toJSON(writer);
+
+        writer.Key("txPrivateKey");
+        txPrivateKey.toJSON(writer); });
 }
 
 std::tuple<bool, crypto::SecretKey> SubWallets::getTxPrivateKey(
@@ -916,6 +1118,14 @@ void SubWallets::storeUnconfirmedIncomingInput(
     if (it != m_subWallets.end())
     {
         it->second.storeUnconfirmedIncomingInput(input);
+
+        journal("unconfirmedInput", [&publicSpendKey, &input](auto &writer)
+                {
+            writer.Key("publicSpendKey");
+            publicSpendKey.toJSON(writer);
+
+            writer.Key("input");
+            input.toJSON(writer); });
     }
 }
 
@@ -929,16 +1139,26 @@ void SubWallets::convertSyncTimestampToHeight(
     {
         subWallet.convertSyncTimestampToHeight(timestamp, height);
     }
+
+    journal("syncTimestampToHeight", [timestamp, height](auto &writer)
+            {
+        writer.Key("timestamp");
+        writer.Uint64(timestamp);
+
+        writer.Key("height");
+        writer.Uint64(height); });
 }
 
 std::vector<std::tuple<std::string, uint64_t, uint64_t>> SubWallets::getBalances(
     const uint64_t currentHeight) const
 {
+    std::scoped_lock lock(m_mutex);
+
     std::vector<std::tuple<std::string, uint64_t, uint64_t>> balances;
 
-    for (auto [pubKey, subWallet] : m_subWallets)
+    for (const auto &[pubKey, subWallet] : m_subWallets)
     {
-        const auto [unlocked, locked] = m_subWallets.at(pubKey).getBalance(currentHeight);
+        const auto [unlocked, locked] = subWallet.getBalance(currentHeight);
 
         balances.emplace_back(subWallet.address(), unlocked, locked);
     }
@@ -946,6 +1166,213 @@ std::vector<std::tuple<std::string, uint64_t, uint64_t>> SubWallets::getBalances
     return balances;
 }
 
+template<typename T>
+void SubWallets::journal(const std::string &type, T writeFields)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+
+    writer.StartObject();
+
+    writer.Key("type");
+    writer.String(type);
+
+    writeFields(writer);
+
+    writer.EndObject();
+
+    m_journal.push_back(sb.GetString());
+}
+
+void SubWallets::invalidateJournal()
+{
+    m_journal.clear();
+    m_journalComplete = false;
+}
+
+std::tuple<bool, std::vector<std::string>> SubWallets::takeJournal()
+{
+    std::scoped_lock lock(m_mutex);
+
+    const bool complete = m_journalComplete;
+
+    std::vector<std::string> changes;
+
+    changes.swap(m_journal);
+
+    m_journalComplete = true;
+
+    return {complete, changes};
+}
+
+std::tuple<bool, std::vector<std::string>> SubWallets::snapshotAndTakeJournal(
+    rapidjson::Writer<rapidjson::StringBuffer> &writer)
+{
+    std::scoped_lock lock(m_mutex);
+
+    toJSON(writer);
+
+    const bool complete = m_journalComplete;
+
+    std::vector<std::string> changes;
+
+    changes.swap(m_journal);
+
+    m_journalComplete = true;
+
+    return {complete, changes};
+}
+
+void SubWallets::applyJournal(const JSONValue &change)
+{
+    const std::string type = getStringFromJSON(change, "type");
+
+    const auto getKey = [&change](const std::string &name, auto &key)
+    {
+        key.fromString(getStringFromJSON(change, name));
+    };
+
+    /* Shouldn't happen, but if the wallet file already has a change, don't
+       make it twice - adding a transaction again throws, and adding an input
+       again counts it twice */
+    const auto alreadyApplied = [this](const auto &check)
+    {
+        std::scoped_lock lock(m_mutex);
+        return check();
+    };
+
+    if (type == "transaction" || type == "unconfirmedTransaction")
+    {
+        wallet_types::Transaction tx;
+        tx.fromJSON(getJsonValue(change, "transaction"));
+
+        const bool applied = alreadyApplied([&]
+                                            { return m_transactions.get<TransactionHashIndex>().count(tx.hash) != 0
+                                                  || (type == "unconfirmedTransaction"
+                                                      && m_lockedTransactions.get<TransactionHashIndex>().count(tx.hash) != 0); });
+
+        if (applied)
+        {
+            return;
+        }
+
+        if (type == "transaction")
+        {
+            addTransaction(tx);
+        }
+        else
+        {
+            addUnconfirmedTransaction(tx);
+        }
+    }
+    else if (type == "input")
+    {
+        crypto::PublicKey publicSpendKey;
+        getKey("publicSpendKey", publicSpendKey);
+
+        wallet_types::TransactionInput input;
+        input.fromJSON(getJsonValue(change, "input"));
+
+        if (alreadyApplied([&]
+                           { return m_subWallets.at(publicSpendKey).hasInput(input.key, input.parentTransactionHash); }))
+        {
+            return;
+        }
+
+        storeTransactionInput(publicSpendKey, input);
+    }
+    else if (type == "spend" || type == "lock")
+    {
+        crypto::KeyImage keyImage;
+        getKey("keyImage", keyImage);
+
+        crypto::PublicKey publicSpendKey;
+        getKey("publicSpendKey", publicSpendKey);
+
+        /* Spent already, or locked already */
+        const bool applied = alreadyApplied([&]
+                                            {
+            const auto &subWallet = m_subWallets.at(publicSpendKey);
+
+            return !subWallet.hasKeyImage(keyImage)
+                || (type == "lock" && subWallet.isKeyImageLocked(keyImage)); });
+
+        if (applied)
+        {
+            return;
+        }
+
+        if (type == "spend")
+        {
+            markInputAsSpent(keyImage, publicSpendKey, getUint64FromJSON(change, "spendHeight"));
+        }
+        else
+        {
+            markInputAsLocked(keyImage, publicSpendKey);
+        }
+    }
+    else if (type == "fork")
+    {
+        removeForkedTransactions(getUint64FromJSON(change, "forkHeight"));
+    }
+    else if (type == "cancel")
+    {
+        std::unordered_set<crypto::Hash> cancelledTransactions;
+
+        for (const auto &x : getArrayFromJSON(change, "transactionHashes"))
+        {
+            crypto::Hash hash;
+            hash.fromString(getStringFromJSONString(x));
+            cancelledTransactions.insert(hash);
+        }
+
+        removeCancelledTransactions(cancelledTransactions);
+    }
+    else if (type == "txPrivateKey")
+    {
+        crypto::Hash txHash;
+        getKey("transactionHash", txHash);
+
+        crypto::SecretKey txPrivateKey;
+        getKey("txPrivateKey", txPrivateKey);
+
+        storeTxPrivateKey(txPrivateKey, txHash);
+    }
+    else if (type == "unconfirmedInput")
+    {
+        crypto::PublicKey publicSpendKey;
+        getKey("publicSpendKey", publicSpendKey);
+
+        wallet_types::UnconfirmedInput input;
+        input.fromJSON(getJsonValue(change, "input"));
+
+        /* Waiting for it already, or it's arrived */
+        const bool applied = alreadyApplied([&]
+                                            {
+            const auto &subWallet = m_subWallets.at(publicSpendKey);
+
+            return subWallet.hasUnconfirmedIncomingInput(input.key, input.parentTransactionHash)
+                || subWallet.hasInput(input.key, input.parentTransactionHash); });
+
+        if (applied)
+        {
+            return;
+        }
+
+        storeUnconfirmedIncomingInput(input, publicSpendKey);
+    }
+    else if (type == "syncTimestampToHeight")
+    {
+        convertSyncTimestampToHeight(
+            getUint64FromJSON(change, "timestamp"),
+            getUint64FromJSON(change, "height"));
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown wallet journal change " + type);
+    }
+}
+
 void SubWallets::fromJSON(const JSONObject &j)
 {
     for (const auto &x : getArrayFromJSON(j, "publicSpendKeys"))
@@ -966,14 +1393,22 @@ void SubWallets::fromJSON(const JSONObject &j)
     {
         wallet_types::Transaction tx;
         tx.fromJSON(x);
-        m_transactions.push_back(tx);
+
+        if (m_transactions.push_back(tx).second)
+        {
+            indexTransaction(tx);
+        }
     }
 
     for (const auto &x : getArrayFromJSON(j, "lockedTransactions"))
     {
         wallet_types::Transaction tx;
         tx.fromJSON(x);
-        m_transactions.push_back(tx);
+
+        if (m_transactions.push_back(tx).second)
+        {
+            indexTransaction(tx);
+        }
     }
 
     m_privateViewKey.fromString(getStringFromJSON(j, "privateViewKey"));
@@ -990,6 +1425,8 @@ void SubWallets::fromJSON(const JSONObject &j)
 
         m_transactionPrivateKeys[txHash] = privateKey;
     }
+
+    rebuildKeyImageOwners();
 }
 
 void SubWallets::toJSON(rapidjson::Writer<rapidjson::StringBuffer> &writer) const
@@ -5,8 +5,19 @@
 
 #pragma once
 
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/mem_fun.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
 #include <crypto/crypto.h>
 
+#include <optional>
+
+#include <set>
+
 #include <sub_wallets/sub_wallet.h>
 
 class SubWallets
@@ -104,6 +115,9 @@ public:
     std::tuple<bool, crypto::PublicKey> getKeyImageOwner(
         const crypto::KeyImage keyImage) const;
 
+    /* Whether the public spend key belongs to one of the subwallets */
+    bool hasSpendKey(const crypto::PublicKey &publicSpendKey) const;
+
     /* Gets the primary address (normally first created) address */
     std::string getPrimaryAddress() const;
 
@@ -159,6 +173,25 @@ public:
 
     std::vector<wallet_types::Transaction> getTransactions() const;
 
+    /* Gets the transaction with the given hash, if it's in a block */
+    std::optional<wallet_types::Transaction> getTransaction(
+        const crypto::Hash &hash) const;
+
+    /* Gets the transactions with a block height in [startHeight, endHeight),
+       ordered by height then hash, starting after the cursor if one is
+       given. If spendKey is given, only the transactions with a transfer to
+       or from that subwallet are included.
+
+       At most limit transactions are returned, or all of them if it's zero,
+       along with the cursor to pass to get the next page, if there is one */
+    std::tuple<std::vector<wallet_types::Transaction>, std::optional<wallet_types::TransactionCursor>>
+    getTransactionsInRange(
+        const uint64_t startHeight,
+        const uint64_t endHeight,
+        const std::optional<crypto::PublicKey> spendKey,
+        const std::optional<wallet_types::TransactionCursor> after,
+        const size_t limit) const;
+
     /* Note that this DOES NOT return incoming transactions in the pool. It only
        returns outgoing transactions which we sent but have not encountered in a
        block yet. */
@@ -187,6 +220,22 @@ public:
     std::vector<std::tuple<std::string, uint64_t, uint64_t>> getBalances(
         const uint64_t currentHeight) const;
 
+    /* Takes the changes made since the last call, to append to the wallet
+       journal. The bool is false if one of them can't be replayed from the
+       journal - a subwallet being added or deleted, say - in which case the
+       whole wallet has to be saved instead. */
+    std::tuple<bool, std::vector<std::string>> takeJournal();
+
+    /* As takeJournal(), also writing out the subwallets as they are with
+       exactly those changes made, so a change being made at the same time
+       ends up in one or the other, never both */
+    std::tuple<bool, std::vector<std::string>> snapshotAndTakeJournal(
+        rapidjson::Writer<rapidjson::StringBuffer> &writer);
+
+    /* Replays a change taken from takeJournal(), when loading the wallet.
+       Changes which have been made already are skipped. */
+    void applyJournal(const JSONValue &change);
+
     /////////////////////////////
     /* Public member variables */
     /////////////////////////////
@@ -196,17 +245,57 @@ public:
     std::vector<crypto::PublicKey> m_publicSpendKeys;
 
 private:
+    //////////////////////////////
+    /* Private member types */
+    //////////////////////////////
+
+    struct TransactionHashIndex
+    {
+    };
+
+    struct TransactionCursorIndex
+    {
+    };
+
+    /* Transactions in the order they were added, which is the order they
+       are saved in, by hash, and by block height then hash */
+    typedef boost::multi_index_container<
+        wallet_types::Transaction,
+        boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+            boost::multi_index::hashed_unique<boost::multi_index::tag<TransactionHashIndex>,
+                                              boost::multi_index::member<wallet_types::Transaction, crypto::Hash, &wallet_types::Transaction::hash>>,
+            boost::multi_index::ordered_unique<boost::multi_index::tag<TransactionCursorIndex>,
+                                               boost::multi_index::const_mem_fun<wallet_types::Transaction, wallet_types::TransactionCursor, &wallet_types::Transaction::cursor>>>>
+        Transactions;
+
     //////////////////////////////
     /* Private member functions */
     //////////////////////////////
 
     void throwIfViewWallet() const;
 
+    /* Adds the transaction to, or removes it from, the per address index of
+       each subwallet it has a transfer for */
+    void indexTransaction(const wallet_types::Transaction &tx);
+    void unindexTransaction(const wallet_types::Transaction &tx);
+
+    /* Re-derives m_keyImageOwners from the subwallets' inputs */
+    void rebuildKeyImageOwners();
+
+    /* Records a change for the journal - writeFields writes what's needed to
+       replay it */
+    template<typename T>
+    void journal(const std::string &type, T writeFields);
+
+    /* Records that something changed which the journal can't replay */
+    void invalidateJournal();
+
     /* Deletes any transactions containing the given spend key, or just
        removes from the transfers array if there are multiple transfers
        in the tx */
     void deleteAddressTransactions(
-        std::vector<wallet_types::Transaction> &txs,
+        Transactions &txs,
         const crypto::PublicKey spendKey);
 
     //////////////////////////////
@@ -216,11 +305,20 @@ private:
     /* The subwallets, indexed by public spend key */
     std::unordered_map<crypto::PublicKey, SubWallet> m_subWallets;
 
-    /* A vector of transactions */
-    std::vector<wallet_types::Transaction> m_transactions;
+    /* The public spend key of the subwallet owning each unspent or locked
+       input, by key image. Lets the synchronizer check whether a
+       transaction input is one of ours without asking every subwallet. */
+    std::unordered_map<crypto::KeyImage, crypto::PublicKey> m_keyImageOwners;
+
+    /* The transactions which are in a block */
+    Transactions m_transactions;
+
+    /* The cursors of the transactions in m_transactions with a transfer for
+       each subwallet, by public spend key */
+    std::unordered_map<crypto::PublicKey, std::set<wallet_types::TransactionCursor>> m_transactionsByAddress;
 
     /* Transactions which we sent, but haven't been added to a block yet */
-    std::vector<wallet_types::Transaction> m_lockedTransactions;
+    Transactions m_lockedTransactions;
 
     crypto::SecretKey m_privateViewKey;
 
@@ -229,6 +327,12 @@ private:
     /* Transaction private keys of sent transactions, used for auditing */
     std::unordered_map<crypto::Hash, crypto::SecretKey> m_transactionPrivateKeys;
 
+    /* The changes since the last takeJournal(), as JSON objects */
+    std::vector<std::string> m_journal;
+
+    /* Whether m_journal covers every change since the last takeJournal() */
+    bool m_journalComplete = true;
+
     /* Need a mutex for accessing inputs, transactions, and locked
        transactions, etc as these are modified on multiple threads */
     mutable std::mutex m_mutex;
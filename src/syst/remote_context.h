@@ -30,6 +30,15 @@ namespace syst
         {
         }
 
+        // Execute operation on one of pool's threads instead, pool being anything with addJob() returning a future, like ThreadPool.
+        template <class Pool>
+        RemoteContext(Dispatcher &d, Pool &pool, std::function<T()> &&operation)
+            : dispatcher(d), event(d), procedure(std::move(operation)), future(pool.addJob([this]
+                                                                                          { return asyncProcedure(); })),
+              interrupted(false)
+        {
+        }
+
         // Run other task on dispatcher until future is ready, then return lambda's result, or rethrow exception. UB if called more than once.
         T get() const
         {
@@ -0,0 +1,40 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include <algorithm>
+#include <syst/tcp_connection.h>
+
+namespace syst
+{
+
+    void TcpConnection::writevAll(std::vector<std::pair<const uint8_t *, size_t>> &buffers)
+    {
+        /* Nothing to write, and an empty write would look like a shutdown
+           request to the connection */
+        buffers.erase(
+            std::remove_if(buffers.begin(), buffers.end(), [](const auto &buffer) { return buffer.second == 0; }),
+            buffers.end());
+
+        size_t first = 0;
+
+        while (first < buffers.size())
+        {
+            size_t written = writev(buffers.data() + first, buffers.size() - first);
+
+            /* Skip what was written, which may end part way through a buffer */
+            while (first < buffers.size() && written >= buffers[first].second)
+            {
+                written -= buffers[first].second;
+                first++;
+            }
+
+            if (written > 0)
+            {
+                buffers[first].first += written;
+                buffers[first].second -= written;
+            }
+        }
+    }
+
+}
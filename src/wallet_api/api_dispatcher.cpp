@@ -24,6 +24,8 @@
 
 #include "json.hpp"
 
+#include <regex>
+
 #include <wallet_api/constants.h>
 
 #include <wallet_backend/json_serialization.h>
@@ -59,7 +61,7 @@ ApiDispatcher::ApiDispatcher(
                to middleware */
             middleware(
                 req, res, walletMustBeOpen, viewWalletPermitted,
-                std::bind(function, this, _1, _2, _3));
+                std::bind(function, this, _1, _2, _3, _4));
         };
     };
 
@@ -212,6 +214,13 @@ void ApiDispatcher::start()
     }
 }
 
+ApiDispatcher::~ApiDispatcher()
+{
+    /* Close the wallets while m_mutex and m_walletFilenames, which they're
+       released from, are still around */
+    m_walletBackends.clear();
+}
+
 void ApiDispatcher::stop()
 {
     m_server.stop();
@@ -224,7 +233,8 @@ void ApiDispatcher::middleware(
     const bool viewWalletPermitted,
     std::function<std::tuple<Error, uint16_t>(const Request &req,
                                               Response &res,
-                                              const nlohmann::json &body)>
+                                              const nlohmann::json &body,
+                                              const std::shared_ptr<WalletBackend> walletBackend)>
         handler)
 {
     std::cout << "Incoming " << req.method << " request: " << req.path << std::endl;
@@ -262,14 +272,24 @@ void ApiDispatcher::middleware(
         return;
     }
 
+    const auto walletId = getWalletId(req);
+
+    if (!walletId)
+    {
+        res.status = 400;
+        return;
+    }
+
+    const std::shared_ptr<WalletBackend> walletBackend = getWalletBackend(*walletId);
+
     /* Wallet must be open for this operation, and it is not */
-    if (walletMustBeOpen && !assertWalletOpen())
+    if (walletMustBeOpen && !assertWalletOpen(walletBackend))
     {
         res.status = 403;
         return;
     }
     /* Wallet must not be open for this operation, and it is */
-    else if (!walletMustBeOpen && !assertWalletClosed())
+    else if (!walletMustBeOpen && !assertWalletClosed(*walletId))
     {
         res.status = 403;
         return;
@@ -277,7 +297,7 @@ void ApiDispatcher::middleware(
 
     /* We have a wallet open, view wallets are not permitted, and the wallet is
        a view wallet (wew!) */
-    if (m_walletBackend != nullptr && !viewWalletPermitted && !assertIsNotViewWallet())
+    if (walletBackend != nullptr && !viewWalletPermitted && !assertIsNotViewWallet(walletBackend))
     {
         /* Bad request */
         res.status = 400;
@@ -296,7 +316,7 @@ void ApiDispatcher::middleware(
 
     try
     {
-        const auto [error, statusCode] = handler(req, res, body);
+        const auto [error, statusCode] = handler(req, res, body, walletBackend);
 
         if (error)
         {
@@ -366,27 +386,28 @@ bool ApiDispatcher::checkAuthenticated(const Request &req, Response &res) const
 std::tuple<Error, uint16_t> ApiDispatcher::openWallet(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
-    std::scoped_lock lock(m_mutex);
-
     const auto [daemonHost, daemonPort, filename, password] = getDefaultWalletParams(body);
 
-    Error error;
+    if (!reserveWallet(req, filename))
+    {
+        return {SUCCESS, 403};
+    }
 
-    std::tie(error, m_walletBackend) = WalletBackend::openWallet(
+    const auto [error, openedWallet] = WalletBackend::openWallet(
         filename, password, daemonHost, daemonPort);
 
-    return {error, 200};
+    return addWallet(req, error, openedWallet, daemonHost, daemonPort);
 }
 
 std::tuple<Error, uint16_t> ApiDispatcher::keyImportWallet(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
-    std::scoped_lock lock(m_mutex);
-
     const auto [daemonHost, daemonPort, filename, password] = getDefaultWalletParams(body);
 
     const auto privateViewKey = tryGetJsonValue<crypto::SecretKey>(body, "privateViewKey");
@@ -399,22 +420,24 @@ std::tuple<Error, uint16_t> ApiDispatcher::keyImportWallet(
         scanHeight = tryGetJsonValue<uint64_t>(body, "scanHeight");
     }
 
-    Error error;
+    if (!reserveWallet(req, filename))
+    {
+        return {SUCCESS, 403};
+    }
 
-    std::tie(error, m_walletBackend) = WalletBackend::importWalletFromKeys(
+    const auto [error, openedWallet] = WalletBackend::importWalletFromKeys(
         privateSpendKey, privateViewKey, filename, password, scanHeight,
         daemonHost, daemonPort);
 
-    return {error, 200};
+    return addWallet(req, error, openedWallet, daemonHost, daemonPort);
 }
 
 std::tuple<Error, uint16_t> ApiDispatcher::seedImportWallet(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
-    std::scoped_lock lock(m_mutex);
-
     const auto [daemonHost, daemonPort, filename, password] = getDefaultWalletParams(body);
 
     const std::string mnemonicSeed = tryGetJsonValue<std::string>(body, "mnemonicSeed");
@@ -426,21 +449,23 @@ std::tuple<Error, uint16_t> ApiDispatcher::seedImportWallet(
         scanHeight = tryGetJsonValue<uint64_t>(body, "scanHeight");
     }
 
-    Error error;
+    if (!reserveWallet(req, filename))
+    {
+        return {SUCCESS, 403};
+    }
 
-    std::tie(error, m_walletBackend) = WalletBackend::importWalletFromSeed(
+    const auto [error, openedWallet] = WalletBackend::importWalletFromSeed(
         mnemonicSeed, filename, password, scanHeight, daemonHost, daemonPort);
 
-    return {error, 200};
+    return addWallet(req, error, openedWallet, daemonHost, daemonPort);
 }
 
 std::tuple<Error, uint16_t> ApiDispatcher::importViewWallet(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
-    std::scoped_lock lock(m_mutex);
-
     const auto [daemonHost, daemonPort, filename, password] = getDefaultWalletParams(body);
 
     const std::string address = tryGetJsonValue<std::string>(body, "address");
@@ -453,38 +478,44 @@ std::tuple<Error, uint16_t> ApiDispatcher::importViewWallet(
         scanHeight = tryGetJsonValue<uint64_t>(body, "scanHeight");
     }
 
-    Error error;
+    if (!reserveWallet(req, filename))
+    {
+        return {SUCCESS, 403};
+    }
 
-    std::tie(error, m_walletBackend) = WalletBackend::importViewWallet(
+    const auto [error, openedWallet] = WalletBackend::importViewWallet(
         privateViewKey, address, filename, password, scanHeight,
         daemonHost, daemonPort);
 
-    return {error, 200};
+    return addWallet(req, error, openedWallet, daemonHost, daemonPort);
 }
 
 std::tuple<Error, uint16_t> ApiDispatcher::createWallet(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
-    std::scoped_lock lock(m_mutex);
-
     const auto [daemonHost, daemonPort, filename, password] = getDefaultWalletParams(body);
 
-    Error error;
+    if (!reserveWallet(req, filename))
+    {
+        return {SUCCESS, 403};
+    }
 
-    std::tie(error, m_walletBackend) = WalletBackend::createWallet(
+    const auto [error, openedWallet] = WalletBackend::createWallet(
         filename, password, daemonHost, daemonPort);
 
-    return {error, 200};
+    return addWallet(req, error, openedWallet, daemonHost, daemonPort);
 }
 
 std::tuple<Error, uint16_t> ApiDispatcher::createAddress(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
-    const auto [error, address, privateSpendKey] = m_walletBackend->addSubWallet();
+    const auto [error, address, privateSpendKey] = walletBackend->addSubWallet();
 
     nlohmann::json j{
         {"address", address},
@@ -498,7 +529,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::createAddress(
 std::tuple<Error, uint16_t> ApiDispatcher::importAddress(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
     uint64_t scanHeight = 0;
 
@@ -511,7 +543,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::importAddress(
 
     const auto privateSpendKey = tryGetJsonValue<crypto::SecretKey>(body, "privateSpendKey");
 
-    const auto [error, address] = m_walletBackend->importSubWallet(
+    const auto [error, address] = walletBackend->importSubWallet(
         privateSpendKey, scanHeight);
 
     if (error)
@@ -530,7 +562,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::importAddress(
 std::tuple<Error, uint16_t> ApiDispatcher::importViewAddress(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
     uint64_t scanHeight = 0;
 
@@ -543,7 +576,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::importViewAddress(
 
     const auto publicSpendKey = tryGetJsonValue<crypto::PublicKey>(body, "publicSpendKey");
 
-    const auto [error, address] = m_walletBackend->importViewSubWallet(
+    const auto [error, address] = walletBackend->importViewSubWallet(
         publicSpendKey, scanHeight);
 
     if (error)
@@ -562,7 +595,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::importViewAddress(
 std::tuple<Error, uint16_t> ApiDispatcher::sendBasicTransaction(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
     const std::string address = tryGetJsonValue<std::string>(body, "destination");
 
@@ -575,7 +609,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::sendBasicTransaction(
         paymentID = tryGetJsonValue<std::string>(body, "paymentID");
     }
 
-    auto [error, hash] = m_walletBackend->sendTransactionBasic(
+    auto [error, hash] = walletBackend->sendTransactionBasic(
         address, amount, paymentID);
 
     if (error)
@@ -594,7 +628,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::sendBasicTransaction(
 std::tuple<Error, uint16_t> ApiDispatcher::sendAdvancedTransaction(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
     const json destinationsJSON = tryGetJsonValue<json>(body, "destinations");
 
@@ -617,7 +652,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::sendAdvancedTransaction(
     {
         /* Get the default mixin */
         std::tie(std::ignore, std::ignore, mixin) = cryptonote::Mixins::getMixinAllowableRange(
-            m_walletBackend->getStatus().networkBlockCount);
+            walletBackend->getStatus().networkBlockCount);
     }
 
     uint64_t fee = wallet_config::defaultFee;
@@ -655,7 +690,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::sendAdvancedTransaction(
         unlockTime = tryGetJsonValue<uint64_t>(body, "unlockTime");
     }
 
-    auto [error, hash] = m_walletBackend->sendTransactionAdvanced(
+    auto [error, hash] = walletBackend->sendTransactionAdvanced(
         destinations, mixin, fee, paymentID, subWalletsToTakeFrom, changeAddress,
         unlockTime);
 
@@ -675,9 +710,10 @@ std::tuple<Error, uint16_t> ApiDispatcher::sendAdvancedTransaction(
 std::tuple<Error, uint16_t> ApiDispatcher::sendBasicFusionTransaction(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
-    auto [error, hash] = m_walletBackend->sendFusionTransactionBasic();
+    auto [error, hash] = walletBackend->sendFusionTransactionBasic();
 
     if (error)
     {
@@ -695,7 +731,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::sendBasicFusionTransaction(
 std::tuple<Error, uint16_t> ApiDispatcher::sendAdvancedFusionTransaction(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
     const std::string destination = tryGetJsonValue<std::string>(body, "destination");
 
@@ -709,7 +746,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::sendAdvancedFusionTransaction(
     {
         /* Get the default mixin */
         std::tie(std::ignore, std::ignore, mixin) = cryptonote::Mixins::getMixinAllowableRange(
-            m_walletBackend->getStatus().networkBlockCount);
+            walletBackend->getStatus().networkBlockCount);
     }
 
     std::vector<std::string> subWalletsToTakeFrom;
@@ -719,7 +756,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::sendAdvancedFusionTransaction(
         subWalletsToTakeFrom = tryGetJsonValue<std::vector<std::string>>(body, "sourceAddresses");
     }
 
-    auto [error, hash] = m_walletBackend->sendFusionTransactionAdvanced(
+    auto [error, hash] = walletBackend->sendFusionTransactionAdvanced(
         mixin, subWalletsToTakeFrom, destination);
 
     if (error)
@@ -742,11 +779,16 @@ std::tuple<Error, uint16_t> ApiDispatcher::sendAdvancedFusionTransaction(
 std::tuple<Error, uint16_t> ApiDispatcher::closeWallet(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
     std::scoped_lock lock(m_mutex);
 
-    m_walletBackend = nullptr;
+    const std::string walletId = *getWalletId(req);
+
+    /* Saved and closed once the requests still using it have finished, which
+       is also when the ID and file are released */
+    m_walletBackends.erase(walletId);
 
     return {SUCCESS, 200};
 }
@@ -754,7 +796,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::closeWallet(
 std::tuple<Error, uint16_t> ApiDispatcher::deleteAddress(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
     /* Remove the addresses prefix to get the address */
     std::string address = req.path.substr(std::string("/addresses/").size());
@@ -764,7 +807,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::deleteAddress(
         return {error, 400};
     }
 
-    Error error = m_walletBackend->deleteSubWallet(address);
+    Error error = walletBackend->deleteSubWallet(address);
 
     if (error)
     {
@@ -781,11 +824,10 @@ std::tuple<Error, uint16_t> ApiDispatcher::deleteAddress(
 std::tuple<Error, uint16_t> ApiDispatcher::saveWallet(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
-    std::scoped_lock lock(m_mutex);
-
-    m_walletBackend->save();
+    walletBackend->save();
 
     return {SUCCESS, 200};
 }
@@ -793,10 +835,9 @@ std::tuple<Error, uint16_t> ApiDispatcher::saveWallet(
 std::tuple<Error, uint16_t> ApiDispatcher::resetWallet(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
-    std::scoped_lock lock(m_mutex);
-
     uint64_t scanHeight = 0;
     uint64_t timestamp = 0;
 
@@ -805,7 +846,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::resetWallet(
         scanHeight = tryGetJsonValue<uint64_t>(body, "scanHeight");
     }
 
-    m_walletBackend->reset(scanHeight, timestamp);
+    walletBackend->reset(scanHeight, timestamp);
 
     return {SUCCESS, 200};
 }
@@ -813,14 +854,13 @@ std::tuple<Error, uint16_t> ApiDispatcher::resetWallet(
 std::tuple<Error, uint16_t> ApiDispatcher::setNodeInfo(
     const Request &req,
     Response &res,
-    const nlohmann::json &body)
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend)
 {
-    std::scoped_lock lock(m_mutex);
-
     const std::string daemonHost = tryGetJsonValue<std::string>(body, "daemonHost");
     const uint16_t daemonPort = tryGetJsonValue<uint16_t>(body, "daemonPort");
 
-    m_walletBackend->swapNode(daemonHost, daemonPort);
+    walletBackend->swapNode(daemonHost, daemonPort, getBlockDownloader(daemonHost, daemonPort));
 
     return {SUCCESS, 202};
 }
@@ -832,11 +872,12 @@ std::tuple<Error, uint16_t> ApiDispatcher::setNodeInfo(
 std::tuple<Error, uint16_t> ApiDispatcher::getNodeInfo(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
-    const auto [daemonHost, daemonPort] = m_walletBackend->getNodeAddress();
+    const auto [daemonHost, daemonPort] = walletBackend->getNodeAddress();
 
-    const auto [nodeFee, nodeAddress] = m_walletBackend->getNodeFee();
+    const auto [nodeFee, nodeAddress] = walletBackend->getNodeFee();
 
     nlohmann::json j{
         {"daemonHost", daemonHost},
@@ -852,10 +893,11 @@ std::tuple<Error, uint16_t> ApiDispatcher::getNodeInfo(
 std::tuple<Error, uint16_t> ApiDispatcher::getPrivateViewKey(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     nlohmann::json j{
-        {"privateViewKey", m_walletBackend->getPrivateViewKey()}};
+        {"privateViewKey", walletBackend->getPrivateViewKey()}};
 
     res.set_content(j.dump(4) + "\n", "application/json");
 
@@ -866,7 +908,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getPrivateViewKey(
 std::tuple<Error, uint16_t> ApiDispatcher::getSpendKeys(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     /* Remove the keys prefix to get the address */
     std::string address = req.path.substr(std::string("/keys/").size());
@@ -876,7 +919,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::getSpendKeys(
         return {error, 400};
     }
 
-    const auto [error, publicSpendKey, privateSpendKey] = m_walletBackend->getSpendKeys(address);
+    const auto [error, publicSpendKey, privateSpendKey] = walletBackend->getSpendKeys(address);
 
     if (error)
     {
@@ -896,7 +939,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getSpendKeys(
 std::tuple<Error, uint16_t> ApiDispatcher::getMnemonicSeed(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     /* Remove the keys prefix to get the address */
     std::string address = req.path.substr(std::string("/keys/mnemonic/").size());
@@ -906,7 +950,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::getMnemonicSeed(
         return {error, 400};
     }
 
-    const auto [error, mnemonicSeed] = m_walletBackend->getMnemonicSeedForAddress(address);
+    const auto [error, mnemonicSeed] = walletBackend->getMnemonicSeedForAddress(address);
 
     if (error)
     {
@@ -924,9 +968,10 @@ std::tuple<Error, uint16_t> ApiDispatcher::getMnemonicSeed(
 std::tuple<Error, uint16_t> ApiDispatcher::getStatus(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
-    const wallet_types::WalletStatus status = m_walletBackend->getStatus();
+    const wallet_types::WalletStatus status = walletBackend->getStatus();
 
     nlohmann::json j{
         {"walletBlockCount", status.walletBlockCount},
@@ -934,8 +979,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getStatus(
         {"networkBlockCount", status.networkBlockCount},
         {"peerCount", status.peerCount},
         {"hashrate", status.lastKnownHashrate},
-        {"isViewWallet", m_walletBackend->isViewWallet()},
-        {"subWalletCount", m_walletBackend->getWalletCount()}};
+        {"isViewWallet", walletBackend->isViewWallet()},
+        {"subWalletCount", walletBackend->getWalletCount()}};
 
     res.set_content(j.dump(4) + "\n", "application/json");
 
@@ -945,10 +990,11 @@ std::tuple<Error, uint16_t> ApiDispatcher::getStatus(
 std::tuple<Error, uint16_t> ApiDispatcher::getAddresses(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     nlohmann::json j{
-        {"addresses", m_walletBackend->getAddresses()}};
+        {"addresses", walletBackend->getAddresses()}};
 
     res.set_content(j.dump(4) + "\n", "application/json");
 
@@ -958,10 +1004,11 @@ std::tuple<Error, uint16_t> ApiDispatcher::getAddresses(
 std::tuple<Error, uint16_t> ApiDispatcher::getPrimaryAddress(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     nlohmann::json j{
-        {"address", m_walletBackend->getPrimaryAddress()}};
+        {"address", walletBackend->getPrimaryAddress()}};
 
     res.set_content(j.dump(4) + "\n", "application/json");
 
@@ -971,7 +1018,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getPrimaryAddress(
 std::tuple<Error, uint16_t> ApiDispatcher::createIntegratedAddress(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     std::string stripped = req.path.substr(std::string("/addresses/").size());
 
@@ -1000,27 +1048,22 @@ std::tuple<Error, uint16_t> ApiDispatcher::createIntegratedAddress(
 std::tuple<Error, uint16_t> ApiDispatcher::getTransactions(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
-    nlohmann::json j{
-        {"transactions", m_walletBackend->getTransactions()}};
-
-    publicKeysToAddresses(j);
-
-    res.set_content(j.dump(4) + "\n", "application/json");
-
-    return {SUCCESS, 200};
+    return getTransactionsPage(req, res, walletBackend, 0, std::numeric_limits<uint64_t>::max(), "");
 }
 
 std::tuple<Error, uint16_t> ApiDispatcher::getUnconfirmedTransactions(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     nlohmann::json j{
-        {"transactions", m_walletBackend->getUnconfirmedTransactions()}};
+        {"transactions", walletBackend->getUnconfirmedTransactions()}};
 
-    publicKeysToAddresses(j);
+    publicKeysToAddresses(j, walletBackend);
 
     res.set_content(j.dump(4) + "\n", "application/json");
 
@@ -1030,20 +1073,21 @@ std::tuple<Error, uint16_t> ApiDispatcher::getUnconfirmedTransactions(
 std::tuple<Error, uint16_t> ApiDispatcher::getUnconfirmedTransactionsForAddress(
     const Request &req,
     Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     std::string address = req.path.substr(std::string("/transactions/unconfirmed").size());
 
-    const auto txs = m_walletBackend->getUnconfirmedTransactions();
+    const auto txs = walletBackend->getUnconfirmedTransactions();
 
     std::vector<wallet_types::Transaction> result;
 
     std::copy_if(txs.begin(), txs.end(), std::back_inserter(result),
-                 [address, this](const auto tx)
+                 [address, walletBackend](const auto tx)
                  {
                      for (const auto [key, transfer] : tx.transfers)
                      {
-                         const auto [error, actualAddress] = m_walletBackend->getAddress(key);
+                         const auto [error, actualAddress] = walletBackend->getAddress(key);
 
                          /* If the transfer contains our address, keep it, else skip */
                          if (actualAddress == address)
@@ -1058,7 +1102,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::getUnconfirmedTransactionsForAddress(
     nlohmann::json j{
         {"transactions", result}};
 
-    publicKeysToAddresses(j);
+    publicKeysToAddresses(j, walletBackend);
 
     res.set_content(j.dump(4) + "\n", "application/json");
 
@@ -1068,7 +1112,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getUnconfirmedTransactionsForAddress(
 std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeight(
     const httplib::Request &req,
     httplib::Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     std::string startHeightStr = req.path.substr(std::string("/transactions/").size());
 
@@ -1076,17 +1121,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeight(
     {
         uint64_t startHeight = std::stoull(startHeightStr);
 
-        const auto txs = m_walletBackend->getTransactionsRange(
-            startHeight, startHeight + 1000);
-
-        nlohmann::json j{
-            {"transactions", txs}};
-
-        publicKeysToAddresses(j);
-
-        res.set_content(j.dump(4) + "\n", "application/json");
-
-        return {SUCCESS, 200};
+        return getTransactionsPage(req, res, walletBackend, startHeight, startHeight + 1000, "");
     }
     catch (const std::out_of_range &)
     {
@@ -1103,7 +1138,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeight(
 std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightToHeight(
     const httplib::Request &req,
     httplib::Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     std::string stripped = req.path.substr(std::string("/transactions/").size());
 
@@ -1127,17 +1163,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightToHeight(
             return {SUCCESS, 400};
         }
 
-        const auto txs = m_walletBackend->getTransactionsRange(
-            startHeight, endHeight);
-
-        nlohmann::json j{
-            {"transactions", txs}};
-
-        publicKeysToAddresses(j);
-
-        res.set_content(j.dump(4) + "\n", "application/json");
-
-        return {SUCCESS, 200};
+        return getTransactionsPage(req, res, walletBackend, startHeight, endHeight, "");
     }
     catch (const std::out_of_range &)
     {
@@ -1154,7 +1180,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightToHeight(
 std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightWithAddress(
     const httplib::Request &req,
     httplib::Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     std::string stripped = req.path.substr(std::string("/transactions/address/").size());
 
@@ -1174,36 +1201,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightWithAddress(
     {
         uint64_t startHeight = std::stoull(startHeightStr);
 
-        const auto txs = m_walletBackend->getTransactionsRange(
-            startHeight, startHeight + 1000);
-
-        std::vector<wallet_types::Transaction> result;
-
-        std::copy_if(txs.begin(), txs.end(), std::back_inserter(result),
-                     [address, this](const auto tx)
-                     {
-                         for (const auto [key, transfer] : tx.transfers)
-                         {
-                             const auto [error, actualAddress] = m_walletBackend->getAddress(key);
-
-                             /* If the transfer contains our address, keep it, else skip */
-                             if (actualAddress == address)
-                             {
-                                 return true;
-                             }
-                         }
-
-                         return false;
-                     });
-
-        nlohmann::json j{
-            {"transactions", result}};
-
-        publicKeysToAddresses(j);
-
-        res.set_content(j.dump(4) + "\n", "application/json");
-
-        return {SUCCESS, 200};
+        return getTransactionsPage(req, res, walletBackend, startHeight, startHeight + 1000, address);
     }
     catch (const std::out_of_range &)
     {
@@ -1220,7 +1218,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightWithAddress(
 std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightToHeightWithAddress(
     const httplib::Request &req,
     httplib::Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     std::string stripped = req.path.substr(std::string("/transactions/address/").size());
 
@@ -1255,36 +1254,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightToHeightWith
             return {SUCCESS, 400};
         }
 
-        const auto txs = m_walletBackend->getTransactionsRange(
-            startHeight, endHeight);
-
-        std::vector<wallet_types::Transaction> result;
-
-        std::copy_if(txs.begin(), txs.end(), std::back_inserter(result),
-                     [address, this](const auto tx)
-                     {
-                         for (const auto [key, transfer] : tx.transfers)
-                         {
-                             const auto [error, actualAddress] = m_walletBackend->getAddress(key);
-
-                             /* If the transfer contains our address, keep it, else skip */
-                             if (actualAddress == address)
-                             {
-                                 return true;
-                             }
-                         }
-
-                         return false;
-                     });
-
-        nlohmann::json j{
-            {"transactions", result}};
-
-        publicKeysToAddresses(j);
-
-        res.set_content(j.dump(4) + "\n", "application/json");
-
-        return {SUCCESS, 200};
+        return getTransactionsPage(req, res, walletBackend, startHeight, endHeight, address);
     }
     catch (const std::out_of_range &)
     {
@@ -1301,7 +1271,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightToHeightWith
 std::tuple<Error, uint16_t> ApiDispatcher::getTransactionDetails(
     const httplib::Request &req,
     httplib::Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     std::string hashStr = req.path.substr(std::string("/transactions/hash/").size());
 
@@ -1309,29 +1280,29 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionDetails(
 
     common::podFromHex(hashStr, hash.data);
 
-    for (const auto tx : m_walletBackend->getTransactions())
+    const auto tx = walletBackend->getTransaction(hash);
+
+    /* Not found */
+    if (!tx)
     {
-        if (tx.hash == hash)
-        {
-            nlohmann::json j{
-                {"transaction", tx}};
+        return {SUCCESS, 404};
+    }
 
-            res.set_content(j.dump(4) + "\n", "application/json");
+    nlohmann::json j{
+        {"transaction", *tx}};
 
-            return {SUCCESS, 200};
-        }
-    }
+    res.set_content(j.dump(4) + "\n", "application/json");
 
-    /* Not found */
-    return {SUCCESS, 404};
+    return {SUCCESS, 200};
 }
 
 std::tuple<Error, uint16_t> ApiDispatcher::getBalance(
     const httplib::Request &req,
     httplib::Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
-    const auto [unlocked, locked] = m_walletBackend->getTotalBalance();
+    const auto [unlocked, locked] = walletBackend->getTotalBalance();
 
     nlohmann::json j{
         {"unlocked", unlocked},
@@ -1345,11 +1316,12 @@ std::tuple<Error, uint16_t> ApiDispatcher::getBalance(
 std::tuple<Error, uint16_t> ApiDispatcher::getBalanceForAddress(
     const httplib::Request &req,
     httplib::Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     std::string address = req.path.substr(std::string("/balance/").size());
 
-    const auto [error, unlocked, locked] = m_walletBackend->getBalance(address);
+    const auto [error, unlocked, locked] = walletBackend->getBalance(address);
 
     if (error)
     {
@@ -1368,9 +1340,10 @@ std::tuple<Error, uint16_t> ApiDispatcher::getBalanceForAddress(
 std::tuple<Error, uint16_t> ApiDispatcher::getBalances(
     const httplib::Request &req,
     httplib::Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
-    const auto balances = m_walletBackend->getBalances();
+    const auto balances = walletBackend->getBalances();
 
     nlohmann::json j;
 
@@ -1389,7 +1362,8 @@ std::tuple<Error, uint16_t> ApiDispatcher::getBalances(
 std::tuple<Error, uint16_t> ApiDispatcher::getTxPrivateKey(
     const httplib::Request &req,
     httplib::Response &res,
-    const nlohmann::json &body) const
+    const nlohmann::json &body,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     std::string txHashStr = req.path.substr(std::string("/transactions/privatekey/").size());
 
@@ -1397,7 +1371,7 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTxPrivateKey(
 
     common::podFromHex(txHashStr, txHash.data);
 
-    const auto [error, key] = m_walletBackend->getTxPrivateKey(txHash);
+    const auto [error, key] = walletBackend->getTxPrivateKey(txHash);
 
     if (error)
     {
@@ -1443,7 +1417,7 @@ void ApiDispatcher::handleOptions(
     {
         res.set_header("Access-Control-Allow-Origin", m_corsHeader);
         res.set_header("Access-Control-Allow-Headers",
-                       "Origin, X-Requested-With, Content-Type, Accept, X-API-KEY");
+                       "Origin, X-Requested-With, Content-Type, Accept, X-API-KEY, X-WALLET-ID");
     }
 
     res.status = 200;
@@ -1475,9 +1449,140 @@ ApiDispatcher::getDefaultWalletParams(const nlohmann::json body) const
 /* END OF API FUNCTIONS */
 //////////////////////////
 
-bool ApiDispatcher::assertIsNotViewWallet() const
+std::optional<std::string> ApiDispatcher::getWalletId(const httplib::Request &req) const
+{
+    if (!req.has_header("X-WALLET-ID"))
+    {
+        return api_constants::defaultWalletId;
+    }
+
+    const std::string walletId = req.get_header_value("X-WALLET-ID");
+
+    static const std::regex walletIdRegex(api_constants::walletIdRegex);
+
+    if (!std::regex_match(walletId, walletIdRegex))
+    {
+        std::cout << "Rejecting request: X-WALLET-ID is invalid.\n";
+        return std::nullopt;
+    }
+
+    return walletId;
+}
+
+std::shared_ptr<WalletBackend> ApiDispatcher::getWalletBackend(const std::string &walletId) const
 {
-    if (m_walletBackend->isViewWallet())
+    std::scoped_lock lock(m_mutex);
+
+    const auto it = m_walletBackends.find(walletId);
+
+    if (it == m_walletBackends.end())
+    {
+        return nullptr;
+    }
+
+    return it->second;
+}
+
+bool ApiDispatcher::reserveWallet(const httplib::Request &req, const std::string &filename)
+{
+    std::scoped_lock lock(m_mutex);
+
+    const std::string walletId = *getWalletId(req);
+
+    if (m_walletFilenames.find(walletId) != m_walletFilenames.end())
+    {
+        std::cout << "Client requested to open a wallet, whilst one is already open" << std::endl;
+        return false;
+    }
+
+    for (const auto &[openWalletId, openFilename] : m_walletFilenames)
+    {
+        if (openFilename == filename)
+        {
+            std::cout << "Client requested to open a wallet, whilst it is already "
+                         "open with the wallet ID "
+                      << openWalletId << std::endl;
+            return false;
+        }
+    }
+
+    m_walletFilenames[walletId] = filename;
+
+    return true;
+}
+
+std::tuple<Error, uint16_t> ApiDispatcher::addWallet(
+    const httplib::Request &req,
+    const Error error,
+    const std::shared_ptr<WalletBackend> walletBackend,
+    const std::string &daemonHost,
+    const uint16_t daemonPort)
+{
+    const std::string walletId = *getWalletId(req);
+
+    if (error)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        m_walletFilenames.erase(walletId);
+
+        return {error, 400};
+    }
+
+    walletBackend->setBlockDownloader(getBlockDownloader(daemonHost, daemonPort));
+
+    /* Keep the file reserved until the wallet has actually been saved and
+       closed, which is only once the last request using it has finished,
+       so it can't be opened again while it's still being written to */
+    const std::shared_ptr<WalletBackend> trackedWalletBackend(
+        walletBackend.get(),
+        [this, walletId, backend = walletBackend](WalletBackend *) mutable
+        {
+            backend.reset();
+
+            std::scoped_lock lock(m_mutex);
+            m_walletFilenames.erase(walletId);
+        });
+
+    std::scoped_lock lock(m_mutex);
+
+    m_walletBackends[walletId] = trackedWalletBackend;
+
+    return {SUCCESS, 200};
+}
+
+std::shared_ptr<SharedBlockDownloader> ApiDispatcher::getBlockDownloader(
+    const std::string &daemonHost,
+    const uint16_t daemonPort)
+{
+    std::scoped_lock lock(m_blockDownloadersMutex);
+
+    /* Stop downloading for daemons no wallets are using any more */
+    for (auto it = m_blockDownloaders.begin(); it != m_blockDownloaders.end();)
+    {
+        if (it->second.use_count() == 1)
+        {
+            it = m_blockDownloaders.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    auto &blockDownloader = m_blockDownloaders[{daemonHost, daemonPort}];
+
+    if (blockDownloader == nullptr)
+    {
+        blockDownloader = std::make_shared<SharedBlockDownloader>(daemonHost, daemonPort);
+    }
+
+    return blockDownloader;
+}
+
+bool ApiDispatcher::assertIsNotViewWallet(const std::shared_ptr<WalletBackend> walletBackend) const
+{
+    if (walletBackend->isViewWallet())
     {
         std::cout << "Client requested to perform an operation which requires "
                      "a non view wallet, but wallet is a view wallet"
@@ -1488,9 +1593,9 @@ bool ApiDispatcher::assertIsNotViewWallet() const
     return true;
 }
 
-bool ApiDispatcher::assertIsViewWallet() const
+bool ApiDispatcher::assertIsViewWallet(const std::shared_ptr<WalletBackend> walletBackend) const
 {
-    if (!m_walletBackend->isViewWallet())
+    if (!walletBackend->isViewWallet())
     {
         std::cout << "Client requested to perform an operation which requires "
                      "a view wallet, but wallet is a non view wallet"
@@ -1501,9 +1606,11 @@ bool ApiDispatcher::assertIsViewWallet() const
     return true;
 }
 
-bool ApiDispatcher::assertWalletClosed() const
+bool ApiDispatcher::assertWalletClosed(const std::string &walletId) const
 {
-    if (m_walletBackend != nullptr)
+    std::scoped_lock lock(m_mutex);
+
+    if (m_walletFilenames.find(walletId) != m_walletFilenames.end())
     {
         std::cout << "Client requested to open a wallet, whilst one is already open" << std::endl;
         return false;
@@ -1512,9 +1619,9 @@ bool ApiDispatcher::assertWalletClosed() const
     return true;
 }
 
-bool ApiDispatcher::assertWalletOpen() const
+bool ApiDispatcher::assertWalletOpen(const std::shared_ptr<WalletBackend> walletBackend) const
 {
-    if (m_walletBackend == nullptr)
+    if (walletBackend == nullptr)
     {
         std::cout << "Client requested to modify a wallet, whilst no wallet is open" << std::endl;
         return false;
@@ -1523,7 +1630,9 @@ bool ApiDispatcher::assertWalletOpen() const
     return true;
 }
 
-void ApiDispatcher::publicKeysToAddresses(nlohmann::json &j) const
+void ApiDispatcher::publicKeysToAddresses(
+    nlohmann::json &j,
+    const std::shared_ptr<WalletBackend> walletBackend) const
 {
     for (auto &item : j.at("transactions"))
     {
@@ -1534,7 +1643,7 @@ void ApiDispatcher::publicKeysToAddresses(nlohmann::json &j) const
             crypto::PublicKey spendKey = tx.at("publicKey").get<crypto::PublicKey>();
 
             /* Get the address it belongs to */
-            const auto [error, address] = m_walletBackend->getAddress(spendKey);
+            const auto [error, address] = walletBackend->getAddress(spendKey);
 
             /* Add the address to the json */
             tx["address"] = address;
@@ -1545,6 +1654,107 @@ void ApiDispatcher::publicKeysToAddresses(nlohmann::json &j) const
     }
 }
 
+std::tuple<bool, size_t, std::optional<wallet_types::TransactionCursor>> ApiDispatcher::getPagination(
+    const httplib::Request &req) const
+{
+    size_t limit = 0;
+
+    std::optional<wallet_types::TransactionCursor> cursor;
+
+    try
+    {
+        if (req.has_param("limit"))
+        {
+            limit = std::stoull(req.get_param_value("limit"));
+        }
+
+        /* <block height>-<transaction hash>, as returned in nextCursor */
+        if (req.has_param("cursor"))
+        {
+            const std::string cursorStr = req.get_param_value("cursor");
+
+            const uint64_t splitPos = cursorStr.find_first_of("-");
+
+            if (splitPos == std::string::npos)
+            {
+                std::cout << "Failed to parse cursor parameter...\n";
+                return {false, 0, std::nullopt};
+            }
+
+            wallet_types::TransactionCursor parsed;
+
+            parsed.blockHeight = std::stoull(cursorStr.substr(0, splitPos));
+
+            if (!common::podFromHex(cursorStr.substr(splitPos + 1), parsed.hash.data))
+            {
+                std::cout << "Failed to parse cursor parameter...\n";
+                return {false, 0, std::nullopt};
+            }
+
+            cursor = parsed;
+        }
+    }
+    catch (const std::out_of_range &)
+    {
+        std::cout << "Limit or cursor parameter is too large or too small!" << std::endl;
+        return {false, 0, std::nullopt};
+    }
+    catch (const std::invalid_argument &)
+    {
+        std::cout << "Failed to parse limit or cursor parameter...\n";
+        return {false, 0, std::nullopt};
+    }
+
+    return {true, limit, cursor};
+}
+
+std::tuple<Error, uint16_t> ApiDispatcher::sendTransactionsPage(
+    httplib::Response &res,
+    const std::shared_ptr<WalletBackend> walletBackend,
+    const std::vector<wallet_types::Transaction> &transactions,
+    const std::optional<wallet_types::TransactionCursor> &next) const
+{
+    nlohmann::json j{
+        {"transactions", transactions}};
+
+    publicKeysToAddresses(j, walletBackend);
+
+    if (next)
+    {
+        j["nextCursor"] = std::to_string(next->blockHeight) + "-" + common::podToHex(next->hash);
+    }
+
+    res.set_content(j.dump(4) + "\n", "application/json");
+
+    return {SUCCESS, 200};
+}
+
+std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsPage(
+    const httplib::Request &req,
+    httplib::Response &res,
+    const std::shared_ptr<WalletBackend> walletBackend,
+    const uint64_t startHeight,
+    const uint64_t endHeight,
+    const std::string &address) const
+{
+    const auto [valid, limit, cursor] = getPagination(req);
+
+    if (!valid)
+    {
+        return {SUCCESS, 400};
+    }
+
+    const auto [error, transactions, next] = walletBackend->getTransactionsPage(
+        startHeight, endHeight, address, cursor, limit);
+
+    if (error)
+    {
+        return {error, 400};
+    }
+
+    return sendTransactionsPage(res, walletBackend, transactions, next);
+}
+
 std::string ApiDispatcher::hashPassword(const std::string password) const
 {
     using namespace CryptoPP;
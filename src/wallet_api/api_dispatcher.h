@@ -7,6 +7,13 @@
 
 #include "httplib.h"
 
+#include <map>
+
+#include <optional>
+
+#include <unordered_map>
+
+#include <wallet_backend/shared_block_downloader.h>
 #include <wallet_backend/wallet_backend.h>
 
 #include <cryptopp/modes.h>
@@ -51,6 +58,9 @@ public:
         const std::string rpcPassword,
         std::string corsHeader);
 
+    /* Deconstructor */
+    ~ApiDispatcher();
+
     /////////////////////////////
     /* Public member functions */
     /////////////////////////////
@@ -75,7 +85,8 @@ private:
         const bool viewWalletsPermitted,
         std::function<std::tuple<Error, uint16_t>(const httplib::Request &req,
                                                   httplib::Response &res,
-                                                  const nlohmann::json &body)>
+                                                  const nlohmann::json &body,
+                                                  const std::shared_ptr<WalletBackend> walletBackend)>
             handler);
 
     /* Verifies that the request has the correct X-API-KEY, and sends a 401
@@ -92,69 +103,81 @@ private:
     std::tuple<Error, uint16_t> openWallet(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     /* Imports a wallet using a private spend + private view key */
     std::tuple<Error, uint16_t> keyImportWallet(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     /* Imports a wallet using a mnemonic seed */
     std::tuple<Error, uint16_t> seedImportWallet(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     /* Imports a view only wallet using a private view key + address */
     std::tuple<Error, uint16_t> importViewWallet(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     /* Creates a new wallet, which will be a deterministic wallet */
     std::tuple<Error, uint16_t> createWallet(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     /* Create a new random address */
     std::tuple<Error, uint16_t> createAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     /* Imports an address with a private spend key */
     std::tuple<Error, uint16_t> importAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     /* Imports a view only address with a public spend key */
     std::tuple<Error, uint16_t> importViewAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     std::tuple<Error, uint16_t> sendBasicTransaction(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     std::tuple<Error, uint16_t> sendAdvancedTransaction(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     std::tuple<Error, uint16_t> sendBasicFusionTransaction(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     std::tuple<Error, uint16_t> sendAdvancedFusionTransaction(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     /////////////////////
     /* DELETE REQUESTS */
@@ -164,12 +187,14 @@ private:
     std::tuple<Error, uint16_t> closeWallet(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     std::tuple<Error, uint16_t> deleteAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     //////////////////
     /* PUT REQUESTS */
@@ -179,19 +204,22 @@ private:
     std::tuple<Error, uint16_t> saveWallet(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     /* Resets and saves the wallet */
     std::tuple<Error, uint16_t> resetWallet(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     /* Sets the daemon node and port */
     std::tuple<Error, uint16_t> setNodeInfo(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body);
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend);
 
     //////////////////
     /* GET REQUESTS */
@@ -201,106 +229,126 @@ private:
     std::tuple<Error, uint16_t> getNodeInfo(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     /* Gets the shared private view key */
     std::tuple<Error, uint16_t> getPrivateViewKey(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     /* Gets the spend keys for the given address */
     std::tuple<Error, uint16_t> getSpendKeys(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     /* Gets the mnemonic seed for the given address (if possible) */
     std::tuple<Error, uint16_t> getMnemonicSeed(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     /* Returns sync status, peer count, etc */
     std::tuple<Error, uint16_t> getStatus(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getAddresses(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getPrimaryAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> createIntegratedAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getTransactions(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getUnconfirmedTransactions(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getUnconfirmedTransactionsForAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getTransactionsFromHeight(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getTransactionsFromHeightToHeight(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getTransactionsFromHeightWithAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getTransactionsFromHeightToHeightWithAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getTransactionDetails(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getBalance(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getBalanceForAddress(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getBalances(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     std::tuple<Error, uint16_t> getTxPrivateKey(
         const httplib::Request &req,
         httplib::Response &res,
-        const nlohmann::json &body) const;
+        const nlohmann::json &body,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
 
     //////////////////////
     /* OPTIONS REQUESTS */
@@ -319,20 +367,70 @@ private:
     std::tuple<std::string, uint16_t, std::string, std::string>
     getDefaultWalletParams(const nlohmann::json body) const;
 
+    /* The ID of the wallet the request is for, from the X-WALLET-ID header,
+       or the default wallet if there isn't one. Empty if it's invalid. */
+    std::optional<std::string> getWalletId(const httplib::Request &req) const;
+
+    /* The open wallet with the given ID, or nullptr */
+    std::shared_ptr<WalletBackend> getWalletBackend(const std::string &walletId) const;
+
+    /* Claims the request's wallet ID and the wallet file while the wallet is
+       opened, so neither can be opened twice. False if either is in use. */
+    bool reserveWallet(const httplib::Request &req, const std::string &filename);
+
+    /* Adds the wallet opened for the request under its ID, or releases the
+       ID if it failed to open */
+    std::tuple<Error, uint16_t> addWallet(
+        const httplib::Request &req,
+        const Error error,
+        const std::shared_ptr<WalletBackend> walletBackend,
+        const std::string &daemonHost,
+        const uint16_t daemonPort);
+
+    /* The block downloader shared by the wallets using the given daemon */
+    std::shared_ptr<SharedBlockDownloader> getBlockDownloader(
+        const std::string &daemonHost,
+        const uint16_t daemonPort);
+
     /* Assert the wallet is not a view only wallet */
-    bool assertIsNotViewWallet() const;
+    bool assertIsNotViewWallet(const std::shared_ptr<WalletBackend> walletBackend) const;
 
     /* Assert the wallet is a view wallet */
-    bool assertIsViewWallet() const;
+    bool assertIsViewWallet(const std::shared_ptr<WalletBackend> walletBackend) const;
 
-    /* Assert the wallet is closed */
-    bool assertWalletClosed() const;
+    /* Assert no wallet is open, or being opened, with the given ID */
+    bool assertWalletClosed(const std::string &walletId) const;
 
     /* Assert the wallet is open */
-    bool assertWalletOpen() const;
+    bool assertWalletOpen(const std::shared_ptr<WalletBackend> walletBackend) const;
 
     /* Converts a public spend key to an address in a transactions json */
-    void publicKeysToAddresses(nlohmann::json &j) const;
+    void publicKeysToAddresses(
+        nlohmann::json &j,
+        const std::shared_ptr<WalletBackend> walletBackend) const;
+
+    /* Reads the optional limit and cursor query parameters of the transaction
+       routes. The first value is false if they're invalid. */
+    std::tuple<bool, size_t, std::optional<wallet_types::TransactionCursor>> getPagination(
+        const httplib::Request &req) const;
+
+    /* Sends a page of transactions, with the cursor to get the next page
+       with, if there's more */
+    std::tuple<Error, uint16_t> sendTransactionsPage(
+        httplib::Response &res,
+        const std::shared_ptr<WalletBackend> walletBackend,
+        const std::vector<wallet_types::Transaction> &transactions,
+        const std::optional<wallet_types::TransactionCursor> &next) const;
+
+    /* Gets and sends a page of the transactions in [startHeight, endHeight),
+       involving the address if it's not empty */
+    std::tuple<Error, uint16_t> getTransactionsPage(
+        const httplib::Request &req,
+        httplib::Response &res,
+        const std::shared_ptr<WalletBackend> walletBackend,
+        const uint64_t startHeight,
+        const uint64_t endHeight,
+        const std::string &address) const;
 
     std::string hashPassword(const std::string password) const;
 
@@ -340,7 +438,17 @@ private:
     /* Private member variables */
     //////////////////////////////
 
-    std::shared_ptr<WalletBackend> m_walletBackend = nullptr;
+    /* Shared by the wallets using the same daemon, so each block is only
+       downloaded once */
+    std::map<std::tuple<std::string, uint16_t>, std::shared_ptr<SharedBlockDownloader>> m_blockDownloaders;
+
+    std::mutex m_blockDownloadersMutex;
+
+    /* The open wallets, by the ID given in the X-WALLET-ID header */
+    std::unordered_map<std::string, std::shared_ptr<WalletBackend>> m_walletBackends;
+
+    /* The files of the open wallets, and those being opened, by ID */
+    std::unordered_map<std::string, std::string> m_walletFilenames;
 
     /* Our server instance */
     httplib::Server m_server;
@@ -351,8 +459,7 @@ private:
     /* The rpc password - only stored to help indicate invalid passwords */
     std::string m_rpcPassword;
 
-    /* Need a mutex for some actions, mainly mutating actions, like opening
-       wallets, sending transfers, etc */
+    /* Protects m_walletBackends and m_walletFilenames */
     mutable std::mutex m_mutex;
 
     /* The server host */
@@ -21,4 +21,10 @@ namespace api_constants
 
     /* 64 char, hex */
     const std::string hashRegex = "[a-fA-F0-9]{64}";
+
+    /* The wallet a request is for, given in the X-WALLET-ID header */
+    const std::string walletIdRegex = "[a-zA-Z0-9_-]{1,64}";
+
+    /* The wallet requests without an X-WALLET-ID header are for */
+    const std::string defaultWalletId = "default";
 }
@@ -5,6 +5,10 @@
 
 #pragma once
 
+#include <array>
+
+#include "crypto_types.h"
+
 namespace Constants
 {
     /* We use this to check that the file is a wallet file, this bit does
@@ -31,9 +35,24 @@ namespace Constants
        password. */
     const uint64_t PBKDF2_ITERATIONS = 500000;
 
+    /* The start of the journal file kept next to the wallet file. Like
+       IS_A_WALLET_IDENTIFIER, this isn't encrypted. */
+    const std::array<char, 27> IS_A_WALLET_JOURNAL_IDENTIFIER =
+        {{0x6b, 0x72, 0x79, 0x70, 0x74, 0x6f, 0x6b, 0x72, 0x6f, 0x6e, 0x61,
+          0x20, 0x77, 0x61, 0x6c, 0x6c, 0x65, 0x74, 0x20, 0x6a, 0x6f, 0x75,
+          0x72, 0x6e, 0x61, 0x6c, 0x0a}};
+
+    /* The wallet file is rewritten in full, and the journal emptied, once
+       the journal has grown larger than the wallet file, or this, whichever
+       is bigger. Replaying the journal on load then never takes longer than
+       reading the wallet file did. */
+    const uint64_t MINIMUM_JOURNAL_COMPACTION_SIZE = 1024 * 1024;
+
     /* What version of the file format are we on (to make it easier to
-       upgrade the wallet format in the future) */
-    const uint16_t WALLET_FILE_FORMAT_VERSION = 0;
+       upgrade the wallet format in the future). Version 1 adds the nonce,
+       and the journal - files from version 0 still open, and are written
+       as version 1 on the next save. */
+    const uint16_t WALLET_FILE_FORMAT_VERSION = 1;
 
     /* How large should the m_lastKnownBlockHashes container be */
     const uint32_t LAST_KNOWN_BLOCK_HASHES_SIZE = 100;
@@ -0,0 +1,186 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+/////////////////////////////////////////////////
+#include <wallet_backend/shared_block_downloader.h>
+/////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include <limits>
+
+#include <wallet_backend/wallet_synchronizer.h>
+
+///////////////////////////////////
+/* CONSTRUCTORS / DECONSTRUCTORS */
+///////////////////////////////////
+
+SharedBlockDownloader::SharedBlockDownloader(
+    const std::string daemonHost,
+    const uint16_t daemonPort) :
+
+                                 m_daemon(std::make_shared<Nigel>(daemonHost, daemonPort)),
+                                 m_downloadForFurthestAhead(false),
+                                 m_walletsAdded(0),
+                                 m_shouldStop(false)
+{
+    m_daemon->init();
+
+    m_downloadThread = std::thread(&SharedBlockDownloader::downloadLoop, this);
+}
+
+SharedBlockDownloader::~SharedBlockDownloader()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_shouldStop = true;
+    }
+
+    m_haveWallets.notify_all();
+
+    if (m_downloadThread.joinable())
+    {
+        m_downloadThread.join();
+    }
+}
+
+/////////////////////
+/* CLASS FUNCTIONS */
+/////////////////////
+
+void SharedBlockDownloader::addWallet(WalletSynchronizer *walletSynchronizer)
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_walletSynchronizers.push_back(walletSynchronizer);
+        m_walletsAdded++;
+    }
+
+    m_haveWallets.notify_all();
+}
+
+void SharedBlockDownloader::removeWallet(WalletSynchronizer *walletSynchronizer)
+{
+    std::scoped_lock lock(m_mutex);
+
+    m_walletSynchronizers.erase(
+        std::remove(m_walletSynchronizers.begin(), m_walletSynchronizers.end(), walletSynchronizer),
+        m_walletSynchronizers.end());
+}
+
+void SharedBlockDownloader::downloadLoop()
+{
+    while (!m_shouldStop)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_haveWallets.wait(lock, [&]
+                           { return m_shouldStop || !m_walletSynchronizers.empty(); });
+
+        if (m_shouldStop)
+        {
+            return;
+        }
+
+        WalletSynchronizer *furthestBehind = nullptr;
+        WalletSynchronizer *furthestAhead = nullptr;
+
+        uint64_t lowestHeight = std::numeric_limits<uint64_t>::max();
+        uint64_t highestHeight = 0;
+
+        for (const auto walletSynchronizer : m_walletSynchronizers)
+        {
+            const uint64_t height = walletSynchronizer->getDownloadHeight();
+
+            if (height < lowestHeight)
+            {
+                lowestHeight = height;
+                furthestBehind = walletSynchronizer;
+            }
+
+            if (furthestAhead == nullptr || height > highestHeight)
+            {
+                highestHeight = height;
+                furthestAhead = walletSynchronizer;
+            }
+        }
+
+        /* Take turns with the wallet furthest ahead, so a wallet catching up
+           from far behind doesn't stop the synced wallets seeing new blocks */
+        m_downloadForFurthestAhead = !m_downloadForFurthestAhead && highestHeight != lowestHeight;
+
+        WalletSynchronizer *downloadFor = m_downloadForFurthestAhead ? furthestAhead : furthestBehind;
+
+        const uint64_t walletsAdded = m_walletsAdded;
+
+        const uint64_t downloadHeight = m_downloadForFurthestAhead ? highestHeight : lowestHeight;
+
+        const auto [blockCheckpoints, startHeight, startTimestamp] = downloadFor->getDownloadRequest();
+
+        /* Don't hold up adding and removing wallets while we download */
+        lock.unlock();
+
+        std::vector<wallet_types::WalletBlockInfo> blocks;
+
+        /* Wait for the daemon to catch up with us, so we don't discard our
+           progress - see WalletSynchronizer::downloadBlocks() */
+        if (m_daemon->localDaemonBlockCount() + 1 >= downloadHeight)
+        {
+            bool success;
+
+            /* Blocks the thread for up to 10 secs */
+            std::tie(success, blocks) = m_daemon->getWalletSyncData(
+                blockCheckpoints, startHeight, startTimestamp);
+
+            if (!success)
+            {
+                blocks.clear();
+            }
+        }
+
+        lock.lock();
+
+        /* A wallet added in the meantime could have the address of one which
+           was removed, don't mistake the blocks for its own */
+        if (m_walletsAdded != walletsAdded)
+        {
+            downloadFor = nullptr;
+        }
+
+        /* The wallet furthest ahead is synced, try the one furthest behind */
+        if (blocks.empty() && m_downloadForFurthestAhead)
+        {
+            continue;
+        }
+
+        /* Synced, or failed to get blocks. Sleep a bit so we don't spam the
+           daemon. */
+        if (blocks.empty())
+        {
+            for (const auto walletSynchronizer : m_walletSynchronizers)
+            {
+                walletSynchronizer->checkLockedTransactionsIfSynced();
+            }
+
+            m_haveWallets.wait_for(lock, std::chrono::seconds(5), [&]
+                                   { return m_shouldStop.load(); });
+
+            continue;
+        }
+
+        for (auto &block : blocks)
+        {
+            const auto sharedBlock = std::make_shared<const wallet_types::WalletBlockInfo>(std::move(block));
+
+            for (const auto walletSynchronizer : m_walletSynchronizers)
+            {
+                /* Blocks if the wallet is too far behind processing them */
+                if (walletSynchronizer->wantsBlock(*sharedBlock, walletSynchronizer == downloadFor))
+                {
+                    walletSynchronizer->queueBlock(sharedBlock, m_scanThreadPool);
+                }
+            }
+        }
+    }
+}
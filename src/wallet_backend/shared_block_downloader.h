@@ -0,0 +1,103 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <atomic>
+
+#include <common/thread_pool.h>
+
+#include <condition_variable>
+
+#include <memory>
+
+#include <mutex>
+
+#include <nigel/nigel.h>
+
+#include <thread>
+
+#include <vector>
+
+class WalletSynchronizer;
+
+/* Downloads blocks once for every wallet syncing from the same daemon,
+   rather than once per wallet, and hands each block to every wallet which
+   needs it, scanning their outputs on one shared pool of threads.
+
+   Blocks are downloaded for the wallet furthest behind, taking turns with
+   the wallet furthest ahead. The wallets ahead of it skip the blocks they
+   already have, unless the chain has forked since, and the ones behind skip
+   the blocks they're not up to yet. */
+class SharedBlockDownloader
+{
+public:
+    //////////////////
+    /* Constructors */
+    //////////////////
+
+    SharedBlockDownloader(const std::string daemonHost, const uint16_t daemonPort);
+
+    /* Delete the copy constructor */
+    SharedBlockDownloader(const SharedBlockDownloader &) = delete;
+
+    /* Delete the assignment operator */
+    SharedBlockDownloader &operator=(const SharedBlockDownloader &) = delete;
+
+    /* Deconstructor */
+    ~SharedBlockDownloader();
+
+    /////////////////////////////
+    /* Public member functions */
+    /////////////////////////////
+
+    /* Starts downloading blocks for the wallet */
+    void addWallet(WalletSynchronizer *walletSynchronizer);
+
+    /* Stops downloading blocks for the wallet, waiting for any block being
+       handed to it. The wallet's block queue must be stopped first, so it
+       doesn't wait for the wallet to make room. */
+    void removeWallet(WalletSynchronizer *walletSynchronizer);
+
+private:
+    //////////////////////////////
+    /* Private member functions */
+    //////////////////////////////
+
+    void downloadLoop();
+
+    //////////////////////////////
+    /* Private member variables */
+    //////////////////////////////
+
+    /* The daemon connection */
+    std::shared_ptr<Nigel> m_daemon;
+
+    /* The wallets we're downloading blocks for */
+    std::vector<WalletSynchronizer *> m_walletSynchronizers;
+
+    /* Held while using m_walletSynchronizers, including while handing out
+       blocks, so a wallet isn't removed part way through */
+    std::mutex m_mutex;
+
+    /* Triggered when a wallet is added, or we're stopping */
+    std::condition_variable m_haveWallets;
+
+    /* Whether the last download was for the wallet furthest ahead, rather
+       than the one furthest behind. Only touched by the download thread. */
+    bool m_downloadForFurthestAhead;
+
+    /* Bumped when a wallet is added */
+    uint64_t m_walletsAdded;
+
+    /* Derives the keys of downloaded blocks' outputs, for every wallet */
+    ThreadPool m_scanThreadPool;
+
+    /* An atomic bool to signal if we should stop the download thread */
+    std::atomic<bool> m_shouldStop;
+
+    /* The thread ID of the block downloader thread. Declared last, so
+       everything it uses is initialized first. */
+    std::thread m_downloadThread;
+};
@@ -18,6 +18,11 @@ uint64_t SynchronizationStatus::getHeight() const
     return m_lastKnownBlockHeight;
 }
 
+bool SynchronizationStatus::empty() const
+{
+    return m_lastKnownBlockHashes.empty() && m_blockHashCheckpoints.empty();
+}
+
 void SynchronizationStatus::storeBlockHash(
     const crypto::Hash hash,
     const uint64_t height)
@@ -38,6 +43,18 @@ void SynchronizationStatus::storeBlockHash(
         }
     }
 
+    /* Forked - the hashes above the fork are for blocks which aren't on the
+       chain any more */
+    if (height <= m_lastKnownBlockHeight)
+    {
+        const uint64_t forkedBlocks = m_lastKnownBlockHeight - height + 1;
+
+        for (uint64_t i = 0; i < forkedBlocks && !m_lastKnownBlockHashes.empty(); i++)
+        {
+            m_lastKnownBlockHashes.pop_front();
+        }
+    }
+
     m_lastKnownBlockHeight = height;
 
     /* If we're at a checkpoint height, add the hash to the infrequent
@@ -56,6 +73,23 @@ void SynchronizationStatus::storeBlockHash(
     }
 }
 
+std::optional<crypto::Hash> SynchronizationStatus::getBlockHash(const uint64_t blockHeight) const
+{
+    if (blockHeight > m_lastKnownBlockHeight)
+    {
+        return std::nullopt;
+    }
+
+    const uint64_t index = m_lastKnownBlockHeight - blockHeight;
+
+    if (index >= m_lastKnownBlockHashes.size())
+    {
+        return std::nullopt;
+    }
+
+    return m_lastKnownBlockHashes[index];
+}
+
 /* This returns a vector of hashes, used to be passed to queryBlocks(), to
    determine where to begin syncing from. We could just pass in the last known
    block hash, but if this block was on a forked chain, we would have to
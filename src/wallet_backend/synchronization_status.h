@@ -13,6 +13,8 @@
 
 #include "json_helper.h"
 
+#include <optional>
+
 #include <vector>
 
 using nlohmann::json;
@@ -38,6 +40,14 @@ public:
 
     uint64_t getHeight() const;
 
+    /* Whether no blocks have been stored yet. The height alone can't tell,
+       it's zero after storing the genesis block too. */
+    bool empty() const;
+
+    /* The hash of the block at the given height, if it's one of the most
+       recent blocks we know about */
+    std::optional<crypto::Hash> getBlockHash(const uint64_t blockHeight) const;
+
 private:
     //////////////////////////////
     /* Private member variables */
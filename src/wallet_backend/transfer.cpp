@@ -420,14 +420,10 @@ namespace send_transaction
             /* Not our output */
             crypto::underive_public_key(derivation, outputIndex, output.key, spendKey);
 
-            const auto spendKeys = subWallets->m_publicSpendKeys;
-
             /* See if the derived spend key is one of ours */
-            const auto it = std::find(spendKeys.begin(), spendKeys.end(), spendKey);
-
-            if (it != spendKeys.end())
+            if (subWallets->hasSpendKey(spendKey))
             {
-                crypto::PublicKey ourSpendKey = *it;
+                crypto::PublicKey ourSpendKey = spendKey;
 
                 wallet_types::UnconfirmedInput input;
 
@@ -8,6 +8,7 @@
 
 #include <common/base58.h>
 #include <common/file_system_shim.h>
+#include <common/string_tools.h>
 
 #include <config/cryptonote_config.h>
 
@@ -36,6 +37,8 @@
 
 #include <mnemonics/mnemonics.h>
 
+#include <syst/memory_mapped_file.h>
+
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
@@ -102,6 +105,24 @@ namespace
         return SUCCESS;
     }
 
+    /* Derive the key the wallet file is encrypted with from the password */
+    std::array<uint8_t, 16> deriveKey(
+        const std::string &password,
+        const std::array<uint8_t, 16> &salt)
+    {
+        std::array<uint8_t, 16> key;
+
+        /* Using SHA256 as the algorithm */
+        CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf2;
+
+        /* Generate the AES Key using pbkdf2 */
+        pbkdf2.DeriveKey(
+            key.data(), key.size(), 0, (CryptoPP::byte *)password.c_str(),
+            password.size(), salt.data(), salt.size(), Constants::PBKDF2_ITERATIONS);
+
+        return key;
+    }
+
 } // namespace
 
 ///////////////////////////////////
@@ -399,35 +420,32 @@ std::tuple<Error, std::shared_ptr<WalletBackend>> WalletBackend::openWallet(
     using namespace CryptoPP;
 
     /* The salt we use for both PBKDF2, and AES decryption */
-    byte salt[16];
+    std::array<uint8_t, 16> salt;
 
-    /* Check the file is large enough for the salt */
-    if (buffer.size() < sizeof(salt))
+    /* Check the file is large enough for the salt, and a block of data */
+    if (buffer.size() < salt.size() + AES::BLOCKSIZE)
     {
         return {WALLET_FILE_CORRUPTED, nullptr};
     }
 
     /* Copy the salt to the salt array */
-    std::copy(buffer.begin(), buffer.begin() + sizeof(salt), salt);
+    std::copy(buffer.begin(), buffer.begin() + salt.size(), salt.begin());
 
     /* Remove the salt, don't need it anymore */
-    buffer.erase(buffer.begin(), buffer.begin() + sizeof(salt));
+    buffer.erase(buffer.begin(), buffer.begin() + salt.size());
 
-    /* The key we use for AES decryption, generated with PBKDF2 */
-    byte key[16];
+    /* The journal following this wallet file is tagged with its last block */
+    WalletJournal::SnapshotId snapshotId;
 
-    /* Using SHA256 as the algorithm */
-    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf2;
+    std::copy(buffer.end() - snapshotId.size(), buffer.end(), snapshotId.begin());
 
-    /* Generate the AES Key using pbkdf2 */
-    pbkdf2.DeriveKey(
-        key, sizeof(key), 0, (byte *)password.c_str(),
-        password.size(), salt, sizeof(salt), Constants::PBKDF2_ITERATIONS);
+    /* The key we use for AES decryption, generated with PBKDF2 */
+    const std::array<uint8_t, 16> key = deriveKey(password, salt);
 
     CBC_Mode<AES>::Decryption cbcDecryption;
 
     /* Initialize our decrypter with the key and salt/iv */
-    cbcDecryption.SetKeyWithIV(key, sizeof(key), salt);
+    cbcDecryption.SetKeyWithIV(key.data(), key.size(), salt.data());
 
     /* This will store the decrypted data */
     std::string decryptedData;
@@ -477,6 +495,13 @@ std::tuple<Error, std::shared_ptr<WalletBackend>> WalletBackend::openWallet(
         /* Make our wallet object */
         const auto wallet = std::make_shared<WalletBackend>();
 
+        /* Keep the key for saving, so it doesn't need deriving again */
+        wallet->m_key = key;
+        wallet->m_salt = salt;
+        wallet->m_keyPassword = password;
+        wallet->m_snapshotSize = buffer.size();
+        wallet->m_journal = WalletJournal(filename, snapshotId, key);
+
         /* Initialize it from the json (We could do this in less steps, but it
            requires a move/copy constructor) */
         error = wallet->fromJSON(
@@ -541,38 +566,144 @@ Error WalletBackend::save() const
    blockchain synchronizer first (Call save()) */
 Error WalletBackend::unsafeSave() const
 {
-    /* Add an identifier to the start of the string so we can verify the wallet
-       has been correctly decrypted */
-    std::string identiferAsString(
-        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.begin(),
-        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.end());
+    /* Let a rewrite started by the last save finish first - it starts the
+       journal this would append to */
+    if (m_compaction.valid())
+    {
+        m_compaction.get();
+    }
 
-    /* Add magic identifier, and get wallet as a JSON string */
-    std::string walletData = identiferAsString + this->toJSON();
+    /* A new password needs a new key, and so does a new wallet */
+    if (m_keyPassword != m_password)
+    {
+        rnd::randomBytes(m_salt.size(), m_salt.data());
 
-    using namespace CryptoPP;
+        m_key = deriveKey(m_password, m_salt);
+
+        m_keyPassword = m_password;
+
+        return writeSnapshot(std::get<0>(snapshotAndTakeJournal()));
+    }
+
+    /* Nothing to append to */
+    if (m_journal.size() == 0)
+    {
+        return writeSnapshot(std::get<0>(snapshotAndTakeJournal()));
+    }
+
+    /* Rewrite the wallet file in the background once the journal gets as big
+       as it. It has to hold exactly the changes appended below, so anything
+       changed in the meantime is left for the next save to append. */
+    const bool compact = m_journal.size() > std::max(Constants::MINIMUM_JOURNAL_COMPACTION_SIZE, m_snapshotSize);
+
+    std::string walletJson;
+    bool journalComplete;
+    std::vector<std::string> changes;
+
+    if (compact)
+    {
+        std::tie(walletJson, journalComplete, changes) = snapshotAndTakeJournal();
+    }
+    else
+    {
+        std::tie(journalComplete, changes) = m_subWallets->takeJournal();
+    }
+
+    /* The changes can't be replayed from the journal. The wallet file has to
+       include them, so it has to be written after taking them. */
+    if (!journalComplete)
+    {
+        return writeSnapshot(compact ? walletJson : std::get<0>(snapshotAndTakeJournal()));
+    }
+
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
 
-    /* The key we use for AES encryption, generated with PBKDF2 */
-    byte key[16];
+    writer.StartObject();
+
+    writer.Key("changes");
+    writer.StartArray();
+    for (const auto &change : changes)
+    {
+        writer.RawValue(change.c_str(), change.size(), kObjectType);
+    }
+    writer.EndArray();
+
+    /* Small, so it's simpler to store the whole thing each time */
+    writer.Key("walletSynchronizer");
+    m_walletSynchronizer->toJSON(writer);
+
+    writer.EndObject();
+
+    if (m_journal.append(sb.GetString()) != SUCCESS)
+    {
+        return writeSnapshot(std::get<0>(snapshotAndTakeJournal()));
+    }
+
+    /* The changes are in the journal already, so nothing is lost if this
+       doesn't finish */
+    if (compact)
+    {
+        m_compaction = std::async(std::launch::async, [this, walletJson]()
+                                  { return writeSnapshot(walletJson); });
+    }
+
+    return SUCCESS;
+}
 
-    /* The salt we use for both PBKDF2, and AES Encryption */
-    byte salt[16];
+std::tuple<std::string, bool, std::vector<std::string>> WalletBackend::snapshotAndTakeJournal() const
+{
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
+
+    writer.StartObject();
+
+    /* Random, and near the start of the wallet file, so with CBC it works as
+       a fresh IV for the rest. The salt and key can then be used for every
+       save this session, and the last block of ciphertext is unique to this
+       write, which the journal uses to tell which file it follows. Ignored
+       when loading. */
+    std::array<uint8_t, 32> nonce;
+
+    rnd::randomBytes(nonce.size(), nonce.data());
+
+    writer.Key("nonce");
+    writer.String(common::podToHex(nonce));
+
+    writer.Key("walletFileFormatVersion");
+    writer.Uint(Constants::WALLET_FILE_FORMAT_VERSION);
 
-    /* Generate 16 random bytes for the salt */
-    rnd::randomBytes(16, salt);
+    writer.Key("subWallets");
+    const auto [journalComplete, changes] = m_subWallets->snapshotAndTakeJournal(writer);
 
-    /* Using SHA256 as the algorithm */
-    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf2;
+    writer.Key("walletSynchronizer");
+    m_walletSynchronizer->toJSON(writer);
 
-    /* Generate the AES Key using pbkdf2 */
-    pbkdf2.DeriveKey(
-        key, sizeof(key), 0, (byte *)m_password.c_str(),
-        m_password.size(), salt, sizeof(salt), Constants::PBKDF2_ITERATIONS);
+    writer.EndObject();
+
+    return {sb.GetString(), journalComplete, changes};
+}
+
+Error WalletBackend::writeSnapshot(const std::string &walletJson) const
+{
+    /* Until the wallet file is written, the current journal doesn't follow
+       on from it */
+    m_journal = WalletJournal();
+
+    using namespace CryptoPP;
+
+    /* Start with an identifier so we can verify the wallet has been
+       correctly decrypted */
+    std::string walletData(
+        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.begin(),
+        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.end());
+
+    walletData += walletJson;
 
     CBC_Mode<AES>::Encryption cbcEncryption;
 
     /* Initialize our encryptor with the key and salt/iv */
-    cbcEncryption.SetKeyWithIV(key, sizeof(key), salt);
+    cbcEncryption.SetKeyWithIV(m_key.data(), m_key.size(), m_salt.data());
 
     /* This will store the encrypted data */
     std::string encryptedData;
@@ -580,29 +711,97 @@ Error WalletBackend::unsafeSave() const
     /* Encrypt, and pad */
     StringSource(walletData, true, new StreamTransformationFilter(cbcEncryption, new StringSink(encryptedData)));
 
-    std::ofstream file(m_filename, std::ios_base::binary);
+    /* The isAWalletIdentifier, so when we open it we can verify that it is
+       a wallet file, then the salt, so we can use it to unencrypt the file
+       later. Note that the salt is unencrypted. */
+    std::string fileData(
+        Constants::IS_A_WALLET_IDENTIFIER.begin(),
+        Constants::IS_A_WALLET_IDENTIFIER.end());
 
-    if (!file)
+    fileData.append(m_salt.begin(), m_salt.end());
+
+    fileData += encryptedData;
+
+    /* Write it to the side and move it over the wallet file once it's on
+       disk, so a crash part way through doesn't leave us with neither the
+       old wallet file nor the new one */
+    const std::string tmpFilename = m_filename + ".tmp";
+
+    std::error_code ec;
+
+    syst::MemoryMappedFile file;
+
+    file.create(tmpFilename, fileData.size(), true, ec);
+
+    if (ec)
     {
         return INVALID_WALLET_FILENAME;
     }
 
-    std::string saltString = std::string(salt, salt + sizeof(salt));
+    std::copy(fileData.begin(), fileData.end(), file.data());
 
-    /* Write the isAWalletIdentifier to the file, so when we open it we can
-       verify that it is a wallet file */
-    std::copy(Constants::IS_A_WALLET_IDENTIFIER.begin(),
-              Constants::IS_A_WALLET_IDENTIFIER.end(),
-              std::ostreambuf_iterator<char>(file));
+    file.flush(file.data(), file.size(), ec);
 
-    /* Write the salt to the file, so we can use it to unencrypt the file
-       later. Note that the salt is unencrypted. */
-    std::copy(std::begin(salt), std::end(salt),
-              std::ostreambuf_iterator<char>(file));
+    if (!ec)
+    {
+        file.rename(m_filename, ec);
+    }
 
-    /* Write the encrypted wallet data to the file */
-    std::copy(encryptedData.begin(), encryptedData.end(),
-              std::ostreambuf_iterator<char>(file));
+    if (ec)
+    {
+        std::error_code ignore;
+        file.close(ignore);
+        fs::remove(tmpFilename, ignore);
+
+        return INVALID_WALLET_FILENAME;
+    }
+
+    m_snapshotSize = encryptedData.size();
+
+    WalletJournal::SnapshotId snapshotId;
+
+    std::copy(encryptedData.end() - snapshotId.size(), encryptedData.end(), snapshotId.begin());
+
+    m_journal = WalletJournal(m_filename, snapshotId, m_key);
+
+    /* If this fails, the next save writes the wallet file again */
+    m_journal.reset();
+
+    return SUCCESS;
+}
+
+Error WalletBackend::replayJournal()
+{
+    for (const auto &entry : m_journal.load())
+    {
+        rapidjson::Document j;
+
+        if (j.Parse(entry.c_str()).HasParseError())
+        {
+            return WALLET_FILE_CORRUPTED;
+        }
+
+        /* The entries are authenticated, so one which can't be replayed is
+           a bug rather than damage - don't carry on with a wallet which is
+           only partly loaded */
+        try
+        {
+            for (const auto &change : getArrayFromJSON(j, "changes"))
+            {
+                m_subWallets->applyJournal(change);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            return WALLET_FILE_CORRUPTED;
+        }
+
+        m_walletSynchronizer = std::make_shared<WalletSynchronizer>();
+        m_walletSynchronizer->fromJSON(getObjectFromJSON(j, "walletSynchronizer"));
+    }
+
+    /* Replaying them recorded the changes again, but they're saved already */
+    m_subWallets->takeJournal();
 
     return SUCCESS;
 }
@@ -929,17 +1128,44 @@ wallet_types::WalletStatus WalletBackend::getStatus() const
 std::vector<wallet_types::Transaction> WalletBackend::getTransactionsRange(
     const uint64_t startHeight, const uint64_t endHeight) const
 {
-    std::vector<wallet_types::Transaction> result;
+    const auto [transactions, next] = m_subWallets->getTransactionsInRange(
+        startHeight, endHeight, std::nullopt, std::nullopt, 0);
 
-    const auto transactions = getTransactions();
+    return transactions;
+}
 
-    std::copy_if(transactions.begin(), transactions.end(), std::back_inserter(result),
-                 [&startHeight, &endHeight](const auto tx)
-                 {
-                     return tx.blockHeight >= startHeight && tx.blockHeight < endHeight;
-                 });
+std::tuple<Error, std::vector<wallet_types::Transaction>, std::optional<wallet_types::TransactionCursor>>
+WalletBackend::getTransactionsPage(
+    const uint64_t startHeight,
+    const uint64_t endHeight,
+    const std::string &address,
+    const std::optional<wallet_types::TransactionCursor> after,
+    const size_t limit) const
+{
+    std::optional<crypto::PublicKey> spendKey;
 
-    return result;
+    if (!address.empty())
+    {
+        if (Error error = validateAddresses({address}, false); error != SUCCESS)
+        {
+            return {error, {}, std::nullopt};
+        }
+
+        const auto [publicSpendKey, publicViewKey] = utilities::addressToKeys(address);
+
+        spendKey = publicSpendKey;
+    }
+
+    const auto [transactions, next] = m_subWallets->getTransactionsInRange(
+        startHeight, endHeight, spendKey, after, limit);
+
+    return {SUCCESS, transactions, next};
+}
+
+std::optional<wallet_types::Transaction> WalletBackend::getTransaction(
+    const crypto::Hash &hash) const
+{
+    return m_subWallets->getTransaction(hash);
 }
 
 std::tuple<uint64_t, std::string> WalletBackend::getNodeFee() const
@@ -952,7 +1178,10 @@ std::tuple<std::string, uint16_t> WalletBackend::getNodeAddress() const
     return m_daemon->nodeAddress();
 }
 
-void WalletBackend::swapNode(std::string daemonHost, uint16_t daemonPort)
+void WalletBackend::swapNode(
+    std::string daemonHost,
+    uint16_t daemonPort,
+    std::shared_ptr<SharedBlockDownloader> blockDownloader)
 {
     m_syncRAIIWrapper->pauseSynchronizerToRunFunction([&, this]()
                                                       {
@@ -962,6 +1191,18 @@ void WalletBackend::swapNode(std::string daemonHost, uint16_t daemonPort)
         /* Give the synchronizer the new daemon */
         m_walletSynchronizer->swapNode(m_daemon);
 
+        /* The old downloader is for the old daemon */
+        m_walletSynchronizer->setBlockDownloader(blockDownloader);
+
+        return 0; });
+}
+
+void WalletBackend::setBlockDownloader(std::shared_ptr<SharedBlockDownloader> blockDownloader)
+{
+    m_syncRAIIWrapper->pauseSynchronizerToRunFunction([&, this]()
+                                                      {
+        m_walletSynchronizer->setBlockDownloader(blockDownloader);
+
         return 0; });
 }
 
@@ -1019,7 +1260,7 @@ Error WalletBackend::fromJSON(const rapidjson::Document &j)
 {
     uint64_t version = getUint64FromJSON(j, "walletFileFormatVersion");
 
-    if (version != Constants::WALLET_FILE_FORMAT_VERSION)
+    if (version > Constants::WALLET_FILE_FORMAT_VERSION)
     {
         return UNSUPPORTED_WALLET_FILE_FORMAT_VERSION;
     }
@@ -1048,6 +1289,11 @@ Error WalletBackend::fromJSON(
     m_filename = filename;
     m_password = password;
 
+    if (Error error = replayJournal(); error != SUCCESS)
+    {
+        return error;
+    }
+
     m_daemon = std::make_shared<Nigel>(daemonHost, daemonPort);
 
     init();
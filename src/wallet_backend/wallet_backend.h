@@ -5,12 +5,18 @@
 
 #pragma once
 
+#include <array>
+
 #include "crypto_types.h"
 
 #include <errors/errors.h>
 
+#include <future>
+
 #include "rapidjson/document.h"
 
+#include <optional>
+
 #include <string>
 
 #include <tuple>
@@ -21,6 +27,8 @@
 
 #include <sub_wallets/sub_wallets.h>
 
+#include <wallet_backend/shared_block_downloader.h>
+#include <wallet_backend/wallet_journal.h>
 #include <wallet_backend/wallet_synchronizer.h>
 #include <wallet_backend/wallet_synchronizer_raii_wrapper.h>
 
@@ -236,14 +244,39 @@ public:
     std::vector<wallet_types::Transaction> getTransactionsRange(
         const uint64_t startHeight, const uint64_t endHeight) const;
 
+    /* Returns a page of at most limit (or all, if zero) transactions in the
+       range [startHeight, endHeight - 1], after the cursor if given, and
+       only involving the given address if it's not empty. Also returns the
+       cursor of the next page, if there's more. */
+    std::tuple<Error, std::vector<wallet_types::Transaction>, std::optional<wallet_types::TransactionCursor>>
+    getTransactionsPage(
+        const uint64_t startHeight,
+        const uint64_t endHeight,
+        const std::string &address,
+        const std::optional<wallet_types::TransactionCursor> after,
+        const size_t limit) const;
+
+    /* Gets a transaction by hash, if it's in a block */
+    std::optional<wallet_types::Transaction> getTransaction(
+        const crypto::Hash &hash) const;
+
     /* Get the node fee and address ({0, ""} if empty) */
     std::tuple<uint64_t, std::string> getNodeFee() const;
 
     /* Returns the node host and port */
     std::tuple<std::string, uint16_t> getNodeAddress() const;
 
-    /* Swap to a different daemon node */
-    void swapNode(std::string daemonHost, uint16_t daemonPort);
+    /* Swap to a different daemon node. Blocks are downloaded through the
+       given downloader, which must be for the same node, or by the wallet
+       itself if it's nullptr. */
+    void swapNode(
+        std::string daemonHost,
+        uint16_t daemonPort,
+        std::shared_ptr<SharedBlockDownloader> blockDownloader = nullptr);
+
+    /* Download blocks through a downloader shared with other wallets using
+       the same node, rather than by the wallet itself */
+    void setBlockDownloader(std::shared_ptr<SharedBlockDownloader> blockDownloader);
 
     /* Whether we have recieved info from the daemon at some point */
     bool daemonOnline() const;
@@ -294,6 +327,16 @@ private:
 
     Error unsafeSave() const;
 
+    /* The wallet as JSON, along with whether the changes taken from the
+       subwallets' journal at the same moment can be replayed, and them */
+    std::tuple<std::string, bool, std::vector<std::string>> snapshotAndTakeJournal() const;
+
+    /* Writes the whole wallet file, and starts a new journal after it */
+    Error writeSnapshot(const std::string &walletJson) const;
+
+    /* Applies the changes in the journal to the wallet just loaded */
+    Error replayJournal();
+
     void init();
 
     //////////////////////////////
@@ -306,6 +349,21 @@ private:
     /* The password the wallet is encrypted with */
     std::string m_password;
 
+    /* The key the wallet file is encrypted with, and the salt it was derived
+       with. PBKDF2 is slow on purpose, so this is derived once, rather than
+       on every save. */
+    mutable std::array<uint8_t, 16> m_key;
+    mutable std::array<uint8_t, 16> m_salt;
+
+    /* The password m_key was derived from, if it has been */
+    mutable std::optional<std::string> m_keyPassword;
+
+    /* The changes saved since the wallet file was last written in full */
+    mutable WalletJournal m_journal;
+
+    /* The size of the encrypted data in the wallet file */
+    mutable uint64_t m_snapshotSize = 0;
+
     /* The sub wallets container (Using a shared_ptr here so
        the WalletSynchronizer has access to it) */
     std::shared_ptr<SubWallets> m_subWallets;
@@ -332,4 +390,9 @@ private:
     std::shared_ptr<WalletSynchronizer> m_walletSynchronizer;
 
     std::shared_ptr<WalletSynchronizerRAIIWrapper> m_syncRAIIWrapper;
+
+    /* Rewriting the wallet file in the background, once the journal has
+       grown large. Last, so it's waited for before anything it uses is
+       destroyed. */
+    mutable std::future<Error> m_compaction;
 };
@@ -0,0 +1,307 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+///////////////////////////////////////
+#include <wallet_backend/wallet_journal.h>
+///////////////////////////////////////
+
+#include <common/file_system_shim.h>
+
+#include <crypto/random.h>
+
+#include <cryptopp/aes.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/misc.h>
+#include <cryptopp/modes.h>
+#include <cryptopp/sha.h>
+
+#include <fstream>
+
+#include <iterator>
+
+#include <wallet_backend/constants.h>
+
+namespace
+{
+    const size_t LENGTH_SIZE = 4;
+    const size_t IV_SIZE = 16;
+    const size_t MAC_SIZE = 32;
+
+    /* Entries are only ever as large as the changes between two saves, this
+       is just a sanity check on the length before allocating for it */
+    const uint32_t MAXIMUM_ENTRY_SIZE = 1024 * 1024 * 1024;
+
+    void writeUint32(uint8_t *data, const uint32_t value)
+    {
+        for (size_t i = 0; i < 4; i++)
+        {
+            data[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint32_t readUint32(const uint8_t *data)
+    {
+        uint32_t value = 0;
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            value |= static_cast<uint32_t>(data[i]) << (8 * i);
+        }
+
+        return value;
+    }
+
+    size_t headerSize()
+    {
+        return Constants::IS_A_WALLET_JOURNAL_IDENTIFIER.size() + std::tuple_size<WalletJournal::SnapshotId>::value;
+    }
+}
+
+WalletJournal::WalletJournal(
+    const std::string walletFilename,
+    const SnapshotId snapshotId,
+    const std::array<uint8_t, 16> walletKey) :
+
+                                               m_filename(walletFilename + ".journal"),
+                                               m_snapshotId(snapshotId)
+{
+    initializeKeys(walletKey);
+}
+
+void WalletJournal::initializeKeys(const std::array<uint8_t, 16> walletKey)
+{
+    const std::string encryptionLabel = "wallet journal encryption";
+    const std::string authenticationLabel = "wallet journal authentication";
+
+    std::array<uint8_t, 32> digest;
+
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(walletKey.data(), walletKey.size());
+
+    hmac.CalculateDigest(
+        digest.data(), reinterpret_cast<const uint8_t *>(encryptionLabel.data()),
+        encryptionLabel.size());
+
+    std::copy(digest.begin(), digest.begin() + m_encryptionKey.size(), m_encryptionKey.begin());
+
+    hmac.CalculateDigest(
+        m_authenticationKey.data(), reinterpret_cast<const uint8_t *>(authenticationLabel.data()),
+        authenticationLabel.size());
+}
+
+std::array<uint8_t, 32> WalletJournal::mac(
+    const uint64_t index,
+    const uint8_t *entry,
+    const size_t entrySize) const
+{
+    uint8_t indexBytes[8];
+
+    for (size_t i = 0; i < sizeof(indexBytes); i++)
+    {
+        indexBytes[i] = static_cast<uint8_t>(index >> (8 * i));
+    }
+
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(m_authenticationKey.data(), m_authenticationKey.size());
+
+    hmac.Update(m_snapshotId.data(), m_snapshotId.size());
+    hmac.Update(indexBytes, sizeof(indexBytes));
+    hmac.Update(entry, entrySize);
+
+    std::array<uint8_t, 32> digest;
+
+    hmac.Final(digest.data());
+
+    return digest;
+}
+
+std::vector<std::string> WalletJournal::load()
+{
+    m_entries = 0;
+    m_size = 0;
+
+    std::ifstream file(m_filename, std::ios_base::binary);
+
+    if (!file)
+    {
+        return {};
+    }
+
+    const std::vector<uint8_t> buffer(
+        (std::istreambuf_iterator<char>(file)),
+        (std::istreambuf_iterator<char>()));
+
+    file.close();
+
+    const auto &identifier = Constants::IS_A_WALLET_JOURNAL_IDENTIFIER;
+
+    /* Not started yet, or it follows a different wallet file */
+    if (buffer.size() < headerSize()
+        || !std::equal(identifier.begin(), identifier.end(), buffer.begin())
+        || !std::equal(m_snapshotId.begin(), m_snapshotId.end(), buffer.begin() + identifier.size()))
+    {
+        return {};
+    }
+
+    std::vector<std::string> entries;
+
+    size_t offset = headerSize();
+
+    while (buffer.size() - offset >= LENGTH_SIZE)
+    {
+        const uint8_t *entry = buffer.data() + offset;
+
+        const uint32_t length = readUint32(entry);
+
+        if (length > MAXIMUM_ENTRY_SIZE)
+        {
+            break;
+        }
+
+        const size_t entrySize = LENGTH_SIZE + IV_SIZE + length;
+
+        if (buffer.size() - offset < entrySize + MAC_SIZE)
+        {
+            break;
+        }
+
+        const auto expected = mac(m_entries, entry, entrySize);
+
+        if (!CryptoPP::VerifyBufsEqual(expected.data(), entry + entrySize, MAC_SIZE))
+        {
+            break;
+        }
+
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption cbcDecryption;
+
+        cbcDecryption.SetKeyWithIV(
+            m_encryptionKey.data(), m_encryptionKey.size(), entry + LENGTH_SIZE);
+
+        std::string decrypted;
+
+        try
+        {
+            CryptoPP::StringSource(
+                entry + LENGTH_SIZE + IV_SIZE, length, true,
+                new CryptoPP::StreamTransformationFilter(cbcDecryption, new CryptoPP::StringSink(decrypted)));
+        }
+        /* Authenticated, so shouldn't happen */
+        catch (const CryptoPP::Exception &)
+        {
+            break;
+        }
+
+        entries.push_back(decrypted);
+
+        m_entries++;
+        offset += entrySize + MAC_SIZE;
+    }
+
+    /* Drop whatever is left of an interrupted append */
+    if (offset != buffer.size())
+    {
+        std::error_code ec;
+        fs::resize_file(m_filename, offset, ec);
+
+        /* Can't append after the broken entry, so start over at the next
+           save rather than lose what's appended */
+        if (ec)
+        {
+            m_entries = 0;
+            return entries;
+        }
+    }
+
+    m_size = offset;
+
+    return entries;
+}
+
+Error WalletJournal::reset()
+{
+    m_entries = 0;
+    m_size = 0;
+
+    std::ofstream file(m_filename, std::ios_base::binary | std::ios_base::trunc);
+
+    if (!file)
+    {
+        return INVALID_WALLET_FILENAME;
+    }
+
+    std::copy(Constants::IS_A_WALLET_JOURNAL_IDENTIFIER.begin(),
+              Constants::IS_A_WALLET_JOURNAL_IDENTIFIER.end(),
+              std::ostreambuf_iterator<char>(file));
+
+    std::copy(m_snapshotId.begin(), m_snapshotId.end(),
+              std::ostreambuf_iterator<char>(file));
+
+    if (!file.flush())
+    {
+        return INVALID_WALLET_FILENAME;
+    }
+
+    m_size = headerSize();
+
+    return SUCCESS;
+}
+
+Error WalletJournal::append(const std::string &entry)
+{
+    if (m_size == 0)
+    {
+        return INVALID_WALLET_FILENAME;
+    }
+
+    uint8_t iv[IV_SIZE];
+
+    rnd::randomBytes(IV_SIZE, iv);
+
+    CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption cbcEncryption;
+
+    cbcEncryption.SetKeyWithIV(m_encryptionKey.data(), m_encryptionKey.size(), iv);
+
+    std::string encrypted;
+
+    CryptoPP::StringSource(
+        entry, true,
+        new CryptoPP::StreamTransformationFilter(cbcEncryption, new CryptoPP::StringSink(encrypted)));
+
+    std::vector<uint8_t> data(LENGTH_SIZE + IV_SIZE + encrypted.size());
+
+    writeUint32(data.data(), static_cast<uint32_t>(encrypted.size()));
+
+    std::copy(std::begin(iv), std::end(iv), data.begin() + LENGTH_SIZE);
+
+    std::copy(encrypted.begin(), encrypted.end(), data.begin() + LENGTH_SIZE + IV_SIZE);
+
+    const auto digest = mac(m_entries, data.data(), data.size());
+
+    data.insert(data.end(), digest.begin(), digest.end());
+
+    std::ofstream file(m_filename, std::ios_base::binary | std::ios_base::app);
+
+    if (!file)
+    {
+        return INVALID_WALLET_FILENAME;
+    }
+
+    file.write(reinterpret_cast<const char *>(data.data()), data.size());
+
+    if (!file.flush())
+    {
+        /* Don't know how much made it - write the whole wallet next time */
+        m_size = 0;
+        return INVALID_WALLET_FILENAME;
+    }
+
+    m_entries++;
+    m_size += data.size();
+
+    return SUCCESS;
+}
+
+uint64_t WalletJournal::size() const
+{
+    return m_size;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2019, The Kryptokrona Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <array>
+
+#include <errors/errors.h>
+
+#include <string>
+
+#include <vector>
+
+/* Writing the whole wallet file means serializing and encrypting every
+   transaction and input the wallet has ever seen. Between those full saves,
+   the changes made since the last one are appended to a journal next to the
+   wallet file instead, and replayed on top of it when the wallet is opened.
+
+   The journal starts with IS_A_WALLET_JOURNAL_IDENTIFIER and the id of the
+   wallet file it follows - the last block of its ciphertext, which is
+   different every time it's written. A journal left over from an earlier
+   wallet file is ignored.
+
+   Each entry after that is
+
+       length (4 bytes) | iv (16 bytes) | ciphertext (length bytes) | mac (32 bytes)
+
+   The ciphertext is AES-CBC, and the mac is HMAC-SHA256 over the wallet file
+   id, the index of the entry, and the rest of the entry - so entries can't
+   be moved between journals, or reordered. Both keys are derived from the
+   wallet file key, so no extra PBKDF2 is needed. */
+class WalletJournal
+{
+public:
+    typedef std::array<uint8_t, 16> SnapshotId;
+
+    WalletJournal() = default;
+
+    /* The journal for the wallet file with the given name, id and key */
+    WalletJournal(
+        const std::string walletFilename,
+        const SnapshotId snapshotId,
+        const std::array<uint8_t, 16> walletKey);
+
+    /* Reads the entries in the journal. Reading stops at the first one which
+       is cut short or fails to authenticate, which is what an interrupted
+       append looks like, and the file is cut back to the entries before it
+       so later appends follow on from them. */
+    std::vector<std::string> load();
+
+    /* Empties the journal */
+    Error reset();
+
+    /* Encrypts and appends an entry. Fails if the journal hasn't been
+       started for this wallet file, and leaves it that way if the write
+       fails - the wallet file has to be written in full then. */
+    Error append(const std::string &entry);
+
+    /* The size of the journal, in bytes. Zero if it hasn't been started
+       for this wallet file. */
+    uint64_t size() const;
+
+private:
+    void initializeKeys(const std::array<uint8_t, 16> walletKey);
+
+    std::array<uint8_t, 32> mac(
+        const uint64_t index,
+        const uint8_t *entry,
+        const size_t entrySize) const;
+
+    std::string m_filename;
+
+    SnapshotId m_snapshotId;
+
+    std::array<uint8_t, 16> m_encryptionKey;
+
+    std::array<uint8_t, 32> m_authenticationKey;
+
+    /* The number of entries in the journal */
+    uint64_t m_entries = 0;
+
+    uint64_t m_size = 0;
+};
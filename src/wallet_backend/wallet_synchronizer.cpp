@@ -20,6 +20,7 @@
 #include <utilities/utilities.h>
 
 #include <wallet_backend/constants.h>
+#include <wallet_backend/shared_block_downloader.h>
 
 ///////////////////////////////////
 /* CONSTRUCTORS / DECONSTRUCTORS */
@@ -27,6 +28,8 @@
 
 /* Default constructor */
 WalletSynchronizer::WalletSynchronizer() : m_shouldStop(false),
+                                           m_downloadGeneration(0),
+                                           m_downloadStatusGeneration(0),
                                            m_startTimestamp(0),
                                            m_startHeight(0)
 {
@@ -42,6 +45,8 @@ WalletSynchronizer::WalletSynchronizer(
 
                                                         m_daemon(daemon),
                                                         m_shouldStop(false),
+                                                        m_downloadGeneration(0),
+                                                        m_downloadStatusGeneration(0),
                                                         m_startHeight(startHeight),
                                                         m_startTimestamp(startTimestamp),
                                                         m_privateViewKey(privateViewKey),
@@ -63,6 +68,7 @@ WalletSynchronizer &WalletSynchronizer::operator=(WalletSynchronizer &&old)
     stop();
 
     m_syncThread = std::move(old.m_syncThread);
+    m_downloadThread = std::move(old.m_downloadThread);
 
     m_syncStatus = std::move(old.m_syncStatus);
 
@@ -75,6 +81,8 @@ WalletSynchronizer &WalletSynchronizer::operator=(WalletSynchronizer &&old)
 
     m_daemon = std::move(old.m_daemon);
 
+    m_blockDownloader = std::move(old.m_blockDownloader);
+
     return *this;
 }
 
@@ -88,43 +96,186 @@ WalletSynchronizer::~WalletSynchronizer()
 /* CLASS FUNCTIONS */
 /////////////////////
 
+/* Processes the downloaded blocks in order. Anything touching the sub
+   wallets or the sync status has to be done here, one block after another,
+   as whether a key image is ours depends on the blocks before it. */
 void WalletSynchronizer::mainLoop()
 {
     while (!m_shouldStop)
     {
-        const auto blocks = downloadBlocks();
+        const PendingBlock pending = m_blockQueue.pop();
 
-        for (const auto block : blocks)
+        /* Queue was stopped */
+        if (m_shouldStop || !pending.block)
         {
-            if (m_shouldStop)
-            {
-                return;
-            }
+            return;
+        }
 
-            processBlock(block);
+        /* Downloaded before we restarted the download, skip it */
+        if (pending.generation != m_downloadGeneration)
+        {
+            continue;
         }
 
+        if (!processBlock(*pending.block, pending.ourInputs.get()))
+        {
+            /* We didn't process the block, so make the downloader start
+               again from the last block we did */
+            m_downloadGeneration++;
+        }
+    }
+}
+
+/* Downloads blocks ahead of the processing thread, and hands their outputs
+   to the scanning threads, so the network, scanning, and processing all
+   happen at the same time */
+void WalletSynchronizer::downloadLoop()
+{
+    while (!m_shouldStop)
+    {
+        updateDownloadStatus();
+
+        auto blocks = downloadBlocks();
+
         if (blocks.empty() && !m_shouldStop)
         {
-            /* If we're synced, check any transactions that may be in the pool */
-            if (getCurrentScanHeight() >= m_daemon->localDaemonBlockCount() &&
-                !m_subWallets->isViewWallet())
-            {
-                checkLockedTransactions();
-            }
+            checkLockedTransactionsIfSynced();
 
             std::this_thread::sleep_for(std::chrono::seconds(5));
 
             continue;
         }
+
+        for (auto &block : blocks)
+        {
+            const auto pending = std::make_shared<const wallet_types::WalletBlockInfo>(std::move(block));
+
+            if (!queueBlock(pending, *m_scanThreadPool))
+            {
+                return;
+            }
+        }
     }
 }
 
+void WalletSynchronizer::updateDownloadStatus()
+{
+    /* The processing thread wants us to start again from where it got
+       to. It has nothing to process until we push some more blocks, so
+       the sync status won't change under us. */
+    if (m_downloadStatusGeneration != m_downloadGeneration)
+    {
+        m_downloadStatusGeneration = m_downloadGeneration;
+        m_downloadStatus = m_syncStatus;
+    }
+}
+
+uint64_t WalletSynchronizer::getDownloadHeight()
+{
+    updateDownloadStatus();
+
+    /* Nothing downloaded yet, so the height we start at */
+    if (m_downloadStatus.empty())
+    {
+        if (m_startTimestamp != 0)
+        {
+            return utilities::timestampToScanHeight(m_startTimestamp);
+        }
+
+        return m_startHeight;
+    }
+
+    return m_downloadStatus.getHeight() + 1;
+}
+
+std::tuple<std::vector<crypto::Hash>, uint64_t, uint64_t> WalletSynchronizer::getDownloadRequest()
+{
+    updateDownloadStatus();
+
+    return {m_downloadStatus.getBlockHashCheckpoints(), m_startHeight, m_startTimestamp};
+}
+
+/* The shared downloader downloads for the wallet furthest behind, so the
+   others skip blocks they already have - or don't need yet, if they're
+   behind after the processing thread started again. Those are downloaded
+   again once we're the furthest behind. */
+bool WalletSynchronizer::wantsBlock(
+    const wallet_types::WalletBlockInfo &block,
+    const bool downloadedForUs)
+{
+    updateDownloadStatus();
+
+    /* Nothing downloaded yet, want the block we start at */
+    if (m_downloadStatus.empty())
+    {
+        /* Only the daemon knows which block a timestamp starts at, so it has
+           to be our own request. A block after the timestamp downloaded for
+           another wallet may be well past it, skipping the blocks between. */
+        if (m_startTimestamp != 0)
+        {
+            return downloadedForUs;
+        }
+
+        return block.blockHeight == m_startHeight;
+    }
+
+    const uint64_t height = m_downloadStatus.getHeight();
+
+    if (block.blockHeight == height + 1)
+    {
+        return true;
+    }
+
+    if (block.blockHeight > height)
+    {
+        return false;
+    }
+
+    /* Already have a block at this height - only want it if the chain has
+       forked since */
+    const auto knownHash = m_downloadStatus.getBlockHash(block.blockHeight);
+
+    return knownHash && *knownHash != block.blockHash;
+}
+
+bool WalletSynchronizer::queueBlock(
+    const std::shared_ptr<const wallet_types::WalletBlockInfo> block,
+    ThreadPool &scanThreadPool)
+{
+    if (m_startTimestamp != 0)
+    {
+        convertSyncTimestampToHeight(block->blockHeight);
+    }
+
+    m_downloadStatus.storeBlockHash(block->blockHash, block->blockHeight);
+
+    PendingBlock pending;
+
+    pending.block = block;
+    pending.generation = m_downloadStatusGeneration;
+
+    pending.ourInputs = scanThreadPool.addJob([block, privateViewKey = m_privateViewKey, subWallets = m_subWallets]()
+    {
+        return processBlockOutputs(*block, privateViewKey, *subWallets);
+    }).share();
+
+    /* Blocks if the processing thread is too far behind */
+    return m_blockQueue.push(pending);
+}
+
+void WalletSynchronizer::convertSyncTimestampToHeight(const uint64_t startHeight)
+{
+    m_startTimestamp = 0;
+    m_startHeight = startHeight;
+
+    m_subWallets->convertSyncTimestampToHeight(m_startTimestamp, m_startHeight);
+}
+
 std::vector<wallet_types::WalletBlockInfo> WalletSynchronizer::downloadBlocks()
 {
     const uint64_t localDaemonBlockCount = m_daemon->localDaemonBlockCount();
 
-    const uint64_t walletBlockCount = getCurrentScanHeight();
+    const uint64_t walletBlockCount = m_downloadStatus.getHeight();
 
     /* Local daemon has less blocks than the wallet:
 
@@ -157,7 +308,7 @@ std::vector<wallet_types::WalletBlockInfo> WalletSynchronizer::downloadBlocks()
     }
 
     /* The block hashes to try begin syncing from */
-    const auto blockCheckpoints = m_syncStatus.getBlockHashCheckpoints();
+    const auto blockCheckpoints = m_downloadStatus.getBlockHashCheckpoints();
 
     /* Blocks the thread for up to 10 secs */
     const auto [success, blocks] = m_daemon->getWalletSyncData(
@@ -171,13 +322,9 @@ std::vector<wallet_types::WalletBlockInfo> WalletSynchronizer::downloadBlocks()
         return {};
     }
 
-    /* Timestamp is transient and can change - block height is constant. */
     if (m_startTimestamp != 0)
     {
-        m_startTimestamp = 0;
-        m_startHeight = blocks.front().blockHeight;
-
-        m_subWallets->convertSyncTimestampToHeight(m_startTimestamp, m_startHeight);
+        convertSyncTimestampToHeight(blocks.front().blockHeight);
     }
 
     /* If checkpoints are empty, this is the first sync request. */
@@ -206,21 +353,24 @@ std::vector<wallet_types::WalletBlockInfo> WalletSynchronizer::downloadBlocks()
 }
 
 std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> WalletSynchronizer::processBlockOutputs(
-    const wallet_types::WalletBlockInfo &block) const
+    const wallet_types::WalletBlockInfo &block,
+    const crypto::SecretKey &privateViewKey,
+    const SubWallets &subWallets)
 {
     std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> inputs;
 
     if (wallet_config::processCoinbaseTransactions)
     {
         const auto newInputs = processTransactionOutputs(
-            block.coinbaseTransaction, block.blockHeight);
+            block.coinbaseTransaction, block.blockHeight, privateViewKey, subWallets);
 
         inputs.insert(inputs.end(), newInputs.begin(), newInputs.end());
     }
 
-    for (const auto tx : block.transactions)
+    for (const auto &tx : block.transactions)
     {
-        const auto newInputs = processTransactionOutputs(tx, block.blockHeight);
+        const auto newInputs = processTransactionOutputs(
+            tx, block.blockHeight, privateViewKey, subWallets);
 
         inputs.insert(inputs.end(), newInputs.begin(), newInputs.end());
     }
@@ -228,7 +378,11 @@ std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> Walle
     return inputs;
 }
 
-void WalletSynchronizer::processBlock(const wallet_types::WalletBlockInfo &block)
+/* Returns false if the block couldn't be processed, and needs downloading
+   again */
+bool WalletSynchronizer::processBlock(
+    const wallet_types::WalletBlockInfo &block,
+    std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> ourInputs)
 {
     /* Chain forked, invalidate previous transactions */
     if (m_syncStatus.getHeight() >= block.blockHeight)
@@ -236,8 +390,6 @@ void WalletSynchronizer::processBlock(const wallet_types::WalletBlockInfo &block
         removeForkedTransactions(block.blockHeight);
     }
 
-    auto ourInputs = processBlockOutputs(block);
-
     std::unordered_map<crypto::Hash, std::vector<uint64_t>> globalIndexes;
 
     for (auto &[publicKey, input] : ourInputs)
@@ -263,7 +415,7 @@ void WalletSynchronizer::processBlock(const wallet_types::WalletBlockInfo &block
                 std::cout << "Warning: Failed to get correct global indexes from daemon."
                           << "\nIf you see this error message repeatedly, the daemon "
                           << "may be faulty. More likely, the chain just forked.\n";
-                return;
+                return false;
             }
 
             input.globalOutputIndex = it->second[input.transactionIndex];
@@ -272,20 +424,20 @@ void WalletSynchronizer::processBlock(const wallet_types::WalletBlockInfo &block
 
     BlockScanTmpInfo blockScanInfo = processBlockTransactions(block, ourInputs);
 
-    for (const auto tx : blockScanInfo.transactionsToAdd)
+    for (const auto &tx : blockScanInfo.transactionsToAdd)
     {
         m_subWallets->addTransaction(tx);
         m_eventHandler->onTransaction.fire(tx);
     }
 
-    for (const auto [publicKey, input] : blockScanInfo.inputsToAdd)
+    for (const auto &[publicKey, input] : blockScanInfo.inputsToAdd)
     {
         m_subWallets->storeTransactionInput(publicKey, input);
     }
 
     /* The input has been spent, discard the key image so we
        don't double spend it */
-    for (const auto [publicKey, keyImage] : blockScanInfo.keyImagesToMarkSpent)
+    for (const auto &[publicKey, keyImage] : blockScanInfo.keyImagesToMarkSpent)
     {
         m_subWallets->markInputAsSpent(keyImage, publicKey, block.blockHeight);
     }
@@ -299,6 +451,8 @@ void WalletSynchronizer::processBlock(const wallet_types::WalletBlockInfo &block
     {
         m_eventHandler->onSynced.fire(block.blockHeight);
     }
+
+    return true;
 }
 
 BlockScanTmpInfo WalletSynchronizer::processBlockTransactions(
@@ -317,7 +471,7 @@ BlockScanTmpInfo WalletSynchronizer::processBlockTransactions(
         }
     }
 
-    for (const auto rawTX : block.transactions)
+    for (const auto &rawTX : block.transactions)
     {
         const auto [tx, keyImagesToMarkSpent] = processTransaction(
             block, inputs, rawTX);
@@ -342,7 +496,7 @@ std::optional<wallet_types::Transaction> WalletSynchronizer::processCoinbaseTran
     const wallet_types::WalletBlockInfo &block,
     const std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> &inputs) const
 {
-    const auto tx = block.coinbaseTransaction;
+    const auto &tx = block.coinbaseTransaction;
 
     std::unordered_map<crypto::PublicKey, int64_t> transfers;
 
@@ -429,36 +583,33 @@ std::tuple<std::optional<wallet_types::Transaction>, std::vector<std::tuple<cryp
 
 std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> WalletSynchronizer::processTransactionOutputs(
     const wallet_types::RawCoinbaseTransaction &rawTX,
-    const uint64_t blockHeight) const
+    const uint64_t blockHeight,
+    const crypto::SecretKey &privateViewKey,
+    const SubWallets &subWallets)
 {
     std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> inputs;
 
     crypto::KeyDerivation derivation;
 
-    crypto::generate_key_derivation(rawTX.transactionPublicKey, m_privateViewKey, derivation);
-
-    const std::vector<crypto::PublicKey> spendKeys = m_subWallets->m_publicSpendKeys;
+    crypto::generate_key_derivation(rawTX.transactionPublicKey, privateViewKey, derivation);
 
     uint64_t outputIndex = 0;
 
-    for (const auto output : rawTX.keyOutputs)
+    for (const auto &output : rawTX.keyOutputs)
     {
         crypto::PublicKey derivedSpendKey;
 
         crypto::underive_public_key(derivation, outputIndex, output.key, derivedSpendKey);
 
-        /* See if the derived spend key matches any of our spend keys */
-        const auto ourSpendKey = std::find(spendKeys.begin(), spendKeys.end(),
-                                           derivedSpendKey);
-
-        /* If it does, the transaction belongs to us */
-        if (ourSpendKey != spendKeys.end())
+        /* See if the derived spend key matches any of our spend keys. If it
+           does, the transaction belongs to us */
+        if (subWallets.hasSpendKey(derivedSpendKey))
         {
             /* We need to fill in the key image of the transaction input -
                we'll let the subwallet do this since we need the private spend
                key. We use the key images to detect outgoing transactions,
                and we use the transaction inputs to make transactions ourself */
-            const crypto::KeyImage keyImage = m_subWallets->getTxInputKeyImage(
+            const crypto::KeyImage keyImage = subWallets.getTxInputKeyImage(
                 derivedSpendKey, derivation, outputIndex);
 
             const uint64_t spendHeight = 0;
@@ -502,6 +653,16 @@ std::unordered_map<crypto::Hash, std::vector<uint64_t>> WalletSynchronizer::getG
     return indexes;
 }
 
+void WalletSynchronizer::checkLockedTransactionsIfSynced()
+{
+    /* If we're synced, check any transactions that may be in the pool */
+    if (getCurrentScanHeight() >= m_daemon->localDaemonBlockCount() &&
+        !m_subWallets->isViewWallet())
+    {
+        checkLockedTransactions();
+    }
+}
+
 void WalletSynchronizer::checkLockedTransactions()
 {
     /* Get the hashes of any locked tx's we have */
@@ -554,7 +715,23 @@ void WalletSynchronizer::start()
         throw std::runtime_error("Daemon has not been initialized!");
     }
 
+    /* Discard anything left in the queue from before we were stopped */
+    m_downloadGeneration++;
+
+    m_blockQueue.start();
+
     m_syncThread = std::thread(&WalletSynchronizer::mainLoop, this);
+
+    if (m_blockDownloader != nullptr)
+    {
+        m_blockDownloader->addWallet(this);
+    }
+    else
+    {
+        m_scanThreadPool = std::make_unique<ThreadPool>();
+
+        m_downloadThread = std::thread(&WalletSynchronizer::downloadLoop, this);
+    }
 }
 
 void WalletSynchronizer::stop()
@@ -562,11 +739,29 @@ void WalletSynchronizer::stop()
     /* Tell the threads to stop */
     m_shouldStop = true;
 
-    /* Wait for the block downloader thread to finish (if applicable) */
+    /* Wake up the threads if they're waiting on the queue */
+    m_blockQueue.stop();
+
+    /* Waits for the shared downloader to stop handing us blocks */
+    if (m_blockDownloader != nullptr)
+    {
+        m_blockDownloader->removeWallet(this);
+    }
+
+    /* Wait for the block downloader and processing threads to finish (if
+       applicable) */
+    if (m_downloadThread.joinable())
+    {
+        m_downloadThread.join();
+    }
+
     if (m_syncThread.joinable())
     {
         m_syncThread.join();
     }
+
+    /* Finishes any blocks still being scanned */
+    m_scanThreadPool.reset();
 }
 
 void WalletSynchronizer::reset(uint64_t startHeight)
@@ -607,6 +802,11 @@ void WalletSynchronizer::swapNode(const std::shared_ptr<Nigel> daemon)
     m_daemon = daemon;
 }
 
+void WalletSynchronizer::setBlockDownloader(const std::shared_ptr<SharedBlockDownloader> blockDownloader)
+{
+    m_blockDownloader = blockDownloader;
+}
+
 void WalletSynchronizer::fromJSON(const JSONObject &j)
 {
     m_syncStatus.fromJSON(getObjectFromJSON(j, "transactionSynchronizerStatus"));
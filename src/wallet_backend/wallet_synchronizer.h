@@ -5,6 +5,10 @@
 
 #pragma once
 
+#include <common/thread_pool.h>
+
+#include <future>
+
 #include <memory>
 
 #include <nigel/nigel.h>
@@ -33,6 +37,23 @@ struct BlockScanTmpInfo
     std::vector<std::tuple<crypto::PublicKey, crypto::KeyImage>> keyImagesToMarkSpent;
 };
 
+/* A downloaded block waiting to be processed. Finding which of its outputs
+   belong to us is independent of every other block, so is started on the
+   scanning threads as soon as the block is downloaded. */
+struct PendingBlock
+{
+    std::shared_ptr<const wallet_types::WalletBlockInfo> block;
+
+    /* The outputs of the block which belong to us */
+    std::shared_future<std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>>> ourInputs;
+
+    /* The download generation this block belongs to. Blocks from an older
+       generation are discarded. */
+    uint64_t generation = 0;
+};
+
+class SharedBlockDownloader;
+
 class WalletSynchronizer
 {
 public:
@@ -92,6 +113,39 @@ public:
 
     void setSyncStart(const uint64_t startTimestamp, const uint64_t startHeight);
 
+    /* Get blocks from the given downloader, shared with other wallets,
+       instead of downloading them ourselves. Pass nullptr to go back to
+       downloading them ourselves. Must be stopped. */
+    void setBlockDownloader(const std::shared_ptr<SharedBlockDownloader> blockDownloader);
+
+    ///////////////////////////////////////////////
+    /* Used by the shared block downloader thread */
+    ///////////////////////////////////////////////
+
+    /* The height of the next block we need */
+    uint64_t getDownloadHeight();
+
+    /* The block hashes, start height and start timestamp to request blocks
+       for us with */
+    std::tuple<std::vector<crypto::Hash>, uint64_t, uint64_t> getDownloadRequest();
+
+    /* Whether this block, downloaded for some wallet or other, is the next
+       one we need. downloadedForUs is whether it was downloaded with our
+       getDownloadRequest(). */
+    bool wantsBlock(
+        const wallet_types::WalletBlockInfo &block,
+        const bool downloadedForUs);
+
+    /* Queues a downloaded block to be processed, scanning its outputs on the
+       thread pool. Returns false if we're stopping. */
+    bool queueBlock(
+        const std::shared_ptr<const wallet_types::WalletBlockInfo> block,
+        ThreadPool &scanThreadPool);
+
+    /* Checks if our locked transactions have been cancelled, when we're
+       synced and there's nothing to download */
+    void checkLockedTransactionsIfSynced();
+
     /////////////////////////////
     /* Public member variables */
     /////////////////////////////
@@ -106,12 +160,27 @@ private:
 
     void mainLoop();
 
+    void downloadLoop();
+
     std::vector<wallet_types::WalletBlockInfo> downloadBlocks();
 
-    std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> processBlockOutputs(
-        const wallet_types::WalletBlockInfo &block) const;
+    /* Starts again from the last processed block, if the processing thread
+       asked us to */
+    void updateDownloadStatus();
+
+    /* Timestamp is transient and can change - block height is constant. */
+    void convertSyncTimestampToHeight(const uint64_t startHeight);
+
+    /* Static, as these run on the scanning threads, which may be shared with
+       other wallets, and finish after we've stopped */
+    static std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> processBlockOutputs(
+        const wallet_types::WalletBlockInfo &block,
+        const crypto::SecretKey &privateViewKey,
+        const SubWallets &subWallets);
 
-    void processBlock(const wallet_types::WalletBlockInfo &block);
+    bool processBlock(
+        const wallet_types::WalletBlockInfo &block,
+        std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> ourInputs);
 
     BlockScanTmpInfo processBlockTransactions(
         const wallet_types::WalletBlockInfo &block,
@@ -126,9 +195,11 @@ private:
         const std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> &inputs,
         const wallet_types::RawTransaction &tx) const;
 
-    std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> processTransactionOutputs(
+    static std::vector<std::tuple<crypto::PublicKey, wallet_types::TransactionInput>> processTransactionOutputs(
         const wallet_types::RawCoinbaseTransaction &rawTX,
-        const uint64_t blockHeight) const;
+        const uint64_t blockHeight,
+        const crypto::SecretKey &privateViewKey,
+        const SubWallets &subWallets);
 
     std::unordered_map<crypto::Hash, std::vector<uint64_t>> getGlobalIndexes(
         const uint64_t blockHeight) const;
@@ -141,14 +212,40 @@ private:
     /* Private member variables */
     //////////////////////////////
 
-    /* The thread ID of the block downloader thread */
+    /* The thread ID of the block processing thread */
     std::thread m_syncThread;
 
-    /* An atomic bool to signal if we should stop the sync thread */
+    /* The thread ID of the block downloader thread */
+    std::thread m_downloadThread;
+
+    /* An atomic bool to signal if we should stop the sync threads */
     std::atomic<bool> m_shouldStop;
 
+    /* The blocks we have processed */
     SynchronizationStatus m_syncStatus;
 
+    /* The blocks we have downloaded, which may be ahead of m_syncStatus.
+       Only touched by the downloader thread. */
+    SynchronizationStatus m_downloadStatus;
+
+    /* Bumped to make the downloader start again from the last processed
+       block, discarding anything downloaded but not yet processed */
+    std::atomic<uint64_t> m_downloadGeneration;
+
+    /* The generation m_downloadStatus belongs to. Only touched by the
+       downloader thread. */
+    uint64_t m_downloadStatusGeneration;
+
+    /* Downloaded blocks, in order, waiting to be processed */
+    ThreadSafeQueue<PendingBlock> m_blockQueue;
+
+    /* Derives the keys of downloaded blocks' outputs to find our own */
+    std::unique_ptr<ThreadPool> m_scanThreadPool;
+
+    /* Downloads and scans blocks for us and other wallets, in place of our
+       own download thread and scanning threads, if set */
+    std::shared_ptr<SharedBlockDownloader> m_blockDownloader;
+
     /* The timestamp to start scanning downloading block data from */
     uint64_t m_startTimestamp;
 